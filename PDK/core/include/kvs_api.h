@@ -267,6 +267,270 @@ kvs_result kvs_get_max_value_length(kvs_device_handle dev_hd, uint32_t *max_valu
 */
 kvs_result kvs_get_optimal_value_length(kvs_device_handle dev_hd, uint32_t *opt_value_length);
 
+/*
+* \ingroup device_interfaces
+*
+  This API returns the operation statistics of a device kept by the API library since the
+  device was opened or kvs_reset_stats() was called. Every store, retrieve, delete, exist and
+  iterator command is counted when it completes, with its latency from the submission to the
+  driver to the completion, so the time spent in driver queues is included. Counters are
+  per CPU and lock free. The same statistics are published in the shared memory object
+  kvs_stats.<pid>.<n> (see /dev/shm) while the device is open, which the kvstop tool reads.
+
+  PARAMETERS
+  IN dev_hd device handle
+  OUT stats operation statistics
+
+  RETURNS
+  KVS_SUCCESS for successful completion or an error code for error
+
+  ERROR CODE
+  KVS_ERR_PARAM_INVALID dev_hd or stats is NULL
+  KVS_ERR_DEV_NOT_OPENED the device is not opened
+*/
+kvs_result kvs_get_stats(kvs_device_handle dev_hd, kvs_stats *stats);
+
+/*
+* \ingroup device_interfaces
+*
+  This API restarts the operation statistics of a device, for kvs_get_stats() and the
+  shared memory object alike.
+
+  PARAMETERS
+  IN dev_hd device handle
+
+  RETURNS
+  KVS_SUCCESS for successful completion or an error code for error
+
+  ERROR CODE
+  KVS_ERR_PARAM_INVALID dev_hd is NULL
+  KVS_ERR_DEV_NOT_OPENED the device is not opened
+*/
+kvs_result kvs_reset_stats(kvs_device_handle dev_hd);
+
+/*
+* \ingroup device_interfaces
+*
+  This API starts a binary trace of all commands of all devices into a file. Every command is
+  recorded when it completes with the CPU timestamp counter (TSC) at its submission to the
+  driver, its dispatch to the device (not available with the user space driver), its
+  completion and the return of the user callback or the wake-up of the synchronous caller,
+  with the operation, a hash of the key, the value size and the result. Records go into lock
+  free per thread rings that a background thread writes out; records the writer falls behind
+  on are counted as dropped. The tool kvstrace decodes the file. Tracing can also be started
+  for the whole run by setting the environment variable KVSSD_TRACE to the file name.
+
+  PARAMETERS
+  IN path trace file, truncated if it exists
+
+  RETURNS
+  KVS_SUCCESS for successful completion or an error code for error
+
+  ERROR CODE
+  KVS_ERR_PARAM_INVALID path is NULL or a trace is already running
+  KVS_ERR_SYS_IO the file can't be created
+*/
+kvs_result kvs_start_trace(const char *path);
+
+/*
+* \ingroup device_interfaces
+*
+  This API stops the trace started by kvs_start_trace() and completes the trace file. It
+  does nothing if no trace is running. A running trace is also stopped when the last open
+  device is closed.
+
+  RETURNS
+  KVS_SUCCESS for successful completion or an error code for error
+
+  ERROR CODE
+  KVS_ERR_SYS_IO the file can't be written
+*/
+kvs_result kvs_stop_trace();
+
+/*
+* \ingroup device_interfaces
+*
+  This post process function queues the completion of an async command in a completion queue
+  instead of notifying the application. Pass it as post_fn to any async API with the queue,
+  created with kvs_create_completion_queue(), as private2, then collect the completions in
+  batches with kvs_get_completions(), e.g. from the event loop of the thread that owns the
+  queue. Threads that each reap their own queue only see the commands they submitted. An
+  async API rejects kvs_queue_completion() with a NULL private2 with KVS_ERR_PARAM_INVALID.
+  The kvs_postprocess_context is copied, so the key, value and private1 pointers it carries
+  stay valid only as long as the application keeps them.
+*/
+void kvs_queue_completion(kvs_postprocess_context *ctx);
+
+/*
+* \ingroup device_interfaces
+*
+  This API creates a completion queue for kvs_queue_completion(). A queue isn't tied to a
+  device or Key Space, commands of any of them may complete into it.
+
+  PARAMETERS
+  OUT cq the queue
+
+  RETURNS
+  KVS_SUCCESS for successful completion or an error code for error
+
+  ERROR CODE
+  KVS_ERR_PARAM_INVALID cq is NULL
+*/
+kvs_result kvs_create_completion_queue(kvs_completion_queue *cq);
+
+/*
+* \ingroup device_interfaces
+*
+  This API deletes a completion queue and closes its descriptor. No command that names it may
+  be in flight; completions still queued are discarded.
+
+  PARAMETERS
+  IN cq the queue
+
+  RETURNS
+  KVS_SUCCESS for successful completion or an error code for error
+
+  ERROR CODE
+  KVS_ERR_PARAM_INVALID cq is NULL
+*/
+kvs_result kvs_delete_completion_queue(kvs_completion_queue cq);
+
+/*
+* \ingroup device_interfaces
+*
+  This API takes up to max completions from a completion queue, in completion order. If none
+  is queued, it waits up to timeout_usec for the first one; a timeout of 0 returns at once.
+
+  PARAMETERS
+  IN cq completion queue
+  OUT events array of at least max contexts, the completions
+  IN max maximum number of completions to take
+  IN timeout_usec time to wait in microseconds when no completion is queued
+  OUT count number of completions taken, 0 if the wait timed out
+
+  RETURNS
+  KVS_SUCCESS for successful completion or an error code for error
+
+  ERROR CODE
+  KVS_ERR_PARAM_INVALID cq, events or count is NULL
+*/
+kvs_result kvs_get_completions(kvs_completion_queue cq, kvs_postprocess_context *events,
+  uint32_t max, uint32_t timeout_usec, uint32_t *count);
+
+/*
+* \ingroup device_interfaces
+*
+  This API returns a file descriptor that is readable while a completion queue holds
+  completions, so that a single-threaded event loop can wait for them with poll, select or
+  epoll together with its other descriptors and take them with kvs_get_completions() and a
+  timeout of 0. It stays readable until a kvs_get_completions() call empties the queue, so an
+  edge-triggered loop must reap until fewer than max completions are returned. The descriptor
+  belongs to the queue and is closed with it; the application must not read or close it.
+
+  PARAMETERS
+  IN cq completion queue
+  OUT fd the descriptor
+
+  RETURNS
+  KVS_SUCCESS for successful completion or an error code for error
+
+  ERROR CODE
+  KVS_ERR_PARAM_INVALID cq or fd is NULL
+  KVS_ERR_SYS_IO the descriptor can't be created
+*/
+kvs_result kvs_get_completion_fd(kvs_completion_queue cq, int *fd);
+
+/*
+* \ingroup device_interfaces
+*
+  This API sets how the host schedules the commands of the device among the QoS classes.
+  Once QoS is set on the device (here or with kvs_set_key_space_qos()), store, retrieve,
+  delete, exist and iterate next commands pass through a scheduler that dispatches them to
+  the driver while fewer than opt->max_inflight commands of the device and fewer than
+  opt->classes[c].max_inflight commands of class c are outstanding. Commands that can't
+  go are queued by class and classes with queued commands are served in proportion to
+  their weights. Without a device cap, classes only matter for their own caps. A zero
+  weight selects the default (8, 4 and 1 for high, normal and low), a zero cap means no
+  limit. The time commands spend queued is reported by class in kvs_stats.qos.
+  An async command may be submitted to the device after the call returns, so its key,
+  value and result buffers must stay valid until its completion, as they must anyway.
+  Values stored through packing or appends reach the device without the scheduler.
+  Scatter-gather and multi-range IO are scheduled like the single-value commands they fall
+  back to, the driver's native commands for them are not used while QoS is set.
+
+  PARAMETERS
+  IN dev_hd device handle
+  IN opt device and class caps and class weights
+
+  RETURNS
+  KVS_SUCCESS for successful completion or an error code for error
+
+  ERROR CODE
+  KVS_ERR_PARAM_INVALID dev_hd or opt is NULL
+  KVS_ERR_DEV_NOT_OPENED the device is not opened
+*/
+kvs_result kvs_set_qos(kvs_device_handle dev_hd, const kvs_qos_option *opt);
+
+/*
+* \ingroup device_interfaces
+*
+  This API sets the QoS class of the commands the calling thread issues afterwards, on any
+  device, in place of the class of their Key Space. KVS_QOS_INHERIT goes back to the class
+  of the Key Space.
+
+  PARAMETERS
+  IN qos_class QoS class
+
+  RETURNS
+  KVS_SUCCESS for successful completion or an error code for error
+
+  ERROR CODE
+  KVS_ERR_OPTION_INVALID qos_class is out of range
+*/
+kvs_result kvs_set_thread_qos_class(kvs_qos_class qos_class);
+
+/*
+* \ingroup device_interfaces
+*
+  This API allocates count requests for the *_req variants of the async APIs. A request holds
+  the per-command state of the driver, so an application that keeps one request per command
+  in flight, and reuses it once the command completes, submits without any allocation in the
+  library. A request carries one command at a time.
+
+  PARAMETERS
+  IN dev_hd device handle
+  IN count number of requests
+  OUT reqs array of count request handles
+
+  RETURNS
+  KVS_SUCCESS for successful completion or an error code for error
+
+  ERROR CODE
+  KVS_ERR_PARAM_INVALID dev_hd or reqs is NULL
+  KVS_ERR_DEV_NOT_OPENED the device is not opened
+*/
+kvs_result kvs_alloc_requests(kvs_device_handle dev_hd, uint32_t count, kvs_request_handle *reqs);
+
+/*
+* \ingroup device_interfaces
+*
+  This API frees requests allocated with kvs_alloc_requests(). No command may be in flight on
+  them. The handles are set to NULL.
+
+  PARAMETERS
+  IN dev_hd device handle the requests were allocated for
+  IN count number of requests
+  IN reqs array of count request handles
+
+  RETURNS
+  KVS_SUCCESS for successful completion or an error code for error
+
+  ERROR CODE
+  KVS_ERR_PARAM_INVALID dev_hd or reqs is NULL
+  KVS_ERR_DEV_NOT_OPENED the device is not opened
+*/
+kvs_result kvs_free_requests(kvs_device_handle dev_hd, uint32_t count, kvs_request_handle *reqs);
+
 /*
 * \ingroup device_interfaces
 *
@@ -515,12 +779,38 @@ kvs_result kvs_retrieve_kvp(kvs_key_space_handle ks_hd, kvs_key *key, kvs_option
 kvs_result kvs_retrieve_kvp_async(kvs_key_space_handle ks_hd, kvs_key *key, 
   kvs_option_retrieve *opt, void *private1, void *private2, kvs_value *value, kvs_postprocess_function post_fn);
 
+/*
+* \ingroup key_space_interfaces
+*
+  This API works as kvs_retrieve_kvp_async() but keeps the state of the command in req, a request allocated
+  with kvs_alloc_requests(), so that the library allocates nothing for it. req may be reused
+  once post_fn has been called for it. Packed and appended commands don't use req.
+
+  PARAMETERS
+  IN req request of the device of ks_hd, not in use by another command
+  the parameters of kvs_retrieve_kvp_async()
+
+  RETURNS
+  KVS_SUCCESS or an error code for error.
+
+  ERROR CODE
+  KVS_ERR_PARAM_INVALID req is NULL or belongs to another device
+  the error codes of kvs_retrieve_kvp_async()
+*/
+kvs_result kvs_retrieve_kvp_req(kvs_request_handle req, kvs_key_space_handle ks_hd, kvs_key *key,
+  kvs_option_retrieve *opt, void *private1, void *private2, kvs_value *value, kvs_postprocess_function post_fn);
+
 /*
 * \ingroup key_space_interfaces
 *
   This API writes a Key-value key value pair into a Key Space. This API supports the modes defined in section 5.4.9 as specified in opt.
   Store operations execute based on the existence of the key and the kvs_option_store specified. If the Key Space does not have enough space to store a key value pair,
   a KVS_ERR_KS_CAPACITY error message is returned.
+  KVS_STORE_APPEND appends the value to the existing one, or creates the pair when the key does not exist;
+  kvs_value.offset must be 0 and the appended value must not exceed KVS_MAX_VALUE_LENGTH. If the device
+  cannot append, or the key space packs small values, the append is done by the library as a read and a
+  store of the whole value; appends to the same key from this process are then serialized, but a concurrent
+  non-append store of the key may be lost.
 
   PARAMETERS
   IN ks_hd Key Space handle
@@ -552,6 +842,11 @@ kvs_result kvs_store_kvp(kvs_key_space_handle ks_hd, kvs_key *key, kvs_value *va
   The final execution results are returned to post process function through kvs_postprocess_context.
   Store operations execute based on the existence of the key and the kvs_option_store specified. If the Key Space does not have enough space to store a key value pair,
   a KVS_ERR_KS_CAPACITY error message is returned.
+  KVS_STORE_APPEND appends the value to the existing one, or creates the pair when the key does not exist;
+  kvs_value.offset must be 0 and the appended value must not exceed KVS_MAX_VALUE_LENGTH. If the device
+  cannot append, or the key space packs small values, the append is done by the library as a read and a
+  store of the whole value; appends to the same key from this process are then serialized, but a concurrent
+  non-append store of the key may be lost.
 
   PARAMETERS
   IN ks_hd Key Space handle
@@ -582,6 +877,185 @@ kvs_result kvs_store_kvp(kvs_key_space_handle ks_hd, kvs_key *key, kvs_value *va
 kvs_result kvs_store_kvp_async(kvs_key_space_handle ks_hd, kvs_key *key, kvs_value *value, 
   kvs_option_store *opt, void *private1, void *private2, kvs_postprocess_function post_fn);
 
+/*
+* \ingroup key_space_interfaces
+*
+  This API works as kvs_store_kvp_async() but keeps the state of the command in req, a request allocated
+  with kvs_alloc_requests(), so that the library allocates nothing for it. req may be reused
+  once post_fn has been called for it. Packed and appended commands don't use req.
+
+  PARAMETERS
+  IN req request of the device of ks_hd, not in use by another command
+  the parameters of kvs_store_kvp_async()
+
+  RETURNS
+  KVS_SUCCESS or an error code for error.
+
+  ERROR CODE
+  KVS_ERR_PARAM_INVALID req is NULL or belongs to another device
+  the error codes of kvs_store_kvp_async()
+*/
+kvs_result kvs_store_kvp_req(kvs_request_handle req, kvs_key_space_handle ks_hd, kvs_key *key,
+  kvs_value *value, kvs_option_store *opt, void *private1, void *private2, kvs_postprocess_function post_fn);
+
+/*
+* \ingroup key_space_interfaces
+*
+  This API works as kvs_store_kvp() but the value is gathered from value.seg_cnt segments in the order given.
+  The total length of the segments is the value length. Segments that are adjacent in memory, or a single
+  segment, are passed to the device as one buffer; otherwise the emulator gathers them directly into its storage
+  and the other drivers copy them into one buffer first.
+
+  PARAMETERS
+  IN ks_hd Key Space handle
+  IN key Key of the key value pair to store into Key Space
+  IN value segments of the value to store into Key Space
+  IN opt Store option
+
+  RETURNS
+  KVS_SUCCESS to indicate that store is successful or an error code for error.
+
+  ERROR CODE
+  the error codes of kvs_store_kvp()
+  KVS_ERR_PARAM_INVALID value.segs is NULL, value.seg_cnt is 0 or a segment buffer is NULL
+*/
+kvs_result kvs_store_kvpv(kvs_key_space_handle ks_hd, kvs_key *key, kvs_value_vec *value, kvs_option_store *opt);
+
+/*
+* \ingroup key_space_interfaces
+*
+  This API is the asynchronous version of kvs_store_kvpv(). The segments must stay valid until post_fn is called.
+  In kvs_postprocess_context, value is NULL and result_buffer.value_vec refers to the given value.
+
+  PARAMETERS
+  IN ks_hd Key Space handle
+  IN key Key of the key value pair to store into Key Space
+  IN value segments of the value to store into Key Space
+  IN opt Store option
+  IN private1 Structure passed that may be returned in the kvs_postprocess_context
+    after the async IO is completed
+  IN private2 Structure passed that may be returned in the kvs_postprocess_context
+    after the async IO is completed
+  IN post_fn post process function pointer
+
+  RETURNS
+  KVS_SUCCESS to indicate that store is successful or an error code for error.
+
+  ERROR CODE
+  the error codes of kvs_store_kvpv()
+*/
+kvs_result kvs_store_kvpv_async(kvs_key_space_handle ks_hd, kvs_key *key, kvs_value_vec *value,
+  kvs_option_store *opt, void *private1, void *private2, kvs_postprocess_function post_fn);
+
+/*
+* \ingroup key_space_interfaces
+*
+  This API works as kvs_retrieve_kvp() but scatters the value into value.seg_cnt segments in the order given.
+  The total length of the segments is the buffer size and must be a multiple of KVS_VALUE_LENGTH_ALIGNMENT_UNIT.
+  On return value.length is set to the number of bytes retrieved and value.actual_value_size to the value size
+  stored in the device.
+
+  PARAMETERS
+  IN ks_hd Key Space handle
+  IN key Key of the key value pair to get value
+  IN opt retrieve option
+  OUT value segments to receive the value
+
+  RETURNS
+  KVS_SUCCESS to indicate that retrieve is successful or an error code for error.
+
+  ERROR CODE
+  the error codes of kvs_retrieve_kvp()
+  KVS_ERR_PARAM_INVALID value.segs is NULL, value.seg_cnt is 0, a segment buffer is NULL or the total length is not aligned
+*/
+kvs_result kvs_retrieve_kvpv(kvs_key_space_handle ks_hd, kvs_key *key, kvs_option_retrieve *opt,
+  kvs_value_vec *value);
+
+/*
+* \ingroup key_space_interfaces
+*
+  This API is the asynchronous version of kvs_retrieve_kvpv(). In kvs_postprocess_context, value is NULL
+  and result_buffer.value_vec refers to the given value, whose lengths are set before post_fn is called.
+
+  PARAMETERS
+  IN ks_hd Key Space handle
+  IN key Key of the key value pair to get value
+  IN opt retrieve option
+  IN private1 Structure passed that may be returned in the kvs_postprocess_context
+    after the async IO is completed
+  IN private2 Structure passed that may be returned in the kvs_postprocess_context
+    after the async IO is completed
+  OUT value segments to receive the value
+  IN post_fn post process function pointer
+
+  RETURNS
+  KVS_SUCCESS to indicate that retrieve is successful or an error code for error.
+
+  ERROR CODE
+  the error codes of kvs_retrieve_kvpv()
+*/
+kvs_result kvs_retrieve_kvpv_async(kvs_key_space_handle ks_hd, kvs_key *key, kvs_option_retrieve *opt,
+  void *private1, void *private2, kvs_value_vec *value, kvs_postprocess_function post_fn);
+
+/*
+* \ingroup key_space_interfaces
+*
+  This API reads ranges.range_cnt byte ranges of the value of a key, each into its own buffer. The ranges
+  may be given in any order, need not be aligned and may overlap. A range that extends past the end of the
+  value receives the bytes that exist, and one that starts past the end receives none; actual_length of
+  each range is set to the number of bytes returned and ranges.actual_value_size to the value size.
+  Devices that cannot read several ranges with one command get the ranges merged into as few reads as
+  possible, ranges closer than KVS_RANGE_COALESCE_GAP bytes are served by the same read.
+
+  PARAMETERS
+  IN ks_hd Key Space handle
+  IN key Key of the key value pair to get value
+  IN opt retrieve option, kvs_retrieve_delete is not supported
+  OUT ranges ranges to read and their buffers
+
+  RETURNS
+  KVS_SUCCESS to indicate that retrieve is successful or an error code for error.
+
+  ERROR CODE
+  KVS_ERR_KS_NOT_OPEN key space is not opened
+  KVS_ERR_KEY_LENGTH_INVALID key length is out of range
+  KVS_ERR_KEY_NOT_EXIST key does not exist
+  KVS_ERR_OPTION_INVALID kvs_retrieve_delete is set
+  KVS_ERR_PARAM_INVALID ranges.ranges is NULL, ranges.range_cnt is 0 or more than KVS_MAX_VALUE_RANGES,
+    or a range buffer is NULL
+  KVS_ERR_VALUE_OFFSET_INVALID a range ends past KVS_MAX_VALUE_LENGTH
+*/
+kvs_result kvs_retrieve_kvp_ranges(kvs_key_space_handle ks_hd, kvs_key *key, kvs_option_retrieve *opt,
+  kvs_value_ranges *ranges);
+
+/*
+* \ingroup key_space_interfaces
+*
+  This API is the asynchronous version of kvs_retrieve_kvp_ranges(). In kvs_postprocess_context, value is
+  NULL and result_buffer.value_ranges refers to the given ranges, whose lengths are set before post_fn is
+  called.
+
+  PARAMETERS
+  IN ks_hd Key Space handle
+  IN key Key of the key value pair to get value
+  IN opt retrieve option, kvs_retrieve_delete is not supported
+  IN private1 Structure passed that may be returned in the kvs_postprocess_context
+    after the async IO is completed
+  IN private2 Structure passed that may be returned in the kvs_postprocess_context
+    after the async IO is completed
+  OUT ranges ranges to read and their buffers
+  IN post_fn post process function pointer
+
+  RETURNS
+  KVS_SUCCESS to indicate that retrieve is successful or an error code for error.
+
+  ERROR CODE
+  the error codes of kvs_retrieve_kvp_ranges()
+*/
+kvs_result kvs_retrieve_kvp_ranges_async(kvs_key_space_handle ks_hd, kvs_key *key,
+  kvs_option_retrieve *opt, void *private1, void *private2, kvs_value_ranges *ranges,
+  kvs_postprocess_function post_fn);
+
 /*
 * \ingroup key_space_interfaces
 *
@@ -633,6 +1107,27 @@ kvs_result kvs_delete_kvp(kvs_key_space_handle ks_hd, kvs_key* key, kvs_option_d
 kvs_result kvs_delete_kvp_async(kvs_key_space_handle ks_hd, kvs_key* key, 
   kvs_option_delete *opt, void *private1, void *private2, kvs_postprocess_function post_fn);
 
+/*
+* \ingroup key_space_interfaces
+*
+  This API works as kvs_delete_kvp_async() but keeps the state of the command in req, a request allocated
+  with kvs_alloc_requests(), so that the library allocates nothing for it. req may be reused
+  once post_fn has been called for it. Packed and appended commands don't use req.
+
+  PARAMETERS
+  IN req request of the device of ks_hd, not in use by another command
+  the parameters of kvs_delete_kvp_async()
+
+  RETURNS
+  KVS_SUCCESS or an error code for error.
+
+  ERROR CODE
+  KVS_ERR_PARAM_INVALID req is NULL or belongs to another device
+  the error codes of kvs_delete_kvp_async()
+*/
+kvs_result kvs_delete_kvp_req(kvs_request_handle req, kvs_key_space_handle ks_hd, kvs_key* key,
+  kvs_option_delete *opt, void *private1, void *private2, kvs_postprocess_function post_fn);
+
 /*
 * \ingroup key_space_interfaces
 *
@@ -686,6 +1181,8 @@ kvs_result kvs_delete_key_group_async(kvs_key_space_handle ks_hd,
   repeated routine calls may return different outputs in multi-threaded environments. One bit is used for each key.
   Therefore when 32 keys are intended to be checked, a caller should allocate 32 bits (i.e., 4 bytes) of memory buffer and the existence information is filled.
   The LSB (Least Significant Bit) of the list->result_buffer indicates if the first key exist or not.
+  On devices whose exist command carries one key, the keys are checked by single-key commands issued
+  in parallel, up to the configured queue depth at a time.
 
   PARAMETERS
   IN ks_hd Key Space handle
@@ -714,6 +1211,10 @@ kvs_result kvs_exist_kv_pairs(kvs_key_space_handle ks_hd, uint32_t key_cnt, kvs_
   Therefore, repeated routine calls is able to return different outputs in multi-threaded environments. One bit is used for each key.
   Therefore when 32 keys are intended to be checked, a caller shall allocate 32 bits (i.e., 4 bytes) of memory buffer and the existence information is filled.
   The LSB (Least Significant Bit) of the list->result_buffer indicates if the first key exist or not.
+  On devices whose exist command carries one key, the keys are checked by single-key commands, up to the
+  configured queue depth of them in flight. The others are submitted as those complete, so the call doesn't
+  wait for the device and may be made from a post process function. post_fn is called once, when every key
+  is checked.
 
   PARAMETERS
   IN ks_hd Key Space handle
@@ -739,6 +1240,27 @@ kvs_result kvs_exist_kv_pairs(kvs_key_space_handle ks_hd, uint32_t key_cnt, kvs_
 kvs_result kvs_exist_kv_pairs_async(kvs_key_space_handle ks_hd, uint32_t key_cnt, 
   kvs_key *keys, kvs_exist_list *list, void *private1, void *private2, kvs_postprocess_function post_fn);
 
+/*
+* \ingroup key_space_interfaces
+*
+  This API works as kvs_exist_kv_pairs_async() but keeps the state of the command in req, a request allocated
+  with kvs_alloc_requests(), so that the library allocates nothing for it. req may be reused
+  once post_fn has been called for it. Packed and appended commands don't use req.
+
+  PARAMETERS
+  IN req request of the device of ks_hd, not in use by another command
+  the parameters of kvs_exist_kv_pairs_async()
+
+  RETURNS
+  KVS_SUCCESS or an error code for error.
+
+  ERROR CODE
+  KVS_ERR_PARAM_INVALID req is NULL or belongs to another device
+  the error codes of kvs_exist_kv_pairs_async()
+*/
+kvs_result kvs_exist_kv_pairs_req(kvs_request_handle req, kvs_key_space_handle ks_hd, uint32_t key_cnt,
+  kvs_key *keys, kvs_exist_list *list, void *private1, void *private2, kvs_postprocess_function post_fn);
+
 
 /*
 * \defgroup iterator_interfaces
@@ -850,6 +1372,287 @@ kvs_result kvs_iterate_next(kvs_key_space_handle ks_hd, kvs_iterator_handle iter
 kvs_result kvs_iterate_next_async(kvs_key_space_handle ks_hd, kvs_iterator_handle iter_hd , 
   kvs_iterator_list *iter_list, void *private1, void *private2, kvs_postprocess_function post_fn);
 
+/*
+* \ingroup key_space_interfaces
+*
+  This API stores a key value pair whose value may be larger than KVS_MAX_VALUE_LENGTH. The value is split
+  into chunks of KVS_LARGE_VALUE_CHUNK_LENGTH bytes that are stored as separate key value pairs with up to
+  KVS_LARGE_VALUE_MAX_INFLIGHT asynchronous requests in flight, and the key itself holds a manifest describing
+  the chunks. On overwrite, the chunks of the new value are written before the manifest is replaced, so a reader
+  sees either the previous or the new value as a whole; the chunks of the previous value are deleted afterwards.
+  Chunk keys are visible to iterators. Values stored with this API must be read and deleted with
+  kvs_retrieve_large_kvp() and kvs_delete_large_kvp().
+
+  PARAMETERS
+  IN ks_hd Key Space handle
+  IN key key of the key value pair, at most KVS_MAX_LARGE_VALUE_KEY_LENGTH bytes
+  IN value value to store, value.offset must be 0
+  IN opt store option. KVS_STORE_APPEND is not supported.
+
+  RETURNS
+  KVS_SUCCESS to indicate that store is successful or an error code for error.
+
+  ERROR CODE
+  KVS_ERR_KS_NOT_EXIST Key Space with a given ks_hd does not exist
+  KVS_ERR_SYS_IO Communication with device failed
+  KVS_ERR_KEY_LENGTH_INVALID given key is not supported (e.g., length)
+  KVS_ERR_VALUE_OFFSET_INVALID value.offset is not 0
+  KVS_ERR_OPTION_INVALID the option is not supported
+  KVS_ERR_PARAM_INVALID key, value or opt is NULL
+  KVS_ERR_KEY_NOT_EXIST key does not exist and KVS_STORE_UPDATE_ONLY is given
+  KVS_ERR_VALUE_UPDATE_NOT_ALLOWED key exists and KVS_STORE_NOOVERWRITE is given
+*/
+kvs_result kvs_store_large_kvp(kvs_key_space_handle ks_hd, kvs_key *key, kvs_value *value, kvs_option_store *opt);
+
+/*
+* \ingroup key_space_interfaces
+*
+  This API retrieves a key value pair value stored with kvs_store_large_kvp(). value.length bytes starting at
+  value.offset are read and only the chunks covering that range are fetched, in parallel. On return value.length
+  is set to the number of bytes copied and value.actual_value_size to the total value size. The offset is required
+  to align to KVS_ALIGNMENT_UNIT. An ordinary key value pair is retrieved as kvs_retrieve_kvp() would.
+
+  PARAMETERS
+  IN ks_hd Key Space handle
+  IN key Key of the key value pair to get value
+  IN opt retrieval option
+  OUT value value to receive the requested range of the key value pair's value
+
+  RETURNS
+  KVS_SUCCESS to indicate that retrieve is successful or an error code for error.
+
+  ERROR CODE
+  KVS_ERR_VALUE_OFFSET_MISALIGNED kvs_value.offset is not aligned to KVS_ALIGNMENT_UNIT
+  KVS_ERR_VALUE_OFFSET_INVALID kvs_value.offset is beyond the end of the value
+  KVS_ERR_KS_NOT_EXIST Key Space with a given ks_hd does not exist
+  KVS_ERR_SYS_IO Communication with device failed
+  KVS_ERR_KEY_LENGTH_INVALID given key is not supported (e.g., length)
+  KVS_ERR_PARAM_INVALID key, value or opt is NULL
+  KVS_ERR_KEY_NOT_EXIST Key does not exist
+*/
+kvs_result kvs_retrieve_large_kvp(kvs_key_space_handle ks_hd, kvs_key *key, kvs_option_retrieve *opt, kvs_value *value);
+
+/*
+* \ingroup key_space_interfaces
+*
+  This API deletes a key value pair stored with kvs_store_large_kvp() together with all of its chunks.
+  The value becomes invisible before any chunk is deleted.
+
+  PARAMETERS
+  IN ks_hd Key Space handle
+  IN key key of the key value pair to delete
+  IN opt delete option
+
+  RETURNS
+  KVS_SUCCESS to indicate that delete is successful or an error code for error.
+
+  ERROR CODE
+  KVS_ERR_KS_NOT_EXIST Key Space with a given ks_hd does not exist
+  KVS_ERR_SYS_IO Communication with device failed
+  KVS_ERR_KEY_LENGTH_INVALID given key is not supported (e.g., length)
+  KVS_ERR_PARAM_INVALID key or opt is NULL
+  KVS_ERR_KEY_NOT_EXIST key does not exist and opt.kvs_delete_error is set
+*/
+kvs_result kvs_delete_large_kvp(kvs_key_space_handle ks_hd, kvs_key *key, kvs_option_delete *opt);
+
+/*
+* \ingroup key_space_interfaces
+*
+  This API deletes chunks of a large value left behind by a store or delete that was interrupted
+  (e.g., by a crash). Stores and deletes of the same key reclaim them as well.
+
+  PARAMETERS
+  IN ks_hd Key Space handle
+  IN key key of the large value
+
+  RETURNS
+  KVS_SUCCESS to indicate success or an error code for error.
+
+  ERROR CODE
+  KVS_ERR_KS_NOT_EXIST Key Space with a given ks_hd does not exist
+  KVS_ERR_SYS_IO Communication with device failed
+  KVS_ERR_KEY_LENGTH_INVALID given key is not supported (e.g., length)
+  KVS_ERR_PARAM_INVALID key is NULL
+  KVS_ERR_KEY_NOT_EXIST key does not exist
+*/
+kvs_result kvs_gc_large_kvp(kvs_key_space_handle ks_hd, kvs_key *key);
+
+/*
+* \ingroup key_space_interfaces
+*
+  This API enables coalescing of the retrieves of a Key Space. A retrieve of a key, offset and
+  value length that another retrieve of the process has in flight doesn't issue a device command:
+  it gets a copy of that command's value in its own buffer and its result, from the thread that
+  completes the command. Stores and deletes of a key through the API keep later retrieves from
+  joining the retrieves of the key in flight, but a retrieve that joined may return the value a
+  write replaced while the shared command was in flight. Retrieves with kvs_retrieve_delete are
+  not coalesced. A synchronous retrieve only joins synchronous ones, so it never waits for an
+  async command whose completion the calling thread would have to process. kvs_get_stats()
+  counts coalesced retrieves in coalesce_hits.
+  Coalescing must not be enabled or disabled while IOs to the Key Space are outstanding.
+
+  PARAMETERS
+  IN ks_hd Key Space handle
+
+  RETURNS
+  KVS_SUCCESS to indicate success or an error code for error.
+
+  ERROR CODE
+  KVS_ERR_KS_NOT_EXIST Key Space with a given ks_hd does not exist
+*/
+kvs_result kvs_enable_coalescing(kvs_key_space_handle ks_hd);
+
+/*
+* \ingroup key_space_interfaces
+*
+  This API disables coalescing of the retrieves of a Key Space.
+
+  PARAMETERS
+  IN ks_hd Key Space handle
+
+  RETURNS
+  KVS_SUCCESS to indicate success or an error code for error.
+
+  ERROR CODE
+  KVS_ERR_KS_NOT_EXIST Key Space with a given ks_hd does not exist
+*/
+kvs_result kvs_disable_coalescing(kvs_key_space_handle ks_hd);
+
+/*
+* \ingroup key_space_interfaces
+*
+  This API enables the negative lookup filter of a Key Space, a counting cuckoo filter of
+  the keys stored through the API on the host. A retrieve or exist of keys the filter
+  doesn't hold completes with KVS_ERR_KEY_NOT_EXIST, or with all exist bits cleared, without
+  a device command; the post process function of such an async request is called by a
+  thread of the filter. Keys that were stored are never reported missing; keys overwritten
+  and then deleted, and about one in 8000 keys that were never stored, still go to the device.
+  Deletes of the Key Space are issued with kvs_delete_error set so that only keys the device
+  had are taken out of the filter.
+  The filter is filled from an iterator over all keys of the Key Space (bitmask 0) and the
+  packed keys. kvs_close_key_space() stores it in the metadata Key Space and the next
+  kvs_open_key_space() loads it, so that the next call of this API doesn't need the scan.
+  kvs_get_stats() counts the lookups it answered in filter_negatives.
+  The filter must not be enabled or disabled while IOs to the Key Space are outstanding.
+
+  PARAMETERS
+  IN ks_hd Key Space handle
+  IN opt filter options, NULL or zero fields select the defaults
+
+  RETURNS
+  KVS_SUCCESS to indicate success or an error code for error.
+
+  ERROR CODE
+  KVS_ERR_KS_NOT_EXIST Key Space with a given ks_hd does not exist
+  KVS_ERR_OPTION_INVALID the Key Space has too many keys for opt->expected_keys
+  KVS_ERR_SYS_IO Communication with device failed or out of memory
+*/
+kvs_result kvs_enable_key_filter(kvs_key_space_handle ks_hd, const kvs_option_key_filter *opt);
+
+/*
+* \ingroup key_space_interfaces
+*
+  This API disables and drops the negative lookup filter of a Key Space. The next
+  kvs_enable_key_filter() rebuilds it.
+
+  PARAMETERS
+  IN ks_hd Key Space handle
+
+  RETURNS
+  KVS_SUCCESS to indicate success or an error code for error.
+
+  ERROR CODE
+  KVS_ERR_KS_NOT_EXIST Key Space with a given ks_hd does not exist
+*/
+kvs_result kvs_disable_key_filter(kvs_key_space_handle ks_hd);
+
+/*
+* \ingroup key_space_interfaces
+*
+  This API sets the QoS class and the rate limits of a Key Space, which then counts as a
+  tenant of the device scheduler (see kvs_set_qos()). Commands to the Key Space take one
+  IO token and one bandwidth token per value byte from token buckets that refill at
+  opt->iops_limit per second and opt->bandwidth_limit bytes per second and hold up to
+  opt->burst_ms milliseconds of tokens (KVS_QOS_BURST_MS if 0). A zero limit means no limit.
+  A command waiting for tokens holds back the later commands of its class. Calling it
+  again replaces the settings and refills the buckets.
+
+  PARAMETERS
+  IN ks_hd Key Space handle
+  IN opt QoS class and limits
+
+  RETURNS
+  KVS_SUCCESS to indicate success or an error code for error.
+
+  ERROR CODE
+  KVS_ERR_KS_NOT_EXIST Key Space with a given ks_hd does not exist
+  KVS_ERR_PARAM_INVALID opt is NULL
+  KVS_ERR_OPTION_INVALID opt->qos_class is out of range
+*/
+kvs_result kvs_set_key_space_qos(kvs_key_space_handle ks_hd, const kvs_option_key_space_qos *opt);
+
+/*
+* \ingroup key_space_interfaces
+*
+  This API enables small value packing on an opened Key Space. Stores of values up to
+  opt->max_value_len bytes are appended to containers of opt->container_size bytes that are
+  stored as key value pairs of the Key Space, and the host keeps an index of the packed keys.
+  Store, retrieve, delete and exist APIs of the Key Space work on packed and unpacked keys
+  alike. Containers with dead space above opt->compaction_threshold percent are compacted in
+  the background. The index is rebuilt from the containers recorded in the metadata Key Space
+  when packing is enabled again, e.g. after a crash.
+  Packed keys are not returned by iterators and can't be retrieved with kvs_retrieve_delete.
+  Packing must not be enabled or disabled while IOs to the Key Space are outstanding.
+
+  PARAMETERS
+  IN ks_hd Key Space handle
+  IN opt packing options, NULL or zero fields select the defaults
+
+  RETURNS
+  KVS_SUCCESS to indicate success or an error code for error.
+
+  ERROR CODE
+  KVS_ERR_KS_NOT_EXIST Key Space with a given ks_hd does not exist
+  KVS_ERR_OPTION_INVALID an option is out of range or packing is already enabled
+  KVS_ERR_SYS_IO Communication with device failed
+*/
+kvs_result kvs_enable_packing(kvs_key_space_handle ks_hd, kvs_option_packing *opt);
+
+/*
+* \ingroup key_space_interfaces
+*
+  This API writes all pending containers and disables small value packing on a Key Space.
+  kvs_close_key_space() disables packing as well.
+
+  PARAMETERS
+  IN ks_hd Key Space handle
+
+  RETURNS
+  KVS_SUCCESS to indicate success or an error code for error.
+
+  ERROR CODE
+  KVS_ERR_KS_NOT_EXIST Key Space with a given ks_hd does not exist
+  KVS_ERR_SYS_IO Communication with device failed
+*/
+kvs_result kvs_disable_packing(kvs_key_space_handle ks_hd);
+
+/*
+* \ingroup key_space_interfaces
+*
+  This API returns after all values packed before the call are stored in the device.
+
+  PARAMETERS
+  IN ks_hd Key Space handle
+
+  RETURNS
+  KVS_SUCCESS to indicate success or an error code for error.
+
+  ERROR CODE
+  KVS_ERR_KS_NOT_EXIST Key Space with a given ks_hd does not exist
+  KVS_ERR_SYS_IO Communication with device failed
+*/
+kvs_result kvs_flush_packing(kvs_key_space_handle ks_hd);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
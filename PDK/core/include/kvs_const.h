@@ -52,6 +52,24 @@ extern "C" {
 #define KVS_ITERATOR_BUFFER_SIZE (32*1024)
 #define MAX_CONT_PATH_LEN 255
 #define MAX_KEYSPACE_NAME_LEN MAX_CONT_PATH_LEN
+#define KVS_LARGE_VALUE_CHUNK_LENGTH (KVS_MAX_VALUE_LENGTH / 2) /* chunk size used by kvs_store_large_kvp, multiple of KVS_OPTIMAL_VALUE_LENGTH */
+#define KVS_LARGE_VALUE_MAX_INFLIGHT 32 /* max outstanding chunk IOs per large value request */
+#define KVS_MAX_LARGE_VALUE_KEY_LENGTH (KVS_MAX_KEY_LENGTH - 9) /* chunk keys append a 9-byte suffix */
+#define KVS_PACK_MAX_VALUE_LENGTH 1024 /* default max length of a value stored in a packing container */
+#define KVS_PACK_CONTAINER_LENGTH KVS_OPTIMAL_VALUE_LENGTH /* default packing container length */
+#define KVS_PACK_COMPACTION_THRESHOLD 50 /* default dead space in percent that triggers compaction of a container */
+#define KVS_PACK_FLUSH_DELAY_US 200 /* default max delay of a container write for asynchronous stores */
+#define KVS_MAX_VALUE_RANGES 64 /* max ranges of a kvs_retrieve_kvp_ranges request */
+#define KVS_RANGE_COALESCE_GAP (32*1024) /* ranges closer than this are read by one device command */
+#define KVS_STATS_OPS 8 /* operation statistics are indexed by kvs_context - 1 */
+#define KVS_STATS_KEY_SPACES 4 /* device key space ids, higher ids are counted in the last one */
+#define KVS_STATS_VALUE_CLASSES 5 /* value length < 512B, < 4KB, < 32KB, < 256KB, >= 256KB */
+#define KVS_STATS_RESULT_CLASSES 3 /* KVS_SUCCESS, KVS_ERR_KEY_NOT_EXIST, other errors */
+#define KVS_STATS_RESULTS 32 /* completions are counted by kvs_result below this */
+#define KVS_STATS_LAT_BUCKETS 128 /* log-linear latency buckets, 4 per power of 2 ns */
+#define KVS_QOS_CLASSES 3 /* priority classes of the host QoS scheduler */
+#define KVS_QOS_BURST_MS 100 /* default depth of the rate limit token buckets, in ms of the rate */
+#define KVS_KEY_FILTER_EXPECTED_KEYS (1024*1024) /* default number of keys a negative lookup filter is sized for */
 
 
 #ifdef __cplusplus
@@ -0,0 +1,450 @@
+/**
+ *   BSD LICENSE
+ *
+ *   Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Samsung Electronics Co., Ltd. nor the names of
+ *       its contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INCLUDE_KVS_CORO_HPP_
+#define INCLUDE_KVS_CORO_HPP_
+
+#if !defined(__cpp_impl_coroutine)
+#error "kvs_coro.hpp needs C++20 coroutines (e.g. -std=c++20)"
+#endif
+
+#include <stdint.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <utility>
+#include <vector>
+#include "kvs_api.h"
+
+/*
+ * C++20 coroutine front-end of the async API
+ *
+ * A reactor drives the commands of the coroutines running on one thread:
+ *
+ *   kvs::task<kvs_result> copy(kvs::reactor &r, kvs_key_space_handle ks, ...) {
+ *     kvs_result ret = co_await r.retrieve(ks, &key, &value);
+ *     if (ret == KVS_SUCCESS)
+ *       ret = co_await r.store(ks, &key2, &value);
+ *     co_return ret;
+ *   }
+ *
+ *   kvs::reactor r(dev_hd);
+ *   auto t = copy(r, ks, ...);
+ *   r.run(t);                 // or r.start(t) and r.poll() from an event loop on r.fd()
+ *
+ * A coroutine is resumed by poll() on the thread of the reactor, never on a
+ * completion thread of the driver. The state of an operation lives in the
+ * awaiting coroutine's frame and the driver's per-command state in requests
+ * the reactor allocates once (kvs_alloc_requests()), so an operation
+ * allocates nothing. At most 'depth' commands of a reactor are in flight; an
+ * operation beyond that waits for a request without blocking the thread.
+ *
+ * A reactor is not thread safe: create one per thread, and use it and the
+ * tasks it runs only from that thread. Keys, values and lists must stay
+ * valid until the operation returns, as for the async API.
+ */
+namespace kvs {
+
+class reactor;
+
+// cancels the operations given this token through reactor::cancel().
+// Operations that are not on the device yet return KVS_ERR_CANCELED; a
+// command already submitted can't be recalled and completes normally.
+class cancel_token {
+public:
+  bool cancelled() const { return cancelled_; }
+
+private:
+  friend class reactor;
+  bool cancelled_ = false;
+};
+
+// a lazily started coroutine returning T; co_await it from another task,
+// or start it with reactor::start()/run()
+template <typename T>
+class task;
+
+namespace detail {
+
+template <typename T>
+struct promise_base {
+  std::coroutine_handle<> continuation;
+  std::exception_ptr error;
+  bool started = false;
+
+  std::suspend_always initial_suspend() noexcept { return {}; }
+
+  struct final_awaiter {
+    bool await_ready() noexcept { return false; }
+    template <typename P>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+      auto next = h.promise().continuation;
+      return next ? next : std::noop_coroutine();
+    }
+    void await_resume() noexcept {}
+  };
+  final_awaiter final_suspend() noexcept { return {}; }
+  void unhandled_exception() { error = std::current_exception(); }
+};
+
+template <typename T>
+struct promise : promise_base<T> {
+  T value{};
+  task<T> get_return_object();
+  void return_value(T v) { value = std::move(v); }
+  T get() {
+    if (this->error) std::rethrow_exception(this->error);
+    return std::move(value);
+  }
+};
+
+template <>
+struct promise<void> : promise_base<void> {
+  task<void> get_return_object();
+  void return_void() {}
+  void get() {
+    if (this->error) std::rethrow_exception(this->error);
+  }
+};
+
+} // namespace detail
+
+template <typename T>
+class task {
+public:
+  typedef detail::promise<T> promise_type;
+  typedef std::coroutine_handle<promise_type> handle_type;
+
+  task() : h(nullptr) {}
+  explicit task(handle_type h_) : h(h_) {}
+  task(task &&o) noexcept : h(std::exchange(o.h, nullptr)) {}
+  task &operator=(task &&o) noexcept {
+    if (this != &o) {
+      if (h) h.destroy();
+      h = std::exchange(o.h, nullptr);
+    }
+    return *this;
+  }
+  task(const task &) = delete;
+  task &operator=(const task &) = delete;
+  ~task() { if (h) h.destroy(); }
+
+  bool done() const { return !h || h.done(); }
+  // the returned value, or the exception the coroutine ended with
+  T result() { return h.promise().get(); }
+
+  bool await_ready() const noexcept { return done(); }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept {
+    h.promise().continuation = caller;
+    if (h.promise().started) return std::noop_coroutine();
+    h.promise().started = true;
+    return h;
+  }
+  T await_resume() { return h.promise().get(); }
+
+private:
+  friend class reactor;
+  handle_type h;
+};
+
+namespace detail {
+
+template <typename T>
+task<T> promise<T>::get_return_object() {
+  return task<T>(std::coroutine_handle<promise<T> >::from_promise(*this));
+}
+
+inline task<void> promise<void>::get_return_object() {
+  return task<void>(std::coroutine_handle<promise<void> >::from_promise(*this));
+}
+
+} // namespace detail
+
+class reactor {
+public:
+  // one operation; co_await it for its kvs_result
+  class op {
+  public:
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> h) { waiter = h; return owner->begin(this); }
+    kvs_result await_resume() const noexcept { return result; }
+
+  private:
+    friend class reactor;
+    op(reactor *r, kvs_context c, kvs_key_space_handle k, cancel_token *t)
+      : owner(r), cmd(c), ks(k), token(t) {}
+
+    reactor *owner;
+    kvs_context cmd;
+    kvs_key_space_handle ks;
+    cancel_token *token;
+    kvs_key *key = nullptr;
+    kvs_value *value = nullptr;
+    uint32_t key_cnt = 0;
+    kvs_exist_list *exist_list = nullptr;
+    kvs_iterator_handle iter = 0;
+    kvs_iterator_list *iter_list = nullptr;
+    union {
+      kvs_option_store store;
+      kvs_option_retrieve retrieve;
+      kvs_option_delete remove;
+    } opt;
+
+    kvs_result result = KVS_SUCCESS;
+    kvs_request_handle req = nullptr;
+    std::coroutine_handle<> waiter;
+    op *next = nullptr;
+  };
+
+  // depth: the most commands in flight, and the requests allocated for them
+  explicit reactor(kvs_device_handle dev_hd, uint32_t depth = 64)
+    : dev(dev_hd), done_head(nullptr), wait_head(nullptr), wait_tail(nullptr), inflight(0) {
+    efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    reqs.resize(depth);
+    if (kvs_alloc_requests(dev, depth, reqs.data()) != KVS_SUCCESS) reqs.clear();
+    free_reqs = reqs;
+  }
+  ~reactor() {
+    if (!reqs.empty()) kvs_free_requests(dev, (uint32_t)reqs.size(), reqs.data());
+    if (efd >= 0) ::close(efd);
+  }
+  reactor(const reactor &) = delete;
+  reactor &operator=(const reactor &) = delete;
+
+  op store(kvs_key_space_handle ks, kvs_key *key, kvs_value *value,
+           kvs_option_store opt = {KVS_STORE_POST, nullptr}, cancel_token *token = nullptr) {
+    op o(this, KVS_CMD_STORE, ks, token);
+    o.key = key; o.value = value; o.opt.store = opt;
+    return o;
+  }
+  op retrieve(kvs_key_space_handle ks, kvs_key *key, kvs_value *value,
+              kvs_option_retrieve opt = {false}, cancel_token *token = nullptr) {
+    op o(this, KVS_CMD_RETRIEVE, ks, token);
+    o.key = key; o.value = value; o.opt.retrieve = opt;
+    return o;
+  }
+  op remove(kvs_key_space_handle ks, kvs_key *key,
+            kvs_option_delete opt = {false}, cancel_token *token = nullptr) {
+    op o(this, KVS_CMD_DELETE, ks, token);
+    o.key = key; o.opt.remove = opt;
+    return o;
+  }
+  op exist(kvs_key_space_handle ks, uint32_t key_cnt, kvs_key *keys, kvs_exist_list *list,
+           cancel_token *token = nullptr) {
+    op o(this, KVS_CMD_EXIST, ks, token);
+    o.key_cnt = key_cnt; o.key = keys; o.exist_list = list;
+    return o;
+  }
+  op iterate_next(kvs_key_space_handle ks, kvs_iterator_handle iter, kvs_iterator_list *list,
+                  cancel_token *token = nullptr) {
+    op o(this, KVS_CMD_ITER_NEXT, ks, token);
+    o.iter = iter; o.iter_list = list;
+    return o;
+  }
+
+  // readable when completed commands wait for poll(), for an event loop
+  int fd() const { return efd; }
+  uint32_t in_flight() const { return inflight; }
+
+  // runs t until its first operation is submitted; a no-op once started
+  template <typename T>
+  void start(task<T> &t) {
+    if (t.h && !t.h.promise().started) {
+      t.h.promise().started = true;
+      t.h.resume();
+    }
+  }
+
+  // starts t if needed and polls until it is done; returns its result
+  template <typename T>
+  T run(task<T> &t) {
+    start(t);
+    while (!t.done()) poll(-1);
+    return t.result();
+  }
+
+  // resumes the coroutines whose commands completed, waiting up to
+  // timeout_ms (-1 forever) for the first one; returns how many were resumed
+  uint32_t poll(int timeout_ms = 0) {
+    if (done_head.load(std::memory_order_acquire) == nullptr && timeout_ms != 0) {
+      struct pollfd pfd = {efd, POLLIN, 0};
+      ::poll(&pfd, 1, timeout_ms);
+    }
+    uint64_t cnt;
+    if (::read(efd, &cnt, sizeof(cnt)) < 0) {}
+    op *o = done_head.exchange(nullptr, std::memory_order_acquire);
+    // the completion threads push in front, resume in completion order
+    op *list = nullptr;
+    while (o) {
+      op *next = o->next;
+      o->next = list;
+      list = o;
+      o = next;
+    }
+    uint32_t n = 0;
+    while (list) {
+      o = list;
+      list = o->next;
+      release(o);
+      o->waiter.resume();
+      n++;
+    }
+    return n;
+  }
+
+  // cancels the operations given token that wait for a request; later
+  // operations with it return KVS_ERR_CANCELED at once
+  void cancel(cancel_token &token) {
+    token.cancelled_ = true;
+    op *cancelled = nullptr, **tail = &cancelled;
+    op **p = &wait_head;
+    wait_tail = nullptr;
+    while (*p) {
+      op *o = *p;
+      if (o->token == &token) {
+        *p = o->next;
+        *tail = o;
+        tail = &o->next;
+        o->next = nullptr;
+      } else {
+        wait_tail = o;
+        p = &o->next;
+      }
+    }
+    while (cancelled) {
+      op *o = cancelled;
+      cancelled = o->next;
+      o->result = KVS_ERR_CANCELED;
+      o->waiter.resume();
+    }
+  }
+
+private:
+  kvs_device_handle dev;
+  int efd;
+  std::vector<kvs_request_handle> reqs;
+  std::vector<kvs_request_handle> free_reqs;
+  std::atomic<op *> done_head;  // completed, pushed by the completion threads
+  op *wait_head, *wait_tail;    // waiting for a request
+  uint32_t inflight;
+
+  // true if the coroutine stays suspended
+  bool begin(op *o) {
+    if (o->token && o->token->cancelled()) {
+      o->result = KVS_ERR_CANCELED;
+      return false;
+    }
+    if (inflight == depth()) {
+      o->next = nullptr;
+      if (wait_tail) wait_tail->next = o; else wait_head = o;
+      wait_tail = o;
+      return true;
+    }
+    return submit(o);
+  }
+
+  uint32_t depth() const { return reqs.empty() ? 64 : (uint32_t)reqs.size(); }
+
+  bool submit(op *o) {
+    if (!free_reqs.empty()) {
+      o->req = free_reqs.back();
+      free_reqs.pop_back();
+    }
+    o->result = issue(o);
+    if (o->result != KVS_SUCCESS) {
+      if (o->req) free_reqs.push_back(o->req);
+      o->req = nullptr;
+      return false;
+    }
+    inflight++;
+    return true;
+  }
+
+  kvs_result issue(op *o) {
+    // without requests (allocation failed) the plain async API is used
+    switch (o->cmd) {
+    case KVS_CMD_STORE:
+      return o->req ? kvs_store_kvp_req(o->req, o->ks, o->key, o->value, &o->opt.store, o, nullptr, on_complete)
+                    : kvs_store_kvp_async(o->ks, o->key, o->value, &o->opt.store, o, nullptr, on_complete);
+    case KVS_CMD_RETRIEVE:
+      return o->req ? kvs_retrieve_kvp_req(o->req, o->ks, o->key, &o->opt.retrieve, o, nullptr, o->value, on_complete)
+                    : kvs_retrieve_kvp_async(o->ks, o->key, &o->opt.retrieve, o, nullptr, o->value, on_complete);
+    case KVS_CMD_DELETE:
+      return o->req ? kvs_delete_kvp_req(o->req, o->ks, o->key, &o->opt.remove, o, nullptr, on_complete)
+                    : kvs_delete_kvp_async(o->ks, o->key, &o->opt.remove, o, nullptr, on_complete);
+    case KVS_CMD_EXIST:
+      return o->req ? kvs_exist_kv_pairs_req(o->req, o->ks, o->key_cnt, o->key, o->exist_list, o, nullptr, on_complete)
+                    : kvs_exist_kv_pairs_async(o->ks, o->key_cnt, o->key, o->exist_list, o, nullptr, on_complete);
+    case KVS_CMD_ITER_NEXT:
+      return kvs_iterate_next_async(o->ks, o->iter, o->iter_list, o, nullptr, on_complete);
+    default:
+      return KVS_ERR_PARAM_INVALID;
+    }
+  }
+
+  // hands the request of a completed command to the first waiting operation
+  void release(op *o) {
+    inflight--;
+    if (o->req) free_reqs.push_back(o->req);
+    o->req = nullptr;
+    while (wait_head && inflight < depth()) {
+      op *w = wait_head;
+      wait_head = w->next;
+      if (!wait_head) wait_tail = nullptr;
+      if (!submit(w)) w->waiter.resume();
+    }
+  }
+
+  // on a completion thread of the driver
+  static void on_complete(kvs_postprocess_context *ctx) {
+    op *o = (op *)ctx->private1;
+    reactor *r = o->owner;
+    o->result = ctx->result;
+    op *head = r->done_head.load(std::memory_order_relaxed);
+    do {
+      o->next = head;
+    } while (!r->done_head.compare_exchange_weak(head, o, std::memory_order_release,
+                                                 std::memory_order_relaxed));
+    if (head == nullptr) {
+      uint64_t one = 1;
+      if (::write(r->efd, &one, sizeof(one)) < 0) {}
+    }
+  }
+};
+
+} // namespace kvs
+
+#endif /* INCLUDE_KVS_CORO_HPP_ */
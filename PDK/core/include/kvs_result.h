@@ -66,6 +66,7 @@ typedef enum {
   KVS_ERR_VALUE_OFFSET_MISALIGNED = 0x016,    // offset of value is required to be aligned to KVS_ALIGNMENT_UNIT
   KVS_ERR_VALUE_UPDATE_NOT_ALLOWED = 0x017,   // key exists but value update is not allowed
   KVS_ERR_DEV_NOT_OPENED          = 0x018,    // device was not opened yet
+  KVS_ERR_CANCELED                = 0x019,    // the operation was cancelled before it was submitted
 } kvs_result;
 
 #ifdef __cplusplus
@@ -111,6 +111,32 @@ typedef struct {
   uint32_t offset;                // [OPTION] offset to indicate the offset of value stored in device
 } kvs_value;
 
+typedef struct {
+  void *value;                    // start address of the segment buffer
+  uint32_t length;                // the length of the segment buffer in bytes
+} kvs_value_segment;
+
+typedef struct {
+  kvs_value_segment *segs;        // buffers that hold the value byte stream, in order
+  uint32_t seg_cnt;               // number of segments
+  uint32_t length;                // [OUT] retrieve: bytes of the value returned in the segments
+  uint32_t actual_value_size;     // [OUT] retrieve: actual value size in bytes that is stored in a device
+  uint32_t offset;                // [OPTION] offset to indicate the offset of value stored in device
+} kvs_value_vec;
+
+typedef struct {
+  uint32_t offset;                // offset of the range in the value, no alignment is required
+  uint32_t length;                // the length of the range and of its buffer in bytes
+  void *value;                    // start address of buffer for the range
+  uint32_t actual_length;         // [OUT] bytes of the range returned, less than length at the end of the value
+} kvs_value_range;
+
+typedef struct {
+  kvs_value_range *ranges;        // ranges to read, in any order
+  uint32_t range_cnt;             // number of ranges
+  uint32_t actual_value_size;     // [OUT] actual value size in bytes that is stored in a device
+} kvs_value_ranges;
+
 typedef struct {
   kvs_association_type assoc_type;  // association type for a group of associated key value pairs.
   uint16_t assoc_hint;              // association hint (e.g. stream id)
@@ -121,10 +147,50 @@ typedef struct {
   kvs_association *assoc;         // association
 } kvs_option_store;
 
+typedef struct {
+  uint32_t max_value_len;         // values up to this length are packed, 0 for KVS_PACK_MAX_VALUE_LENGTH
+  uint32_t container_size;        // container length in bytes, 0 for KVS_PACK_CONTAINER_LENGTH
+  uint8_t compaction_threshold;   // dead space in percent that triggers compaction, 0 for KVS_PACK_COMPACTION_THRESHOLD
+  uint32_t flush_delay_us;        // max time an asynchronous store waits for other stores, 0 for KVS_PACK_FLUSH_DELAY_US
+} kvs_option_packing;
+
+typedef enum {
+  KVS_QOS_HIGH = 0,       // latency critical foreground commands
+  KVS_QOS_NORMAL = 1,     // default class
+  KVS_QOS_LOW = 2,        // background work, e.g. scans and bulk loads
+  KVS_QOS_INHERIT = 3,    // kvs_set_thread_qos_class(): the class of the key space
+} kvs_qos_class;
+
+typedef struct {
+  uint32_t weight;        // share of the dispatches while classes wait, 0 for the default (8, 4, 1)
+  uint32_t max_inflight;  // commands of the class on the device at once, 0 for no cap
+} kvs_qos_class_option;
+
+typedef struct {
+  uint32_t max_inflight;  // commands on the device at once, 0 for no cap
+  kvs_qos_class_option classes[KVS_QOS_CLASSES];  // indexed by kvs_qos_class
+} kvs_qos_option;
+
+typedef struct {
+  kvs_qos_class qos_class;  // class of the commands of the key space
+  uint32_t iops_limit;      // commands per second, 0 for no limit
+  uint64_t bandwidth_limit; // value bytes per second, 0 for no limit
+  uint32_t burst_ms;        // token bucket depth in ms of the limits, 0 for KVS_QOS_BURST_MS
+} kvs_option_key_space_qos;
+
+typedef struct {
+  uint64_t expected_keys;   // keys the filter is sized for, 0 for the persisted size or KVS_KEY_FILTER_EXPECTED_KEYS
+  bool rebuild;             // rebuild from the keys of the key space even if a filter was loaded
+} kvs_option_key_filter;
+
 struct _kvs_device_handle;
 struct _kvs_key_space_handle;
+struct _kvs_request;
+struct _kvs_completion_queue;
 typedef struct _kvs_device_handle* kvs_device_handle;    // type definition of kvs_device_handle
 typedef struct _kvs_key_space_handle* kvs_key_space_handle; // type definition of kvs_key_space_handle
+typedef struct _kvs_request* kvs_request_handle;           // caller-owned async request, see kvs_alloc_requests()
+typedef struct _kvs_completion_queue* kvs_completion_queue; // caller-created completion queue, see kvs_create_completion_queue()
 typedef uint8_t kvs_iterator_handle;  // type definition of kvs_iterator_handle
 
 typedef struct {
@@ -182,6 +248,8 @@ typedef struct {
   union {
     kvs_iterator_list* iter_list;
     kvs_exist_list* list;
+    kvs_value_vec* value_vec;     // scatter-gather store and retrieve, value is NULL
+    kvs_value_ranges* value_ranges; // multi-range retrieve, value is NULL
   }result_buffer;
 } kvs_postprocess_context;
 
@@ -193,6 +261,28 @@ typedef struct {
   uint32_t value_len; // value length in bytes
 } kvs_kvp_info;
 
+// latency bucket b < 4 holds b ns, bucket b >= 4 holds
+// [(4 + b % 4) << (b / 4 - 1), (5 + b % 4) << (b / 4 - 1)) ns, the last one everything above
+typedef struct {
+  uint64_t count;                           // completed operations
+  uint64_t bytes;                           // value bytes stored or returned
+  uint64_t latency_sum_ns;                  // sum of submission to completion latencies
+  uint64_t latency[KVS_STATS_LAT_BUCKETS];  // latency histogram
+} kvs_stats_cell;
+
+typedef struct {
+  // by operation, device key space id, value length class and result class
+  kvs_stats_cell cells[KVS_STATS_OPS][KVS_STATS_KEY_SPACES][KVS_STATS_VALUE_CLASSES][KVS_STATS_RESULT_CLASSES];
+  uint64_t results[KVS_STATS_OPS][KVS_STATS_RESULTS];  // completions by operation and result code
+  // by QoS class, commands dispatched by the host scheduler and their queueing delay in latency
+  kvs_stats_cell qos[KVS_QOS_CLASSES];
+  uint64_t coalesce_hits;                   // retrieves that shared the device command of another retrieve
+  uint64_t coalesce_misses;                 // retrieves of key spaces with coalescing that issued their own
+  uint64_t filter_negatives;                // lookups that the key filter answered without a device command
+  uint64_t filter_passes;                   // lookups of key spaces with a key filter that went to the device
+  uint64_t elapsed_ns;                      // time since the device was opened or the stats were reset
+} kvs_stats;
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
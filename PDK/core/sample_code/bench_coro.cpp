@@ -0,0 +1,257 @@
+/**
+ *   BSD LICENSE
+ *
+ *   Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Samsung Electronics Co., Ltd. nor the names of
+ *       its contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Compares the coroutine front-end (kvs_coro.hpp) with the callback API:
+ * the same stores, then retrieves, at the same queue depth, from one
+ * submitting thread. Heap allocations are counted through operator new.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <vector>
+#include <kvs_coro.hpp>
+
+static std::atomic<uint64_t> heap_allocs(0);
+
+void *operator new(size_t size) {
+  heap_allocs.fetch_add(1, std::memory_order_relaxed);
+  void *p = malloc(size ? size : 1);
+  if (p == NULL) throw std::bad_alloc();
+  return p;
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+struct bench_args {
+  kvs_device_handle dev;
+  kvs_key_space_handle ks;
+  int count;
+  int qdepth;
+  uint16_t klen;
+  uint32_t vlen;
+  std::vector<char> keys;      // count keys of klen bytes
+  std::vector<char> values;    // qdepth buffers of vlen bytes
+  char *key(int i) { return &keys[(size_t)i * klen]; }
+  char *value(int slot) { return &values[(size_t)slot * vlen]; }
+};
+
+static double now_sec() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void report(const char *api, const char *op, int count, double sec, uint64_t allocs, int errors) {
+  fprintf(stdout, "%-9s %-9s %10.0f ops/sec  %6.2f heap allocations/op  %d errors\n",
+    api, op, count / sec, (double)allocs / count, errors);
+}
+
+/* callback API: a free list of buffer slots refilled from the completion thread */
+struct callback_state {
+  std::mutex lock;
+  std::condition_variable cond;
+  std::vector<int> free_slots;
+  int done = 0;
+  int errors = 0;
+};
+
+static void callback_complete(kvs_postprocess_context *ctx) {
+  callback_state *st = (callback_state *)ctx->private2;
+  std::unique_lock<std::mutex> guard(st->lock);
+  if (ctx->result != KVS_SUCCESS) st->errors++;
+  st->free_slots.push_back((int)(intptr_t)ctx->private1);
+  st->done++;
+  st->cond.notify_one();
+}
+
+static void bench_callback(bench_args &a, kvs_context op, const char *label = "callback") {
+  callback_state st;
+  std::vector<kvs_key> keys(a.qdepth);
+  std::vector<kvs_value> values(a.qdepth);
+  for (int i = 0; i < a.qdepth; i++) st.free_slots.push_back(i);
+  kvs_option_store sopt = {KVS_STORE_POST, NULL};
+  kvs_option_retrieve ropt = {false};
+
+  uint64_t allocs = heap_allocs.load();
+  double start = now_sec();
+  for (int i = 0; i < a.count; i++) {
+    int slot;
+    {
+      std::unique_lock<std::mutex> guard(st.lock);
+      st.cond.wait(guard, [&st] { return !st.free_slots.empty(); });
+      slot = st.free_slots.back();
+      st.free_slots.pop_back();
+    }
+    keys[slot].key = a.key(i);
+    keys[slot].length = a.klen;
+    values[slot].value = a.value(slot);
+    values[slot].length = a.vlen;
+    values[slot].actual_value_size = 0;
+    values[slot].offset = 0;
+    kvs_result ret = (op == KVS_CMD_STORE) ?
+      kvs_store_kvp_async(a.ks, &keys[slot], &values[slot], &sopt, (void *)(intptr_t)slot, &st, callback_complete) :
+      kvs_retrieve_kvp_async(a.ks, &keys[slot], &ropt, (void *)(intptr_t)slot, &st, &values[slot], callback_complete);
+    if (ret != KVS_SUCCESS) {
+      std::unique_lock<std::mutex> guard(st.lock);
+      st.errors++;
+      st.done++;
+      st.free_slots.push_back(slot);
+    }
+  }
+  {
+    std::unique_lock<std::mutex> guard(st.lock);
+    st.cond.wait(guard, [&st, &a] { return st.done == a.count; });
+  }
+  report(label, op == KVS_CMD_STORE ? "store" : "retrieve", a.count, now_sec() - start,
+    heap_allocs.load() - allocs, st.errors);
+}
+
+/* coroutines: qdepth workers, each issuing its share of the commands in turn */
+static kvs::task<int> worker(kvs::reactor &r, bench_args &a, kvs_context op, int id) {
+  kvs_key key;
+  kvs_value value;
+  int errors = 0;
+  for (int i = id; i < a.count; i += a.qdepth) {
+    key.key = a.key(i);
+    key.length = a.klen;
+    value.value = a.value(id);
+    value.length = a.vlen;
+    value.actual_value_size = 0;
+    value.offset = 0;
+    kvs_result ret = (op == KVS_CMD_STORE) ? co_await r.store(a.ks, &key, &value) :
+      co_await r.retrieve(a.ks, &key, &value);
+    if (ret != KVS_SUCCESS) errors++;
+  }
+  co_return errors;
+}
+
+static void bench_coro(bench_args &a, kvs_context op) {
+  kvs::reactor r(a.dev, a.qdepth);
+  std::vector<kvs::task<int> > workers;
+  workers.reserve(a.qdepth);
+  for (int i = 0; i < a.qdepth; i++) workers.push_back(worker(r, a, op, i));
+
+  // the coroutine frames are allocated once per worker, not per command
+  uint64_t allocs = heap_allocs.load();
+  double start = now_sec();
+  for (auto &w : workers) r.start(w);
+  int errors = 0;
+  for (auto &w : workers) errors += r.run(w);
+  report("coroutine", op == KVS_CMD_STORE ? "store" : "retrieve", a.count, now_sec() - start,
+    heap_allocs.load() - allocs, errors);
+}
+
+static int env_init(char *dev_path, bench_args &a) {
+  kvs_result ret = kvs_open_device(dev_path, &a.dev);
+  if (ret != KVS_SUCCESS) {
+    fprintf(stderr, "Device open failed 0x%x\n", ret);
+    return 1;
+  }
+  char name[] = "bench_coro";
+  kvs_key_space_name ks_name = {(uint32_t)strlen(name), name};
+  kvs_option_key_space option = {KVS_KEY_ORDER_NONE};
+  kvs_delete_key_space(a.dev, &ks_name);
+  ret = kvs_create_key_space(a.dev, &ks_name, 0, option);
+  if (ret == KVS_SUCCESS) ret = kvs_open_key_space(a.dev, name, &a.ks);
+  if (ret != KVS_SUCCESS) {
+    fprintf(stderr, "Key space setup failed 0x%x\n", ret);
+    kvs_close_device(a.dev);
+    return 1;
+  }
+  return 0;
+}
+
+static void env_exit(bench_args &a) {
+  char name[] = "bench_coro";
+  kvs_key_space_name ks_name = {(uint32_t)strlen(name), name};
+  kvs_close_key_space(a.ks);
+  kvs_delete_key_space(a.dev, &ks_name);
+  kvs_close_device(a.dev);
+}
+
+static void usage(const char *prog) {
+  fprintf(stdout, "%s -d device_path [-n num_ios] [-q queue_depth] [-k klen] [-v vlen]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+  char *dev_path = NULL;
+  bench_args a;
+  a.count = 100000;
+  a.qdepth = 64;
+  a.klen = 16;
+  a.vlen = 4096;
+  int c;
+
+  while ((c = getopt(argc, argv, "d:n:q:k:v:h")) != -1) {
+    switch (c) {
+      case 'd': dev_path = optarg; break;
+      case 'n': a.count = atoi(optarg); break;
+      case 'q': a.qdepth = atoi(optarg); break;
+      case 'k': a.klen = atoi(optarg); break;
+      case 'v': a.vlen = atoi(optarg); break;
+      default: usage(argv[0]); return 0;
+    }
+  }
+  if (dev_path == NULL || a.count <= 0 || a.qdepth <= 0 || a.klen < 10 || a.klen > KVS_MAX_KEY_LENGTH) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  a.keys.resize((size_t)a.count * a.klen);
+  a.values.resize((size_t)a.qdepth * a.vlen, 'v');
+  for (int i = 0; i < a.count; i++) {
+    char buf[16];
+    int len = snprintf(buf, sizeof(buf), "%08d", i);
+    memset(a.key(i), '0', a.klen);
+    memcpy(a.key(i) + a.klen - len, buf, len);
+  }
+  if (env_init(dev_path, a)) return 1;
+
+  // creates the keys, so that the measured stores all overwrite
+  bench_callback(a, KVS_CMD_STORE, "populate");
+  bench_callback(a, KVS_CMD_STORE);
+  bench_callback(a, KVS_CMD_RETRIEVE);
+  bench_coro(a, KVS_CMD_STORE);
+  bench_coro(a, KVS_CMD_RETRIEVE);
+
+  env_exit(a);
+  return 0;
+}
@@ -64,6 +64,9 @@ class KvEmulator: public KvsDriver {
     std::atomic<int> done_sync;
     std::condition_variable done_cond_sync;
     bool syncio;
+    uint64_t submit_ns;
+    uint64_t submit_tsc;
+    bool from_request;  // embedded in a caller-owned request, never pooled
   } kv_emul_context;
 
   kv_interrupt_handler int_handler;
@@ -76,22 +79,24 @@ class KvEmulator: public KvsDriver {
   virtual int32_t init(const char*devpath, const char* configfile, int queuedepth,
                        int is_polling) override;
   virtual int32_t process_completions(int max) override;
+  virtual void *alloc_request_context() override;
+  virtual void free_request_context(void *req_ctx) override;
   virtual int32_t store_tuple(kvs_key_space_handle ks_hd, const kvs_key *key,
                               const kvs_value *value, kvs_option_store option/*uint8_t option*/,
                               void *private1 = NULL, void *private2 = NULL, bool sync = false,
-                              kvs_postprocess_function post_fn = NULL) override;
+                              kvs_postprocess_function post_fn = NULL, void *req_ctx = NULL) override;
   virtual int32_t retrieve_tuple(kvs_key_space_handle ks_hd, const kvs_key *key,
                                  kvs_value *value, kvs_option_retrieve option/*uint8_t option*/,
                                  void *private1 = NULL, void *private2 = NULL, bool sync = false,
-                                 kvs_postprocess_function post_fn = NULL) override;
+                                 kvs_postprocess_function post_fn = NULL, void *req_ctx = NULL) override;
   virtual int32_t delete_tuple(kvs_key_space_handle ks_hd, const kvs_key *key,
                                kvs_option_delete option/*uint8_t option*/, void *private1 = NULL,
                                void *private2 = NULL, bool sync = false,
-                               kvs_postprocess_function post_fn = NULL) override;
+                               kvs_postprocess_function post_fn = NULL, void *req_ctx = NULL) override;
   virtual int32_t exist_tuple(kvs_key_space_handle ks_hd, uint32_t key_cnt,
                               const kvs_key *keys, kvs_exist_list *list,
                               void *private1 = NULL, void *private2 = NULL, bool sync = false,
-                              kvs_postprocess_function post_fn = NULL) override;
+                              kvs_postprocess_function post_fn = NULL, void *req_ctx = NULL) override;
   virtual int32_t create_iterator(kvs_key_space_handle ks_hd,
                                 kvs_option_iterator option, uint32_t bitmask, uint32_t bit_pattern,
                                 kvs_iterator_handle *iter_hd) override;
@@ -106,15 +111,39 @@ class KvEmulator: public KvsDriver {
   virtual int32_t get_used_size(uint32_t *dev_util)override;
   virtual int32_t get_total_size(uint64_t *dev_capa) override;
   virtual int32_t get_device_info(kvs_device *dev_info) override;
+  virtual bool native_append(bool syncio) override { return true; }
+  virtual bool native_vector_io() override { return true; }
+  virtual int32_t store_tuple_vec(kvs_key_space_handle ks_hd, const kvs_key *key,
+                                  const kvs_value_segment *segs, uint32_t seg_cnt, const kvs_value *value,
+                                  kvs_option_store option, void *private1 = NULL, void *private2 = NULL,
+                                  bool sync = false, kvs_postprocess_function post_fn = NULL) override;
+  virtual int32_t retrieve_tuple_vec(kvs_key_space_handle ks_hd, const kvs_key *key,
+                                     const kvs_value_segment *segs, uint32_t seg_cnt, kvs_value *value,
+                                     kvs_option_retrieve option, void *private1 = NULL, void *private2 = NULL,
+                                     bool sync = false, kvs_postprocess_function post_fn = NULL) override;
+  virtual bool native_range_read() override { return true; }
+  virtual int32_t retrieve_tuple_ranges(kvs_key_space_handle ks_hd, const kvs_key *key,
+                                        kvs_value_range *ranges, uint32_t range_cnt, kvs_value *value,
+                                        kvs_option_retrieve option, void *private1 = NULL, void *private2 = NULL,
+                                        bool sync = false, kvs_postprocess_function post_fn = NULL) override;
 
  private:
   void wait_for_io(kv_emul_context *ctx);
+  int32_t submit_store(kvs_key_space_handle ks_hd, const kvs_key *key,
+                       const kvs_value_segment *segs, uint32_t seg_cnt, const kvs_value *value,
+                       kvs_option_store option, void *private1, void *private2, bool sync,
+                       kvs_postprocess_function post_fn, void *req_ctx = NULL);
+  int32_t submit_retrieve(kvs_key_space_handle ks_hd, const kvs_key *key,
+                          const kvs_value_segment *segs, uint32_t seg_cnt,
+                          kvs_value_range *ranges, uint32_t range_cnt, kvs_value *value,
+                          kvs_option_retrieve option, void *private1, void *private2, bool sync,
+                          kvs_postprocess_function post_fn, void *req_ctx = NULL);
   int32_t trans_store_cmd_opt(kvs_option_store kvs_opt, kv_store_option *kv_opt);
   int create_queue(int qdepth, uint16_t qtype, kv_queue_handle *handle, int cqid,
                    int is_polling);
   kv_emul_context* prep_io_context(kvs_context opcode, kvs_key_space_handle ks_hd,
                                    const kvs_key *key, const kvs_value *value, void *private1, void *private2,
-                                   bool syncio, kvs_postprocess_function cbfn);
+                                   bool syncio, kvs_postprocess_function cbfn, void *req_ctx = NULL);
   bool ispersist;
   std::string datapath;
 };
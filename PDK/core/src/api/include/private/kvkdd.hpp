@@ -69,6 +69,9 @@ public:
 
     bool done;
     bool syncio;
+    uint64_t submit_ns;
+    uint64_t submit_tsc;
+    bool from_request;  // embedded in a caller-owned request, never deleted
   } kv_kdd_context;
 
   kv_interrupt_handler int_handler;
@@ -81,13 +84,17 @@ public:
   virtual int32_t init(const char*devpath, const char* configfile, int queuedepth, int is_polling) override;
   virtual int32_t process_completions(int max) override;
   virtual int32_t store_tuple(kvs_key_space_handle ks_hd, const kvs_key *key, const kvs_value *value, 
-    kvs_option_store option, void *private1=NULL, void *private2=NULL, bool sync = false, kvs_postprocess_function cbfn = NULL) override;
+    kvs_option_store option, void *private1=NULL, void *private2=NULL, bool sync = false, kvs_postprocess_function cbfn = NULL,
+    void *req_ctx = NULL) override;
   virtual int32_t retrieve_tuple(kvs_key_space_handle ks_hd, const kvs_key *key, kvs_value *value, 
-    kvs_option_retrieve option, void *private1=NULL, void *private2=NULL, bool sync = false, kvs_postprocess_function cbfn = NULL) override;
+    kvs_option_retrieve option, void *private1=NULL, void *private2=NULL, bool sync = false, kvs_postprocess_function cbfn = NULL,
+    void *req_ctx = NULL) override;
   virtual int32_t delete_tuple(kvs_key_space_handle ks_hd, const kvs_key *key, kvs_option_delete option, 
-    void *private1=NULL, void *private2=NULL, bool sync = false, kvs_postprocess_function cbfn = NULL) override;
+    void *private1=NULL, void *private2=NULL, bool sync = false, kvs_postprocess_function cbfn = NULL,
+    void *req_ctx = NULL) override;
   virtual int32_t exist_tuple(kvs_key_space_handle ks_hd, uint32_t key_cnt, const kvs_key *keys, kvs_exist_list *list, 
-    void *private1=NULL, void *private2=NULL, bool sync = false, kvs_postprocess_function cbfn = NULL) override;
+    void *private1=NULL, void *private2=NULL, bool sync = false, kvs_postprocess_function cbfn = NULL,
+    void *req_ctx = NULL) override;
   virtual int32_t create_iterator(kvs_key_space_handle ks_hd, kvs_option_iterator option, uint32_t bitmask, 
     uint32_t bit_pattern, kvs_iterator_handle *iter_hd) override;
   virtual int32_t delete_iterator(kvs_key_space_handle ks_hd, kvs_iterator_handle hiter);
@@ -98,6 +105,9 @@ public:
   virtual int32_t get_used_size(uint32_t *dev_util) override;
   virtual int32_t get_total_size(uint64_t *dev_capa) override;
   virtual int32_t get_device_info(kvs_device *dev_info) override;
+  virtual bool native_append(bool syncio) override { return true; }
+  virtual void *alloc_request_context() override;
+  virtual void free_request_context(void *req_ctx) override;
   void _kv_callback_thread();
 
 private:
@@ -106,7 +116,7 @@ private:
   int create_queue(int qdepth, uint16_t qtype, kv_queue_handle *handle, int cqid, int is_polling);
   kv_kdd_context* prep_io_context(kvs_context opcode, kvs_key_space_handle ks_hd,
     const kvs_key *key, const kvs_value *value, void *private1, void *private2,
-    bool syncio, kvs_postprocess_function cbfn);
+    bool syncio, kvs_postprocess_function cbfn, void *req_ctx = NULL);
   int check_opened_iterators(uint32_t bitmask,uint32_t bit_pattern,
     kvs_iterator_handle *iter_hd);
   int32_t trans_iter_type(uint8_t dev_it_type, uint8_t* kvs_it_type);
@@ -0,0 +1,109 @@
+/**
+ *   BSD LICENSE
+ *
+ *   Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Samsung Electronics Co., Ltd. nor the names of
+ *       its contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INCLUDE_PRIVATE_KVS_APPEND_H_
+#define INCLUDE_PRIVATE_KVS_APPEND_H_
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include "private_types.h"
+
+/*
+ * KVS_STORE_APPEND of a key space
+ *
+ * Appends go to the device when the driver implements them natively for
+ * both sync and async IO and no value of the key space is packed on the
+ * host. Otherwise an append is executed on the host: natively with a sync
+ * command where the driver allows it, or as a read-modify-write of the
+ * whole value. Host appends to the same key are serialized within the
+ * process; async ones are queued on the lane that the key hashes to and
+ * executed in order by the lane's thread. A sync append runs in the
+ * caller's thread unless the lane has work pending, in which case it is
+ * queued behind it.
+ */
+
+const int APPEND_LANES = 4;
+const int APPEND_KEY_LOCK_STRIPES = 64;
+
+class KvsAppender {
+public:
+  KvsAppender(kvs_key_space_handle ks_hd);
+  ~KvsAppender();
+
+  // completes all queued appends and stops the lane threads, which are
+  // started again by the next async append
+  void close();
+
+  kvs_result append(const kvs_key *key, const kvs_value *value,
+    void *private1, void *private2, bool sync, kvs_postprocess_function post_fn);
+
+private:
+  typedef struct {
+    kvs_result result;
+    bool done;
+  } append_waiter;
+
+  typedef struct {
+    kvs_key *key;
+    kvs_value *value;
+    void *private1;
+    void *private2;
+    kvs_postprocess_function post_fn;
+    append_waiter *waiter;   // sync append queued on a lane
+  } append_op;
+
+  struct append_lane {
+    std::mutex lock;
+    std::condition_variable cond;       // lane thread
+    std::condition_variable done_cond;  // sync appends queued on the lane
+    std::deque<append_op> queue;
+    uint32_t pending;                   // queued or executing appends
+    std::thread worker;
+    bool started;
+    bool stop;
+  };
+
+  uint32_t hash(const kvs_key *key) const;
+  kvs_result execute(const kvs_key *key, const kvs_value *value);
+  kvs_result read_modify_write(const kvs_key *key, const kvs_value *value);
+  kvs_result key_space_io(const kvs_key *key, kvs_value *value, void *option, kvs_context op);
+  void run(append_lane *lane);
+
+  kvs_key_space_handle ks_hd;
+  append_lane lanes[APPEND_LANES];
+  std::mutex key_locks[APPEND_KEY_LOCK_STRIPES];
+};
+
+#endif /* INCLUDE_PRIVATE_KVS_APPEND_H_ */
@@ -0,0 +1,133 @@
+/**
+ *   BSD LICENSE
+ *
+ *   Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Samsung Electronics Co., Ltd. nor the names of
+ *       its contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INCLUDE_PRIVATE_KVS_COALESCE_H_
+#define INCLUDE_PRIVATE_KVS_COALESCE_H_
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+#include <condition_variable>
+#include "private_types.h"
+
+/*
+ * Single-flight retrieves of a key space
+ *
+ * A retrieve of a key, offset and length that another retrieve of the
+ * process already has in flight doesn't issue a command of its own: it
+ * joins the command in flight (a flight) and gets a copy of its value in
+ * its own buffer, with the same result. The caller that issued the command
+ * leads the flight; its buffer is copied from before its own post process
+ * function is called. Async callers join any flight, sync callers only the
+ * flights of sync leaders: an async command may complete only once the
+ * application processes completions, possibly on the very thread a sync
+ * joiner would block.
+ *
+ * A store or delete of a key through the API closes the flights of the key
+ * to later retrieves, and once more when it completes. A retrieve
+ * that joined may still return the value a write that completed while the
+ * shared command was in flight replaced, as if it had been issued with the
+ * leader. Retrieves with kvs_retrieve_delete are never coalesced.
+ */
+
+const int COALESCE_SHARDS = 16;
+
+class KvsCoalescer {
+public:
+  KvsCoalescer(kvs_key_space_handle ks_hd);
+  ~KvsCoalescer() {}
+
+  kvs_result retrieve(const kvs_key *key, kvs_value *value, const kvs_option_retrieve *opt,
+    void *private1, void *private2, bool sync, kvs_postprocess_function post_fn, void *req_ctx);
+  // later retrieves of key don't join the flights of the key
+  void invalidate(const kvs_key *key);
+  // an async store or delete of key closes the flights of the key again when
+  // it completes: its private1, private2 and post_fn are replaced, and the
+  // returned write goes to drop_write() if the submission fails
+  void *wrap_write(kvs_key *key, void **private1, void **private2,
+    kvs_postprocess_function *post_fn);
+  static void drop_write(void *write);
+
+private:
+  typedef struct {
+    kvs_key *key;
+    kvs_value *value;
+    void *private1;
+    void *private2;
+    kvs_postprocess_function post_fn;   // NULL for a sync retrieve
+  } coalesce_waiter;
+
+  typedef struct {
+    KvsCoalescer *owner;
+    kvs_key *key;
+    void *private1;
+    void *private2;
+    kvs_postprocess_function post_fn;
+  } coalesce_write;
+
+  struct flight {
+    KvsCoalescer *owner;
+    int shard;
+    std::string key;
+    uint32_t offset;
+    uint32_t length;
+    bool sync;            // led by a sync retrieve, sync retrieves may join
+    bool listed;          // retrieves may join
+    bool done;
+    kvs_result result;
+    uint32_t refs;        // the leader and the sync waiters
+    kvs_value *value;     // the leader's
+    void *private1;       // of an async leader
+    void *private2;
+    kvs_postprocess_function post_fn;
+    std::vector<coalesce_waiter> waiters;
+    std::condition_variable cond;
+  };
+
+  struct coalesce_shard {
+    std::mutex lock;
+    std::unordered_multimap<std::string, flight*> flights;
+  };
+
+  int shard_of(const std::string &key) const;
+  void unlist(coalesce_shard *s, flight *f);
+  void finish(flight *f, kvs_result result);
+  static void on_complete(kvs_postprocess_context *ctx);
+  static void on_write_complete(kvs_postprocess_context *ctx);
+
+  kvs_key_space_handle ks_hd;
+  coalesce_shard shards[COALESCE_SHARDS];
+};
+
+#endif /* INCLUDE_PRIVATE_KVS_COALESCE_H_ */
@@ -0,0 +1,120 @@
+/**
+ *   BSD LICENSE
+ *
+ *   Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Samsung Electronics Co., Ltd. nor the names of
+ *       its contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INCLUDE_PRIVATE_KVS_COMPLETIONS_H_
+#define INCLUDE_PRIVATE_KVS_COMPLETIONS_H_
+
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include "kvs_api.h"
+
+/*
+ * Completion queue created by the application
+ *
+ * Async commands submitted with kvs_queue_completion() as their post
+ * process function leave a copy of their kvs_postprocess_context in the
+ * queue named by their private2 when they complete, and
+ * kvs_get_completions() takes them out in batches on the thread that owns
+ * the queue. The completion thread only appends under a
+ * short lock, and wakes up the reaper only when one is waiting.
+ *
+ * Once fd() has been asked for, the queue has an eventfd of its own, closed
+ * with it, that is readable for as long as completions are queued, so that
+ * an event loop can poll it instead of blocking in reap(): it is signalled
+ * when the queue becomes non-empty and drained when a reap empties it, one
+ * write and one read per batch.
+ */
+class KvsCompletions {
+public:
+  KvsCompletions() : waiters(0), efd(-1) {}
+  ~KvsCompletions() {
+    if (efd >= 0) ::close(efd);
+  }
+
+  void push(const kvs_postprocess_context *ctx) {
+    std::unique_lock<std::mutex> guard(lock);
+    done.push_back(*ctx);
+    if (waiters) cond.notify_one();
+    if (efd >= 0 && done.size() == 1) signal();
+  }
+
+  // the readiness descriptor, -1 if it can't be created
+  int fd() {
+    std::unique_lock<std::mutex> guard(lock);
+    if (efd < 0) {
+      efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      if (efd >= 0 && !done.empty()) signal();
+    }
+    return efd;
+  }
+
+  // up to max completions; waits up to timeout_usec for the first one
+  uint32_t reap(kvs_postprocess_context *events, uint32_t max, uint32_t timeout_usec) {
+    std::unique_lock<std::mutex> guard(lock);
+    if (done.empty() && timeout_usec) {
+      waiters++;
+      cond.wait_for(guard, std::chrono::microseconds(timeout_usec),
+        [this] { return !done.empty(); });
+      waiters--;
+    }
+    uint32_t n = 0;
+    while (n < max && !done.empty()) {
+      events[n++] = done.front();
+      done.pop_front();
+    }
+    if (efd >= 0 && n && done.empty()) {
+      uint64_t cnt;
+      if (::read(efd, &cnt, sizeof(cnt)) < 0) {}
+    }
+    return n;
+  }
+
+private:
+  std::mutex lock;
+  std::condition_variable cond;
+  std::deque<kvs_postprocess_context> done;
+  int waiters;
+  int efd;
+
+  void signal() {
+    uint64_t one = 1;
+    if (::write(efd, &one, sizeof(one)) < 0) {}
+  }
+};
+
+#endif /* INCLUDE_PRIVATE_KVS_COMPLETIONS_H_ */
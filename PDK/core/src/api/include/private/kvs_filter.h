@@ -0,0 +1,178 @@
+/**
+ *   BSD LICENSE
+ *
+ *   Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Samsung Electronics Co., Ltd. nor the names of
+ *       its contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INCLUDE_PRIVATE_KVS_FILTER_H_
+#define INCLUDE_PRIVATE_KVS_FILTER_H_
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include "private_types.h"
+
+/*
+ * Negative lookup filter of a key space
+ *
+ * A counting cuckoo filter of the keys stored through the API: buckets of
+ * FILTER_BUCKET_SLOTS fingerprints of 16 bits, each with the number of
+ * stores of keys that map to it. A store adds its key before the command is
+ * issued; a delete takes the key back only once the device reported that
+ * the key existed, so the count of a key never drops below the number of
+ * its copies on the device. Overwrites and failed stores leave stale
+ * counts, which only cost false positives until the filter is rebuilt. A
+ * retrieve or exist of a key the filter doesn't hold completes with
+ * KVS_ERR_KEY_NOT_EXIST without a device command.
+ *
+ * The filter is rebuilt from an iterator over the key space and the index
+ * of the packing layer, or loaded from the copy in the metadata key space
+ * that the previous handle of the key space stored when it was closed. The
+ * copy is loaded, and deleted, when the key space is opened, so that a crash
+ * or a handle that ran without the filter never leaves a stale copy behind.
+ * A filter that was loaded tracks stores and deletes right away but only
+ * answers lookups once kvs_enable_key_filter() is called.
+ */
+
+const uint32_t FILTER_BUCKET_SLOTS = 4;
+// displacements before an insert gives up and parks the fingerprint in the victim slot
+const int FILTER_MAX_KICKS = 500;
+const uint32_t FILTER_MIN_BUCKETS = 1024;
+// a count that reached it is never decremented again
+const uint8_t FILTER_COUNT_STICKY = 0xff;
+
+class KvsKeyFilter {
+public:
+  KvsKeyFilter(kvs_key_space_handle ks_hd, uint64_t expected_keys);
+  ~KvsKeyFilter();
+
+  // allocates the tables, false if out of memory
+  bool init();
+  // number of buckets of a filter for expected_keys keys
+  static uint64_t buckets_for(uint64_t expected_keys);
+  uint64_t buckets() const { return nbuckets; }
+
+  // fills the filter from the keys of the key space
+  kvs_result rebuild();
+  // the copy in the metadata key space, deleted once read; KVS_ERR_KEY_NOT_EXIST if none
+  static kvs_result load(kvs_key_space_handle ks_hd, KvsKeyFilter **filter);
+  kvs_result save();
+  // deletes the copy of key space keyspace_id from the metadata key space
+  static void drop(kvs_device_handle dev_hd, uint8_t keyspace_id);
+
+  void set_answering(bool on) { answering.store(on, std::memory_order_release); }
+
+  // counts a store of key
+  void insert(const kvs_key *key);
+  // true if key was certainly never stored; counted in the device stats
+  bool excludes(const kvs_key *key);
+  // true if none of the keys was stored; then the result bits are cleared
+  bool excludes_all(uint32_t key_cnt, const kvs_key *keys, kvs_exist_list *list);
+
+  // deletes key and takes it back from the filter if the device had it
+  kvs_result remove(const kvs_key *key, const kvs_option_delete *opt, void *private1,
+    void *private2, bool sync, kvs_postprocess_function post_fn, void *req_ctx);
+  // completes an async retrieve or exist that the filter answered; the post
+  // process function is called by the filter's thread, not by the caller
+  kvs_result complete(kvs_context op, const kvs_key *key, kvs_value *value,
+    kvs_exist_list *list, void *private1, void *private2, kvs_postprocess_function post_fn);
+
+private:
+  typedef struct {
+    uint16_t fp;
+    uint8_t count;
+    bool used;
+    uint64_t bucket;
+  } filter_victim;
+
+  typedef struct {
+    kvs_postprocess_context ctx;
+    kvs_postprocess_function post_fn;
+  } filter_completion;
+
+  typedef struct {
+    KvsKeyFilter *owner;
+    uint64_t hash;
+    bool delete_error;   // the caller's kvs_delete_error
+    void *private1;
+    void *private2;
+    kvs_postprocess_function post_fn;
+  } filter_delete_op;
+
+  static uint64_t hash(const void *data, uint32_t len);
+  uint64_t index_of(uint64_t h) const { return h & (nbuckets - 1); }
+  uint64_t alt_index(uint64_t bucket, uint16_t fp) const;
+  static uint16_t fingerprint(uint64_t h);
+
+  // caller holds the lock
+  int find(uint64_t bucket, uint16_t fp) const;
+  bool place(uint64_t bucket, uint16_t fp, uint8_t count);
+  void add(uint64_t h);
+  void take(uint64_t h);
+  bool contains(uint64_t h);
+  // the persisted form of the tables, bytes [off, off + len)
+  void encode(uint64_t off, uint32_t len, uint8_t *out) const;
+  void decode(uint64_t off, uint32_t len, const uint8_t *in);
+
+  static void on_delete_complete(kvs_postprocess_context *ctx);
+  void run();
+
+  kvs_key_space_handle ks_hd;
+  uint64_t nbuckets;   // a power of 2
+  uint16_t *fps;       // 0 is an empty slot
+  uint8_t *counts;
+  filter_victim victim;
+  bool overflow;       // the victim slot was taken, every lookup is positive
+  std::mutex lock;
+  std::atomic<bool> answering;
+  uint32_t seed;       // displacement choices
+
+  // completions of lookups the filter answered
+  std::mutex worker_lock;
+  std::condition_variable worker_cond;
+  std::deque<filter_completion> deferred;
+  std::thread worker;
+  bool worker_started;
+  bool stop;
+};
+
+// helpers for the api modules; a NULL filter holds every key
+static inline void _filter_insert(kvs_key_space_handle ks_hd, const kvs_key *key) {
+  if (ks_hd->filter)
+    ks_hd->filter->insert(key);
+}
+
+static inline bool _filter_excludes(kvs_key_space_handle ks_hd, const kvs_key *key) {
+  return ks_hd->filter && ks_hd->filter->excludes(key);
+}
+
+#endif /* INCLUDE_PRIVATE_KVS_FILTER_H_ */
@@ -0,0 +1,171 @@
+/**
+ *   BSD LICENSE
+ *
+ *   Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Samsung Electronics Co., Ltd. nor the names of
+ *       its contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INCLUDE_PRIVATE_KVS_PACKING_H_
+#define INCLUDE_PRIVATE_KVS_PACKING_H_
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include "private_types.h"
+
+/*
+ * Small value packing layer of a key space
+ *
+ * Values up to kvs_option_packing.max_value_len are appended to page sized
+ * containers that are stored as ordinary kv pairs of the key space under
+ * reserved keys. The host keeps an index from a user key to the container
+ * entry that holds its latest version; all other keys go to the device as
+ * usual. See kvs_packing.cpp for the container and directory formats.
+ */
+
+struct pack_op;
+struct pack_buffer;
+
+typedef struct {
+  uint64_t cid;      // container id, 0 is never used
+  uint32_t off;      // entry offset in the container
+  uint32_t len;      // value length
+} pack_loc;
+
+typedef struct {
+  uint32_t live;        // bytes of entries that the index refers to
+  uint32_t total;       // bytes of all entries
+  uint32_t readers;     // outstanding reads of the container from the device
+  bool compacting;
+  bool delete_pending;
+  pack_buffer *buf;     // in-memory image while the container is being filled or written
+} pack_container;
+
+typedef struct {
+  pack_op *op;
+  std::string key;
+  uint32_t off;      // entry offset in the buffer
+  pack_loc old;      // version that the entry replaced, cid 0 if none
+} pack_pending;
+
+class KvsPacker {
+public:
+  KvsPacker(kvs_key_space_handle ks_hd, const kvs_option_packing *opt);
+  ~KvsPacker();
+
+  kvs_result open();
+  kvs_result close();
+  kvs_result flush();
+
+  kvs_result store(const kvs_key *key, const kvs_value *value, const kvs_option_store *opt,
+    void *private1, void *private2, bool sync, kvs_postprocess_function post_fn);
+  kvs_result retrieve(const kvs_key *key, kvs_value *value, const kvs_option_retrieve *opt,
+    void *private1, void *private2, bool sync, kvs_postprocess_function post_fn);
+  kvs_result remove(const kvs_key *key, const kvs_option_delete *opt,
+    void *private1, void *private2, bool sync, kvs_postprocess_function post_fn);
+  kvs_result exist(uint32_t key_cnt, const kvs_key *keys, kvs_exist_list *list,
+    void *private1, void *private2, bool sync, kvs_postprocess_function post_fn);
+
+  // calls fn with each packed key, under the index lock
+  void for_each_key(const std::function<void(const std::string &key)> &fn);
+
+  static kvs_result check_option(const kvs_option_packing *opt);
+
+private:
+  static void on_flush_complete(kvs_postprocess_context *ctx);
+  static void on_forward_complete(kvs_postprocess_context *ctx);
+  static void on_read_complete(kvs_postprocess_context *ctx);
+  static void on_exist_complete(kvs_postprocess_context *ctx);
+
+  bool packable(const kvs_key *key, const kvs_value *value) const;
+  pack_buffer *append(uint8_t type, const std::string &key, const void *value,
+    uint32_t vlen, pack_op *op, const pack_loc &old, pack_loc *loc);
+  pack_buffer *new_buffer();
+  void drop_buffer(pack_buffer *b);
+  void seal(pack_buffer *b);
+  void kill(const std::string &key, const pack_loc &loc);
+  void check_compaction(uint64_t cid);
+  void undo(pack_buffer *b, const pack_pending &p);
+
+  bool prepare_flush(pack_buffer *b);
+  void submit_flush(pack_buffer *b);
+  void finish_write(pack_buffer *b, kvs_result res, std::vector<pack_op*> &ready);
+  void kick(pack_buffer *b, bool can_submit, std::vector<pack_buffer*> &go);
+
+  void release(pack_op *op, kvs_result res, std::vector<pack_op*> &ready);
+  void complete(std::vector<pack_op*> &ready);
+  kvs_result wait(pack_op *op);
+  void wait_locked(std::unique_lock<std::mutex> &guard);
+  kvs_result forward(pack_op *op);
+  void forward_done(pack_op *op, kvs_result res, bool can_submit);
+  void read_done(pack_op *op, kvs_result res);
+
+  kvs_result read_directory(uint64_t *low, uint64_t *limit, uint32_t *csize);
+  kvs_result write_directory(uint64_t low, uint64_t limit);
+  kvs_result container_io(kvs_context op, uint64_t cid, uint8_t *buf, uint32_t *len);
+  kvs_result load_container(uint64_t cid, uint8_t *buf);
+  void compact(uint64_t cid);
+  void background();
+
+  kvs_key_space_handle ks_hd;
+  uint32_t max_value_len;
+  uint32_t container_size;
+  uint32_t read_size;           // largest container size found in the key space
+  uint32_t threshold;
+  uint32_t flush_delay_us;
+  bool syncio;
+  bool polling;
+
+  std::mutex lock;
+  std::condition_variable cond;      // waiters of operations and close
+  std::condition_variable bg_cond;   // background thread
+  std::thread bg;
+  bool stop;
+  bool closing;
+
+  std::unordered_map<std::string, pack_loc> index;
+  std::map<uint64_t, pack_container> containers;
+  std::set<pack_buffer*> buffers;    // buffers in memory
+  std::set<uint64_t> candidates;     // containers to compact
+  std::vector<uint64_t> reclaim;     // compacted containers to delete
+  std::vector<pack_op*> deferred;    // operations to complete from the background thread
+  bool compaction_busy;
+  pack_buffer *open_buf;
+  uint64_t next_cid;
+  uint64_t durable_limit;            // containers below this id are covered by the directory
+  uint32_t outstanding;              // operations not completed yet
+};
+
+#endif /* INCLUDE_PRIVATE_KVS_PACKING_H_ */
@@ -0,0 +1,170 @@
+/**
+ *   BSD LICENSE
+ *
+ *   Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Samsung Electronics Co., Ltd. nor the names of
+ *       its contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INCLUDE_PRIVATE_KVS_QOS_H_
+#define INCLUDE_PRIVATE_KVS_QOS_H_
+
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include "private_types.h"
+
+/*
+ * Host QoS scheduler of a device
+ *
+ * Point commands (store, retrieve, delete, exist) and iterator reads of
+ * the API go through the scheduler once kvs_set_qos() or
+ * kvs_set_key_space_qos() has been called on the device. A command belongs
+ * to the class of the calling thread (kvs_set_thread_qos_class()) or else
+ * of its key space, KVS_QOS_NORMAL by default. It is dispatched in the
+ * caller's thread when its class has nothing queued and the device and
+ * class in-flight caps and the token buckets of the key space allow it;
+ * otherwise it is queued on its class and the dispatcher thread submits it
+ * later. Among the classes whose first command may go, the dispatcher
+ * picks by stride scheduling, so backlogged classes share the dispatches
+ * in proportion to their weights. Queues are FIFO per class: a command
+ * waiting for the tokens of its key space holds back the class.
+ *
+ * Async commands complete through on_complete(), which gives the user's
+ * private data back before calling the user's post process function. The
+ * time a command spends queued is counted by class in the statistics.
+ * Packed values, appends and the other host-side layers reach the driver
+ * directly and are not scheduled. Scatter-gather and multi-range IO don't
+ * use the native commands of the driver while a scheduler is set, they go
+ * through the scheduled per-key path.
+ */
+
+const uint64_t QOS_STRIDE = 1 << 20;
+const uint32_t QOS_DEFAULT_WEIGHTS[KVS_QOS_CLASSES] = {8, 4, 1};
+
+// rate limits of a key space, kvs_set_key_space_qos()
+struct KvsQosTenant {
+  kvs_qos_class qos_class;
+  double iops_rate;         // tokens per ns, 0 for no limit
+  double bw_rate;
+  double iops_burst;
+  double bw_burst;
+  double iops_tokens;
+  double bw_tokens;
+  uint64_t refill_ns;
+};
+
+class KvsScheduler {
+public:
+  KvsScheduler(KvsDriver *driver);
+  // waits for the queued and in-flight commands
+  ~KvsScheduler();
+
+  void configure(const kvs_qos_option *opt);
+  void configure(kvs_key_space_handle ks_hd, const kvs_option_key_space_qos *opt);
+  // drops the limits of a key space that is closed
+  void release(kvs_key_space_handle ks_hd);
+
+  // class of the commands of the calling thread, KVS_QOS_INHERIT for the key space's
+  static thread_local kvs_qos_class thread_class;
+
+  int32_t store_tuple(kvs_key_space_handle ks_hd, const kvs_key *key, const kvs_value *value,
+    kvs_option_store option, void *private1, void *private2, bool syncio,
+    kvs_postprocess_function post_fn, void *req_ctx = NULL);
+  int32_t retrieve_tuple(kvs_key_space_handle ks_hd, const kvs_key *key, kvs_value *value,
+    kvs_option_retrieve option, void *private1, void *private2, bool syncio,
+    kvs_postprocess_function post_fn, void *req_ctx = NULL);
+  int32_t delete_tuple(kvs_key_space_handle ks_hd, const kvs_key *key,
+    kvs_option_delete option, void *private1, void *private2, bool syncio,
+    kvs_postprocess_function post_fn, void *req_ctx = NULL);
+  int32_t exist_tuple(kvs_key_space_handle ks_hd, uint32_t key_cnt, const kvs_key *keys,
+    kvs_exist_list *list, void *private1, void *private2, bool syncio,
+    kvs_postprocess_function post_fn, void *req_ctx = NULL);
+  int32_t iterator_next(kvs_key_space_handle ks_hd, kvs_iterator_handle hiter,
+    kvs_iterator_list *iter_list, void *private1, void *private2, bool syncio,
+    kvs_postprocess_function post_fn);
+
+private:
+  typedef struct qos_op {
+    KvsScheduler *owner;
+    kvs_context cmd;
+    kvs_key_space_handle ks_hd;
+    const kvs_key *key;
+    kvs_value *value;
+    uint32_t key_cnt;
+    kvs_exist_list *list;
+    kvs_iterator_handle hiter;
+    kvs_iterator_list *iter_list;
+    union {
+      kvs_option_store store;
+      kvs_option_retrieve retrieve;
+      kvs_option_delete remove;
+    } option;
+    void *private1;
+    void *private2;
+    kvs_postprocess_function post_fn;
+    void *req_ctx;
+    bool syncio;
+    bool dispatched;      // a queued sync command may go
+    int cls;
+    uint64_t bytes;       // for the bandwidth limit
+    uint64_t enqueue_ns;
+  } qos_op;
+
+  // async commands come from a pool, sync ones live on the caller's stack
+  qos_op *get_op(bool syncio, qos_op *stack_op);
+  int32_t submit(qos_op *op);
+  int32_t issue(qos_op *op);
+  bool admit(qos_op *op, uint64_t now, uint64_t *wait_ns);
+  qos_op *pick(uint64_t now, uint64_t *wait_ns);
+  void complete(qos_op *op);
+  void run();
+  static void on_complete(kvs_postprocess_context *ctx);
+
+  KvsDriver *driver;
+  std::mutex lock;
+  std::condition_variable cond;        // dispatcher
+  std::condition_variable sync_cond;   // queued sync commands
+  std::condition_variable idle_cond;   // destructor
+  std::deque<qos_op*> queue[KVS_QOS_CLASSES];
+  std::vector<qos_op*> free_ops;       // async commands, reused
+  uint32_t weight[KVS_QOS_CLASSES];
+  uint32_t class_cap[KVS_QOS_CLASSES];
+  uint32_t class_inflight[KVS_QOS_CLASSES];
+  uint64_t pass[KVS_QOS_CLASSES];
+  uint64_t vtime;                      // pass of the last dispatch from the queues
+  uint32_t cap;
+  uint32_t inflight;
+  uint32_t queued;
+  std::thread worker;
+  bool stop;
+};
+
+#endif /* INCLUDE_PRIVATE_KVS_QOS_H_ */
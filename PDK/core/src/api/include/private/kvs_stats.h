@@ -0,0 +1,168 @@
+/**
+ *   BSD LICENSE
+ *
+ *   Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Samsung Electronics Co., Ltd. nor the names of
+ *       its contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INCLUDE_PRIVATE_KVS_STATS_H_
+#define INCLUDE_PRIVATE_KVS_STATS_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <mutex>
+#include "kvs_api.h"
+
+/*
+ * Operation statistics of a device
+ *
+ * The drivers stamp a command when it is submitted and count it when it
+ * completes, in the shard of the CPU that completes it. A shard is a
+ * kvs_stats that is only updated with relaxed atomic adds, so counting
+ * takes no lock and the shards of different CPUs don't share cache lines.
+ * The shards live in a shared memory object, /dev/shm/kvs_stats.<pid>.<n>,
+ * where tools/kvstop reads them while the process runs. Readers sum the
+ * shards and subtract the base that kvs_reset_stats() leaves.
+ */
+
+#define KVS_STATS_SHM_PREFIX "kvs_stats."
+#define KVS_STATS_MAGIC 0x315441545353564bULL  // "KVSSTAT1"
+#define KVS_STATS_MAX_SHARDS 256
+#define KVS_STATS_PAGE 4096
+
+// header of the shared memory object, followed by the base and the shards,
+// each of them page aligned
+typedef struct {
+  uint64_t magic;
+  uint64_t stats_size;      // sizeof(kvs_stats) of the writer
+  uint32_t nshards;
+  int32_t pid;
+  uint64_t open_ns;         // CLOCK_MONOTONIC
+  uint64_t reset_ns;
+  char dev_path[256];
+} kvs_stats_segment;
+
+inline uint64_t kvs_stats_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+inline size_t kvs_stats_stride() {
+  return (sizeof(kvs_stats) + KVS_STATS_PAGE - 1) & ~(size_t)(KVS_STATS_PAGE - 1);
+}
+
+inline size_t kvs_stats_segment_size(uint32_t nshards) {
+  return KVS_STATS_PAGE + (nshards + 1) * kvs_stats_stride();
+}
+
+// idx -1 is the base
+inline kvs_stats *kvs_stats_shard(const kvs_stats_segment *seg, int idx) {
+  return (kvs_stats*)((char*)seg + KVS_STATS_PAGE + (idx + 1) * kvs_stats_stride());
+}
+
+inline uint32_t kvs_stats_bucket(uint64_t ns) {
+  if (ns < 4) return (uint32_t)ns;
+  uint32_t msb = 63 - __builtin_clzll(ns);
+  uint32_t b = (msb - 1) * 4 + ((ns >> (msb - 2)) & 3);
+  return (b < KVS_STATS_LAT_BUCKETS) ? b : KVS_STATS_LAT_BUCKETS - 1;
+}
+
+// lower bound of a bucket in ns
+inline uint64_t kvs_stats_bucket_ns(uint32_t b) {
+  if (b < 4) return b;
+  return (uint64_t)(4 + b % 4) << (b / 4 - 1);
+}
+
+// payload moved by a completed command
+inline uint64_t kvs_stats_io_bytes(const kvs_postprocess_context *iocb) {
+  switch (iocb->context) {
+    case KVS_CMD_STORE:
+      return iocb->value ? iocb->value->length : 0;
+    case KVS_CMD_RETRIEVE:
+      if (!iocb->value) return 0;
+      return (iocb->value->length < iocb->value->actual_value_size) ?
+        iocb->value->length : iocb->value->actual_value_size;
+    case KVS_CMD_ITER_NEXT:
+      return iocb->result_buffer.iter_list ? iocb->result_buffer.iter_list->size : 0;
+    default:
+      return 0;
+  }
+}
+
+// sum of the shards less the base
+inline void kvs_stats_read(const kvs_stats_segment *seg, kvs_stats *stats) {
+  const size_t n = sizeof(kvs_stats) / sizeof(uint64_t);
+  uint64_t *out = (uint64_t*)stats;
+  memset(stats, 0, sizeof(kvs_stats));
+  for (uint32_t i = 0; i < seg->nshards; i++) {
+    const uint64_t *in = (const uint64_t*)kvs_stats_shard(seg, i);
+    for (size_t j = 0; j < n; j++)
+      out[j] += __atomic_load_n(&in[j], __ATOMIC_RELAXED);
+  }
+  const uint64_t *base = (const uint64_t*)kvs_stats_shard(seg, -1);
+  for (size_t j = 0; j < n; j++)
+    out[j] -= base[j];
+  stats->elapsed_ns = kvs_stats_now() - seg->reset_ns;
+}
+
+class KvsStats {
+public:
+  KvsStats();
+  ~KvsStats();
+
+  // maps the shards; in private memory if the shared memory object can't be
+  // created, and then only kvs_get_stats() sees them
+  void open(const char *dev_path);
+
+  // counts a completed command that was submitted at submit_ns
+  void record(kvs_context op, kvs_key_space_handle ks_hd, uint64_t bytes,
+    kvs_result result, uint64_t submit_ns);
+  void record(const kvs_postprocess_context *iocb, kvs_result result,
+    uint64_t submit_ns);
+  // counts a command dispatched by the QoS scheduler after delay_ns in its queue
+  void record_queue(int cls, uint64_t bytes, uint64_t delay_ns);
+  // counts a retrieve of a key space with coalescing, hit if it joined a command in flight
+  void record_coalesce(bool hit);
+  // counts a lookup of a key space with a key filter, negative if the filter answered it
+  void record_filter(bool negative);
+
+  void get(kvs_stats *stats);
+  void reset();
+
+private:
+  kvs_stats_segment *seg;
+  size_t seg_size;
+  uint32_t nshards;
+  char shm_name[64];
+  std::mutex reset_lock;
+};
+
+#endif /* INCLUDE_PRIVATE_KVS_STATS_H_ */
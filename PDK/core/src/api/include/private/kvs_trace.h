@@ -0,0 +1,138 @@
+/**
+ *   BSD LICENSE
+ *
+ *   Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Samsung Electronics Co., Ltd. nor the names of
+ *       its contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INCLUDE_PRIVATE_KVS_TRACE_H_
+#define INCLUDE_PRIVATE_KVS_TRACE_H_
+
+#include <stdint.h>
+#include "kvs_api.h"
+#include "kvs_stats.h"
+
+/*
+ * Binary command trace
+ *
+ * When tracing is on, every command is stamped with the TSC at four points:
+ * submission to the driver, dispatch to the device (0 where the driver can't
+ * see it), completion by the device and return of the user callback, or
+ * wake-up of the synchronous caller. The record goes into a ring of the
+ * completing thread, which only that thread writes, so recording takes no
+ * lock and no atomic read-modify-write. A flusher thread drains the rings
+ * into the trace file; records overwritten before it gets to them are
+ * counted as dropped. tools/kvstrace decodes the file.
+ *
+ * When tracing is off, the drivers pay a load and a branch at submission
+ * and at completion.
+ */
+
+#define KVS_TRACE_MAGIC 0x4543415254535653ULL  // "KVSTRACE"
+#define KVS_TRACE_VERSION 1
+#define KVS_TRACE_RING_SIZE 16384             // records per thread, power of 2
+#define KVS_TRACE_FLUSH_MS 10
+
+#define KVS_TRACE_SYNC 0x1                    // synchronous call
+
+// trace file: a header followed by the records
+typedef struct {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t record_size;
+  double tsc_per_ns;        // measured between start and stop
+  uint64_t start_tsc;
+  uint64_t records;
+  uint64_t dropped;
+  uint8_t reserved[16];
+} kvs_trace_header;
+
+typedef struct {
+  uint64_t submit_tsc;
+  uint64_t dispatch_tsc;
+  uint64_t complete_tsc;
+  uint64_t callback_tsc;
+  uint64_t key_hash;
+  uint32_t value_bytes;
+  uint32_t tid;
+  uint16_t key_len;
+  uint8_t opcode;           // kvs_context
+  uint8_t result;           // kvs_result
+  uint8_t ks_id;
+  uint8_t flags;
+  uint8_t reserved[10];
+} kvs_trace_record;
+
+static_assert(sizeof(kvs_trace_header) == 64, "trace header layout");
+static_assert(sizeof(kvs_trace_record) == 64, "trace record layout");
+
+extern volatile bool kvs_trace_on;
+
+inline uint64_t kvs_trace_tsc() {
+  return __builtin_ia32_rdtsc();
+}
+
+// submission stamp, 0 when tracing is off
+inline uint64_t kvs_trace_submit() {
+  return kvs_trace_on ? kvs_trace_tsc() : 0;
+}
+
+kvs_result kvs_trace_start(const char *path);
+kvs_result kvs_trace_stop();
+
+kvs_trace_record *_kvs_trace_begin(kvs_context op, kvs_key_space_handle ks_hd,
+  const kvs_key *key, uint64_t bytes, kvs_result result, uint64_t submit_tsc,
+  uint64_t dispatch_tsc, bool sync);
+void _kvs_trace_commit();
+
+// called by the completing thread before the user callback or the wake-up
+// of the synchronous caller; returns the record to finish with
+// kvs_trace_end(), or NULL if the command isn't traced
+inline kvs_trace_record *kvs_trace_begin(kvs_context op, kvs_key_space_handle ks_hd,
+  const kvs_key *key, uint64_t bytes, kvs_result result, uint64_t submit_tsc,
+  uint64_t dispatch_tsc, bool sync) {
+  if (!submit_tsc) return NULL;
+  return _kvs_trace_begin(op, ks_hd, key, bytes, result, submit_tsc,
+    dispatch_tsc, sync);
+}
+
+inline kvs_trace_record *kvs_trace_begin(const kvs_postprocess_context *iocb,
+  kvs_result result, uint64_t submit_tsc, uint64_t dispatch_tsc, bool sync) {
+  if (!submit_tsc) return NULL;
+  return _kvs_trace_begin(iocb->context, iocb->ks_hd, iocb->key,
+    kvs_stats_io_bytes(iocb), result, submit_tsc, dispatch_tsc, sync);
+}
+
+inline void kvs_trace_end(kvs_trace_record *rec) {
+  if (!rec) return;
+  rec->callback_tsc = kvs_trace_tsc();
+  _kvs_trace_commit();
+}
+
+#endif /* INCLUDE_PRIVATE_KVS_TRACE_H_ */
@@ -42,8 +42,12 @@
 #include <mutex>
 #include <list>
 #include <map>
+#include <atomic>
 #include <condition_variable>
 #include "kvs_api.h"
+#include "kvs_stats.h"
+#include "kvs_trace.h"
+#include "kvs_completions.h"
 
 
 #ifndef WITH_SPDK
@@ -77,11 +81,10 @@ extern std::map<kv_result, kvs_result> code_map;
 
 inline kvs_result convert_return_code(kv_result kv_return_code)
 {
-  if(code_map.count(kv_return_code)!=0) {
-    return code_map[kv_return_code];
-  } else {
-    return KVS_ERR_SYS_IO;
-  }
+  if (kv_return_code == KV_SUCCESS)
+    return KVS_SUCCESS;
+  auto it = code_map.find(kv_return_code);
+  return (it != code_map.end()) ? it->second : KVS_ERR_SYS_IO;
 }
 #endif
 
@@ -124,16 +127,20 @@ public:
  * KvsDevice represents a KV SSD
  *
  */
+class KvsScheduler;
+
 class KvsDriver {
 public:
   kv_device_priv *dev;
   kvs_postprocess_function user_io_complete;
   std::list<kvs_key_space*> list_containers;
   std::list<kvs_key_space_handle> open_containers;
+  KvsStats stats; //operation statistics, counted by the driver adapters
+  std::atomic<KvsScheduler*> qos; //host QoS scheduler, NULL until kvs_set_qos() or kvs_set_key_space_qos()
 
  public:
  KvsDriver(kv_device_priv *dev_, kvs_postprocess_function user_io_complete_):
-	  dev(dev_), user_io_complete(user_io_complete_) {}
+	  dev(dev_), user_io_complete(user_io_complete_), qos(NULL) {}
 
   virtual ~KvsDriver() {}
 
@@ -160,15 +167,24 @@ public:
   virtual int32_t init(const char* devpath, bool syncio) {return 0;}
   virtual int32_t process_completions(int max) =0;
 
+  // per-command state of the driver embedded in a caller-owned request (kvs_alloc_requests());
+  // the async calls given req_ctx use it instead of allocating their own
+  virtual void *alloc_request_context() {return NULL;}
+  virtual void free_request_context(void *req_ctx) {}
+
   //SNIA API
   virtual int32_t store_tuple(kvs_key_space_handle ks_hd, const kvs_key *key,const kvs_value *value, 
-    kvs_option_store option, void *private1=NULL, void *private2=NULL, bool sync = false, kvs_postprocess_function cbfn = NULL) = 0;
+    kvs_option_store option, void *private1=NULL, void *private2=NULL, bool sync = false, kvs_postprocess_function cbfn = NULL,
+    void *req_ctx = NULL) = 0;
   virtual int32_t retrieve_tuple(kvs_key_space_handle ks_hd, const kvs_key *key, 
-  	kvs_value *value, kvs_option_retrieve option, void *private1=NULL, void *private2=NULL, bool sync = false, kvs_postprocess_function cbfn = NULL) = 0;
+  	kvs_value *value, kvs_option_retrieve option, void *private1=NULL, void *private2=NULL, bool sync = false, kvs_postprocess_function cbfn = NULL,
+    void *req_ctx = NULL) = 0;
   virtual int32_t delete_tuple(kvs_key_space_handle ks_hd, const kvs_key *key, 
-  	kvs_option_delete option, void *private1=NULL, void *private2=NULL, bool sync = false, kvs_postprocess_function cbfn = NULL) = 0;
+  	kvs_option_delete option, void *private1=NULL, void *private2=NULL, bool sync = false, kvs_postprocess_function cbfn = NULL,
+    void *req_ctx = NULL) = 0;
   virtual int32_t exist_tuple(kvs_key_space_handle ks_hd, uint32_t key_cnt, const kvs_key *keys, 
-  	kvs_exist_list *list, void *private1=NULL, void *private2=NULL, bool sync = false, kvs_postprocess_function cbfn = NULL) = 0;
+  	kvs_exist_list *list, void *private1=NULL, void *private2=NULL, bool sync = false, kvs_postprocess_function cbfn = NULL,
+    void *req_ctx = NULL) = 0;
   virtual int32_t create_iterator(kvs_key_space_handle ks_hd, kvs_option_iterator option, uint32_t bitmask, 
     uint32_t bit_pattern, kvs_iterator_handle *iter_hd) = 0;
   virtual int32_t delete_iterator(kvs_key_space_handle ks_hd, kvs_iterator_handle hiter) = 0;
@@ -179,10 +195,48 @@ public:
   virtual int32_t get_used_size(uint32_t *dev_util) {return 0;}
   virtual int32_t get_total_size(uint64_t *dev_capa) {return 0;}
   virtual int32_t get_device_info(kvs_device *dev_info) {return 0;}
+  // whether store_tuple() executes KVS_STORE_APPEND on the device
+  virtual bool native_append(bool syncio) {return false;}
+  // store_tuple() and retrieve_tuple() on a value scattered over segs, value only
+  // carries the total length and the offset; only drivers with native_vector_io() serve them
+  virtual bool native_vector_io() {return false;}
+  virtual int32_t store_tuple_vec(kvs_key_space_handle ks_hd, const kvs_key *key,
+    const kvs_value_segment *segs, uint32_t seg_cnt, const kvs_value *value, kvs_option_store option,
+    void *private1=NULL, void *private2=NULL, bool sync = false, kvs_postprocess_function cbfn = NULL) {
+    return KVS_ERR_OPTION_INVALID;
+  }
+  virtual int32_t retrieve_tuple_vec(kvs_key_space_handle ks_hd, const kvs_key *key,
+    const kvs_value_segment *segs, uint32_t seg_cnt, kvs_value *value, kvs_option_retrieve option,
+    void *private1=NULL, void *private2=NULL, bool sync = false, kvs_postprocess_function cbfn = NULL) {
+    return KVS_ERR_OPTION_INVALID;
+  }
+  // retrieve_tuple() of several byte ranges of a value with one command, value only
+  // receives the lengths; only drivers with native_range_read() serve it
+  virtual bool native_range_read() {return false;}
+  virtual int32_t retrieve_tuple_ranges(kvs_key_space_handle ks_hd, const kvs_key *key,
+    kvs_value_range *ranges, uint32_t range_cnt, kvs_value *value, kvs_option_retrieve option,
+    void *private1=NULL, void *private2=NULL, bool sync = false, kvs_postprocess_function cbfn = NULL) {
+    return KVS_ERR_OPTION_INVALID;
+  }
+  // exist_tuple() of several keys as single-key exists issued in parallel,
+  // for drivers whose exist command carries one key
+  int32_t exist_tuple_each(kvs_key_space_handle ks_hd, uint32_t key_cnt, const kvs_key *keys,
+    kvs_exist_list *list, void *private1, void *private2, bool sync, kvs_postprocess_function cbfn);
   
   std::string path;
 };
 
+// a caller-owned async request, see kvs_alloc_requests()
+struct _kvs_request {
+  kvs_device_handle dev;
+  void *ctx; //per-command state of the driver
+};
+
+// a caller-created completion queue, see kvs_create_completion_queue()
+struct _kvs_completion_queue {
+  KvsCompletions completions;
+};
+
 struct _kvs_device_handle {
   kv_device_priv * dev;
   KvsDriver* driver;
@@ -191,11 +245,22 @@ struct _kvs_device_handle {
   std::list<kvs_key_space_handle> open_ks_hds; //containers opened by user
 };
 
+class KvsPacker;
+class KvsAppender;
+class KvsCoalescer;
+class KvsKeyFilter;
+struct KvsQosTenant;
+
 struct _kvs_key_space_handle {
   uint8_t container_id;
   uint8_t keyspace_id; //corresponding keyspace id in KVSSD
   kvs_device_handle dev;
   char name[MAX_CONT_PATH_LEN + 1];
+  KvsPacker *packer; //small value packing layer, NULL if disabled
+  KvsAppender *appender; //dispatches KVS_STORE_APPEND, emulates it on the host if needed
+  KvsQosTenant *qos; //class and rate limits set by kvs_set_key_space_qos(), NULL if none
+  KvsCoalescer *coalescer; //single-flight retrieves, NULL if disabled
+  KvsKeyFilter *filter; //negative lookup filter, NULL if none
 };
 
 typedef struct {
@@ -255,4 +320,23 @@ typedef struct {
 } // extern "C"
 #endif
 
+// frontend helpers shared by the api modules, defined in cfrontend.cpp
+kvs_result _check_key_space_handle(kvs_key_space_handle ks_hd);
+bool _valid_post_fn(kvs_postprocess_function post_fn, void *private2);
+bool _env_sync_io_only();
+bool _env_is_polling();
+uint32_t _env_queue_depth();
+kvs_result _sync_io_to_key_space(kvs_key_space_handle ks_hd, const kvs_key* key,
+    kvs_value *value, void* io_option, kvs_context io_op);
+kvs_result _sync_io_to_meta_keyspace(kvs_device_handle dev_hd, const kvs_key* key,
+    kvs_value *value, void* io_option, kvs_context io_op);
+// a retrieve below the coalescing layer: packing, QoS scheduler or driver
+kvs_result _retrieve_from_key_space(kvs_key_space_handle ks_hd, const kvs_key *key,
+    kvs_value *value, const kvs_option_retrieve *opt, void *private1, void *private2,
+    bool sync, kvs_postprocess_function post_fn, void *req_ctx);
+// a delete below the filter: packing, QoS scheduler or driver
+kvs_result _delete_from_key_space(kvs_key_space_handle ks_hd, const kvs_key *key,
+    const kvs_option_delete *opt, void *private1, void *private2,
+    bool sync, kvs_postprocess_function post_fn, void *req_ctx);
+
 #endif /* INCLUDE_PRIVATE_PRIVATE_TYPES_H_ */
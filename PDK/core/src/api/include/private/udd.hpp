@@ -67,6 +67,9 @@ public:
     KUDDriver *owner;
     kvs_postprocess_function on_complete;
     kvs_iterator_list *iter_list;
+    uint64_t submit_ns;
+    uint64_t submit_tsc;
+    bool from_request;  // embedded in a caller-owned request, never freed
   } kv_udd_context;
   
   std::mutex lock;
@@ -78,10 +81,10 @@ public:
   virtual ~KUDDriver();
   virtual int32_t init(const char*devpath, bool syncio, uint64_t sq_core, uint64_t cq_core, uint32_t mem_size_mb, int queue_depth) override;
   virtual int32_t process_completions(int max) override;
-  virtual int32_t store_tuple(kvs_key_space_handle ks_hd, const kvs_key *key, const kvs_value *value, kvs_option_store option/*uint8_t option*/, void *private1=NULL, void *private2=NULL, bool sync = false, kvs_postprocess_function cbfn = NULL) override;
-  virtual int32_t retrieve_tuple(kvs_key_space_handle ks_hd, const kvs_key *key, kvs_value *value, kvs_option_retrieve option, void *private1=NULL, void *private2=NULL, bool sync = false, kvs_postprocess_function cbfn = NULL) override;
-  virtual int32_t delete_tuple(kvs_key_space_handle ks_hd, const kvs_key *key, kvs_option_delete option/*uint8_t option*/, void *private1=NULL, void *private2=NULL, bool sync = false, kvs_postprocess_function cbfn = NULL) override;
-  virtual int32_t exist_tuple(kvs_key_space_handle ks_hd, uint32_t key_cnt, const kvs_key *keys, kvs_exist_list *list, void *private1=NULL, void *private2=NULL, bool sync = false, kvs_postprocess_function cbfn = NULL) override;
+  virtual int32_t store_tuple(kvs_key_space_handle ks_hd, const kvs_key *key, const kvs_value *value, kvs_option_store option/*uint8_t option*/, void *private1=NULL, void *private2=NULL, bool sync = false, kvs_postprocess_function cbfn = NULL, void *req_ctx = NULL) override;
+  virtual int32_t retrieve_tuple(kvs_key_space_handle ks_hd, const kvs_key *key, kvs_value *value, kvs_option_retrieve option, void *private1=NULL, void *private2=NULL, bool sync = false, kvs_postprocess_function cbfn = NULL, void *req_ctx = NULL) override;
+  virtual int32_t delete_tuple(kvs_key_space_handle ks_hd, const kvs_key *key, kvs_option_delete option/*uint8_t option*/, void *private1=NULL, void *private2=NULL, bool sync = false, kvs_postprocess_function cbfn = NULL, void *req_ctx = NULL) override;
+  virtual int32_t exist_tuple(kvs_key_space_handle ks_hd, uint32_t key_cnt, const kvs_key *keys, kvs_exist_list *list, void *private1=NULL, void *private2=NULL, bool sync = false, kvs_postprocess_function cbfn = NULL, void *req_ctx = NULL) override;
   virtual int32_t create_iterator(kvs_key_space_handle ks_hd, kvs_option_iterator option, uint32_t bitmask, uint32_t bit_pattern, kvs_iterator_handle *iter_hd) override;
   virtual int32_t delete_iterator(kvs_key_space_handle ks_hd, kvs_iterator_handle hiter) override;
   virtual int32_t delete_iterator_all(kvs_key_space_handle ks_hd) override;
@@ -90,13 +93,17 @@ public:
   virtual int32_t get_used_size(uint32_t *dev_util) override;
   virtual int32_t get_total_size(uint64_t *dev_capa) override;
   virtual int32_t get_device_info(kvs_device *dev_info) override;
+  // the user driver has no asynchronous append command
+  virtual bool native_append(bool syncio) override { return syncio && sync_io; }
+  virtual void *alloc_request_context() override;
+  virtual void free_request_context(void *req_ctx) override;
   
 private:
 
   bool ispersist;
   std::string datapath;
 
-  kv_udd_context* prep_io_context(kvs_context opcode, kvs_key_space_handle ks_hd, const kvs_key *key, const kvs_value *value, void *private1, void *private2, bool syncio, kvs_postprocess_function cbfn);
+  kv_udd_context* prep_io_context(kvs_context opcode, kvs_key_space_handle ks_hd, const kvs_key *key, const kvs_value *value, void *private1, void *private2, bool syncio, kvs_postprocess_function cbfn, void *req_ctx = NULL);
   int32_t trans_iter_type(uint8_t dev_it_type, uint8_t* kvs_it_type);
   int32_t trans_store_cmd_opt(kvs_option_store kvs_opt, int *kv_opt);
   int16_t _get_queue_id(kvs_key_space_handle ks_hd);
@@ -37,6 +37,12 @@
 #include <list>
 #include "kvs_utils.h"
 #include "private_types.h"
+#include "kvs_packing.h"
+#include "kvs_append.h"
+#include "kvs_qos.h"
+#include "kvs_filter.h"
+#include "kvs_coalesce.h"
+#include "kvs_trace.h"
 #ifdef WITH_EMU
 #include "kvemul.hpp"
 #elif WITH_KDD
@@ -106,6 +112,7 @@ const char* errortable[] = {
   stringify(KVS_ERR_VALUE_OFFSET_MISALIGNED),
   stringify(KVS_ERR_VALUE_UPDATE_NOT_ALLOWED),
   stringify(KVS_ERR_DEV_NOT_OPENED),
+  stringify(KVS_ERR_CANCELED),
 };
 
 void init_default_option(kvs_init_options &options) {
@@ -265,6 +272,11 @@ kvs_result kvs_init_env(kvs_init_options* options) {
     */
   }
 
+  // trace the whole run
+  char *trace_path = getenv("KVSSD_TRACE");
+  if (trace_path)
+    kvs_trace_start(trace_path);
+
   g_env.initialized = true;
 
   //WRITE_LOG("INIT_ENV Finished: async? %d\n", g_env.use_async);
@@ -389,6 +401,7 @@ kvs_result _kvs_exit_env() {
   for (kvs_device_handle t : clone) {
       kvs_close_device(t);
   }
+  kvs_trace_stop();
   
   return KVS_SUCCESS;
 }
@@ -455,6 +468,7 @@ kvs_result kvs_open_device(char *URI, kvs_device_handle *dev_hd) {
     return ret;
   }
 #endif
+  user_dev->driver->stats.open(URI);
   user_dev->dev_path = (char*)malloc(strlen(URI) + 1);
   if (user_dev->dev_path == NULL) {
     delete user_dev;
@@ -477,6 +491,11 @@ kvs_result kvs_open_device(char *URI, kvs_device_handle *dev_hd) {
   user_dev->meta_ks_hd = ks_handle;
   ks_handle->keyspace_id = META_DATA_KEYSPACE_ID;
   ks_handle->dev = user_dev;
+  ks_handle->packer = NULL;
+  ks_handle->appender = NULL;
+  ks_handle->qos = NULL;
+  ks_handle->coalescer = NULL;
+  ks_handle->filter = NULL;
   snprintf(ks_handle->name, sizeof(ks_handle->name), "%s", "meta_data_keyspace");
   *dev_hd = user_dev;
 
@@ -513,7 +532,25 @@ kvs_result kvs_close_device(kvs_device_handle dev_hd) {
     return KVS_ERR_DEV_NOT_OPENED;
   }
 
+  // completes the commands the scheduler still holds
+  delete dev_hd->driver->qos.exchange(NULL);
+
   //free all opened key space handle in this device
+  for (const auto &t : dev_hd->open_ks_hds) {
+    delete t->qos;
+    delete t->coalescer;
+    delete t->appender;
+    if (t->packer) {
+      t->packer->close();
+      delete t->packer;
+    }
+    if (t->filter) {
+      if (t->filter->save() != KVS_SUCCESS)
+        fprintf(stderr, "WARN: failed to store the key filter of key space %s\n", t->name);
+      delete t->filter;
+    }
+  }
+
   if(dev_hd->meta_ks_hd)
     free(dev_hd->meta_ks_hd);
 
@@ -624,6 +661,162 @@ kvs_result kvs_get_optimal_value_length (kvs_device_handle dev_hd,
   return KVS_SUCCESS;
 }
 
+kvs_result kvs_get_stats(kvs_device_handle dev_hd, kvs_stats *stats) {
+  if((dev_hd == NULL) || (stats == NULL)) {
+    return KVS_ERR_PARAM_INVALID;
+  }
+  if (!_device_opened(dev_hd)) {
+    return KVS_ERR_DEV_NOT_OPENED;
+  }
+  dev_hd->driver->stats.get(stats);
+  return KVS_SUCCESS;
+}
+
+kvs_result kvs_reset_stats(kvs_device_handle dev_hd) {
+  if(dev_hd == NULL) {
+    return KVS_ERR_PARAM_INVALID;
+  }
+  if (!_device_opened(dev_hd)) {
+    return KVS_ERR_DEV_NOT_OPENED;
+  }
+  dev_hd->driver->stats.reset();
+  return KVS_SUCCESS;
+}
+
+// async commands are rejected at submission without a post process function,
+// or with kvs_queue_completion() but no queue to put their completion in
+bool _valid_post_fn(kvs_postprocess_function post_fn, void *private2) {
+  return post_fn != NULL && (post_fn != kvs_queue_completion || private2 != NULL);
+}
+
+void kvs_queue_completion(kvs_postprocess_context *ctx) {
+  ((kvs_completion_queue)ctx->private2)->completions.push(ctx);
+}
+
+kvs_result kvs_create_completion_queue(kvs_completion_queue *cq) {
+  if(cq == NULL) {
+    return KVS_ERR_PARAM_INVALID;
+  }
+  *cq = new _kvs_completion_queue();
+  return KVS_SUCCESS;
+}
+
+kvs_result kvs_delete_completion_queue(kvs_completion_queue cq) {
+  if(cq == NULL) {
+    return KVS_ERR_PARAM_INVALID;
+  }
+  delete cq;
+  return KVS_SUCCESS;
+}
+
+kvs_result kvs_get_completions(kvs_completion_queue cq, kvs_postprocess_context *events,
+  uint32_t max, uint32_t timeout_usec, uint32_t *count) {
+  if((cq == NULL) || (events == NULL) || (count == NULL)) {
+    return KVS_ERR_PARAM_INVALID;
+  }
+  *count = cq->completions.reap(events, max, timeout_usec);
+  return KVS_SUCCESS;
+}
+
+kvs_result kvs_get_completion_fd(kvs_completion_queue cq, int *fd) {
+  if((cq == NULL) || (fd == NULL)) {
+    return KVS_ERR_PARAM_INVALID;
+  }
+  *fd = cq->completions.fd();
+  if (*fd < 0) {
+    return KVS_ERR_SYS_IO;
+  }
+  return KVS_SUCCESS;
+}
+
+// the scheduler is only started once QoS is set, devices without it keep
+// calling the driver directly
+static KvsScheduler *_start_scheduler(kvs_device_handle dev_hd) {
+  pthread_mutex_lock(&env_mutex);
+  KvsScheduler *qos = dev_hd->driver->qos.load();
+  if (qos == NULL) {
+    qos = new KvsScheduler(dev_hd->driver);
+    dev_hd->driver->qos.store(qos, std::memory_order_release);
+  }
+  pthread_mutex_unlock(&env_mutex);
+  return qos;
+}
+
+kvs_result kvs_set_qos(kvs_device_handle dev_hd, const kvs_qos_option *opt) {
+  if((dev_hd == NULL) || (opt == NULL)) {
+    return KVS_ERR_PARAM_INVALID;
+  }
+  if (!_device_opened(dev_hd)) {
+    return KVS_ERR_DEV_NOT_OPENED;
+  }
+  _start_scheduler(dev_hd)->configure(opt);
+  return KVS_SUCCESS;
+}
+
+kvs_result kvs_set_key_space_qos(kvs_key_space_handle ks_hd, const kvs_option_key_space_qos *opt) {
+  kvs_result ret = _check_key_space_handle(ks_hd);
+  if (ret != KVS_SUCCESS) {
+    return ret;
+  }
+  if (opt == NULL) {
+    return KVS_ERR_PARAM_INVALID;
+  }
+  if ((uint32_t)opt->qos_class > KVS_QOS_INHERIT) {
+    return KVS_ERR_OPTION_INVALID;
+  }
+  _start_scheduler(ks_hd->dev)->configure(ks_hd, opt);
+  return KVS_SUCCESS;
+}
+
+kvs_result kvs_set_thread_qos_class(kvs_qos_class qos_class) {
+  if ((uint32_t)qos_class > KVS_QOS_INHERIT) {
+    return KVS_ERR_OPTION_INVALID;
+  }
+  KvsScheduler::thread_class = qos_class;
+  return KVS_SUCCESS;
+}
+
+kvs_result kvs_alloc_requests(kvs_device_handle dev_hd, uint32_t count, kvs_request_handle *reqs) {
+  if((dev_hd == NULL) || (reqs == NULL)) {
+    return KVS_ERR_PARAM_INVALID;
+  }
+  if (!_device_opened(dev_hd)) {
+    return KVS_ERR_DEV_NOT_OPENED;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    reqs[i] = new _kvs_request();
+    reqs[i]->dev = dev_hd;
+    reqs[i]->ctx = dev_hd->driver->alloc_request_context();
+  }
+  return KVS_SUCCESS;
+}
+
+kvs_result kvs_free_requests(kvs_device_handle dev_hd, uint32_t count, kvs_request_handle *reqs) {
+  if((dev_hd == NULL) || (reqs == NULL)) {
+    return KVS_ERR_PARAM_INVALID;
+  }
+  if (!_device_opened(dev_hd)) {
+    return KVS_ERR_DEV_NOT_OPENED;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    if (reqs[i] == NULL || reqs[i]->dev != dev_hd) {
+      continue;
+    }
+    dev_hd->driver->free_request_context(reqs[i]->ctx);
+    delete reqs[i];
+    reqs[i] = NULL;
+  }
+  return KVS_SUCCESS;
+}
+
+kvs_result kvs_start_trace(const char *path) {
+  return kvs_trace_start(path);
+}
+
+kvs_result kvs_stop_trace() {
+  return kvs_trace_stop();
+}
+
 bool _key_space_opened(kvs_device_handle dev_hd, const char* name) {
   if (dev_hd->open_ks_hds.empty()) return false;
   for (const auto &t : dev_hd->open_ks_hds) {
@@ -638,7 +831,7 @@ bool _key_space_opened(kvs_key_space_handle ks_hd) {
   else return true;
 }
 
-inline kvs_result _check_key_space_handle(kvs_key_space_handle ks_hd) {
+kvs_result _check_key_space_handle(kvs_key_space_handle ks_hd) {
   if (ks_hd == NULL) return KVS_ERR_PARAM_INVALID;
   if (!_key_space_opened(ks_hd)) return KVS_ERR_KS_NOT_OPEN;
   if ((ks_hd->dev == NULL) || (ks_hd->dev->driver == NULL))
@@ -648,6 +841,23 @@ inline kvs_result _check_key_space_handle(kvs_key_space_handle ks_hd) {
   return KVS_SUCCESS;
 }
 
+bool _env_sync_io_only() {
+#ifdef WITH_SPDK
+  // UDD only serves the interface that matches its configured io mode
+  return g_env.udd_option.syncio != 0;
+#else
+  return false;
+#endif
+}
+
+bool _env_is_polling() {
+  return g_env.is_polling != 0;
+}
+
+uint32_t _env_queue_depth() {
+  return g_env.queuedepth > 0 ? g_env.queuedepth : 1;
+}
+
 static void filter2context(kvs_key_group_filter* fltr, uint32_t* bitmask, uint32_t* bit_pattern) {
   *bitmask = (uint32_t)fltr->bitmask[3] | ((uint32_t)fltr->bitmask[2]) << 8 |
     ((uint32_t)fltr->bitmask[1]) << 16 | ((uint32_t)fltr->bitmask[0]) << 24;
@@ -693,7 +903,7 @@ void _metadata_keyspace_aio_complete_handle(kvs_postprocess_context *ioctx) {
     free(ioctx->result_buffer.list);
 }
 
-kvs_result _sync_io_to_meta_keyspace(kvs_device_handle dev_hd, const kvs_key* key,
+kvs_result _sync_io_to_key_space(kvs_key_space_handle ks_hd, const kvs_key* key,
     kvs_value *value, void* io_option, kvs_context io_op) {
   kvs_result ret = KVS_SUCCESS;
   bool syncio = true;
@@ -712,17 +922,16 @@ kvs_result _sync_io_to_meta_keyspace(kvs_device_handle dev_hd, const kvs_key* ke
     cbfn = _metadata_keyspace_aio_complete_handle;
   }
 #endif
-  kvs_key_space_handle ks_hd = dev_hd->meta_ks_hd;
   if (io_op == KVS_CMD_STORE) {
-    ret = (kvs_result)dev_hd->meta_ks_hd->dev->driver->store_tuple(ks_hd,
+    ret = (kvs_result)ks_hd->dev->driver->store_tuple(ks_hd,
         key, value, *((kvs_option_store*)io_option), (void*)&async_completed,
         (void*)&async_result, syncio, cbfn);
   } else if (io_op == KVS_CMD_RETRIEVE) {
-    ret = (kvs_result)dev_hd->meta_ks_hd->dev->driver->retrieve_tuple(
+    ret = (kvs_result)ks_hd->dev->driver->retrieve_tuple(
       ks_hd, key, value, *((kvs_option_retrieve*)io_option), (void*)&async_completed,
       (void*)&async_result, syncio, cbfn);
   }else if(io_op == KVS_CMD_DELETE){
-    ret = (kvs_result)dev_hd->meta_ks_hd->dev->driver->delete_tuple(
+    ret = (kvs_result)ks_hd->dev->driver->delete_tuple(
       ks_hd, key, *((kvs_option_delete*)io_option), (void*)&async_completed,
       (void*)&async_result, syncio, cbfn);
   }else {
@@ -735,10 +944,16 @@ kvs_result _sync_io_to_meta_keyspace(kvs_device_handle dev_hd, const kvs_key* ke
     while (true) {
       if (async_completed) break;
     }
+    ret = async_result;
   }
   return ret;
 }
 
+kvs_result _sync_io_to_meta_keyspace(kvs_device_handle dev_hd, const kvs_key* key,
+    kvs_value *value, void* io_option, kvs_context io_op) {
+  return _sync_io_to_key_space(dev_hd->meta_ks_hd, key, value, io_option, io_op);
+}
+
 kvs_result _exist_key_space_entry(kvs_device_handle dev_hd, const char* name,
     uint8_t* exist_buffer) {
   kvs_result ret = KVS_SUCCESS;
@@ -1296,6 +1511,7 @@ kvs_result kvs_delete_key_space(kvs_device_handle dev_hd,
     _add_to_key_space_list(dev_hd, key_space_name->name, &keyspace_id_removed);
     return ret;
   }
+  KvsKeyFilter::drop(dev_hd, keyspace_id_removed);
   return KVS_SUCCESS;
 }
 
@@ -1382,6 +1598,10 @@ kvs_result kvs_open_key_space(kvs_device_handle dev_hd, char *name, kvs_key_spac
   kvs_key_space_handle ks_handle = (kvs_key_space_handle)malloc(sizeof(struct _kvs_key_space_handle));
   if (!ks_handle) return KVS_ERR_SYS_IO;
   ks_handle->dev = dev_hd;
+  ks_handle->packer = NULL;
+  ks_handle->qos = NULL;
+  ks_handle->coalescer = NULL;
+  ks_handle->filter = NULL;
   snprintf(ks_handle->name, sizeof(ks_handle->name), "%s", name);
 
   ret = _open_key_space(ks_handle);
@@ -1390,6 +1610,9 @@ kvs_result kvs_open_key_space(kvs_device_handle dev_hd, char *name, kvs_key_spac
     free(ks_handle);
     return ret;
   }
+  ks_handle->appender = new KvsAppender(ks_handle);
+  // a filter stored by the previous handle tracks writes from now on
+  KvsKeyFilter::load(ks_handle, &ks_handle->filter);
 
   dev_hd->open_ks_hds.push_back(ks_handle);
   g_env.list_open_ks.push_back(ks_handle);
@@ -1411,6 +1634,23 @@ kvs_result kvs_close_key_space(kvs_key_space_handle ks_hd) {
   kvs_result ret = _check_key_space_handle(ks_hd);
   if (ret != KVS_SUCCESS) return ret;
 
+  // completes queued appends, which may still go through the packing layer
+  ks_hd->appender->close();
+
+  ret = kvs_disable_packing(ks_hd);
+  if (ret != KVS_SUCCESS) {
+    fprintf(stderr, "Disable packing failed. error code:0x%x-%s.\n", ret,
+        kvs_errstr(ret));
+  }
+
+  if (ks_hd->filter) {
+    ret = ks_hd->filter->save();
+    if (ret != KVS_SUCCESS) {
+      fprintf(stderr, "Store key filter failed. error code:0x%x-%s.\n", ret,
+          kvs_errstr(ret));
+    }
+  }
+
   ret = _close_key_space(ks_hd);
   if (ret != KVS_SUCCESS) {
     fprintf(stderr, "Close key space failed. error code:0x%x-%s.\n", ret,
@@ -1420,6 +1660,11 @@ kvs_result kvs_close_key_space(kvs_key_space_handle ks_hd) {
   kvs_device_handle dev_hd = ks_hd->dev;
   dev_hd->open_ks_hds.remove(ks_hd);
   g_env.list_open_ks.remove(ks_hd);
+  delete ks_hd->appender;
+  delete ks_hd->coalescer;
+  delete ks_hd->filter;
+  KvsScheduler *qos = dev_hd->driver->qos.load();
+  if (qos) qos->release(ks_hd);
   free(ks_hd);
   return ret;
 }
@@ -1486,6 +1731,25 @@ kvs_result kvs_get_key_space_info(kvs_key_space_handle ks_hd, kvs_key_space *ks)
   return ret;
 }
 
+// the QoS scheduler in front of the driver, if any
+static inline KvsScheduler *_scheduler(kvs_key_space_handle ks_hd) {
+  return ks_hd->dev->driver->qos.load(std::memory_order_acquire);
+}
+
+// a write of key closes the retrieves of the key in flight to new callers
+static inline void _invalidate_retrieves(kvs_key_space_handle ks_hd, const kvs_key *key) {
+  if (ks_hd->coalescer)
+    ks_hd->coalescer->invalidate(key);
+}
+
+// an async write of key closes them again when it completes, NULL if nothing is wrapped
+static inline void *_wrap_write(kvs_key_space_handle ks_hd, kvs_key *key, void **private1,
+    void **private2, kvs_postprocess_function *post_fn) {
+  if (ks_hd->coalescer)
+    return ks_hd->coalescer->wrap_write(key, private1, private2, post_fn);
+  return NULL;
+}
+
 kvs_result kvs_store_kvp(kvs_key_space_handle ks_hd, kvs_key *key, 
                       kvs_value *value, kvs_option_store *opt) {
   int ret = _check_key_space_handle(ks_hd);
@@ -1501,30 +1765,82 @@ kvs_result kvs_store_kvp(kvs_key_space_handle ks_hd, kvs_key *key,
   if(ret)
     return (kvs_result)ret;
 
-  ret = ks_hd->dev->driver->store_tuple(ks_hd, key, value,
-    *opt, 0, 0, 1, 0);
+  // retrieves in flight are closed to new callers when the store is issued
+  // and again when it completes
+  _invalidate_retrieves(ks_hd, key);
+  // an append always extends the value at its end
+  if (opt->st_type == KVS_STORE_APPEND && value->offset != 0)
+    return KVS_ERR_VALUE_OFFSET_INVALID;
+  // the key is in the filter before any lookup can find it on the device
+  _filter_insert(ks_hd, key);
+  if (opt->st_type == KVS_STORE_APPEND) {
+    ret = ks_hd->appender->append(key, value, 0, 0, 1, 0);
+  } else if (ks_hd->packer) {
+    ret = ks_hd->packer->store(key, value, opt, 0, 0, 1, 0);
+  } else {
+    KvsScheduler *qos = _scheduler(ks_hd);
+    if (qos)
+      ret = qos->store_tuple(ks_hd, key, value,
+        *opt, 0, 0, 1, 0);
+    else
+      ret = ks_hd->dev->driver->store_tuple(ks_hd, key, value,
+        *opt, 0, 0, 1, 0);
+  }
+  _invalidate_retrieves(ks_hd, key);
   return (kvs_result)ret;
 }
 
-kvs_result kvs_store_kvp_async(kvs_key_space_handle ks_hd, kvs_key *key, kvs_value *value,
-        kvs_option_store *opt, void *private1, void *private2, kvs_postprocess_function post_fn) {
+static kvs_result _store_kvp_async(kvs_key_space_handle ks_hd, kvs_key *key, kvs_value *value,
+        kvs_option_store *opt, void *private1, void *private2, kvs_postprocess_function post_fn,
+        void *req_ctx) {
   int ret = _check_key_space_handle(ks_hd);
   if (ret!=KVS_SUCCESS) {
     return (kvs_result)ret;
   }
 
-  if(key == NULL || value == NULL || opt == NULL || post_fn == NULL)
+  if(key == NULL || value == NULL || opt == NULL || !_valid_post_fn(post_fn, private2))
     return KVS_ERR_PARAM_INVALID;
 
   ret = validate_request(key, value);
   if(ret)
     return (kvs_result)ret;
 
-  ret = ks_hd->dev->driver->store_tuple(ks_hd, key, value,
-    *opt, private1, private2, 0, post_fn);
+  _invalidate_retrieves(ks_hd, key);
+  if (opt->st_type == KVS_STORE_APPEND && value->offset != 0)
+    return KVS_ERR_VALUE_OFFSET_INVALID;
+  _filter_insert(ks_hd, key);
+  void *write = _wrap_write(ks_hd, key, &private1, &private2, &post_fn);
+  if (opt->st_type == KVS_STORE_APPEND) {
+    ret = ks_hd->appender->append(key, value, private1, private2, 0, post_fn);
+  } else if (ks_hd->packer) {
+    ret = ks_hd->packer->store(key, value, opt, private1, private2, 0, post_fn);
+  } else {
+    KvsScheduler *qos = _scheduler(ks_hd);
+    if (qos)
+      ret = qos->store_tuple(ks_hd, key, value,
+        *opt, private1, private2, 0, post_fn, req_ctx);
+    else
+      ret = ks_hd->dev->driver->store_tuple(ks_hd, key, value,
+        *opt, private1, private2, 0, post_fn, req_ctx);
+  }
+  if (ret != KVS_SUCCESS && write)
+    KvsCoalescer::drop_write(write);
   return (kvs_result)ret;
 }
 
+kvs_result kvs_store_kvp_async(kvs_key_space_handle ks_hd, kvs_key *key, kvs_value *value,
+        kvs_option_store *opt, void *private1, void *private2, kvs_postprocess_function post_fn) {
+  return _store_kvp_async(ks_hd, key, value, opt, private1, private2, post_fn, NULL);
+}
+
+kvs_result kvs_store_kvp_req(kvs_request_handle req, kvs_key_space_handle ks_hd, kvs_key *key,
+        kvs_value *value, kvs_option_store *opt, void *private1, void *private2,
+        kvs_postprocess_function post_fn) {
+  if (req == NULL || ks_hd == NULL || req->dev != ks_hd->dev)
+    return KVS_ERR_PARAM_INVALID;
+  return _store_kvp_async(ks_hd, key, value, opt, private1, private2, post_fn, req->ctx);
+}
+
 kvs_result kvs_retrieve_kvp(kvs_key_space_handle ks_hd, kvs_key *key,
                         kvs_option_retrieve *opt, kvs_value *value) {
   int ret = _check_key_space_handle(ks_hd);
@@ -1540,19 +1856,42 @@ kvs_result kvs_retrieve_kvp(kvs_key_space_handle ks_hd, kvs_key *key,
   if (value->length & (KVS_VALUE_LENGTH_ALIGNMENT_UNIT - 1))
       return KVS_ERR_PARAM_INVALID;
 
-  ret = ks_hd->dev->driver->retrieve_tuple(ks_hd, key, value,
-    *opt, 0, 0, 1, 0);
+  if (_filter_excludes(ks_hd, key)) {
+    value->actual_value_size = 0;
+    return KVS_ERR_KEY_NOT_EXIST;
+  }
+  if (ks_hd->coalescer) {
+    if (!opt->kvs_retrieve_delete)
+      return ks_hd->coalescer->retrieve(key, value, opt, 0, 0, 1, 0, NULL);
+    ks_hd->coalescer->invalidate(key);
+  }
+  return _retrieve_from_key_space(ks_hd, key, value, opt, 0, 0, 1, 0, NULL);
+}
+
+kvs_result _retrieve_from_key_space(kvs_key_space_handle ks_hd, const kvs_key *key,
+    kvs_value *value, const kvs_option_retrieve *opt, void *private1, void *private2,
+    bool sync, kvs_postprocess_function post_fn, void *req_ctx) {
+  int32_t ret;
+  if (ks_hd->packer)
+    return ks_hd->packer->retrieve(key, value, opt, private1, private2, sync, post_fn);
+  KvsScheduler *qos = _scheduler(ks_hd);
+  if (qos)
+    ret = qos->retrieve_tuple(ks_hd, key, value,
+      *opt, private1, private2, sync, post_fn, req_ctx);
+  else
+    ret = ks_hd->dev->driver->retrieve_tuple(ks_hd, key, value,
+      *opt, private1, private2, sync, post_fn, req_ctx);
   return (kvs_result)ret;
 }
 
-kvs_result kvs_retrieve_kvp_async(kvs_key_space_handle ks_hd, kvs_key *key, 
+static kvs_result _retrieve_kvp_async(kvs_key_space_handle ks_hd, kvs_key *key, 
       kvs_option_retrieve *opt, void *private1, void *private2, kvs_value *value, 
-      kvs_postprocess_function post_fn) {
+      kvs_postprocess_function post_fn, void *req_ctx) {
   int ret = _check_key_space_handle(ks_hd);
   if (ret!=KVS_SUCCESS) {
     return (kvs_result)ret;
   }
-  if(key == NULL || value == NULL || opt == NULL || post_fn == NULL)
+  if(key == NULL || value == NULL || opt == NULL || !_valid_post_fn(post_fn, private2))
     return KVS_ERR_PARAM_INVALID;
   ret = validate_request(key, value);
   if(ret)
@@ -1560,9 +1899,28 @@ kvs_result kvs_retrieve_kvp_async(kvs_key_space_handle ks_hd, kvs_key *key,
   if (value->length & (KVS_VALUE_LENGTH_ALIGNMENT_UNIT - 1))
       return KVS_ERR_PARAM_INVALID;
 
-  ret = ks_hd->dev->driver->retrieve_tuple(ks_hd, key, value,
-    *opt, private1, private2, 0, post_fn);
-  return (kvs_result)ret;
+  if (_filter_excludes(ks_hd, key))
+    return ks_hd->filter->complete(KVS_CMD_RETRIEVE, key, value, NULL, private1, private2, post_fn);
+  if (ks_hd->coalescer) {
+    if (!opt->kvs_retrieve_delete)
+      return ks_hd->coalescer->retrieve(key, value, opt, private1, private2, 0, post_fn, req_ctx);
+    ks_hd->coalescer->invalidate(key);
+  }
+  return _retrieve_from_key_space(ks_hd, key, value, opt, private1, private2, 0, post_fn, req_ctx);
+}
+
+kvs_result kvs_retrieve_kvp_async(kvs_key_space_handle ks_hd, kvs_key *key, 
+      kvs_option_retrieve *opt, void *private1, void *private2, kvs_value *value, 
+      kvs_postprocess_function post_fn) {
+  return _retrieve_kvp_async(ks_hd, key, opt, private1, private2, value, post_fn, NULL);
+}
+
+kvs_result kvs_retrieve_kvp_req(kvs_request_handle req, kvs_key_space_handle ks_hd, kvs_key *key,
+      kvs_option_retrieve *opt, void *private1, void *private2, kvs_value *value,
+      kvs_postprocess_function post_fn) {
+  if (req == NULL || ks_hd == NULL || req->dev != ks_hd->dev)
+    return KVS_ERR_PARAM_INVALID;
+  return _retrieve_kvp_async(ks_hd, key, opt, private1, private2, value, post_fn, req->ctx);
 }
 
 kvs_result kvs_exist_kv_pairs(kvs_key_space_handle ks_hd, uint32_t key_cnt, kvs_key *keys, kvs_exist_list *list) {
@@ -1585,16 +1943,25 @@ kvs_result kvs_exist_kv_pairs(kvs_key_space_handle ks_hd, uint32_t key_cnt, kvs_
   if(list->length <= 0)
       return KVS_ERR_BUFFER_SMALL;
   
-  ret = ks_hd->dev->driver->exist_tuple(ks_hd, key_cnt, keys,
-    list, NULL, NULL, 1, 0); 
+  if (ks_hd->filter && ks_hd->filter->excludes_all(key_cnt, keys, list))
+    return KVS_SUCCESS;
+  if (ks_hd->packer)
+    return ks_hd->packer->exist(key_cnt, keys, list, NULL, NULL, 1, 0);
+  KvsScheduler *qos = _scheduler(ks_hd);
+  if (qos)
+    ret = qos->exist_tuple(ks_hd, key_cnt, keys,
+      list, NULL, NULL, 1, 0);
+  else
+    ret = ks_hd->dev->driver->exist_tuple(ks_hd, key_cnt, keys,
+      list, NULL, NULL, 1, 0); 
   return (kvs_result)ret;
 }
 
-kvs_result kvs_exist_kv_pairs_async(kvs_key_space_handle ks_hd, uint32_t key_cnt, 
+static kvs_result _exist_kv_pairs_async(kvs_key_space_handle ks_hd, uint32_t key_cnt, 
       kvs_key *keys, kvs_exist_list *list, void *private1, void *private2, 
-      kvs_postprocess_function post_fn) {
+      kvs_postprocess_function post_fn, void *req_ctx) {
   int ret = KVS_SUCCESS;    
-  if (keys == NULL || list == NULL || post_fn == NULL || list->result_buffer == NULL || (key_cnt <= 0))
+  if (keys == NULL || list == NULL || !_valid_post_fn(post_fn, private2) || list->result_buffer == NULL || (key_cnt <= 0))
     return KVS_ERR_PARAM_INVALID;
 
   for (unsigned int i = 0; i != key_cnt; ++i) {
@@ -1613,12 +1980,35 @@ kvs_result kvs_exist_kv_pairs_async(kvs_key_space_handle ks_hd, uint32_t key_cnt
   if(list->length  <= 0)
     return KVS_ERR_BUFFER_SMALL;
   
-  ret = ks_hd->dev->driver->exist_tuple(ks_hd, key_cnt, keys,
-    list, private1, private2, 0, post_fn);
+  if (ks_hd->filter && ks_hd->filter->excludes_all(key_cnt, keys, list))
+    return ks_hd->filter->complete(KVS_CMD_EXIST, keys, NULL, list, private1, private2, post_fn);
+  if (ks_hd->packer)
+    return ks_hd->packer->exist(key_cnt, keys, list, private1, private2, 0, post_fn);
+  KvsScheduler *qos = _scheduler(ks_hd);
+  if (qos)
+    ret = qos->exist_tuple(ks_hd, key_cnt, keys,
+      list, private1, private2, 0, post_fn, req_ctx);
+  else
+    ret = ks_hd->dev->driver->exist_tuple(ks_hd, key_cnt, keys,
+      list, private1, private2, 0, post_fn, req_ctx);
 
   return (kvs_result)ret;
 }
 
+kvs_result kvs_exist_kv_pairs_async(kvs_key_space_handle ks_hd, uint32_t key_cnt, 
+      kvs_key *keys, kvs_exist_list *list, void *private1, void *private2, 
+      kvs_postprocess_function post_fn) {
+  return _exist_kv_pairs_async(ks_hd, key_cnt, keys, list, private1, private2, post_fn, NULL);
+}
+
+kvs_result kvs_exist_kv_pairs_req(kvs_request_handle req, kvs_key_space_handle ks_hd,
+      uint32_t key_cnt, kvs_key *keys, kvs_exist_list *list, void *private1, void *private2,
+      kvs_postprocess_function post_fn) {
+  if (req == NULL || ks_hd == NULL || req->dev != ks_hd->dev)
+    return KVS_ERR_PARAM_INVALID;
+  return _exist_kv_pairs_async(ks_hd, key_cnt, keys, list, private1, private2, post_fn, req->ctx);
+}
+
 kvs_result kvs_create_iterator(kvs_key_space_handle ks_hd, kvs_option_iterator *iter_op,
                       kvs_key_group_filter *iter_fltr, kvs_iterator_handle *iter_hd) {
   int ret = _check_key_space_handle(ks_hd);
@@ -1662,31 +2052,71 @@ kvs_result kvs_delete_kvp(kvs_key_space_handle ks_hd, kvs_key *key, kvs_option_d
   if(ret != KVS_SUCCESS)
     return ret;
 
-  ret = (kvs_result)ks_hd->dev->driver->delete_tuple(ks_hd, key, 
-    *opt, NULL, NULL, 1, 0);
+  _invalidate_retrieves(ks_hd, key);
+  if (ks_hd->filter)
+    ret = ks_hd->filter->remove(key, opt, NULL, NULL, 1, 0, NULL);
+  else
+    ret = _delete_from_key_space(ks_hd, key, opt, NULL, NULL, 1, 0, NULL);
+  _invalidate_retrieves(ks_hd, key);
   return ret;
 }
 
-kvs_result kvs_delete_kvp_async(kvs_key_space_handle ks_hd, kvs_key* key, 
+kvs_result _delete_from_key_space(kvs_key_space_handle ks_hd, const kvs_key *key,
+    const kvs_option_delete *opt, void *private1, void *private2,
+    bool sync, kvs_postprocess_function post_fn, void *req_ctx) {
+  int32_t ret;
+  if (ks_hd->packer)
+    return ks_hd->packer->remove(key, opt, private1, private2, sync, post_fn);
+  KvsScheduler *qos = _scheduler(ks_hd);
+  if (qos)
+    ret = qos->delete_tuple(ks_hd, key,
+      *opt, private1, private2, sync, post_fn, req_ctx);
+  else
+    ret = ks_hd->dev->driver->delete_tuple(ks_hd, key,
+      *opt, private1, private2, sync, post_fn, req_ctx);
+  return (kvs_result)ret;
+}
+
+static kvs_result _delete_kvp_async(kvs_key_space_handle ks_hd, kvs_key* key, 
       kvs_option_delete *opt, void *private1, void *private2, 
-      kvs_postprocess_function post_fn) {
+      kvs_postprocess_function post_fn, void *req_ctx) {
 
   kvs_result ret = _check_key_space_handle(ks_hd);
   if (ret != KVS_SUCCESS) {
     return ret;
   }
-  if((key == NULL) || (opt == NULL) || (post_fn == NULL))
+  if((key == NULL) || (opt == NULL) || !_valid_post_fn(post_fn, private2))
     return KVS_ERR_PARAM_INVALID;
 
   ret = (kvs_result)validate_request(key, 0);
   if(ret != KVS_SUCCESS) 
     return ret;
   
-  ret = (kvs_result)ks_hd->dev->driver->delete_tuple(ks_hd, key,
-    *opt, private1, private2, 0, post_fn);
+  _invalidate_retrieves(ks_hd, key);
+  void *write = _wrap_write(ks_hd, key, &private1, &private2, &post_fn);
+  if (ks_hd->filter)
+    ret = ks_hd->filter->remove(key, opt, private1, private2, 0, post_fn, req_ctx);
+  else
+    ret = _delete_from_key_space(ks_hd, key, opt, private1, private2, 0, post_fn, req_ctx);
+  if (ret != KVS_SUCCESS && write)
+    KvsCoalescer::drop_write(write);
   return ret;
 }
 
+kvs_result kvs_delete_kvp_async(kvs_key_space_handle ks_hd, kvs_key* key, 
+      kvs_option_delete *opt, void *private1, void *private2, 
+      kvs_postprocess_function post_fn) {
+  return _delete_kvp_async(ks_hd, key, opt, private1, private2, post_fn, NULL);
+}
+
+kvs_result kvs_delete_kvp_req(kvs_request_handle req, kvs_key_space_handle ks_hd, kvs_key* key,
+      kvs_option_delete *opt, void *private1, void *private2,
+      kvs_postprocess_function post_fn) {
+  if (req == NULL || ks_hd == NULL || req->dev != ks_hd->dev)
+    return KVS_ERR_PARAM_INVALID;
+  return _delete_kvp_async(ks_hd, key, opt, private1, private2, post_fn, req->ctx);
+}
+
 kvs_result kvs_iterate_next(kvs_key_space_handle ks_hd, kvs_iterator_handle iter_hd, 
     kvs_iterator_list *iter_list) {
 
@@ -1702,13 +2132,17 @@ kvs_result kvs_iterate_next(kvs_key_space_handle ks_hd, kvs_iterator_handle iter
     return KVS_ERR_SYS_IO;
   }
 
-  ret = (kvs_result)ks_hd->dev->driver->iterator_next(ks_hd, iter_hd, iter_list, NULL, NULL, 1, 0);
+  KvsScheduler *qos = _scheduler(ks_hd);
+  if (qos)
+    ret = (kvs_result)qos->iterator_next(ks_hd, iter_hd, iter_list, NULL, NULL, 1, 0);
+  else
+    ret = (kvs_result)ks_hd->dev->driver->iterator_next(ks_hd, iter_hd, iter_list, NULL, NULL, 1, 0);
   return ret;
 }
 
 kvs_result kvs_iterate_next_async(kvs_key_space_handle ks_hd, kvs_iterator_handle iter_hd , 
     kvs_iterator_list *iter_list, void *private1, void *private2, kvs_postprocess_function post_fn) {
-  if (iter_list == NULL || iter_list->it_list == NULL || post_fn == NULL){
+  if (iter_list == NULL || iter_list->it_list == NULL || !_valid_post_fn(post_fn, private2)){
     return KVS_ERR_PARAM_INVALID;
   }
 
@@ -1721,8 +2155,13 @@ kvs_result kvs_iterate_next_async(kvs_key_space_handle ks_hd, kvs_iterator_handl
     return KVS_ERR_SYS_IO;
   }
 
-  ret = (kvs_result)ks_hd->dev->driver->iterator_next(ks_hd, iter_hd, iter_list, private1, 
-    private2, 0, post_fn);
+  KvsScheduler *qos = _scheduler(ks_hd);
+  if (qos)
+    ret = (kvs_result)qos->iterator_next(ks_hd, iter_hd, iter_list, private1, 
+      private2, 0, post_fn);
+  else
+    ret = (kvs_result)ks_hd->dev->driver->iterator_next(ks_hd, iter_hd, iter_list, private1, 
+      private2, 0, post_fn);
   return ret;
 }
 
@@ -64,6 +64,7 @@ inline void malloc_context(KvEmulator::kv_emul_context **ctx,
 inline void free_context(KvEmulator::kv_emul_context *ctx,
                          std::condition_variable* ctx_pool_notfull,
                          std::queue<KvEmulator::kv_emul_context *> &pool, std::mutex& pool_lock) {
+  if (ctx->from_request) return;
 #if defined use_pool
   std::unique_lock<std::mutex> lock(pool_lock);
   memset(ctx, 0, sizeof(KvEmulator::kv_emul_context));
@@ -164,6 +165,10 @@ void on_io_complete(kv_io_context *context) {
   if (context->opcode == KV_OPC_GET)
     iocb->value->actual_value_size = context->value->actual_value_size -
                                      context->value->offset;
+  kvs_result result = convert_return_code(context->retcode);
+  owner->stats.record(iocb, result, ctx->submit_ns);
+  kvs_trace_record *trace = kvs_trace_begin(iocb, result, ctx->submit_tsc,
+    context->dispatch_tsc, ctx->syncio);
 
   if (ctx->syncio) {  	
     /*The conversion of the adi layer return code in the synchronous call is in the main entry method.*/
@@ -179,15 +184,19 @@ void on_io_complete(kv_io_context *context) {
       lock_s.unlock();
     }
   } else {
-    iocb->result = convert_return_code(context->retcode);
+    iocb->result = result;
+    // a reused request may be resubmitted from the callback, ctx isn't read after it
+    const bool from_request = ctx->from_request;
     if (context->opcode != KV_OPC_OPEN_ITERATOR
         && context->opcode != KV_OPC_CLOSE_ITERATOR) {
       if (ctx->on_complete && iocb) {
         ctx->on_complete(iocb);
       }
     }
-    free_context(ctx, &owner->ctx_pool_notfull, owner->kv_ctx_pool, owner->lock);
+    if (!from_request)
+      free_context(ctx, &owner->ctx_pool_notfull, owner->kv_ctx_pool, owner->lock);
   }
+  kvs_trace_end(trace);
 }
 
 int KvEmulator::create_queue(int qdepth, uint16_t qtype,
@@ -262,9 +271,14 @@ int32_t KvEmulator::init(const char* devpath, const char* configfile,
 KvEmulator::kv_emul_context* KvEmulator::prep_io_context(kvs_context opcode,
     kvs_key_space_handle ks_hd, const kvs_key *key, const kvs_value *value,
     void *private1,
-    void *private2, bool syncio, kvs_postprocess_function post_fn) {
-  kv_emul_context *ctx = NULL;
-  malloc_context(&ctx, &this->ctx_pool_notfull, this->kv_ctx_pool, this->lock);
+    void *private2, bool syncio, kvs_postprocess_function post_fn, void *req_ctx) {
+  kv_emul_context *ctx = (kv_emul_context*)req_ctx;
+  if (ctx) {
+    memset(&ctx->iocb, 0, sizeof(ctx->iocb));
+    ctx->from_request = true;
+  } else {
+    malloc_context(&ctx, &this->ctx_pool_notfull, this->kv_ctx_pool, this->lock);
+  }
   ctx->on_complete = post_fn;
   ctx->iocb.context = opcode;
   ctx->iocb.ks_hd = ks_hd;
@@ -285,17 +299,43 @@ KvEmulator::kv_emul_context* KvEmulator::prep_io_context(kvs_context opcode,
   ctx->owner = this;
 
   ctx->syncio = syncio;
+  ctx->submit_ns = kvs_stats_now();
+  ctx->submit_tsc = kvs_trace_submit();
   std::unique_lock<std::mutex> lock_s(ctx->lock_sync);
   ctx->done_sync = 0;
   return ctx;
 }
 
+void *KvEmulator::alloc_request_context() {
+  return new kv_emul_context();
+}
+
+void KvEmulator::free_request_context(void *req_ctx) {
+  delete (kv_emul_context*)req_ctx;
+}
+
 /* MAIN ENTRY POINT */
 int32_t KvEmulator::store_tuple(kvs_key_space_handle ks_hd, const kvs_key *key,
                                 const kvs_value *value, kvs_option_store option, void *private1, void *private2,
-                                bool syncio, kvs_postprocess_function post_fn) {
+                                bool syncio, kvs_postprocess_function post_fn, void *req_ctx) {
+  return submit_store(ks_hd, key, NULL, 0, value, option, private1, private2,
+                      syncio, post_fn, req_ctx);
+}
+
+int32_t KvEmulator::store_tuple_vec(kvs_key_space_handle ks_hd, const kvs_key *key,
+                                    const kvs_value_segment *segs, uint32_t seg_cnt, const kvs_value *value,
+                                    kvs_option_store option, void *private1, void *private2,
+                                    bool syncio, kvs_postprocess_function post_fn) {
+  return submit_store(ks_hd, key, segs, seg_cnt, value, option, private1, private2,
+                      syncio, post_fn);
+}
+
+int32_t KvEmulator::submit_store(kvs_key_space_handle ks_hd, const kvs_key *key,
+                                 const kvs_value_segment *segs, uint32_t seg_cnt, const kvs_value *value,
+                                 kvs_option_store option, void *private1, void *private2,
+                                 bool syncio, kvs_postprocess_function post_fn, void *req_ctx) {
   auto ctx = prep_io_context(KVS_CMD_STORE, ks_hd, key, value, private1,
-                             private2, syncio, post_fn);
+                             private2, syncio, post_fn, req_ctx);
   kv_postprocess_function f = {on_io_complete, (void*)ctx};
 
   kv_store_option option_adi;
@@ -321,8 +361,13 @@ int32_t KvEmulator::store_tuple(kvs_key_space_handle ks_hd, const kvs_key *key,
 
   ctx->key = (kv_key*)key;
   ctx->value = (kv_value*)value;
-  int ret = kv_store(this->sqH, this->nsH, ks_hd->keyspace_id, (kv_key*)key,
-                     (kv_value*)value, option_adi, &f);
+  int ret;
+  if (segs)
+    ret = kv_store_vec(this->sqH, this->nsH, ks_hd->keyspace_id, (kv_key*)key,
+                       (const kv_value_segment*)segs, seg_cnt, (kv_value*)value, option_adi, &f);
+  else
+    ret = kv_store(this->sqH, this->nsH, ks_hd->keyspace_id, (kv_key*)key,
+                   (kv_value*)value, option_adi, &f);
   if (ret != KV_SUCCESS) {
     fprintf(stderr, "kv_store failed with error:  0x%X\n", ret);
     free_context(ctx, &this->ctx_pool_notfull, this->kv_ctx_pool, this->lock);
@@ -345,9 +390,34 @@ int32_t KvEmulator::store_tuple(kvs_key_space_handle ks_hd, const kvs_key *key,
 
 int32_t KvEmulator::retrieve_tuple(kvs_key_space_handle ks_hd, const kvs_key *key,
   kvs_value *value, kvs_option_retrieve option, void *private1, void *private2,
+  bool syncio, kvs_postprocess_function cbfn, void *req_ctx) {
+  return submit_retrieve(ks_hd, key, NULL, 0, NULL, 0, value, option, private1, private2,
+    syncio, cbfn, req_ctx);
+}
+
+int32_t KvEmulator::retrieve_tuple_vec(kvs_key_space_handle ks_hd, const kvs_key *key,
+  const kvs_value_segment *segs, uint32_t seg_cnt, kvs_value *value,
+  kvs_option_retrieve option, void *private1, void *private2,
+  bool syncio, kvs_postprocess_function cbfn) {
+  return submit_retrieve(ks_hd, key, segs, seg_cnt, NULL, 0, value, option, private1, private2,
+    syncio, cbfn);
+}
+
+int32_t KvEmulator::retrieve_tuple_ranges(kvs_key_space_handle ks_hd, const kvs_key *key,
+  kvs_value_range *ranges, uint32_t range_cnt, kvs_value *value,
+  kvs_option_retrieve option, void *private1, void *private2,
   bool syncio, kvs_postprocess_function cbfn) {
+  return submit_retrieve(ks_hd, key, NULL, 0, ranges, range_cnt, value, option, private1, private2,
+    syncio, cbfn);
+}
+
+int32_t KvEmulator::submit_retrieve(kvs_key_space_handle ks_hd, const kvs_key *key,
+  const kvs_value_segment *segs, uint32_t seg_cnt,
+  kvs_value_range *ranges, uint32_t range_cnt, kvs_value *value,
+  kvs_option_retrieve option, void *private1, void *private2,
+  bool syncio, kvs_postprocess_function cbfn, void *req_ctx) {
   auto ctx = prep_io_context(KVS_CMD_RETRIEVE, ks_hd, key, value, private1, 
-    private2, syncio, cbfn);
+    private2, syncio, cbfn, req_ctx);
   kv_postprocess_function f = {on_io_complete, (void*)ctx};
 
   kv_retrieve_option option_adi;
@@ -359,8 +429,16 @@ int32_t KvEmulator::retrieve_tuple(kvs_key_space_handle ks_hd, const kvs_key *ke
 
   ctx->key = (kv_key*)key;
   ctx->value = (kv_value*)value;
-  int ret = kv_retrieve(this->sqH, this->nsH, ks_hd->keyspace_id, 
-    (kv_key*)key, option_adi, (kv_value*)value, &f);
+  int ret;
+  if (ranges)
+    ret = kv_retrieve_ranges(this->sqH, this->nsH, ks_hd->keyspace_id,
+      (kv_key*)key, option_adi, (kv_value_range*)ranges, range_cnt, (kv_value*)value, &f);
+  else if (segs)
+    ret = kv_retrieve_vec(this->sqH, this->nsH, ks_hd->keyspace_id,
+      (kv_key*)key, option_adi, (const kv_value_segment*)segs, seg_cnt, (kv_value*)value, &f);
+  else
+    ret = kv_retrieve(this->sqH, this->nsH, ks_hd->keyspace_id, 
+      (kv_key*)key, option_adi, (kv_value*)value, &f);
   if(ret != KV_SUCCESS) {
     fprintf(stderr, "kv_retrieve failed with error:  0x%X\n", ret);
     free_context(ctx, &this->ctx_pool_notfull, this->kv_ctx_pool, this->lock);
@@ -384,9 +462,9 @@ int32_t KvEmulator::retrieve_tuple(kvs_key_space_handle ks_hd, const kvs_key *ke
 
 int32_t KvEmulator::delete_tuple(kvs_key_space_handle ks_hd, const kvs_key *key,
                                  kvs_option_delete option, void *private1, void *private2, bool syncio,
-                                 kvs_postprocess_function post_fn) {
+                                 kvs_postprocess_function post_fn, void *req_ctx) {
   auto ctx = prep_io_context(KVS_CMD_DELETE, ks_hd, key, NULL, private1, private2,
-                             syncio, post_fn);
+                             syncio, post_fn, req_ctx);
   kv_postprocess_function f = {on_io_complete, (void*)ctx};
 
   kv_delete_option option_adi;
@@ -420,9 +498,10 @@ int32_t KvEmulator::delete_tuple(kvs_key_space_handle ks_hd, const kvs_key *key,
 
 int32_t KvEmulator::exist_tuple(kvs_key_space_handle ks_hd, uint32_t key_cnt,
                                 const kvs_key *keys,kvs_exist_list *list, void *private1,
-                                void *private2, bool syncio, kvs_postprocess_function post_fn) {
+                                void *private2, bool syncio, kvs_postprocess_function post_fn,
+                                void *req_ctx) {
   auto ctx = prep_io_context(KVS_CMD_EXIST, ks_hd, keys, NULL,
-                             private1, private2, syncio, post_fn);
+                             private1, private2, syncio, post_fn, req_ctx);
   
   ctx->iocb.result_buffer.list = list;
   kv_postprocess_function f = {on_io_complete, (void*)ctx};
@@ -163,9 +163,15 @@ std::map<kv_result, kvs_result> code_map = {
   {KV_ERR_KEYSPACE_INVALID, KVS_ERR_SYS_IO}
 };
 
+inline void free_context(KDDriver::kv_kdd_context *ctx) {
+  if (!ctx->from_request) {
+    delete ctx;
+  }
+}
+
 inline void free_if_error(int ret, KDDriver::kv_kdd_context *ctx) {
  if (ret != 0 && ctx) {
-    delete ctx;
+    free_context(ctx);
   }
 }
 
@@ -445,6 +451,11 @@ void kdd_on_io_complete(kv_io_context *context){
     }
   #endif
 
+  kvs_result result = (kvs_result)convert_return_code(iocb->context, context->retcode);
+  ctx->owner->stats.record(iocb, result, ctx->submit_ns);
+  kvs_trace_record *trace = kvs_trace_begin(iocb, result, ctx->submit_tsc,
+    context->dispatch_tsc, ctx->syncio);
+
   if(ctx->syncio) {
     /*The conversion of the adi layer return code in the synchronous call is in the main entry method.*/
     iocb->result = (kvs_result)context->retcode;
@@ -453,13 +464,18 @@ void kdd_on_io_complete(kv_io_context *context){
     ctx->done_cond_sync.notify_one();
 
   } else { 
-    iocb->result = convert_return_code(iocb->context, context->retcode);
+    iocb->result = result;
+    // a reused request may be resubmitted from the callback, ctx isn't read after it
+    const bool from_request = ctx->from_request;
     if(ctx->on_complete && iocb) {
       ctx->on_complete(iocb);
     }
-    delete ctx;
+    if (!from_request) {
+      delete ctx;
+    }
     ctx = NULL;
   }
+  kvs_trace_end(trace);
 }
 
 int KDDriver::create_queue(int qdepth, uint16_t qtype, kv_queue_handle *handle, int cqid, int is_polling){
@@ -528,15 +544,15 @@ int32_t KDDriver::init(const char* devpath, const char* configfile, int queue_de
 
 int32_t KDDriver::store_tuple(kvs_key_space_handle ks_hd, const kvs_key *key,
   const kvs_value *value, kvs_option_store option, void *private1, void *private2,
-  bool syncio, kvs_postprocess_function cbfn) {
+  bool syncio, kvs_postprocess_function cbfn, void *req_ctx) {
   auto ctx = prep_io_context(KVS_CMD_STORE, ks_hd, key, value, private1,
-    private2, syncio, cbfn);
+    private2, syncio, cbfn, req_ctx);
   kv_postprocess_function f = {
     kdd_on_io_complete, (void*)ctx
   };
   kv_store_option option_adi;
   if(trans_store_cmd_opt(option, &option_adi)) {
-    delete ctx;
+    free_context(ctx);
     return KVS_ERR_OPTION_INVALID;
   }
 
@@ -551,7 +567,7 @@ int32_t KDDriver::store_tuple(kvs_key_space_handle ks_hd, const kvs_key *key,
     wait_for_io(ctx);
     ret = ctx->iocb.result;
 
-    delete ctx; ctx = NULL;
+    free_context(ctx); ctx = NULL;
   }
 
   free_if_error(ret, ctx);
@@ -569,8 +585,9 @@ void KDDriver::wait_for_io(kv_kdd_context *ctx) {
 
 int32_t KDDriver::retrieve_tuple(kvs_key_space_handle ks_hd, const kvs_key *key,
   kvs_value *value, kvs_option_retrieve option, void *private1, void *private2,
-  bool syncio, kvs_postprocess_function cbfn) {
-  auto ctx = prep_io_context(KVS_CMD_RETRIEVE, ks_hd, key, value, private1, private2, syncio, cbfn);
+  bool syncio, kvs_postprocess_function cbfn, void *req_ctx) {
+  auto ctx = prep_io_context(KVS_CMD_RETRIEVE, ks_hd, key, value, private1, private2, syncio, cbfn,
+    req_ctx);
   kv_postprocess_function f = {kdd_on_io_complete, (void*)ctx};
 
   kv_retrieve_option option_adi;
@@ -591,7 +608,7 @@ int32_t KDDriver::retrieve_tuple(kvs_key_space_handle ks_hd, const kvs_key *key,
   if(syncio && ret == 0) {
      wait_for_io(ctx);  
      ret = ctx->iocb.result;
-     delete ctx;
+     free_context(ctx);
      ctx = NULL;
   }
 
@@ -600,9 +617,10 @@ int32_t KDDriver::retrieve_tuple(kvs_key_space_handle ks_hd, const kvs_key *key,
 }
 
 int32_t KDDriver::delete_tuple(kvs_key_space_handle ks_hd, const kvs_key *key,
-  kvs_option_delete option, void *private1, void *private2, bool syncio, kvs_postprocess_function cbfn) {
+  kvs_option_delete option, void *private1, void *private2, bool syncio, kvs_postprocess_function cbfn,
+  void *req_ctx) {
   auto ctx = prep_io_context(KVS_CMD_DELETE, ks_hd, key, NULL, private1, private2,
-    syncio, cbfn);
+    syncio, cbfn, req_ctx);
   kv_postprocess_function f = {kdd_on_io_complete, (void*)ctx};
 
   kv_delete_option option_adi;
@@ -622,7 +640,7 @@ int32_t KDDriver::delete_tuple(kvs_key_space_handle ks_hd, const kvs_key *key,
   if(syncio && ret == 0) {
     wait_for_io(ctx);  
     ret = ctx->iocb.result;
-    delete ctx;
+    free_context(ctx);
     ctx = NULL;
   }    
 
@@ -633,13 +651,13 @@ int32_t KDDriver::delete_tuple(kvs_key_space_handle ks_hd, const kvs_key *key,
 
 int32_t KDDriver::exist_tuple(kvs_key_space_handle ks_hd, uint32_t key_cnt,
   const kvs_key *keys, kvs_exist_list *list, void *private1,
-  void *private2, bool syncio, kvs_postprocess_function cbfn) {
-  if(key_cnt > 1) {
-    fprintf(stderr, "WARN: kernel driver only supports one key check \n");
-    return convert_return_code(KV_ERR_PARAM_INVALID);
-  }
+  void *private2, bool syncio, kvs_postprocess_function cbfn, void *req_ctx) {
+  // the exist command carries one key
+  if(key_cnt > 1)
+    return exist_tuple_each(ks_hd, key_cnt, keys, list, private1, private2, syncio, cbfn);
+
   auto ctx = prep_io_context(KVS_CMD_EXIST, ks_hd, keys, NULL,
-    private1, private2, syncio, cbfn);
+    private1, private2, syncio, cbfn, req_ctx);
   ctx->iocb.result_buffer.list = list;  
   kv_postprocess_function f = {kdd_on_io_complete, (void*)ctx};
 
@@ -653,7 +671,7 @@ int32_t KDDriver::exist_tuple(kvs_key_space_handle ks_hd, uint32_t key_cnt,
   if(syncio && ret == 0) {
     wait_for_io(ctx);  
     ret = ctx->iocb.result;
-    delete ctx;
+    free_context(ctx);
     ctx = NULL;
   }
 
@@ -743,7 +761,7 @@ int32_t KDDriver::iterator_next(kvs_key_space_handle ks_hd, kvs_iterator_handle
   
     if(ret != KV_SUCCESS) {
       fprintf(stderr, "kv_iterator_next failed with error:  0x%X\n", convert_return_code(ret));
-      delete ctx;
+      free_context(ctx);
       ctx = NULL;
     }
   }
@@ -822,10 +840,24 @@ KDDriver::~KDDriver() {
   kv_cleanup_device(devH);
 }
 
+void *KDDriver::alloc_request_context() {
+  return new kv_kdd_context();
+}
+
+void KDDriver::free_request_context(void *req_ctx) {
+  delete (kv_kdd_context*)req_ctx;
+}
+
 KDDriver::kv_kdd_context* KDDriver::prep_io_context(kvs_context opcode, kvs_key_space_handle ks_hd,
   const kvs_key *key, const kvs_value *value, void *private1, void *private2,
-  bool syncio, kvs_postprocess_function cbfn){
-  kv_kdd_context *ctx = new kv_kdd_context();
+  bool syncio, kvs_postprocess_function cbfn, void *req_ctx){
+  kv_kdd_context *ctx = (kv_kdd_context*)req_ctx;
+  if(ctx) {
+    memset(&ctx->iocb, 0, sizeof(ctx->iocb));
+    ctx->from_request = true;
+  } else {
+    ctx = new kv_kdd_context();
+  }
   ctx->owner = this;
   ctx->iocb.context = opcode;
   ctx->iocb.ks_hd = ks_hd;
@@ -849,6 +881,8 @@ KDDriver::kv_kdd_context* KDDriver::prep_io_context(kvs_context opcode, kvs_key_
 
   ctx->done= false;
   ctx->syncio = syncio;
+  ctx->submit_ns = kvs_stats_now();
+  ctx->submit_tsc = kvs_trace_submit();
   
   return ctx;
 }
@@ -48,6 +48,12 @@
 #define MAX_POOLSIZE 10240
 #define GB_SIZE (1024 * 1024 * 1024)
 
+inline void free_context(KUDDriver::kv_udd_context *ctx) {
+  if (!ctx->from_request) {
+    free(ctx);
+  }
+}
+
 KUDDriver::KUDDriver(kv_device_priv *dev, kvs_postprocess_function user_io_complete_):
   KvsDriver(dev, user_io_complete_), queue_depth(256), num_cq_threads(1), mem_size_mb(1024)
 {
@@ -135,9 +141,14 @@ void udd_iterate_cb(kv_iterate *it, unsigned int result, unsigned int status) {
     ctx->iter_list->size = it->kv.value.length - KV_IT_READ_BUFFER_META_LEN;
   else
     ctx->iter_list->size = it->kv.value.length;
+  ctx->owner->stats.record(iocb, iocb->result, ctx->submit_ns);
+  kvs_trace_record *trace = kvs_trace_begin(iocb, iocb->result, ctx->submit_tsc, 0, false);
+  // a reused request may be resubmitted from the callback, ctx isn't read after it
+  const bool from_request = ctx->from_request;
   if(ctx->on_complete && iocb) ctx->on_complete(iocb);    
+  kvs_trace_end(trace);
   
-  if (ctx) {
+  if (!from_request) {
     free(ctx);
     ctx = NULL;
   }
@@ -212,10 +223,15 @@ void udd_write_cb(kv_pair *kv, unsigned int result, unsigned int status) {
     iocb->value->length = kv->value.length;
   }
   
+  ctx->owner->stats.record(iocb, iocb->result, ctx->submit_ns);
+  kvs_trace_record *trace = kvs_trace_begin(iocb, iocb->result, ctx->submit_tsc, 0, false);
+  // a reused request may be resubmitted from the callback, ctx isn't read after it
+  const auto owner = ctx->owner;
+  const bool from_request = ctx->from_request;
   if(ctx->on_complete && iocb) ctx->on_complete(iocb);
+  kvs_trace_end(trace);
  
-  const auto owner = ctx->owner;
-  if (ctx) {
+  if (!from_request) {
     free(ctx);
     ctx = NULL;
   }
@@ -308,10 +324,25 @@ int16_t KUDDriver::_get_queue_id(kvs_key_space_handle ks_hd) {
   return qid;
 }
 
+void *KUDDriver::alloc_request_context() {
+  return calloc(1, sizeof(kv_udd_context));
+}
+
+void KUDDriver::free_request_context(void *req_ctx) {
+  free(req_ctx);
+}
+
 KUDDriver::kv_udd_context* KUDDriver::prep_io_context(kvs_context opcode,
   kvs_key_space_handle ks_hd, const kvs_key *key, const kvs_value *value,
-  void *private1, void *private2, bool syncio, kvs_postprocess_function cbfn) {
-  kv_udd_context *ctx = (kv_udd_context*)calloc(1, sizeof(kv_udd_context));
+  void *private1, void *private2, bool syncio, kvs_postprocess_function cbfn, void *req_ctx) {
+  kv_udd_context *ctx = (kv_udd_context*)req_ctx;
+  if(ctx) {
+    memset(&ctx->iocb, 0, sizeof(ctx->iocb));
+    ctx->iter_list = NULL;
+    ctx->from_request = true;
+  } else {
+    ctx = (kv_udd_context*)calloc(1, sizeof(kv_udd_context));
+  }
   ctx->on_complete = cbfn;
   ctx->iocb.context = opcode;
   ctx->iocb.ks_hd = ks_hd;
@@ -331,6 +362,8 @@ KUDDriver::kv_udd_context* KUDDriver::prep_io_context(kvs_context opcode,
   ctx->iocb.private1 = private1;
   ctx->iocb.private2 = private2;
   ctx->owner = this;
+  ctx->submit_ns = kvs_stats_now();
+  ctx->submit_tsc = kvs_trace_submit();
   
   return ctx;
   
@@ -362,16 +395,19 @@ int32_t KUDDriver::trans_iter_type(uint8_t dev_it_type, uint8_t* kvs_it_type){
 /* MAIN ENTRY POINT */
 int32_t KUDDriver::store_tuple(kvs_key_space_handle ks_hd, const kvs_key *key,
 const kvs_value *value, kvs_option_store option, void *private1, void *private2,
-bool syncio, kvs_postprocess_function cbfn) {
+bool syncio, kvs_postprocess_function cbfn, void *req_ctx) {
   int ret = -EINVAL;
-  auto ctx = prep_io_context(KVS_CMD_STORE, ks_hd, key, value, private1, private2, syncio, cbfn);
+  if (option.st_type == KVS_STORE_APPEND && !native_append(syncio)) {
+    return KVS_ERR_OPTION_INVALID;
+  }
+  auto ctx = prep_io_context(KVS_CMD_STORE, ks_hd, key, value, private1, private2, syncio, cbfn, req_ctx);
   std::unique_lock<std::mutex> lock(this->lock);
   kv_pair *kv = this->kv_pair_pool.front();
   this->kv_pair_pool.pop();
   lock.unlock();
   if(!kv) {
     fprintf(stderr, "failed to allocate kv pairs\n");
-    free(ctx);
+    free_context(ctx);
     return KVS_ERR_SYS_IO;
   }
 
@@ -381,7 +417,7 @@ bool syncio, kvs_postprocess_function cbfn) {
     std::unique_lock<std::mutex> lock(this->lock);
     this->kv_pair_pool.push(kv);
     lock.unlock();
-    free(ctx);
+    free_context(ctx);
     return ret;
   }
   kv->keyspace_id = ks_hd->keyspace_id;
@@ -398,11 +434,16 @@ bool syncio, kvs_postprocess_function cbfn) {
 
   int qid = _get_queue_id(ks_hd);
   if(syncio) {
-    ret = kv_nvme_write(handle, qid, kv);
+    const uint64_t submit_ns = ctx->submit_ns;
+    const uint64_t submit_tsc = ctx->submit_tsc;
+    if (option.st_type == KVS_STORE_APPEND)
+      ret = kv_nvme_append(handle, qid, kv);
+    else
+      ret = kv_nvme_write(handle, qid, kv);
     std::unique_lock<std::mutex> lock(this->lock);
     this->kv_pair_pool.push(kv);
     lock.unlock();
-    free(ctx);
+    free_context(ctx);
     ctx = NULL;
     
     if(ret == KV_SUCCESS) {
@@ -439,6 +480,8 @@ bool syncio, kvs_postprocess_function cbfn) {
           value->length, value->offset, ret);
       ret = KVS_ERR_SYS_IO;
     }
+    stats.record(KVS_CMD_STORE, ks_hd, value->length, (kvs_result)ret, submit_ns);
+    kvs_trace_end(kvs_trace_begin(KVS_CMD_STORE, ks_hd, key, value->length, (kvs_result)ret, submit_tsc, 0, true));
   } else {
     ret = -EINVAL;
     while (ret) {
@@ -465,7 +508,7 @@ bool syncio, kvs_postprocess_function cbfn) {
           std::unique_lock<std::mutex> lock(this->lock);
           this->kv_pair_pool.push(kv);
           lock.unlock();
-          free(ctx);
+          free_context(ctx);
           ctx = NULL;
         }
         break;
@@ -478,9 +521,9 @@ bool syncio, kvs_postprocess_function cbfn) {
 
 int32_t KUDDriver::retrieve_tuple(kvs_key_space_handle ks_hd,
   const kvs_key *key, kvs_value *value, kvs_option_retrieve option,
-  void *private1, void *private2, bool syncio, kvs_postprocess_function cbfn) {
+  void *private1, void *private2, bool syncio, kvs_postprocess_function cbfn, void *req_ctx) {
   int ret = -EINVAL;
-  auto ctx = prep_io_context(KVS_CMD_RETRIEVE, ks_hd, key, value, private1, private2, syncio, cbfn);
+  auto ctx = prep_io_context(KVS_CMD_RETRIEVE, ks_hd, key, value, private1, private2, syncio, cbfn, req_ctx);
   
   std::unique_lock<std::mutex> lock(this->lock);
   kv_pair *kv = this->kv_pair_pool.front();
@@ -488,7 +531,7 @@ int32_t KUDDriver::retrieve_tuple(kvs_key_space_handle ks_hd,
   lock.unlock();
   if(!kv) {
     fprintf(stderr, "failed to allocate kv pairs\n");
-    free(ctx);
+    free_context(ctx);
     return KVS_ERR_SYS_IO;
   }
 
@@ -499,7 +542,7 @@ int32_t KUDDriver::retrieve_tuple(kvs_key_space_handle ks_hd,
     std::unique_lock<std::mutex> lock(this->lock);
     this->kv_pair_pool.push(kv);
     lock.unlock();
-    free(ctx);
+    free_context(ctx);
     return KVS_ERR_OPTION_INVALID;
   }
   kv->keyspace_id = ks_hd->keyspace_id;
@@ -516,13 +559,15 @@ int32_t KUDDriver::retrieve_tuple(kvs_key_space_handle ks_hd,
 
   int qid = _get_queue_id(ks_hd);
   if(syncio) {
+    const uint64_t submit_ns = ctx->submit_ns;
+    const uint64_t submit_tsc = ctx->submit_tsc;
     ret = kv_nvme_read(handle, qid, kv);
     value->actual_value_size = kv->value.actual_value_size;
     value->length = kv->value.length;
     std::unique_lock<std::mutex> lock(this->lock);
     this->kv_pair_pool.push(kv);
     lock.unlock();
-    free(ctx);
+    free_context(ctx);
     ctx = NULL;
 
     if(ret == KV_SUCCESS) {
@@ -559,6 +604,8 @@ int32_t KUDDriver::retrieve_tuple(kvs_key_space_handle ks_hd,
           value->length, value->offset, ret);
       ret = KVS_ERR_SYS_IO;
     }
+    stats.record(KVS_CMD_RETRIEVE, ks_hd, std::min(value->length, value->actual_value_size), (kvs_result)ret, submit_ns);
+    kvs_trace_end(kvs_trace_begin(KVS_CMD_RETRIEVE, ks_hd, key, std::min(value->length, value->actual_value_size), (kvs_result)ret, submit_tsc, 0, true));
   } else {
     while (ret) {
       ret = kv_nvme_read_async(handle, qid, kv);
@@ -584,7 +631,7 @@ int32_t KUDDriver::retrieve_tuple(kvs_key_space_handle ks_hd,
           std::unique_lock<std::mutex> lock(this->lock);
           this->kv_pair_pool.push(kv);
           lock.unlock();
-          free(ctx);
+          free_context(ctx);
           ctx = NULL;
         }
         break;
@@ -598,10 +645,10 @@ int32_t KUDDriver::retrieve_tuple(kvs_key_space_handle ks_hd,
 //
 //  uncomment these code for these api in adaptor layer haven't implemented currently 
 //
-int32_t KUDDriver::delete_tuple(kvs_key_space_handle ks_hd, const kvs_key *key, kvs_option_delete option, void *private1, void *private2, bool syncio, kvs_postprocess_function cbfn) {
+int32_t KUDDriver::delete_tuple(kvs_key_space_handle ks_hd, const kvs_key *key, kvs_option_delete option, void *private1, void *private2, bool syncio, kvs_postprocess_function cbfn, void *req_ctx) {
 
   int ret = -EINVAL;
-  auto ctx = prep_io_context(KVS_CMD_DELETE, ks_hd, key, NULL, private1, private2, syncio, cbfn);
+  auto ctx = prep_io_context(KVS_CMD_DELETE, ks_hd, key, NULL, private1, private2, syncio, cbfn, req_ctx);
 
   std::unique_lock<std::mutex> lock(this->lock);
   kv_pair *kv = this->kv_pair_pool.front();
@@ -609,7 +656,7 @@ int32_t KUDDriver::delete_tuple(kvs_key_space_handle ks_hd, const kvs_key *key,
   lock.unlock();
   if(!kv) {
     fprintf(stderr, "failed to allocate kv pairs\n");
-    free(ctx);
+    free_context(ctx);
     return KVS_ERR_SYS_IO;
   }
 
@@ -630,11 +677,13 @@ int32_t KUDDriver::delete_tuple(kvs_key_space_handle ks_hd, const kvs_key *key,
 
   int qid = _get_queue_id(ks_hd);
   if(syncio){
+    const uint64_t submit_ns = ctx->submit_ns;
+    const uint64_t submit_tsc = ctx->submit_tsc;
     ret = kv_nvme_delete(handle, qid, kv);
     std::unique_lock<std::mutex> lock(this->lock);
     this->kv_pair_pool.push(kv);
     lock.unlock();
-    free(ctx);
+    free_context(ctx);
     ctx = NULL;
 
     if(ret == KV_SUCCESS) {
@@ -666,7 +715,8 @@ int32_t KUDDriver::delete_tuple(kvs_key_space_handle ks_hd, const kvs_key *key,
           __FUNCTION__, (char*)key->key, option_adi, ret);
       ret = KVS_ERR_SYS_IO;
     }
-    
+    stats.record(KVS_CMD_DELETE, ks_hd, 0, (kvs_result)ret, submit_ns);
+    kvs_trace_end(kvs_trace_begin(KVS_CMD_DELETE, ks_hd, key, 0, (kvs_result)ret, submit_tsc, 0, true));
   } else {
     while(ret){
       ret = kv_nvme_delete_async(handle, qid, kv);
@@ -692,7 +742,7 @@ int32_t KUDDriver::delete_tuple(kvs_key_space_handle ks_hd, const kvs_key *key,
          std::unique_lock<std::mutex> lock(this->lock);
           this->kv_pair_pool.push(kv);
           lock.unlock();
-          free(ctx);
+          free_context(ctx);
           ctx = NULL;
         }
         break;
@@ -703,10 +753,13 @@ int32_t KUDDriver::delete_tuple(kvs_key_space_handle ks_hd, const kvs_key *key,
   return ret;
 }
 
-int32_t KUDDriver::exist_tuple(kvs_key_space_handle ks_hd, uint32_t key_cnt, const kvs_key *keys, kvs_exist_list *list, void *private1, void *private2, bool syncio, kvs_postprocess_function cbfn ) {
+int32_t KUDDriver::exist_tuple(kvs_key_space_handle ks_hd, uint32_t key_cnt, const kvs_key *keys, kvs_exist_list *list, void *private1, void *private2, bool syncio, kvs_postprocess_function cbfn, void *req_ctx) {
+  // the exist command carries one key
+  if(key_cnt > 1)
+    return exist_tuple_each(ks_hd, key_cnt, keys, list, private1, private2, syncio, cbfn);
 
   int ret = 1;
-  auto ctx = prep_io_context(KVS_CMD_EXIST, ks_hd, keys, NULL, private1, private2, syncio, cbfn);
+  auto ctx = prep_io_context(KVS_CMD_EXIST, ks_hd, keys, NULL, private1, private2, syncio, cbfn, req_ctx);
   ctx->iocb.result_buffer.list = list;
   
   std::unique_lock<std::mutex> lock(this->lock);
@@ -715,7 +768,7 @@ int32_t KUDDriver::exist_tuple(kvs_key_space_handle ks_hd, uint32_t key_cnt, con
   lock.unlock();
   if(!kv) {
     fprintf(stderr, "failed to allocate kv pairs\n");
-    free(ctx);
+    free_context(ctx);
     return KVS_ERR_SYS_IO;
   }
   
@@ -729,6 +782,8 @@ int32_t KUDDriver::exist_tuple(kvs_key_space_handle ks_hd, uint32_t key_cnt, con
 
   int qid = _get_queue_id(ks_hd);
   if(syncio) {
+    const uint64_t submit_ns = ctx->submit_ns;
+    const uint64_t submit_tsc = ctx->submit_tsc;
     ret = kv_nvme_exist(handle, qid, kv);
     if(ret == KV_SUCCESS) {
       *(list->result_buffer) = 1;//ret;
@@ -764,8 +819,10 @@ int32_t KUDDriver::exist_tuple(kvs_key_space_handle ks_hd, uint32_t key_cnt, con
     std::unique_lock<std::mutex> lock(this->lock);
     this->kv_pair_pool.push(kv);
     lock.unlock();
-    free(ctx);
+    free_context(ctx);
     ctx = NULL;    
+    stats.record(KVS_CMD_EXIST, ks_hd, 0, (kvs_result)ret, submit_ns);
+    kvs_trace_end(kvs_trace_begin(KVS_CMD_EXIST, ks_hd, keys, 0, (kvs_result)ret, submit_tsc, 0, true));
   } else {
     while(ret){
       ret = kv_nvme_exist_async(handle, qid, kv);
@@ -791,7 +848,7 @@ int32_t KUDDriver::exist_tuple(kvs_key_space_handle ks_hd, uint32_t key_cnt, con
           std::unique_lock<std::mutex> lock(this->lock);
           this->kv_pair_pool.push(kv);
           lock.unlock();
-          free(ctx);
+          free_context(ctx);
           ctx = NULL;
         }
         break;
@@ -927,6 +984,8 @@ int32_t KUDDriver::iterator_next(kvs_key_space_handle ks_hd, kvs_iterator_handle
   it->kv.param.private_data = ctx;
   it->kv.param.io_option.iterate_read_option = KV_ITERATE_READ_DEFAULT;
   if (syncio) {
+    const uint64_t submit_ns = ctx->submit_ns;
+    const uint64_t submit_tsc = ctx->submit_tsc;
     ret = kv_nvme_iterate_read(handle, DEFAULT_IO_QUEUE_ID, it);
     iter_list->end = 0;
     if(ret != KV_SUCCESS) {
@@ -1012,9 +1071,11 @@ int32_t KUDDriver::iterator_next(kvs_key_space_handle ks_hd, kvs_iterator_handle
       it = NULL;
     }
     if(ctx) {
-      free(ctx);
+      free_context(ctx);
       ctx = NULL;
     } 
+    stats.record(KVS_CMD_ITER_NEXT, ks_hd, iter_list->size, (kvs_result)ret, submit_ns);
+    kvs_trace_end(kvs_trace_begin(KVS_CMD_ITER_NEXT, ks_hd, NULL, iter_list->size, (kvs_result)ret, submit_tsc, 0, true));
   } else { // async
     while(ret) {
       ret = kv_nvme_iterate_read_async(handle, DEFAULT_IO_QUEUE_ID, it);
@@ -1041,7 +1102,7 @@ int32_t KUDDriver::iterator_next(kvs_key_space_handle ks_hd, kvs_iterator_handle
             it = NULL;
           }
           if(ctx) {
-            free(ctx);
+            free_context(ctx);
             ctx = NULL;
           }
         }
@@ -1063,6 +1124,9 @@ int32_t KUDDriver::trans_store_cmd_opt(kvs_option_store kvs_opt, int *kv_opt){
         *kv_opt = KV_STORE_IDEMPOTENT;
         break;
       case KVS_STORE_APPEND:
+        // issued with kv_nvme_append(), which takes no store option
+        *kv_opt = KV_STORE_DEFAULT;
+        break;
       case KVS_STORE_UPDATE_ONLY:
       default:
         fprintf(stderr, "WARN: Wrong store option\n");
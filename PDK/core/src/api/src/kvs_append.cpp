@@ -0,0 +1,208 @@
+/**
+ *   BSD LICENSE
+ *
+ *   Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Samsung Electronics Co., Ltd. nor the names of
+ *       its contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Host side KVS_STORE_APPEND, see kvs_append.h
+ *
+ * The read-modify-write reads the current value into a buffer that has
+ * room for the appended bytes and stores the result as a new value, so a
+ * value can only grow up to KVS_MAX_VALUE_LENGTH. A missing key is created
+ * with the appended value as KVS_STORE_APPEND requires.
+ */
+
+#include <string.h>
+#include <functional>
+#include <string>
+#include "kvs_utils.h"
+#include "kvs_packing.h"
+#include "kvs_append.h"
+
+KvsAppender::KvsAppender(kvs_key_space_handle ks_hd_): ks_hd(ks_hd_) {
+  for (int i = 0; i < APPEND_LANES; i++) {
+    lanes[i].started = false;
+    lanes[i].pending = 0;
+    lanes[i].stop = false;
+  }
+}
+
+KvsAppender::~KvsAppender() {
+  close();
+}
+
+void KvsAppender::close() {
+  for (int i = 0; i < APPEND_LANES; i++) {
+    append_lane *lane = &lanes[i];
+    std::unique_lock<std::mutex> guard(lane->lock);
+    if (!lane->started) continue;
+    lane->stop = true;
+    lane->cond.notify_one();
+    guard.unlock();
+    lane->worker.join();
+
+    guard.lock();
+    lane->started = false;
+    lane->stop = false;
+  }
+}
+
+uint32_t KvsAppender::hash(const kvs_key *key) const {
+  size_t h = std::hash<std::string>()(std::string((const char*)key->key, key->length));
+  return (uint32_t)(h ^ (h >> 32));
+}
+
+kvs_result KvsAppender::append(const kvs_key *key, const kvs_value *value,
+    void *private1, void *private2, bool sync, kvs_postprocess_function post_fn) {
+  KvsDriver *driver = ks_hd->dev->driver;
+  if (ks_hd->packer == NULL && driver->native_append(true) && driver->native_append(false)) {
+    kvs_option_store opt = {KVS_STORE_APPEND, NULL};
+    return (kvs_result)driver->store_tuple(ks_hd, key, value, opt, private1, private2,
+      sync, post_fn);
+  }
+
+  uint32_t h = hash(key);
+  append_lane *lane = &lanes[h % APPEND_LANES];
+  std::unique_lock<std::mutex> guard(lane->lock);
+  if (sync && lane->pending == 0) {
+    guard.unlock();
+    std::unique_lock<std::mutex> klock(key_locks[h % APPEND_KEY_LOCK_STRIPES]);
+    return execute(key, value);
+  }
+
+  append_waiter waiter = {KVS_SUCCESS, false};
+  append_op op = {(kvs_key*)key, (kvs_value*)value, private1, private2, post_fn,
+    sync ? &waiter : NULL};
+  if (!lane->started) {
+    lane->worker = std::thread(&KvsAppender::run, this, lane);
+    lane->started = true;
+  }
+  lane->queue.push_back(op);
+  lane->pending++;
+  lane->cond.notify_one();
+  if (!sync) return KVS_SUCCESS;
+
+  while (!waiter.done)
+    lane->done_cond.wait(guard);
+  return waiter.result;
+}
+
+// called with the key lock held
+kvs_result KvsAppender::execute(const kvs_key *key, const kvs_value *value) {
+  KvsDriver *driver = ks_hd->dev->driver;
+  if (ks_hd->packer == NULL && driver->native_append(true)) {
+    kvs_option_store opt = {KVS_STORE_APPEND, NULL};
+    return (kvs_result)driver->store_tuple(ks_hd, key, value, opt, 0, 0, true, 0);
+  }
+  return read_modify_write(key, value);
+}
+
+kvs_result KvsAppender::read_modify_write(const kvs_key *key, const kvs_value *value) {
+  uint32_t room = (value->length + KVS_ALIGNMENT_UNIT - 1) & ~(KVS_ALIGNMENT_UNIT - 1);
+  uint8_t *buf = (uint8_t*)kvs_malloc(KVS_MAX_VALUE_LENGTH + room, PAGE_ALIGN);
+  if (buf == NULL) {
+    fprintf(stderr, "WARN: no memory for an append of %u bytes\n", value->length);
+    return KVS_ERR_SYS_IO;
+  }
+
+  kvs_option_retrieve ropt = {false};
+  kvs_value cur = {buf, KVS_MAX_VALUE_LENGTH, 0, 0};
+  kvs_result ret = key_space_io(key, &cur, &ropt, KVS_CMD_RETRIEVE);
+  if (ret == KVS_ERR_KEY_NOT_EXIST) {
+    cur.length = 0;
+    ret = KVS_SUCCESS;
+  }
+  if (ret == KVS_SUCCESS && cur.length + value->length > KVS_MAX_VALUE_LENGTH)
+    ret = KVS_ERR_VALUE_LENGTH_INVALID;
+  if (ret == KVS_SUCCESS) {
+    memcpy(buf + cur.length, value->value, value->length);
+    kvs_option_store sopt = {KVS_STORE_POST, NULL};
+    kvs_value merged = {buf, cur.length + value->length, 0, 0};
+    ret = key_space_io(key, &merged, &sopt, KVS_CMD_STORE);
+  }
+  kvs_free(buf);
+  return ret;
+}
+
+kvs_result KvsAppender::key_space_io(const kvs_key *key, kvs_value *value, void *option,
+    kvs_context op) {
+  KvsPacker *packer = ks_hd->packer;
+  if (packer == NULL)
+    return _sync_io_to_key_space(ks_hd, key, value, option, op);
+  if (op == KVS_CMD_STORE)
+    return packer->store(key, value, (kvs_option_store*)option, NULL, NULL, true, NULL);
+  return packer->retrieve(key, value, (kvs_option_retrieve*)option, NULL, NULL, true, NULL);
+}
+
+void KvsAppender::run(append_lane *lane) {
+  std::unique_lock<std::mutex> guard(lane->lock);
+  while (true) {
+    if (lane->queue.empty()) {
+      if (lane->stop) break;
+      lane->cond.wait(guard);
+      continue;
+    }
+    append_op op = lane->queue.front();
+    lane->queue.pop_front();
+    guard.unlock();
+
+    kvs_result res;
+    {
+      std::unique_lock<std::mutex> klock(key_locks[hash(op.key) % APPEND_KEY_LOCK_STRIPES]);
+      res = execute(op.key, op.value);
+    }
+
+    if (op.waiter) {
+      guard.lock();
+      op.waiter->result = res;
+      op.waiter->done = true;
+      lane->pending--;
+      lane->done_cond.notify_all();
+      continue;
+    }
+
+    kvs_option_store opt = {KVS_STORE_APPEND, NULL};
+    kvs_postprocess_context ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.context = KVS_CMD_STORE;
+    ctx.ks_hd = ks_hd;
+    ctx.key = op.key;
+    ctx.value = op.value;
+    ctx.option = &opt;
+    ctx.private1 = op.private1;
+    ctx.private2 = op.private2;
+    ctx.result = res;
+    op.post_fn(&ctx);
+
+    guard.lock();
+    lane->pending--;
+  }
+}
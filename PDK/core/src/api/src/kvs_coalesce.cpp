@@ -0,0 +1,232 @@
+/**
+ *   BSD LICENSE
+ *
+ *   Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Samsung Electronics Co., Ltd. nor the names of
+ *       its contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Single-flight retrieves, see kvs_coalesce.h
+ *
+ * A flight is listed in the shard of its key until its command completes
+ * or a write of the key closes it. Values are copied to the waiters before
+ * any post process function of the flight is called, while the leader's
+ * buffer is still the caller's to read.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include <functional>
+#include "kvs_utils.h"
+#include "kvs_coalesce.h"
+
+KvsCoalescer::KvsCoalescer(kvs_key_space_handle ks_hd_): ks_hd(ks_hd_) {
+}
+
+int KvsCoalescer::shard_of(const std::string &key) const {
+  size_t h = std::hash<std::string>()(key);
+  return (int)((h ^ (h >> 32)) % COALESCE_SHARDS);
+}
+
+void KvsCoalescer::unlist(coalesce_shard *s, flight *f) {
+  if (!f->listed) return;
+  auto range = s->flights.equal_range(f->key);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second == f) {
+      s->flights.erase(it);
+      break;
+    }
+  }
+  f->listed = false;
+}
+
+void KvsCoalescer::invalidate(const kvs_key *key) {
+  std::string k((const char*)key->key, key->length);
+  coalesce_shard *s = &shards[shard_of(k)];
+  std::unique_lock<std::mutex> lock(s->lock);
+  auto range = s->flights.equal_range(k);
+  for (auto it = range.first; it != range.second; ++it)
+    it->second->listed = false;
+  s->flights.erase(range.first, range.second);
+}
+
+void *KvsCoalescer::wrap_write(kvs_key *key, void **private1, void **private2,
+    kvs_postprocess_function *post_fn) {
+  coalesce_write *w = new coalesce_write();
+  w->owner = this;
+  w->key = key;
+  w->private1 = *private1;
+  w->private2 = *private2;
+  w->post_fn = *post_fn;
+  *private1 = w;
+  *private2 = NULL;
+  *post_fn = KvsCoalescer::on_write_complete;
+  return w;
+}
+
+void KvsCoalescer::drop_write(void *write) {
+  delete (coalesce_write*)write;
+}
+
+void KvsCoalescer::on_write_complete(kvs_postprocess_context *ctx) {
+  coalesce_write *w = (coalesce_write*)ctx->private1;
+  // retrieves that joined before now may not outlive the write
+  w->owner->invalidate(w->key);
+  kvs_postprocess_context uctx = *ctx;
+  uctx.private1 = w->private1;
+  uctx.private2 = w->private2;
+  kvs_postprocess_function post_fn = w->post_fn;
+  delete w;
+  post_fn(&uctx);
+}
+
+kvs_result KvsCoalescer::retrieve(const kvs_key *key, kvs_value *value,
+    const kvs_option_retrieve *opt, void *private1, void *private2, bool sync,
+    kvs_postprocess_function post_fn, void *req_ctx) {
+  KvsStats *stats = &ks_hd->dev->driver->stats;
+  std::string k((const char*)key->key, key->length);
+  int idx = shard_of(k);
+  coalesce_shard *s = &shards[idx];
+
+  std::unique_lock<std::mutex> lock(s->lock);
+  auto range = s->flights.equal_range(k);
+  for (auto it = range.first; it != range.second; ++it) {
+    flight *f = it->second;
+    if (f->offset != value->offset || f->length != value->length) continue;
+    if (sync && !f->sync) continue;
+
+    coalesce_waiter w = {(kvs_key*)key, value, private1, private2, sync ? NULL : post_fn};
+    f->waiters.push_back(w);
+    stats->record_coalesce(true);
+    if (!sync) return KVS_SUCCESS;
+
+    f->refs++;
+    while (!f->done)
+      f->cond.wait(lock);
+    kvs_result result = f->result;
+    if (--f->refs == 0) delete f;
+    return result;
+  }
+
+  flight *f = new flight();
+  f->owner = this;
+  f->shard = idx;
+  f->key = k;
+  f->offset = value->offset;
+  f->length = value->length;
+  f->sync = sync;
+  f->listed = true;
+  f->done = false;
+  f->result = KVS_SUCCESS;
+  f->refs = 1;
+  f->value = value;
+  f->private1 = private1;
+  f->private2 = private2;
+  f->post_fn = post_fn;
+  s->flights.insert(std::make_pair(k, f));
+  lock.unlock();
+  stats->record_coalesce(false);
+
+  kvs_result ret;
+  if (sync) {
+    ret = _retrieve_from_key_space(ks_hd, key, value, opt, private1, private2, true, NULL, NULL);
+    finish(f, ret);
+    return ret;
+  }
+  ret = _retrieve_from_key_space(ks_hd, key, value, opt, f, NULL, false, on_complete, req_ctx);
+  if (ret != KVS_SUCCESS) {
+    // the leader learns of it from the return value, the waiters from their callbacks
+    f->post_fn = NULL;
+    finish(f, ret);
+  }
+  return ret;
+}
+
+void KvsCoalescer::finish(flight *f, kvs_result result) {
+  coalesce_shard *s = &shards[f->shard];
+  std::vector<coalesce_waiter> waiters;
+  {
+    std::unique_lock<std::mutex> lock(s->lock);
+    unlist(s, f);
+    waiters.swap(f->waiters);
+  }
+
+  const kvs_value *src = f->value;
+  bool has_data = (result == KVS_SUCCESS || result == KVS_ERR_BUFFER_SMALL);
+  uint32_t n = has_data ? std::min(src->length, f->length) : 0;
+  for (auto &w : waiters) {
+    if (n) memcpy(w.value->value, src->value, n);
+    w.value->length = src->length;
+    w.value->actual_value_size = src->actual_value_size;
+  }
+  for (auto &w : waiters) {
+    if (w.post_fn == NULL) continue;
+    kvs_postprocess_context ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.context = KVS_CMD_RETRIEVE;
+    ctx.ks_hd = ks_hd;
+    ctx.key = w.key;
+    ctx.value = w.value;
+    ctx.private1 = w.private1;
+    ctx.private2 = w.private2;
+    ctx.result = result;
+    w.post_fn(&ctx);
+  }
+
+  std::unique_lock<std::mutex> lock(s->lock);
+  f->done = true;
+  f->result = result;
+  f->cond.notify_all();
+  if (--f->refs == 0) delete f;
+}
+
+void KvsCoalescer::on_complete(kvs_postprocess_context *ctx) {
+  flight *f = (flight*)ctx->private1;
+  kvs_postprocess_function post_fn = f->post_fn;
+  ctx->private1 = f->private1;
+  ctx->private2 = f->private2;
+  f->owner->finish(f, ctx->result);
+  post_fn(ctx);
+}
+
+kvs_result kvs_enable_coalescing(kvs_key_space_handle ks_hd) {
+  kvs_result ret = _check_key_space_handle(ks_hd);
+  if (ret != KVS_SUCCESS) return ret;
+  if (ks_hd->coalescer == NULL)
+    ks_hd->coalescer = new KvsCoalescer(ks_hd);
+  return KVS_SUCCESS;
+}
+
+kvs_result kvs_disable_coalescing(kvs_key_space_handle ks_hd) {
+  kvs_result ret = _check_key_space_handle(ks_hd);
+  if (ret != KVS_SUCCESS) return ret;
+  delete ks_hd->coalescer;
+  ks_hd->coalescer = NULL;
+  return KVS_SUCCESS;
+}
@@ -0,0 +1,649 @@
+/**
+ *   BSD LICENSE
+ *
+ *   Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Samsung Electronics Co., Ltd. nor the names of
+ *       its contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Negative lookup filter, see kvs_filter.h
+ *
+ * A key hashes to a 16 bit fingerprint and a bucket; the alternate bucket
+ * of a fingerprint is its bucket xor a hash of the fingerprint, so either
+ * bucket finds the other one (partial-key cuckoo hashing). Stores of keys
+ * with the same fingerprint and bucket pair share a slot and its count. An
+ * insert that finds no free slot displaces fingerprints to their alternate
+ * buckets; the last one is parked in a single victim slot, and once that is
+ * taken the filter overflows and answers every lookup as positive.
+ *
+ * The copy in the metadata key space is a header under
+ * "\xffkeyfilter<keyspace id>" followed by chunks of FILTER_CHUNK_LEN bytes
+ * under "\xffkeyfilter<keyspace id>.<chunk>" that hold the fingerprints as
+ * le16 and then the counts. The header
+ *   [magic:le32][version:le16][flags:le16][buckets:le64][body length:le64]
+ *   [chunk length:le32][victim fingerprint:le16][victim count:u8]
+ *   [victim used:u8][victim bucket:le64][checksum:le64]
+ * is stored after the chunks, so that it only refers to complete ones.
+ */
+
+#include <string.h>
+#include <endian.h>
+#include <algorithm>
+#include "kvs_utils.h"
+#include "kvs_packing.h"
+#include "kvs_filter.h"
+
+namespace {
+
+const uint32_t FILTER_MAGIC = 0x464b564b;   // "KVKF"
+const uint16_t FILTER_VERSION = 1;
+const uint16_t FILTER_FLAG_OVERFLOW = 0x1;
+const uint32_t FILTER_HEADER_LEN = 64;
+const uint32_t FILTER_CHUNK_LEN = 1024 * 1024;
+const uint32_t FILTER_KEY_LEN = 32;
+
+// bytes of fingerprints and counts per slot
+const uint32_t FILTER_SLOT_BYTES = 3;
+
+kvs_key filter_key(uint8_t keyspace_id, int64_t chunk, char *buf) {
+  int len = (chunk < 0) ?
+    snprintf(buf, FILTER_KEY_LEN, "\xff" "keyfilter%u", keyspace_id) :
+    snprintf(buf, FILTER_KEY_LEN, "\xff" "keyfilter%u.%u", keyspace_id, (uint32_t)chunk);
+  kvs_key key = {buf, (uint16_t)len};
+  return key;
+}
+
+kvs_result filter_meta_io(kvs_device_handle dev_hd, uint8_t keyspace_id, int64_t chunk,
+    uint8_t *buf, uint32_t *len, kvs_context op) {
+  char name[FILTER_KEY_LEN];
+  kvs_key key = filter_key(keyspace_id, chunk, name);
+  kvs_value value = {buf, len ? *len : 0, 0, 0};
+  kvs_option_store store_opt = {KVS_STORE_POST, NULL};
+  kvs_option_retrieve retrieve_opt = {false};
+  kvs_option_delete delete_opt = {false};
+  void *option = (op == KVS_CMD_STORE) ? (void*)&store_opt :
+    (op == KVS_CMD_RETRIEVE) ? (void*)&retrieve_opt : (void*)&delete_opt;
+  kvs_result ret = _sync_io_to_meta_keyspace(dev_hd, &key,
+    (op == KVS_CMD_DELETE) ? NULL : &value, option, op);
+  if (ret == KVS_SUCCESS && op == KVS_CMD_RETRIEVE && len) *len = value.length;
+  return ret;
+}
+
+} // namespace
+
+KvsKeyFilter::KvsKeyFilter(kvs_key_space_handle ks_hd_, uint64_t expected_keys):
+  ks_hd(ks_hd_), nbuckets(buckets_for(expected_keys)), fps(NULL), counts(NULL),
+  overflow(false), answering(false), seed(0x2545f491), worker_started(false), stop(false) {
+  memset(&victim, 0, sizeof(victim));
+}
+
+KvsKeyFilter::~KvsKeyFilter() {
+  {
+    std::unique_lock<std::mutex> guard(worker_lock);
+    stop = true;
+    worker_cond.notify_all();
+  }
+  if (worker_started) worker.join();
+  free(fps);
+  free(counts);
+}
+
+uint64_t KvsKeyFilter::buckets_for(uint64_t expected_keys) {
+  // a load factor of up to 90% leaves the displacements short
+  uint64_t want = expected_keys / FILTER_BUCKET_SLOTS * 10 / 9 + 1;
+  uint64_t n = FILTER_MIN_BUCKETS;
+  while (n < want) n <<= 1;
+  return n;
+}
+
+bool KvsKeyFilter::init() {
+  fps = (uint16_t*)calloc(nbuckets * FILTER_BUCKET_SLOTS, sizeof(uint16_t));
+  counts = (uint8_t*)calloc(nbuckets * FILTER_BUCKET_SLOTS, sizeof(uint8_t));
+  return fps && counts;
+}
+
+// MurmurHash64A; the filter is persisted, so the hash must not depend on the build
+uint64_t KvsKeyFilter::hash(const void *data, uint32_t len) {
+  const uint64_t m = 0xc6a4a7935bd1e995ULL;
+  const int r = 47;
+  const uint8_t *p = (const uint8_t*)data;
+  const uint8_t *end = p + (len & ~7u);
+  uint64_t h = 0x9747b28cULL ^ (len * m);
+
+  for (; p != end; p += 8) {
+    uint64_t k;
+    memcpy(&k, p, 8);
+    k = le64toh(k);
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+    h ^= k;
+    h *= m;
+  }
+  if (len & 7) {
+    uint64_t t = 0;
+    for (uint32_t i = len & 7; i > 0; i--)
+      t = (t << 8) | p[i - 1];
+    h ^= t;
+    h *= m;
+  }
+  h ^= h >> r;
+  h *= m;
+  h ^= h >> r;
+  return h;
+}
+
+uint16_t KvsKeyFilter::fingerprint(uint64_t h) {
+  uint16_t fp = (uint16_t)(h >> 48);
+  return fp ? fp : 1;
+}
+
+uint64_t KvsKeyFilter::alt_index(uint64_t bucket, uint16_t fp) const {
+  return (bucket ^ (fp * 0x5bd1e995ULL)) & (nbuckets - 1);
+}
+
+int KvsKeyFilter::find(uint64_t bucket, uint16_t fp) const {
+  const uint16_t *b = fps + bucket * FILTER_BUCKET_SLOTS;
+  for (uint32_t i = 0; i < FILTER_BUCKET_SLOTS; i++)
+    if (b[i] == fp) return i;
+  return -1;
+}
+
+bool KvsKeyFilter::place(uint64_t bucket, uint16_t fp, uint8_t count) {
+  int s = find(bucket, 0);
+  if (s < 0) return false;
+  fps[bucket * FILTER_BUCKET_SLOTS + s] = fp;
+  counts[bucket * FILTER_BUCKET_SLOTS + s] = count;
+  return true;
+}
+
+void KvsKeyFilter::add(uint64_t h) {
+  if (overflow) return;
+  uint16_t fp = fingerprint(h);
+  uint64_t i1 = index_of(h);
+  uint64_t i2 = alt_index(i1, fp);
+
+  int s = find(i1, fp);
+  uint64_t bucket = i1;
+  if (s < 0) {
+    s = find(i2, fp);
+    bucket = i2;
+  }
+  if (s >= 0) {
+    uint8_t *c = &counts[bucket * FILTER_BUCKET_SLOTS + s];
+    if (*c != FILTER_COUNT_STICKY) (*c)++;
+    return;
+  }
+  if (victim.used && victim.fp == fp && (victim.bucket == i1 || victim.bucket == i2)) {
+    if (victim.count != FILTER_COUNT_STICKY) victim.count++;
+    return;
+  }
+  if (place(i1, fp, 1) || place(i2, fp, 1)) return;
+
+  uint8_t count = 1;
+  bucket = (seed & 1) ? i1 : i2;
+  for (int n = 0; n < FILTER_MAX_KICKS; n++) {
+    seed = seed * 1103515245 + 12345;
+    uint64_t slot = bucket * FILTER_BUCKET_SLOTS + (seed >> 16) % FILTER_BUCKET_SLOTS;
+    std::swap(fp, fps[slot]);
+    std::swap(count, counts[slot]);
+    bucket = alt_index(bucket, fp);
+    if (place(bucket, fp, count)) return;
+  }
+  if (victim.used) {
+    overflow = true;
+    return;
+  }
+  victim.fp = fp;
+  victim.count = count;
+  victim.bucket = bucket;
+  victim.used = true;
+}
+
+void KvsKeyFilter::take(uint64_t h) {
+  if (overflow) return;
+  uint16_t fp = fingerprint(h);
+  uint64_t i1 = index_of(h);
+  uint64_t i2 = alt_index(i1, fp);
+
+  int s = find(i1, fp);
+  uint64_t bucket = i1;
+  if (s < 0) {
+    s = find(i2, fp);
+    bucket = i2;
+  }
+  if (s >= 0) {
+    uint64_t slot = bucket * FILTER_BUCKET_SLOTS + s;
+    if (counts[slot] == FILTER_COUNT_STICKY || --counts[slot]) return;
+    fps[slot] = 0;
+    // the freed slot may take the victim back
+    if (victim.used && (place(victim.bucket, victim.fp, victim.count) ||
+        place(alt_index(victim.bucket, victim.fp), victim.fp, victim.count)))
+      victim.used = false;
+    return;
+  }
+  if (victim.used && victim.fp == fp && (victim.bucket == i1 || victim.bucket == i2)) {
+    if (victim.count != FILTER_COUNT_STICKY && --victim.count == 0)
+      victim.used = false;
+  }
+}
+
+bool KvsKeyFilter::contains(uint64_t h) {
+  if (overflow) return true;
+  uint16_t fp = fingerprint(h);
+  uint64_t i1 = index_of(h);
+  uint64_t i2 = alt_index(i1, fp);
+  if (find(i1, fp) >= 0 || find(i2, fp) >= 0) return true;
+  return victim.used && victim.fp == fp && (victim.bucket == i1 || victim.bucket == i2);
+}
+
+void KvsKeyFilter::insert(const kvs_key *key) {
+  uint64_t h = hash(key->key, key->length);
+  std::unique_lock<std::mutex> guard(lock);
+  add(h);
+}
+
+bool KvsKeyFilter::excludes(const kvs_key *key) {
+  if (!answering.load(std::memory_order_acquire)) return false;
+  uint64_t h = hash(key->key, key->length);
+  bool found;
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    found = contains(h);
+  }
+  ks_hd->dev->driver->stats.record_filter(!found);
+  return !found;
+}
+
+bool KvsKeyFilter::excludes_all(uint32_t key_cnt, const kvs_key *keys, kvs_exist_list *list) {
+  if (!answering.load(std::memory_order_acquire)) return false;
+  bool found = false;
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    for (uint32_t i = 0; i < key_cnt && !found; i++)
+      found = contains(hash(keys[i].key, keys[i].length));
+  }
+  ks_hd->dev->driver->stats.record_filter(!found);
+  if (found) return false;
+  memset(list->result_buffer, 0, (key_cnt + 7) / 8);
+  return true;
+}
+
+/*
+ * Deletes
+ */
+
+kvs_result KvsKeyFilter::remove(const kvs_key *key, const kvs_option_delete *opt,
+    void *private1, void *private2, bool sync, kvs_postprocess_function post_fn, void *req_ctx) {
+  // only a delete that found the key may take it back
+  kvs_option_delete delete_opt = *opt;
+  delete_opt.kvs_delete_error = true;
+  uint64_t h = hash(key->key, key->length);
+
+  if (sync) {
+    kvs_result ret = _delete_from_key_space(ks_hd, key, &delete_opt, private1, private2,
+      true, NULL, NULL);
+    if (ret == KVS_SUCCESS) {
+      std::unique_lock<std::mutex> guard(lock);
+      take(h);
+    } else if (ret == KVS_ERR_KEY_NOT_EXIST && !opt->kvs_delete_error) {
+      ret = KVS_SUCCESS;
+    }
+    return ret;
+  }
+
+  filter_delete_op *op = new filter_delete_op();
+  op->owner = this;
+  op->hash = h;
+  op->delete_error = opt->kvs_delete_error;
+  op->private1 = private1;
+  op->private2 = private2;
+  op->post_fn = post_fn;
+  kvs_result ret = _delete_from_key_space(ks_hd, key, &delete_opt, op, NULL, false,
+    on_delete_complete, req_ctx);
+  if (ret != KVS_SUCCESS) delete op;
+  return ret;
+}
+
+void KvsKeyFilter::on_delete_complete(kvs_postprocess_context *ctx) {
+  filter_delete_op *op = (filter_delete_op*)ctx->private1;
+  kvs_postprocess_function post_fn = op->post_fn;
+  if (ctx->result == KVS_SUCCESS) {
+    std::unique_lock<std::mutex> guard(op->owner->lock);
+    op->owner->take(op->hash);
+  } else if (ctx->result == KVS_ERR_KEY_NOT_EXIST && !op->delete_error) {
+    ctx->result = KVS_SUCCESS;
+  }
+  ctx->private1 = op->private1;
+  ctx->private2 = op->private2;
+  delete op;
+  post_fn(ctx);
+}
+
+/*
+ * Lookups answered by the filter
+ */
+
+kvs_result KvsKeyFilter::complete(kvs_context op, const kvs_key *key, kvs_value *value,
+    kvs_exist_list *list, void *private1, void *private2, kvs_postprocess_function post_fn) {
+  filter_completion c;
+  memset(&c.ctx, 0, sizeof(c.ctx));
+  c.ctx.context = op;
+  c.ctx.ks_hd = ks_hd;
+  c.ctx.key = (kvs_key*)key;
+  c.ctx.value = value;
+  c.ctx.private1 = private1;
+  c.ctx.private2 = private2;
+  if (op == KVS_CMD_EXIST) {
+    c.ctx.result_buffer.list = list;
+    c.ctx.result = KVS_SUCCESS;
+  } else {
+    value->actual_value_size = 0;
+    c.ctx.result = KVS_ERR_KEY_NOT_EXIST;
+  }
+  c.post_fn = post_fn;
+
+  std::unique_lock<std::mutex> guard(worker_lock);
+  if (!worker_started) {
+    worker = std::thread(&KvsKeyFilter::run, this);
+    worker_started = true;
+  }
+  deferred.push_back(c);
+  worker_cond.notify_one();
+  return KVS_SUCCESS;
+}
+
+void KvsKeyFilter::run() {
+  std::unique_lock<std::mutex> guard(worker_lock);
+  while (true) {
+    while (deferred.empty() && !stop)
+      worker_cond.wait(guard);
+    if (deferred.empty()) break;
+    filter_completion c = deferred.front();
+    deferred.pop_front();
+    guard.unlock();
+    c.post_fn(&c.ctx);
+    guard.lock();
+  }
+}
+
+/*
+ * Rebuild and persistence
+ */
+
+kvs_result KvsKeyFilter::rebuild() {
+  KvsDriver *driver = ks_hd->dev->driver;
+  std::unique_lock<std::mutex> guard(lock);
+  memset(fps, 0, nbuckets * FILTER_BUCKET_SLOTS * sizeof(uint16_t));
+  memset(counts, 0, nbuckets * FILTER_BUCKET_SLOTS);
+  memset(&victim, 0, sizeof(victim));
+  overflow = false;
+
+  // a bitmask of 0 iterates all keys of the key space
+  kvs_option_iterator iter_opt = {KVS_ITERATOR_KEY};
+  kvs_iterator_handle iter;
+  int32_t ret = driver->create_iterator(ks_hd, iter_opt, 0, 0, &iter);
+  if (ret != KVS_SUCCESS) return (kvs_result)ret;
+
+  uint8_t *buf = (uint8_t*)kvs_zalloc(KVS_ITERATOR_BUFFER_SIZE, PAGE_ALIGN);
+  if (buf == NULL) {
+    driver->delete_iterator(ks_hd, iter);
+    return KVS_ERR_SYS_IO;
+  }
+  kvs_iterator_list list;
+  do {
+    list.num_entries = 0;
+    list.end = false;
+    list.size = KVS_ITERATOR_BUFFER_SIZE;
+    list.it_list = buf;
+    ret = driver->iterator_next(ks_hd, iter, &list, NULL, NULL, true, NULL);
+    if (ret != KVS_SUCCESS) break;
+
+    // entries are [key length:u32][key]; a batch that holds fewer
+    // well-formed keys than it claims would leave keys out of the filter,
+    // which then answers "not found" for keys that exist
+    if (list.size > KVS_ITERATOR_BUFFER_SIZE) {
+      ret = KVS_ERR_SYS_IO;
+      break;
+    }
+    uint32_t pos = 0, i = 0;
+    for (; i < list.num_entries; i++) {
+      uint32_t klen;
+      if (list.size - pos < 4) break;
+      memcpy(&klen, buf + pos, 4);
+      pos += 4;
+      if (klen == 0 || klen > KVS_MAX_KEY_LENGTH || klen > list.size - pos) break;
+      add(hash(buf + pos, klen));
+      pos += klen;
+    }
+    if (i != list.num_entries) {
+      ret = KVS_ERR_SYS_IO;
+      break;
+    }
+  } while (!list.end);
+  driver->delete_iterator(ks_hd, iter);
+  kvs_free(buf);
+  if (ret != KVS_SUCCESS) return (kvs_result)ret;
+
+  // packed keys are not returned by iterators
+  if (ks_hd->packer) {
+    ks_hd->packer->for_each_key([this](const std::string &key) {
+      add(hash(key.data(), key.size()));
+    });
+  }
+  return overflow ? KVS_ERR_OPTION_INVALID : KVS_SUCCESS;
+}
+
+void KvsKeyFilter::encode(uint64_t off, uint32_t len, uint8_t *out) const {
+  uint64_t fp_bytes = nbuckets * FILTER_BUCKET_SLOTS * sizeof(uint16_t);
+  if (off < fp_bytes) {
+    uint32_t n = (uint32_t)std::min<uint64_t>(len, fp_bytes - off);
+    for (uint32_t i = 0; i < n; i += 2) {
+      uint16_t v = htole16(fps[(off + i) / 2]);
+      memcpy(out + i, &v, 2);
+    }
+    off += n;
+    out += n;
+    len -= n;
+  }
+  if (len) memcpy(out, counts + (off - fp_bytes), len);
+}
+
+void KvsKeyFilter::decode(uint64_t off, uint32_t len, const uint8_t *in) {
+  uint64_t fp_bytes = nbuckets * FILTER_BUCKET_SLOTS * sizeof(uint16_t);
+  if (off < fp_bytes) {
+    uint32_t n = (uint32_t)std::min<uint64_t>(len, fp_bytes - off);
+    for (uint32_t i = 0; i < n; i += 2) {
+      uint16_t v;
+      memcpy(&v, in + i, 2);
+      fps[(off + i) / 2] = le16toh(v);
+    }
+    off += n;
+    in += n;
+    len -= n;
+  }
+  if (len) memcpy(counts + (off - fp_bytes), in, len);
+}
+
+kvs_result KvsKeyFilter::save() {
+  std::unique_lock<std::mutex> guard(lock);
+  // a filter that overflowed answers nothing, the next one is rebuilt
+  if (overflow) return KVS_SUCCESS;
+
+  uint64_t body = nbuckets * FILTER_BUCKET_SLOTS * FILTER_SLOT_BYTES;
+  uint8_t *buf = (uint8_t*)kvs_zalloc(FILTER_CHUNK_LEN, PAGE_ALIGN);
+  if (buf == NULL) return KVS_ERR_SYS_IO;
+
+  kvs_result ret = KVS_SUCCESS;
+  uint64_t checksum = 0;
+  for (uint64_t off = 0; off < body && ret == KVS_SUCCESS; off += FILTER_CHUNK_LEN) {
+    uint32_t len = (uint32_t)std::min<uint64_t>(FILTER_CHUNK_LEN, body - off);
+    encode(off, len, buf);
+    checksum = checksum * 31 + hash(buf, len);
+    ret = filter_meta_io(ks_hd->dev, ks_hd->keyspace_id, off / FILTER_CHUNK_LEN, buf, &len,
+      KVS_CMD_STORE);
+  }
+
+  if (ret == KVS_SUCCESS) {
+    uint32_t u32; uint16_t u16; uint64_t u64;
+    memset(buf, 0, FILTER_HEADER_LEN);
+    u32 = htole32(FILTER_MAGIC);        memcpy(buf + 0, &u32, 4);
+    u16 = htole16(FILTER_VERSION);      memcpy(buf + 4, &u16, 2);
+    u16 = 0;                            memcpy(buf + 6, &u16, 2);
+    u64 = htole64(nbuckets);            memcpy(buf + 8, &u64, 8);
+    u64 = htole64(body);                memcpy(buf + 16, &u64, 8);
+    u32 = htole32(FILTER_CHUNK_LEN);    memcpy(buf + 24, &u32, 4);
+    u16 = htole16(victim.fp);           memcpy(buf + 28, &u16, 2);
+    buf[30] = victim.count;
+    buf[31] = victim.used ? 1 : 0;
+    u64 = htole64(victim.bucket);       memcpy(buf + 32, &u64, 8);
+    u64 = htole64(checksum);            memcpy(buf + 40, &u64, 8);
+    uint32_t len = FILTER_HEADER_LEN;
+    ret = filter_meta_io(ks_hd->dev, ks_hd->keyspace_id, -1, buf, &len, KVS_CMD_STORE);
+  }
+  kvs_free(buf);
+  return ret;
+}
+
+kvs_result KvsKeyFilter::load(kvs_key_space_handle ks_hd, KvsKeyFilter **filter) {
+  kvs_device_handle dev_hd = ks_hd->dev;
+  uint8_t *buf = (uint8_t*)kvs_zalloc(FILTER_CHUNK_LEN, PAGE_ALIGN);
+  if (buf == NULL) return KVS_ERR_SYS_IO;
+
+  uint32_t len = FILTER_HEADER_LEN;
+  kvs_result ret = filter_meta_io(dev_hd, ks_hd->keyspace_id, -1, buf, &len, KVS_CMD_RETRIEVE);
+  if (ret != KVS_SUCCESS) {
+    kvs_free(buf);
+    return ret;
+  }
+
+  uint32_t u32; uint16_t u16; uint64_t u64;
+  uint64_t nbuckets, body, checksum = 0;
+  memcpy(&u32, buf + 0, 4);
+  bool valid = (len == FILTER_HEADER_LEN) && le32toh(u32) == FILTER_MAGIC;
+  memcpy(&u16, buf + 4, 2);  valid = valid && le16toh(u16) == FILTER_VERSION;
+  memcpy(&u16, buf + 6, 2);  valid = valid && !(le16toh(u16) & FILTER_FLAG_OVERFLOW);
+  memcpy(&u64, buf + 8, 8);  nbuckets = le64toh(u64);
+  memcpy(&u64, buf + 16, 8); body = le64toh(u64);
+  memcpy(&u32, buf + 24, 4); valid = valid && le32toh(u32) == FILTER_CHUNK_LEN;
+  valid = valid && nbuckets >= FILTER_MIN_BUCKETS && !(nbuckets & (nbuckets - 1)) &&
+    body == nbuckets * FILTER_BUCKET_SLOTS * FILTER_SLOT_BYTES;
+
+  KvsKeyFilter *f = NULL;
+  if (valid) {
+    f = new KvsKeyFilter(ks_hd, 0);
+    f->nbuckets = nbuckets;
+    memcpy(&u16, buf + 28, 2); f->victim.fp = le16toh(u16);
+    f->victim.count = buf[30];
+    f->victim.used = buf[31] != 0;
+    memcpy(&u64, buf + 32, 8); f->victim.bucket = le64toh(u64) & (nbuckets - 1);
+    memcpy(&u64, buf + 40, 8); checksum = le64toh(u64);
+    valid = f->init();
+  }
+
+  uint64_t sum = 0;
+  for (uint64_t off = 0; valid && off < body; off += FILTER_CHUNK_LEN) {
+    uint32_t want = (uint32_t)std::min<uint64_t>(FILTER_CHUNK_LEN, body - off);
+    len = want;
+    ret = filter_meta_io(dev_hd, ks_hd->keyspace_id, off / FILTER_CHUNK_LEN, buf, &len,
+      KVS_CMD_RETRIEVE);
+    valid = (ret == KVS_SUCCESS) && len == want;
+    if (valid) {
+      sum = sum * 31 + hash(buf, len);
+      f->decode(off, len, buf);
+    }
+  }
+  valid = valid && sum == checksum;
+  kvs_free(buf);
+
+  // the copy is only good until the key space is written without it
+  ret = filter_meta_io(dev_hd, ks_hd->keyspace_id, -1, NULL, NULL, KVS_CMD_DELETE);
+  if (!valid || ret != KVS_SUCCESS) {
+    delete f;
+    return (ret != KVS_SUCCESS) ? ret : KVS_ERR_KEY_NOT_EXIST;
+  }
+  *filter = f;
+  return KVS_SUCCESS;
+}
+
+void KvsKeyFilter::drop(kvs_device_handle dev_hd, uint8_t keyspace_id) {
+  uint8_t *buf = (uint8_t*)kvs_zalloc(FILTER_HEADER_LEN, PAGE_ALIGN);
+  if (buf == NULL) return;
+  uint32_t len = FILTER_HEADER_LEN;
+  kvs_result ret = filter_meta_io(dev_hd, keyspace_id, -1, buf, &len, KVS_CMD_RETRIEVE);
+  if (ret == KVS_SUCCESS && len == FILTER_HEADER_LEN) {
+    uint64_t u64;
+    memcpy(&u64, buf + 16, 8);
+    uint64_t chunks = (le64toh(u64) + FILTER_CHUNK_LEN - 1) / FILTER_CHUNK_LEN;
+    filter_meta_io(dev_hd, keyspace_id, -1, NULL, NULL, KVS_CMD_DELETE);
+    for (uint64_t i = 0; i < chunks; i++)
+      filter_meta_io(dev_hd, keyspace_id, i, NULL, NULL, KVS_CMD_DELETE);
+  }
+  kvs_free(buf);
+}
+
+/*
+ * Public API
+ */
+
+kvs_result kvs_enable_key_filter(kvs_key_space_handle ks_hd, const kvs_option_key_filter *opt) {
+  kvs_result ret = _check_key_space_handle(ks_hd);
+  if (ret != KVS_SUCCESS) return ret;
+
+  uint64_t expected_keys = opt ? opt->expected_keys : 0;
+  KvsKeyFilter *f = ks_hd->filter;
+  if (f && !(opt && opt->rebuild) &&
+      (expected_keys == 0 || KvsKeyFilter::buckets_for(expected_keys) == f->buckets())) {
+    f->set_answering(true);
+    return KVS_SUCCESS;
+  }
+
+  f = new KvsKeyFilter(ks_hd, expected_keys ? expected_keys : KVS_KEY_FILTER_EXPECTED_KEYS);
+  if (!f->init()) {
+    delete f;
+    return KVS_ERR_SYS_IO;
+  }
+  ret = f->rebuild();
+  if (ret != KVS_SUCCESS) {
+    delete f;
+    return ret;
+  }
+  f->set_answering(true);
+  delete ks_hd->filter;
+  ks_hd->filter = f;
+  return KVS_SUCCESS;
+}
+
+kvs_result kvs_disable_key_filter(kvs_key_space_handle ks_hd) {
+  kvs_result ret = _check_key_space_handle(ks_hd);
+  if (ret != KVS_SUCCESS) return ret;
+  delete ks_hd->filter;
+  ks_hd->filter = NULL;
+  return KVS_SUCCESS;
+}
@@ -0,0 +1,641 @@
+/**
+ *   BSD LICENSE
+ *
+ *   Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Samsung Electronics Co., Ltd. nor the names of
+ *       its contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Large value layer
+ *
+ * Values bigger than a device can hold are split into chunks of
+ * KVS_LARGE_VALUE_CHUNK_LENGTH bytes. The user key itself holds a small
+ * manifest that describes the object, and chunk i of generation g is stored
+ * under <user key><0xff><g:be32><i:be32>. Overwrites write the chunks of a
+ * new generation first and then replace the manifest, which is a single key
+ * store and therefore atomic; the chunks of the previous generation are
+ * reclaimed afterwards. Generations that may have been left behind by an
+ * interrupted operation are recorded in the manifest (orphan_generation,
+ * orphan_cnt) before any chunk is touched, so they can always be reclaimed
+ * later by kvs_gc_large_kvp() or the next store/delete of the key. A store
+ * over an ordinary value keeps that value readable until the manifest
+ * replaces it, so its record goes to a sidecar key, <user key><0xff>, that
+ * is dropped once the store is done.
+ *
+ * Chunk IOs are issued through the asynchronous driver interface with at
+ * most min(KVS_LARGE_VALUE_MAX_INFLIGHT, queue depth) commands outstanding.
+ */
+
+#include <string.h>
+#include <endian.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include "kvs_utils.h"
+#include "private_types.h"
+#include "kvs_filter.h"
+
+namespace {
+
+const uint32_t LARGE_MANIFEST_MAGIC = 0x564c564b;   // "KVLV"
+const uint16_t LARGE_MANIFEST_VERSION = 1;
+const uint32_t LARGE_MANIFEST_LEN = 40;
+// the object is being created or deleted and is not visible to readers
+const uint16_t LARGE_FLAG_HIDDEN = 0x1;
+
+const uint8_t LARGE_CHUNK_KEY_MARK = 0xff;
+const uint32_t LARGE_CHUNK_KEY_STRIDE = KVS_MAX_KEY_LENGTH + 1;
+const int LARGE_KEY_LOCK_STRIPES = 64;
+// retries of a read that raced with an overwrite of the same key
+const int LARGE_READ_RETRIES = 3;
+
+typedef struct {
+  uint16_t flags;
+  uint32_t chunk_size;
+  uint32_t chunk_cnt;
+  uint64_t total_length;
+  uint32_t generation;
+  uint32_t orphan_generation;  // generation whose chunks may still exist
+  uint32_t orphan_cnt;         // number of chunks of orphan_generation
+} large_manifest;
+
+std::mutex large_key_locks[LARGE_KEY_LOCK_STRIPES];
+
+// serializes writers of the same key within the process
+std::mutex &large_key_lock(kvs_key_space_handle ks_hd, const kvs_key *key) {
+  size_t h = std::hash<std::string>()(std::string((const char*)key->key, key->length));
+  return large_key_locks[(h ^ ks_hd->keyspace_id) % LARGE_KEY_LOCK_STRIPES];
+}
+
+void large_encode_manifest(const large_manifest *m, uint8_t *buf) {
+  uint32_t u32; uint16_t u16; uint64_t u64;
+  u32 = htole32(LARGE_MANIFEST_MAGIC);   memcpy(buf + 0, &u32, 4);
+  u16 = htole16(LARGE_MANIFEST_VERSION); memcpy(buf + 4, &u16, 2);
+  u16 = htole16(m->flags);               memcpy(buf + 6, &u16, 2);
+  u32 = htole32(m->chunk_size);          memcpy(buf + 8, &u32, 4);
+  u32 = htole32(m->chunk_cnt);           memcpy(buf + 12, &u32, 4);
+  u64 = htole64(m->total_length);        memcpy(buf + 16, &u64, 8);
+  u32 = htole32(m->generation);          memcpy(buf + 24, &u32, 4);
+  u32 = htole32(m->orphan_generation);   memcpy(buf + 28, &u32, 4);
+  u32 = htole32(m->orphan_cnt);          memcpy(buf + 32, &u32, 4);
+  memset(buf + 36, 0, 4);
+}
+
+bool large_decode_manifest(const uint8_t *buf, large_manifest *m) {
+  uint32_t u32; uint16_t u16; uint64_t u64;
+  memcpy(&u32, buf + 0, 4);
+  if (le32toh(u32) != LARGE_MANIFEST_MAGIC) return false;
+  memcpy(&u16, buf + 4, 2);
+  if (le16toh(u16) != LARGE_MANIFEST_VERSION) return false;
+  memcpy(&u16, buf + 6, 2);  m->flags = le16toh(u16);
+  memcpy(&u32, buf + 8, 4);  m->chunk_size = le32toh(u32);
+  memcpy(&u32, buf + 12, 4); m->chunk_cnt = le32toh(u32);
+  memcpy(&u64, buf + 16, 8); m->total_length = le64toh(u64);
+  memcpy(&u32, buf + 24, 4); m->generation = le32toh(u32);
+  memcpy(&u32, buf + 28, 4); m->orphan_generation = le32toh(u32);
+  memcpy(&u32, buf + 32, 4); m->orphan_cnt = le32toh(u32);
+  return m->chunk_size != 0 && (m->chunk_size % KVS_ALIGNMENT_UNIT) == 0;
+}
+
+class large_batch;
+
+typedef struct {
+  large_batch *batch;
+  kvs_key key;
+  kvs_value value;
+  bool partial;   // reads a part of a chunk, KVS_ERR_BUFFER_SMALL is expected
+} large_io;
+
+/*
+ * A set of IOs to one key space with a bounded number of outstanding
+ * commands. The first failure stops further submissions and is returned
+ * by wait_all().
+ */
+class large_batch {
+public:
+  large_batch(kvs_key_space_handle ks_hd_, uint32_t depth_, bool tolerate_missing_ = false):
+    ks_hd(ks_hd_), depth(depth_), tolerate_missing(tolerate_missing_),
+    syncio(_env_sync_io_only()), polling(_env_is_polling()),
+    inflight(0), result(KVS_SUCCESS) {
+    if (depth == 0) depth = 1;
+  }
+
+  kvs_result submit(kvs_context op, large_io *io) {
+    wait_until(depth - 1);
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      if (result != KVS_SUCCESS) return result;
+      inflight++;
+    }
+
+    io->batch = this;
+    KvsDriver *driver = ks_hd->dev->driver;
+    kvs_option_store store_opt = {KVS_STORE_POST, NULL};
+    kvs_option_retrieve retrieve_opt = {false};
+    kvs_option_delete delete_opt = {false};
+    void *p1 = syncio ? NULL : io;
+    kvs_postprocess_function cbfn = syncio ? NULL : large_batch::on_io_complete;
+    int32_t ret;
+
+    if (op == KVS_CMD_STORE) {
+      ret = driver->store_tuple(ks_hd, &io->key, &io->value, store_opt, p1, NULL, syncio, cbfn);
+    } else if (op == KVS_CMD_RETRIEVE) {
+      ret = driver->retrieve_tuple(ks_hd, &io->key, &io->value, retrieve_opt, p1, NULL, syncio, cbfn);
+    } else {
+      ret = driver->delete_tuple(ks_hd, &io->key, delete_opt, p1, NULL, syncio, cbfn);
+    }
+
+    // a synchronous command is already done, a failed submission never completes
+    if (syncio || ret != KVS_SUCCESS) return complete(io, (kvs_result)ret);
+    return KVS_SUCCESS;
+  }
+
+  kvs_result wait_all() {
+    wait_until(0);
+    return result;
+  }
+
+private:
+  static void on_io_complete(kvs_postprocess_context *ctx) {
+    large_io *io = (large_io*)ctx->private1;
+    io->batch->complete(io, ctx->result);
+  }
+
+  kvs_result complete(large_io *io, kvs_result res) {
+    if (res == KVS_ERR_BUFFER_SMALL && io->partial) res = KVS_SUCCESS;
+    if (res == KVS_ERR_KEY_NOT_EXIST && tolerate_missing) res = KVS_SUCCESS;
+
+    std::unique_lock<std::mutex> guard(lock);
+    if (res != KVS_SUCCESS && result == KVS_SUCCESS) result = res;
+    inflight--;
+    cond.notify_all();
+    return res;
+  }
+
+  void wait_until(uint32_t limit) {
+    std::unique_lock<std::mutex> guard(lock);
+    while (inflight > limit) {
+      if (polling) {
+        guard.unlock();
+        ks_hd->dev->driver->process_completions(depth);
+        guard.lock();
+      } else {
+        cond.wait(guard);
+      }
+    }
+  }
+
+  kvs_key_space_handle ks_hd;
+  uint32_t depth;
+  bool tolerate_missing;
+  bool syncio;
+  bool polling;
+  std::mutex lock;
+  std::condition_variable cond;
+  uint32_t inflight;
+  kvs_result result;
+};
+
+uint32_t large_io_depth() {
+  uint32_t depth = _env_queue_depth();
+  return depth < KVS_LARGE_VALUE_MAX_INFLIGHT ? depth : KVS_LARGE_VALUE_MAX_INFLIGHT;
+}
+
+kvs_result large_single_io(kvs_key_space_handle ks_hd, kvs_context op,
+    const kvs_key *key, kvs_value *value, bool tolerate_missing = false) {
+  large_batch batch(ks_hd, 1, tolerate_missing);
+  large_io io;
+  io.key = *key;
+  if (value) io.value = *value;
+  else memset(&io.value, 0, sizeof(io.value));
+  io.partial = false;
+
+  batch.submit(op, &io);
+  kvs_result ret = batch.wait_all();
+  if (value) {
+    value->length = io.value.length;
+    value->actual_value_size = io.value.actual_value_size;
+  }
+  return ret;
+}
+
+// returns KVS_SUCCESS with *plain set when the key holds an ordinary value
+kvs_result large_read_manifest(kvs_key_space_handle ks_hd, const kvs_key *key,
+    large_manifest *m, bool *plain) {
+  *plain = false;
+  uint8_t *buf = (uint8_t*)kvs_zalloc(LARGE_MANIFEST_LEN, PAGE_ALIGN);
+  if (buf == NULL) return KVS_ERR_SYS_IO;
+
+  kvs_value value = {buf, LARGE_MANIFEST_LEN, 0, 0};
+  kvs_result ret = large_single_io(ks_hd, KVS_CMD_RETRIEVE, key, &value);
+  if (ret == KVS_ERR_BUFFER_SMALL) {
+    *plain = true;
+    ret = KVS_SUCCESS;
+  } else if (ret == KVS_SUCCESS) {
+    *plain = (value.length != LARGE_MANIFEST_LEN) || !large_decode_manifest(buf, m);
+  }
+  kvs_free(buf);
+  return ret;
+}
+
+kvs_result large_write_manifest(kvs_key_space_handle ks_hd, const kvs_key *key,
+    const large_manifest *m) {
+  uint8_t *buf = (uint8_t*)kvs_zalloc(LARGE_MANIFEST_LEN, PAGE_ALIGN);
+  if (buf == NULL) return KVS_ERR_SYS_IO;
+
+  large_encode_manifest(m, buf);
+  kvs_value value = {buf, LARGE_MANIFEST_LEN, 0, 0};
+  kvs_result ret = large_single_io(ks_hd, KVS_CMD_STORE, key, &value);
+  kvs_free(buf);
+  return ret;
+}
+
+void large_sidecar_key(const kvs_key *key, uint8_t *buf, kvs_key *sidecar_key) {
+  memcpy(buf, key->key, key->length);
+  buf[key->length] = LARGE_CHUNK_KEY_MARK;
+  sidecar_key->key = buf;
+  sidecar_key->length = key->length + 1;
+}
+
+void large_chunk_key(const kvs_key *key, uint32_t generation, uint32_t idx,
+    uint8_t *buf, kvs_key *chunk_key) {
+  uint32_t be_gen = htobe32(generation);
+  uint32_t be_idx = htobe32(idx);
+  memcpy(buf, key->key, key->length);
+  buf[key->length] = LARGE_CHUNK_KEY_MARK;
+  memcpy(buf + key->length + 1, &be_gen, 4);
+  memcpy(buf + key->length + 5, &be_idx, 4);
+  chunk_key->key = buf;
+  chunk_key->length = key->length + 9;
+}
+
+/*
+ * Runs op on the chunks of a generation that overlap [offset, offset + length).
+ * buf maps to offset for stores and retrieves and is ignored for deletes.
+ */
+kvs_result large_chunk_io(kvs_key_space_handle ks_hd, const kvs_key *key,
+    kvs_context op, uint32_t generation, uint32_t chunk_size, uint32_t chunk_cnt,
+    uint8_t *buf, uint64_t offset, uint64_t length) {
+  if (chunk_cnt == 0 || length == 0) return KVS_SUCCESS;
+
+  uint32_t first = offset / chunk_size;
+  uint32_t last = (op == KVS_CMD_DELETE) ? chunk_cnt - 1 :
+    (uint32_t)((offset + length - 1) / chunk_size);
+  uint32_t n = last - first + 1;
+
+  uint8_t *keys = (uint8_t*)kvs_malloc((size_t)n * LARGE_CHUNK_KEY_STRIDE, PAGE_ALIGN);
+  if (keys == NULL) return KVS_ERR_SYS_IO;
+  std::vector<large_io> ios(n);
+  uint8_t *bounce = NULL;
+  uint32_t bounce_len = 0;
+
+  large_batch batch(ks_hd, large_io_depth(), op == KVS_CMD_DELETE);
+  for (uint32_t i = 0; i < n; i++) {
+    large_io *io = &ios[i];
+    uint64_t chunk_start = (uint64_t)(first + i) * chunk_size;
+    large_chunk_key(key, generation, first + i, keys + (size_t)i * LARGE_CHUNK_KEY_STRIDE, &io->key);
+    memset(&io->value, 0, sizeof(io->value));
+    io->partial = false;
+
+    if (op != KVS_CMD_DELETE) {
+      uint64_t start = chunk_start > offset ? chunk_start : offset;
+      uint64_t end = chunk_start + chunk_size;
+      if (end > offset + length) end = offset + length;
+
+      io->value.value = buf + (start - offset);
+      io->value.length = end - start;
+      io->value.offset = start - chunk_start;
+      if (op == KVS_CMD_RETRIEVE) {
+        io->partial = (io->value.offset != 0) || (io->value.length != chunk_size);
+        if (io->value.length & (KVS_VALUE_LENGTH_ALIGNMENT_UNIT - 1)) {
+          // only the tail of a range can be unaligned; read it through a bounce buffer
+          bounce_len = (io->value.length + KVS_VALUE_LENGTH_ALIGNMENT_UNIT - 1) &
+            ~(KVS_VALUE_LENGTH_ALIGNMENT_UNIT - 1);
+          bounce = (uint8_t*)kvs_malloc(bounce_len, PAGE_ALIGN);
+          if (bounce == NULL) break;
+          io->value.value = bounce;
+          io->value.length = bounce_len;
+        }
+      }
+    }
+
+    if (batch.submit(op, io) != KVS_SUCCESS) break;
+  }
+
+  kvs_result ret = batch.wait_all();
+  if (ret == KVS_SUCCESS && bounce == NULL && bounce_len != 0) ret = KVS_ERR_SYS_IO;
+  if (bounce) {
+    if (ret == KVS_SUCCESS) {
+      uint64_t tail_start = ((uint64_t)last * chunk_size > offset) ? (uint64_t)last * chunk_size : offset;
+      memcpy(buf + (tail_start - offset), bounce, offset + length - tail_start);
+    }
+    kvs_free(bounce);
+  }
+  kvs_free(keys);
+  return ret;
+}
+
+/*
+ * Deletes the orphaned chunks recorded in m, then either drops a hidden
+ * manifest or stores m back with the orphan record cleared.
+ */
+kvs_result large_reclaim_orphans(kvs_key_space_handle ks_hd, const kvs_key *key,
+    large_manifest *m) {
+  kvs_result ret = large_chunk_io(ks_hd, key, KVS_CMD_DELETE, m->orphan_generation,
+    m->chunk_size, m->orphan_cnt, NULL, 0, (uint64_t)m->orphan_cnt * m->chunk_size);
+  if (ret != KVS_SUCCESS) return ret;
+
+  if (m->flags & LARGE_FLAG_HIDDEN)
+    return large_single_io(ks_hd, KVS_CMD_DELETE, key, NULL, true);
+
+  m->orphan_generation = 0;
+  m->orphan_cnt = 0;
+  return large_write_manifest(ks_hd, key, m);
+}
+
+/*
+ * Deletes the chunks recorded in the sidecar of key, unless they are the
+ * generation live_generation that the manifest of the key refers to, and
+ * then the sidecar itself.
+ */
+kvs_result large_reclaim_sidecar(kvs_key_space_handle ks_hd, const kvs_key *key,
+    uint32_t live_generation) {
+  uint8_t buf[LARGE_CHUNK_KEY_STRIDE];
+  kvs_key sidecar_key;
+  large_sidecar_key(key, buf, &sidecar_key);
+
+  large_manifest m;
+  bool plain;
+  kvs_result ret = large_read_manifest(ks_hd, &sidecar_key, &m, &plain);
+  if (ret == KVS_ERR_KEY_NOT_EXIST) return KVS_SUCCESS;
+  if (ret != KVS_SUCCESS) return ret;
+
+  if (!plain && m.orphan_generation != live_generation) {
+    ret = large_chunk_io(ks_hd, key, KVS_CMD_DELETE, m.orphan_generation,
+      m.chunk_size, m.orphan_cnt, NULL, 0, (uint64_t)m.orphan_cnt * m.chunk_size);
+    if (ret != KVS_SUCCESS) return ret;
+  }
+  return large_single_io(ks_hd, KVS_CMD_DELETE, &sidecar_key, NULL, true);
+}
+
+// a sidecar only ever records generation 1, the first one written over an ordinary value
+bool large_may_have_sidecar(kvs_result read_ret, bool plain, const large_manifest *m) {
+  return read_ret == KVS_ERR_KEY_NOT_EXIST || plain || m->generation <= 1;
+}
+
+// the generation the manifest m makes visible, 0 for none
+uint32_t large_live_generation(kvs_result read_ret, bool plain, const large_manifest *m) {
+  if (read_ret != KVS_SUCCESS || plain || (m->flags & LARGE_FLAG_HIDDEN)) return 0;
+  return m->generation;
+}
+
+kvs_result large_check_key(const kvs_key *key) {
+  kvs_result ret = (kvs_result)validate_kv_pair_(key, NULL, 0);
+  if (ret != KVS_SUCCESS) return ret;
+  if (key->length > KVS_MAX_LARGE_VALUE_KEY_LENGTH) {
+    WRITE_WARNING("key size is out of range for a large value, key size = %d\n", key->length);
+    return KVS_ERR_KEY_LENGTH_INVALID;
+  }
+  return KVS_SUCCESS;
+}
+
+// caller holds the key lock
+kvs_result large_delete_locked(kvs_key_space_handle ks_hd, const kvs_key *key,
+    const kvs_option_delete *opt) {
+  large_manifest m;
+  bool plain;
+  kvs_result ret = large_read_manifest(ks_hd, key, &m, &plain);
+  if (ret != KVS_SUCCESS && ret != KVS_ERR_KEY_NOT_EXIST) return ret;
+  if (large_may_have_sidecar(ret, plain, &m)) {
+    kvs_result rc = large_reclaim_sidecar(ks_hd, key, large_live_generation(ret, plain, &m));
+    if (rc != KVS_SUCCESS) return rc;
+  }
+  if (ret == KVS_ERR_KEY_NOT_EXIST)
+    return opt->kvs_delete_error ? KVS_ERR_KEY_NOT_EXIST : KVS_SUCCESS;
+  if (plain) return large_single_io(ks_hd, KVS_CMD_DELETE, key, NULL);
+
+  if (m.flags & LARGE_FLAG_HIDDEN) {
+    ret = large_reclaim_orphans(ks_hd, key, &m);
+    if (ret != KVS_SUCCESS) return ret;
+    return opt->kvs_delete_error ? KVS_ERR_KEY_NOT_EXIST : KVS_SUCCESS;
+  }
+
+  if (m.orphan_cnt) {
+    ret = large_reclaim_orphans(ks_hd, key, &m);
+    if (ret != KVS_SUCCESS) return ret;
+  }
+
+  // hide the object first so that a crash never exposes a partly deleted value
+  m.flags |= LARGE_FLAG_HIDDEN;
+  m.orphan_generation = m.generation;
+  m.orphan_cnt = m.chunk_cnt;
+  m.chunk_cnt = 0;
+  ret = large_write_manifest(ks_hd, key, &m);
+  if (ret != KVS_SUCCESS) return ret;
+  return large_reclaim_orphans(ks_hd, key, &m);
+}
+
+} // namespace
+
+kvs_result kvs_store_large_kvp(kvs_key_space_handle ks_hd, kvs_key *key,
+    kvs_value *value, kvs_option_store *opt) {
+  kvs_result ret = _check_key_space_handle(ks_hd);
+  if (ret != KVS_SUCCESS) return ret;
+  if (key == NULL || value == NULL || opt == NULL) return KVS_ERR_PARAM_INVALID;
+
+  ret = large_check_key(key);
+  if (ret != KVS_SUCCESS) return ret;
+  ret = (kvs_result)validate_kv_pair_(key, value, UINT32_MAX);
+  if (ret != KVS_SUCCESS) return ret;
+  if (value->offset != 0) return KVS_ERR_VALUE_OFFSET_INVALID;
+  if (opt->st_type == KVS_STORE_APPEND) return KVS_ERR_OPTION_INVALID;
+
+  std::unique_lock<std::mutex> guard(large_key_lock(ks_hd, key));
+  // chunk keys are not looked up through the API, the user key stands for them
+  _filter_insert(ks_hd, key);
+
+  large_manifest old;
+  bool plain;
+  ret = large_read_manifest(ks_hd, key, &old, &plain);
+  if (ret != KVS_SUCCESS && ret != KVS_ERR_KEY_NOT_EXIST) return ret;
+  bool has_manifest = (ret == KVS_SUCCESS) && !plain;
+  if (large_may_have_sidecar(ret, plain, &old)) {
+    kvs_result rc = large_reclaim_sidecar(ks_hd, key, large_live_generation(ret, plain, &old));
+    if (rc != KVS_SUCCESS) return rc;
+  }
+
+  if (has_manifest && (old.orphan_cnt || (old.flags & LARGE_FLAG_HIDDEN))) {
+    ret = large_reclaim_orphans(ks_hd, key, &old);
+    if (ret != KVS_SUCCESS) return ret;
+    if (old.flags & LARGE_FLAG_HIDDEN) has_manifest = false;
+  }
+
+  bool exists = plain || has_manifest;
+  if (opt->st_type == KVS_STORE_NOOVERWRITE && exists) return KVS_ERR_VALUE_UPDATE_NOT_ALLOWED;
+  if (opt->st_type == KVS_STORE_UPDATE_ONLY && !exists) return KVS_ERR_KEY_NOT_EXIST;
+
+  large_manifest m;
+  memset(&m, 0, sizeof(m));
+  m.chunk_size = KVS_LARGE_VALUE_CHUNK_LENGTH;
+  m.chunk_cnt = (value->length + m.chunk_size - 1) / m.chunk_size;
+  m.total_length = value->length;
+  m.generation = has_manifest ? old.generation + 1 : 1;
+
+  // record the chunks about to be written so that an interrupted store can be reclaimed.
+  // An ordinary value is left in place, it stays readable until the manifest replaces
+  // it; the record goes to the sidecar then.
+  uint8_t sidecar_buf[LARGE_CHUNK_KEY_STRIDE];
+  kvs_key sidecar_key;
+  large_sidecar_key(key, sidecar_buf, &sidecar_key);
+  large_manifest intent;
+  if (has_manifest) {
+    intent = old;
+  } else {
+    memset(&intent, 0, sizeof(intent));
+    intent.flags = LARGE_FLAG_HIDDEN;
+    intent.chunk_size = m.chunk_size;
+  }
+  intent.orphan_generation = m.generation;
+  intent.orphan_cnt = m.chunk_cnt;
+  ret = large_write_manifest(ks_hd, plain ? &sidecar_key : key, &intent);
+  if (ret != KVS_SUCCESS) return ret;
+
+  ret = large_chunk_io(ks_hd, key, KVS_CMD_STORE, m.generation, m.chunk_size,
+    m.chunk_cnt, (uint8_t*)value->value, 0, value->length);
+  if (ret == KVS_SUCCESS) {
+    if (has_manifest) {
+      m.orphan_generation = old.generation;
+      m.orphan_cnt = old.chunk_cnt;
+    }
+    ret = large_write_manifest(ks_hd, key, &m);
+  }
+
+  if (ret != KVS_SUCCESS) {
+    kvs_result rc = plain ? large_reclaim_sidecar(ks_hd, key, 0) :
+      large_reclaim_orphans(ks_hd, key, &intent);
+    if (rc != KVS_SUCCESS)
+      fprintf(stderr, "WARN: failed to reclaim chunks of an interrupted large value store\n");
+    return ret;
+  }
+
+  // the manifest refers to the chunks now, the next store or delete drops a sidecar left here
+  if (plain && large_single_io(ks_hd, KVS_CMD_DELETE, &sidecar_key, NULL, true) != KVS_SUCCESS)
+    fprintf(stderr, "WARN: sidecar of a large value is left for kvs_gc_large_kvp\n");
+
+  // the new value is visible, failing to drop the previous generation is not an error
+  if (m.orphan_cnt && large_reclaim_orphans(ks_hd, key, &m) != KVS_SUCCESS)
+    fprintf(stderr, "WARN: previous generation of a large value is left for kvs_gc_large_kvp\n");
+
+  return KVS_SUCCESS;
+}
+
+kvs_result kvs_retrieve_large_kvp(kvs_key_space_handle ks_hd, kvs_key *key,
+    kvs_option_retrieve *opt, kvs_value *value) {
+  kvs_result ret = _check_key_space_handle(ks_hd);
+  if (ret != KVS_SUCCESS) return ret;
+  if (key == NULL || value == NULL || opt == NULL) return KVS_ERR_PARAM_INVALID;
+
+  ret = large_check_key(key);
+  if (ret != KVS_SUCCESS) return ret;
+  ret = (kvs_result)validate_kv_pair_(key, value, UINT32_MAX);
+  if (ret != KVS_SUCCESS) return ret;
+  if (_filter_excludes(ks_hd, key)) return KVS_ERR_KEY_NOT_EXIST;
+
+  for (int retry = 0; ; retry++) {
+    large_manifest m;
+    bool plain;
+    ret = large_read_manifest(ks_hd, key, &m, &plain);
+    if (ret != KVS_SUCCESS) return ret;
+
+    if (plain) {
+      if (value->length & (KVS_VALUE_LENGTH_ALIGNMENT_UNIT - 1))
+        return KVS_ERR_PARAM_INVALID;
+      ret = large_single_io(ks_hd, KVS_CMD_RETRIEVE, key, value);
+      break;
+    }
+    if (m.flags & LARGE_FLAG_HIDDEN) return KVS_ERR_KEY_NOT_EXIST;
+    if (value->offset != 0 && value->offset >= m.total_length)
+      return KVS_ERR_VALUE_OFFSET_INVALID;
+
+    uint64_t length = m.total_length - value->offset;
+    if (length > value->length) length = value->length;
+
+    ret = large_chunk_io(ks_hd, key, KVS_CMD_RETRIEVE, m.generation, m.chunk_size,
+      m.chunk_cnt, (uint8_t*)value->value, value->offset, length);
+    // a chunk vanished because the key was overwritten meanwhile, read the new generation
+    if (ret == KVS_ERR_KEY_NOT_EXIST && retry < LARGE_READ_RETRIES) continue;
+    if (ret != KVS_SUCCESS) return ret;
+
+    value->length = length;
+    value->actual_value_size = m.total_length;
+    break;
+  }
+
+  if (ret == KVS_SUCCESS && opt->kvs_retrieve_delete) {
+    std::unique_lock<std::mutex> guard(large_key_lock(ks_hd, key));
+    kvs_option_delete delete_opt = {false};
+    ret = large_delete_locked(ks_hd, key, &delete_opt);
+  }
+  return ret;
+}
+
+kvs_result kvs_delete_large_kvp(kvs_key_space_handle ks_hd, kvs_key *key,
+    kvs_option_delete *opt) {
+  kvs_result ret = _check_key_space_handle(ks_hd);
+  if (ret != KVS_SUCCESS) return ret;
+  if (key == NULL || opt == NULL) return KVS_ERR_PARAM_INVALID;
+
+  ret = large_check_key(key);
+  if (ret != KVS_SUCCESS) return ret;
+
+  std::unique_lock<std::mutex> guard(large_key_lock(ks_hd, key));
+  return large_delete_locked(ks_hd, key, opt);
+}
+
+kvs_result kvs_gc_large_kvp(kvs_key_space_handle ks_hd, kvs_key *key) {
+  kvs_result ret = _check_key_space_handle(ks_hd);
+  if (ret != KVS_SUCCESS) return ret;
+  if (key == NULL) return KVS_ERR_PARAM_INVALID;
+
+  ret = large_check_key(key);
+  if (ret != KVS_SUCCESS) return ret;
+
+  std::unique_lock<std::mutex> guard(large_key_lock(ks_hd, key));
+  large_manifest m;
+  bool plain;
+  ret = large_read_manifest(ks_hd, key, &m, &plain);
+  if (ret != KVS_SUCCESS && ret != KVS_ERR_KEY_NOT_EXIST) return ret;
+  kvs_result rc = large_reclaim_sidecar(ks_hd, key, large_live_generation(ret, plain, &m));
+  if (rc != KVS_SUCCESS) return rc;
+  if (ret != KVS_SUCCESS || plain) return ret;
+  if (m.orphan_cnt == 0 && !(m.flags & LARGE_FLAG_HIDDEN)) return KVS_SUCCESS;
+  return large_reclaim_orphans(ks_hd, key, &m);
+}
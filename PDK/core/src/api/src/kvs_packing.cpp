@@ -0,0 +1,1253 @@
+/**
+ *   BSD LICENSE
+ *
+ *   Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Samsung Electronics Co., Ltd. nor the names of
+ *       its contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Small value packing layer
+ *
+ * Container <cid> is stored in the user key space under the 16 byte key
+ * PACK_KEY_PREFIX<cid:be64>. It starts with a header
+ *   [magic:le32][version:le16][reserved:le16][used:le32][count:le32]
+ * followed by entries
+ *   [type:u8][key length:u8][value length:le16][key][value]
+ * A PUT entry holds a value, a DEL entry (tombstone) holds the id of the
+ * container of the version it deleted as be64 and a DEAD entry is an entry
+ * whose write failed. Replaying the containers in ascending id and offset
+ * order yields the index: later entries win and tombstones remove keys.
+ *
+ * Container ids are handed out in ascending order. The directory in the
+ * metadata key space records the range [low, limit) that may hold
+ * containers; ids are reserved PACK_CID_BLOCK at a time by the background
+ * thread, so that a container is never written beyond the recorded limit.
+ *
+ * Entries are appended to an in-memory image of the open container and
+ * acknowledged once a write of the container that covers them completed.
+ * Synchronous callers write the container right away, others wait up to
+ * flush_delay_us so that concurrent small stores share one device write.
+ * Containers whose dead bytes reach the compaction threshold are compacted
+ * by the background thread: live entries are moved to the open container
+ * and the old container is deleted once the moved entries are durable.
+ */
+
+#include <string.h>
+#include <endian.h>
+#include <chrono>
+#include "kvs_utils.h"
+#include "kvs_packing.h"
+
+namespace {
+
+const uint32_t PACK_CONTAINER_MAGIC = 0x4b50564b;   // "KVPK"
+const uint32_t PACK_DIRECTORY_MAGIC = 0x4450564b;   // "KVPD"
+const uint16_t PACK_VERSION = 1;
+const uint32_t PACK_HEADER_LEN = 16;
+const uint32_t PACK_ENTRY_HEADER_LEN = 4;
+const uint32_t PACK_DIRECTORY_LEN = 32;
+const uint32_t PACK_KEY_LEN = 16;
+const uint8_t PACK_KEY_PREFIX[8] = {0xff, 'k', 'v', 'p', 'a', 'c', 'k', 0};
+const uint64_t PACK_CID_BLOCK = 1024;
+// a sentinel that does not refer to an entry, used by kvs_flush_packing
+const uint32_t PACK_NO_ENTRY = 0xffffffff;
+
+const uint8_t PACK_ENTRY_PUT = 1;
+const uint8_t PACK_ENTRY_DEL = 2;
+const uint8_t PACK_ENTRY_DEAD = 3;
+
+inline uint32_t pack_entry_len(size_t klen, uint32_t vlen) {
+  return PACK_ENTRY_HEADER_LEN + klen + vlen;
+}
+
+inline uint32_t pack_align(uint32_t len) {
+  return (len + KVS_VALUE_LENGTH_ALIGNMENT_UNIT - 1) & ~(KVS_VALUE_LENGTH_ALIGNMENT_UNIT - 1);
+}
+
+void pack_container_key(uint64_t cid, uint8_t *buf, kvs_key *key) {
+  uint64_t be_cid = htobe64(cid);
+  memcpy(buf, PACK_KEY_PREFIX, sizeof(PACK_KEY_PREFIX));
+  memcpy(buf + sizeof(PACK_KEY_PREFIX), &be_cid, 8);
+  key->key = buf;
+  key->length = PACK_KEY_LEN;
+}
+
+void pack_encode_header(uint8_t *buf, uint32_t used, uint32_t count) {
+  uint32_t u32; uint16_t u16;
+  u32 = htole32(PACK_CONTAINER_MAGIC); memcpy(buf + 0, &u32, 4);
+  u16 = htole16(PACK_VERSION);         memcpy(buf + 4, &u16, 2);
+  memset(buf + 6, 0, 2);
+  u32 = htole32(used);                 memcpy(buf + 8, &u32, 4);
+  u32 = htole32(count);                memcpy(buf + 12, &u32, 4);
+}
+
+bool pack_decode_header(const uint8_t *buf, uint32_t len, uint32_t *used) {
+  uint32_t u32; uint16_t u16;
+  if (len < PACK_HEADER_LEN) return false;
+  memcpy(&u32, buf + 0, 4);
+  if (le32toh(u32) != PACK_CONTAINER_MAGIC) return false;
+  memcpy(&u16, buf + 4, 2);
+  if (le16toh(u16) != PACK_VERSION) return false;
+  memcpy(&u32, buf + 8, 4);
+  *used = le32toh(u32);
+  return *used >= PACK_HEADER_LEN && *used <= len;
+}
+
+// parses the entry at off, returns false at the end of the entries
+bool pack_decode_entry(const uint8_t *buf, uint32_t used, uint32_t off,
+    uint8_t *type, uint8_t *klen, uint16_t *vlen) {
+  if (off + PACK_ENTRY_HEADER_LEN > used) return false;
+  uint16_t u16;
+  *type = buf[off];
+  *klen = buf[off + 1];
+  memcpy(&u16, buf + off + 2, 2);
+  *vlen = le16toh(u16);
+  return off + pack_entry_len(*klen, *vlen) <= used;
+}
+
+inline bool pack_loc_equal(const pack_loc &a, const pack_loc &b) {
+  return a.cid == b.cid && a.off == b.off;
+}
+
+// copies the value of a PUT entry with the offset semantics of the drivers
+kvs_result pack_copy_value(const uint8_t *entry, const std::string &key, kvs_value *value) {
+  uint16_t u16;
+  memcpy(&u16, entry + 2, 2);
+  uint32_t vlen = le16toh(u16);
+  if (entry[0] != PACK_ENTRY_PUT || entry[1] != key.size() ||
+      memcmp(entry + PACK_ENTRY_HEADER_LEN, key.data(), key.size()) != 0)
+    return KVS_ERR_KEY_NOT_EXIST;
+  if (value->offset != 0 && value->offset >= vlen)
+    return KVS_ERR_VALUE_OFFSET_INVALID;
+
+  uint32_t remain = vlen - value->offset;
+  uint32_t copylen = remain < value->length ? remain : value->length;
+  kvs_result ret = value->length < remain ? KVS_ERR_BUFFER_SMALL : KVS_SUCCESS;
+  memcpy(value->value, entry + PACK_ENTRY_HEADER_LEN + key.size() + value->offset, copylen);
+  value->length = copylen;
+  value->actual_value_size = remain;
+  return ret;
+}
+
+} // namespace
+
+struct pack_op {
+  KvsPacker *owner;
+  kvs_context context;
+  bool internal;              // a compaction, owned by the packer
+  uint64_t cid;               // container being compacted
+  kvs_key *key;               // arguments of the caller, passed back to post_fn
+  kvs_value *value;
+  kvs_option_store store_opt;
+  kvs_option_retrieve retrieve_opt;
+  kvs_option_delete delete_opt;
+  void *private1;
+  void *private2;
+  kvs_postprocess_function post_fn;   // NULL for a synchronous caller
+  uint32_t refs;              // outstanding entry writes and device commands
+  kvs_result result;
+  bool done;
+
+  // a read of a container from the device
+  pack_loc loc;
+  uint32_t base;              // container offset of rbuf
+  uint8_t *rbuf;
+  uint8_t ckeybuf[PACK_KEY_LEN];
+  kvs_key ckey;
+  kvs_value cvalue;
+
+  pack_op(KvsPacker *owner_, kvs_context context_, const kvs_key *key_, kvs_value *value_,
+      void *private1_, void *private2_, kvs_postprocess_function post_fn_):
+    owner(owner_), context(context_), internal(false), cid(0),
+    key(const_cast<kvs_key*>(key_)), value(value_),
+    private1(private1_), private2(private2_), post_fn(post_fn_),
+    refs(0), result(KVS_SUCCESS), done(false), base(0), rbuf(NULL) {
+    store_opt.st_type = KVS_STORE_POST;
+    store_opt.assoc = NULL;
+    retrieve_opt.kvs_retrieve_delete = false;
+    delete_opt.kvs_delete_error = false;
+    loc.cid = 0;
+    loc.off = 0;
+    loc.len = 0;
+  }
+
+  ~pack_op() {
+    if (rbuf) kvs_free(rbuf);
+  }
+};
+
+struct pack_buffer {
+  KvsPacker *owner;
+  uint64_t cid;
+  uint8_t *data;              // container image
+  uint8_t *wbuf;              // image of the write in flight
+  uint32_t used;
+  uint32_t count;
+  bool sealed;                // no more entries are appended
+  bool flushing;
+  bool urgent;                // a caller is waiting, write without delay
+  std::vector<pack_pending> pending;    // entries not written yet
+  std::vector<pack_pending> inflight;   // entries covered by the write in flight
+  uint8_t keybuf[PACK_KEY_LEN];
+  kvs_key key;
+  kvs_value value;
+};
+
+KvsPacker::KvsPacker(kvs_key_space_handle ks_hd_, const kvs_option_packing *opt):
+  ks_hd(ks_hd_), syncio(_env_sync_io_only()), polling(_env_is_polling()),
+  stop(false), closing(false), compaction_busy(false), open_buf(NULL),
+  next_cid(1), durable_limit(1), outstanding(0) {
+  container_size = (opt && opt->container_size) ? opt->container_size : KVS_PACK_CONTAINER_LENGTH;
+  max_value_len = (opt && opt->max_value_len) ? opt->max_value_len : KVS_PACK_MAX_VALUE_LENGTH;
+  threshold = (opt && opt->compaction_threshold) ? opt->compaction_threshold :
+    KVS_PACK_COMPACTION_THRESHOLD;
+  flush_delay_us = (opt && opt->flush_delay_us) ? opt->flush_delay_us : KVS_PACK_FLUSH_DELAY_US;
+  read_size = container_size;
+}
+
+KvsPacker::~KvsPacker() {
+  for (auto b : buffers) {
+    kvs_free(b->data);
+    kvs_free(b->wbuf);
+    delete b;
+  }
+}
+
+kvs_result KvsPacker::check_option(const kvs_option_packing *opt) {
+  if (opt == NULL) return KVS_SUCCESS;
+  uint32_t csize = opt->container_size ? opt->container_size : KVS_PACK_CONTAINER_LENGTH;
+  uint32_t vlen = opt->max_value_len ? opt->max_value_len : KVS_PACK_MAX_VALUE_LENGTH;
+  if ((csize & (KVS_ALIGNMENT_UNIT - 1)) || csize > KVS_MAX_VALUE_LENGTH)
+    return KVS_ERR_OPTION_INVALID;
+  if (vlen > UINT16_MAX ||
+      pack_entry_len(KVS_MAX_KEY_LENGTH, vlen) > csize - PACK_HEADER_LEN)
+    return KVS_ERR_OPTION_INVALID;
+  if (opt->compaction_threshold > 100)
+    return KVS_ERR_OPTION_INVALID;
+  return KVS_SUCCESS;
+}
+
+bool KvsPacker::packable(const kvs_key *key, const kvs_value *value) const {
+  return value->offset == 0 && value->length <= max_value_len;
+}
+
+/*
+ * Open and close
+ */
+
+kvs_result KvsPacker::read_directory(uint64_t *low, uint64_t *limit, uint32_t *csize) {
+  char name[16];
+  int len = snprintf(name, sizeof(name), "\xffpackdir%u", ks_hd->keyspace_id);
+  kvs_key key = {name, (uint16_t)len};
+  uint8_t *buf = (uint8_t*)kvs_zalloc(PACK_DIRECTORY_LEN, PAGE_ALIGN);
+  if (buf == NULL) return KVS_ERR_SYS_IO;
+
+  kvs_value value = {buf, PACK_DIRECTORY_LEN, 0, 0};
+  kvs_option_retrieve option = {false};
+  kvs_result ret = _sync_io_to_meta_keyspace(ks_hd->dev, &key, &value, &option, KVS_CMD_RETRIEVE);
+  if (ret == KVS_ERR_KEY_NOT_EXIST) {
+    *low = *limit = 1;
+    *csize = 0;
+    ret = KVS_SUCCESS;
+  } else if (ret == KVS_SUCCESS) {
+    uint32_t u32; uint64_t u64;
+    memcpy(&u32, buf, 4);
+    if (le32toh(u32) != PACK_DIRECTORY_MAGIC) {
+      ret = KVS_ERR_SYS_IO;
+    } else {
+      memcpy(&u64, buf + 8, 8);  *low = le64toh(u64);
+      memcpy(&u64, buf + 16, 8); *limit = le64toh(u64);
+      memcpy(&u32, buf + 24, 4); *csize = le32toh(u32);
+    }
+  }
+  kvs_free(buf);
+  return ret;
+}
+
+kvs_result KvsPacker::write_directory(uint64_t low, uint64_t limit) {
+  char name[16];
+  int len = snprintf(name, sizeof(name), "\xffpackdir%u", ks_hd->keyspace_id);
+  kvs_key key = {name, (uint16_t)len};
+  uint8_t *buf = (uint8_t*)kvs_zalloc(PACK_DIRECTORY_LEN, PAGE_ALIGN);
+  if (buf == NULL) return KVS_ERR_SYS_IO;
+
+  uint32_t u32; uint16_t u16; uint64_t u64;
+  u32 = htole32(PACK_DIRECTORY_MAGIC); memcpy(buf + 0, &u32, 4);
+  u16 = htole16(PACK_VERSION);         memcpy(buf + 4, &u16, 2);
+  u64 = htole64(low);                  memcpy(buf + 8, &u64, 8);
+  u64 = htole64(limit);                memcpy(buf + 16, &u64, 8);
+  u32 = htole32(read_size);            memcpy(buf + 24, &u32, 4);
+
+  kvs_value value = {buf, PACK_DIRECTORY_LEN, 0, 0};
+  kvs_option_store option = {KVS_STORE_POST, NULL};
+  kvs_result ret = _sync_io_to_meta_keyspace(ks_hd->dev, &key, &value, &option, KVS_CMD_STORE);
+  kvs_free(buf);
+  return ret;
+}
+
+kvs_result KvsPacker::container_io(kvs_context op, uint64_t cid, uint8_t *buf, uint32_t *len) {
+  uint8_t keybuf[PACK_KEY_LEN];
+  kvs_key key;
+  pack_container_key(cid, keybuf, &key);
+  kvs_value value = {buf, len ? *len : 0, 0, 0};
+  kvs_option_store store_opt = {KVS_STORE_POST, NULL};
+  kvs_option_retrieve retrieve_opt = {false};
+  kvs_option_delete delete_opt = {false};
+  void *option = (op == KVS_CMD_STORE) ? (void*)&store_opt :
+    (op == KVS_CMD_RETRIEVE) ? (void*)&retrieve_opt : (void*)&delete_opt;
+
+  kvs_result ret = _sync_io_to_key_space(ks_hd, &key, op == KVS_CMD_DELETE ? NULL : &value,
+    option, op);
+  if (len) *len = value.length;
+  return ret;
+}
+
+// replays the entries of a container into the index
+kvs_result KvsPacker::load_container(uint64_t cid, uint8_t *buf) {
+  uint32_t len = read_size;
+  kvs_result ret = container_io(KVS_CMD_RETRIEVE, cid, buf, &len);
+  if (ret == KVS_ERR_KEY_NOT_EXIST) return KVS_SUCCESS;
+  if (ret != KVS_SUCCESS) return ret;
+
+  uint32_t used;
+  if (!pack_decode_header(buf, len, &used)) {
+    fprintf(stderr, "WARN: packing container %lu of key space %s is corrupted, skipped\n",
+      (unsigned long)cid, ks_hd->name);
+    return KVS_SUCCESS;
+  }
+
+  pack_container &c = containers[cid];
+  c.live = 0;
+  c.total = used - PACK_HEADER_LEN;
+  c.readers = 0;
+  c.compacting = false;
+  c.delete_pending = false;
+  c.buf = NULL;
+
+  uint8_t type, klen;
+  uint16_t vlen;
+  for (uint32_t off = PACK_HEADER_LEN; pack_decode_entry(buf, used, off, &type, &klen, &vlen);
+       off += pack_entry_len(klen, vlen)) {
+    if (type != PACK_ENTRY_PUT && type != PACK_ENTRY_DEL) continue;
+    std::string k((const char*)buf + off + PACK_ENTRY_HEADER_LEN, klen);
+    auto it = index.find(k);
+    if (it != index.end())
+      containers[it->second.cid].live -= pack_entry_len(klen, it->second.len);
+
+    if (type == PACK_ENTRY_PUT) {
+      pack_loc loc = {cid, off, vlen};
+      index[k] = loc;
+      c.live += pack_entry_len(klen, vlen);
+    } else if (it != index.end()) {
+      index.erase(it);
+    }
+  }
+  return KVS_SUCCESS;
+}
+
+kvs_result KvsPacker::open() {
+  uint64_t low, limit;
+  uint32_t csize;
+  kvs_result ret = read_directory(&low, &limit, &csize);
+  if (ret != KVS_SUCCESS) return ret;
+  if (csize > read_size) read_size = csize;
+
+  uint8_t *buf = (uint8_t*)kvs_malloc(read_size, PAGE_ALIGN);
+  if (buf == NULL) return KVS_ERR_SYS_IO;
+  for (uint64_t cid = low; cid < limit; cid++) {
+    ret = load_container(cid, buf);
+    if (ret != KVS_SUCCESS) {
+      fprintf(stderr, "WARN: failed to load packing container %lu of key space %s: 0x%x\n",
+        (unsigned long)cid, ks_hd->name, ret);
+      break;
+    }
+  }
+  kvs_free(buf);
+  if (ret != KVS_SUCCESS) return ret;
+
+  next_cid = limit;
+  ret = write_directory(containers.empty() ? next_cid : containers.begin()->first,
+    next_cid + PACK_CID_BLOCK);
+  if (ret != KVS_SUCCESS) return ret;
+  durable_limit = next_cid + PACK_CID_BLOCK;
+
+  for (auto &t : containers) check_compaction(t.first);
+  bg = std::thread(&KvsPacker::background, this);
+  return KVS_SUCCESS;
+}
+
+kvs_result KvsPacker::close() {
+  std::unique_lock<std::mutex> guard(lock);
+  closing = true;
+  candidates.clear();
+  if (open_buf) {
+    seal(open_buf);
+    open_buf = NULL;
+  }
+  for (auto b : buffers) b->urgent = true;
+  bg_cond.notify_one();
+  while (!buffers.empty() || outstanding > 0) wait_locked(guard);
+
+  stop = true;
+  bg_cond.notify_one();
+  guard.unlock();
+  bg.join();
+
+  // the background thread has stopped, containers can be deleted in place
+  for (auto cid : reclaim) {
+    if (container_io(KVS_CMD_DELETE, cid, NULL, NULL) == KVS_SUCCESS)
+      containers.erase(cid);
+  }
+  reclaim.clear();
+  return write_directory(containers.empty() ? next_cid : containers.begin()->first, next_cid);
+}
+
+/*
+ * Container buffers
+ */
+
+pack_buffer *KvsPacker::new_buffer() {
+  pack_buffer *b = new pack_buffer();
+  b->data = (uint8_t*)kvs_zalloc(container_size, PAGE_ALIGN);
+  b->wbuf = (uint8_t*)kvs_malloc(container_size, PAGE_ALIGN);
+  if (b->data == NULL || b->wbuf == NULL) {
+    if (b->data) kvs_free(b->data);
+    if (b->wbuf) kvs_free(b->wbuf);
+    delete b;
+    return NULL;
+  }
+  b->owner = this;
+  b->cid = next_cid++;
+  b->used = PACK_HEADER_LEN;
+  b->count = 0;
+  b->sealed = false;
+  b->flushing = false;
+  b->urgent = false;
+  pack_container_key(b->cid, b->keybuf, &b->key);
+
+  pack_container c = {0, 0, 0, false, false, b};
+  containers[b->cid] = c;
+  buffers.insert(b);
+  // let the background thread reserve more container ids ahead of time
+  if (next_cid + PACK_CID_BLOCK / 2 > durable_limit) bg_cond.notify_one();
+  return b;
+}
+
+void KvsPacker::drop_buffer(pack_buffer *b) {
+  auto c = containers.find(b->cid);
+  if (c != containers.end()) c->second.buf = NULL;
+  buffers.erase(b);
+  kvs_free(b->data);
+  kvs_free(b->wbuf);
+  delete b;
+  if (c != containers.end()) check_compaction(c->first);
+  cond.notify_all();
+}
+
+void KvsPacker::seal(pack_buffer *b) {
+  b->sealed = true;
+  b->urgent = true;
+  if (!b->flushing && b->pending.empty()) drop_buffer(b);
+  else bg_cond.notify_one();
+}
+
+// marks the version at loc as dead
+void KvsPacker::kill(const std::string &key, const pack_loc &loc) {
+  auto c = containers.find(loc.cid);
+  if (c == containers.end()) return;
+  c->second.live -= pack_entry_len(key.size(), loc.len);
+  check_compaction(loc.cid);
+}
+
+void KvsPacker::check_compaction(uint64_t cid) {
+  auto t = containers.find(cid);
+  if (t == containers.end() || closing) return;
+  pack_container &c = t->second;
+  if (c.buf || c.compacting || c.delete_pending || c.total == 0) return;
+  if ((uint64_t)(c.total - c.live) * 100 >= (uint64_t)threshold * c.total) {
+    candidates.insert(cid);
+    bg_cond.notify_one();
+  }
+}
+
+/*
+ * Appends an entry to the open container. A PUT entry becomes live, the
+ * version at old (if any) becomes dead. The caller updates the index.
+ */
+pack_buffer *KvsPacker::append(uint8_t type, const std::string &key, const void *value,
+    uint32_t vlen, pack_op *op, const pack_loc &old, pack_loc *loc) {
+  uint32_t len = pack_entry_len(key.size(), vlen);
+  if (open_buf && open_buf->used + len > container_size) {
+    seal(open_buf);
+    open_buf = NULL;
+  }
+  if (open_buf == NULL) {
+    open_buf = new_buffer();
+    if (open_buf == NULL) return NULL;
+  }
+
+  pack_buffer *b = open_buf;
+  uint8_t *e = b->data + b->used;
+  uint16_t u16 = htole16((uint16_t)vlen);
+  e[0] = type;
+  e[1] = (uint8_t)key.size();
+  memcpy(e + 2, &u16, 2);
+  memcpy(e + PACK_ENTRY_HEADER_LEN, key.data(), key.size());
+  if (vlen) memcpy(e + PACK_ENTRY_HEADER_LEN + key.size(), value, vlen);
+
+  pack_pending p = {op, key, b->used, old};
+  b->pending.push_back(p);
+  if (op) {
+    op->refs++;
+    if (op->post_fn == NULL || op->internal) b->urgent = true;
+  }
+
+  pack_container &c = containers[b->cid];
+  c.total += len;
+  if (type == PACK_ENTRY_PUT) c.live += len;
+  if (old.cid) kill(key, old);
+
+  loc->cid = b->cid;
+  loc->off = b->used;
+  loc->len = vlen;
+  b->used += len;
+  b->count++;
+  return b;
+}
+
+// reverts an entry whose write failed
+void KvsPacker::undo(pack_buffer *b, const pack_pending &p) {
+  if (p.off == PACK_NO_ENTRY) return;
+  uint8_t *e = b->data + p.off;
+  uint8_t type = e[0];
+  uint16_t u16;
+  memcpy(&u16, e + 2, 2);
+  pack_loc loc = {b->cid, p.off, le16toh(u16)};
+  e[0] = PACK_ENTRY_DEAD;
+
+  auto old = containers.find(p.old.cid);
+  bool old_valid = p.old.cid != 0 && old != containers.end() && !old->second.delete_pending;
+  auto it = index.find(p.key);
+  if (type == PACK_ENTRY_PUT) {
+    if (it == index.end() || !pack_loc_equal(it->second, loc)) return;
+    kill(p.key, loc);
+    if (old_valid) {
+      it->second = p.old;
+      old->second.live += pack_entry_len(p.key.size(), p.old.len);
+    } else {
+      index.erase(it);
+    }
+  } else if (type == PACK_ENTRY_DEL && it == index.end() && old_valid) {
+    index[p.key] = p.old;
+    old->second.live += pack_entry_len(p.key.size(), p.old.len);
+  }
+}
+
+// takes a snapshot of a buffer for a write, called with the lock held
+bool KvsPacker::prepare_flush(pack_buffer *b) {
+  if (b->flushing || b->pending.empty() || b->cid >= durable_limit) return false;
+  b->flushing = true;
+  b->urgent = false;
+  b->inflight.swap(b->pending);
+
+  uint32_t len = pack_align(b->used);
+  memcpy(b->wbuf, b->data, b->used);
+  memset(b->wbuf + b->used, 0, len - b->used);
+  pack_encode_header(b->wbuf, b->used, b->count);
+  b->value.value = b->wbuf;
+  b->value.length = len;
+  b->value.actual_value_size = 0;
+  b->value.offset = 0;
+  return true;
+}
+
+void KvsPacker::submit_flush(pack_buffer *b) {
+  kvs_option_store option = {KVS_STORE_POST, NULL};
+  KvsDriver *driver = ks_hd->dev->driver;
+  int32_t ret;
+  if (syncio) {
+    ret = driver->store_tuple(ks_hd, &b->key, &b->value, option, NULL, NULL, true, NULL);
+  } else {
+    ret = driver->store_tuple(ks_hd, &b->key, &b->value, option, b, NULL, false,
+      KvsPacker::on_flush_complete);
+    if (ret == KVS_SUCCESS) return;
+  }
+
+  std::vector<pack_op*> ready;
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    finish_write(b, (kvs_result)ret, ready);
+  }
+  complete(ready);
+}
+
+void KvsPacker::on_flush_complete(kvs_postprocess_context *ctx) {
+  pack_buffer *b = (pack_buffer*)ctx->private1;
+  KvsPacker *packer = b->owner;
+  std::vector<pack_op*> ready;
+  {
+    std::unique_lock<std::mutex> guard(packer->lock);
+    packer->finish_write(b, ctx->result, ready);
+  }
+  packer->complete(ready);
+}
+
+void KvsPacker::finish_write(pack_buffer *b, kvs_result res, std::vector<pack_op*> &ready) {
+  if (res != KVS_SUCCESS)
+    fprintf(stderr, "WARN: packing container %lu write failed: 0x%x\n", (unsigned long)b->cid, res);
+
+  b->flushing = false;
+  for (auto &p : b->inflight) {
+    if (res != KVS_SUCCESS) undo(b, p);
+    if (p.op) release(p.op, res, ready);
+  }
+  b->inflight.clear();
+
+  if (!b->pending.empty()) {
+    // writes are not submitted from a completion context
+    if (b->urgent) bg_cond.notify_one();
+  } else if (b->sealed) {
+    drop_buffer(b);
+  }
+}
+
+void KvsPacker::kick(pack_buffer *b, bool can_submit, std::vector<pack_buffer*> &go) {
+  if (!b->urgent) return;
+  if (can_submit && prepare_flush(b)) go.push_back(b);
+  else bg_cond.notify_one();
+}
+
+/*
+ * Operations
+ */
+
+void KvsPacker::release(pack_op *op, kvs_result res, std::vector<pack_op*> &ready) {
+  if (res != KVS_SUCCESS && op->result == KVS_SUCCESS) op->result = res;
+  if (--op->refs == 0) ready.push_back(op);
+}
+
+// completes operations whose writes are done, called without the lock held
+void KvsPacker::complete(std::vector<pack_op*> &ready) {
+  for (auto op : ready) {
+    if (op->internal) {
+      std::unique_lock<std::mutex> guard(lock);
+      auto c = containers.find(op->cid);
+      if (op->result == KVS_SUCCESS) {
+        reclaim.push_back(op->cid);
+      } else if (c != containers.end()) {
+        c->second.compacting = false;
+      }
+      compaction_busy = false;
+      outstanding--;
+      bg_cond.notify_one();
+      cond.notify_all();
+      guard.unlock();
+      delete op;
+    } else if (op->post_fn) {
+      kvs_postprocess_context ctx;
+      memset(&ctx, 0, sizeof(ctx));
+      ctx.context = op->context;
+      ctx.ks_hd = ks_hd;
+      ctx.key = op->key;
+      ctx.value = op->value;
+      ctx.option = (op->context == KVS_CMD_STORE) ? (void*)&op->store_opt :
+        (op->context == KVS_CMD_RETRIEVE) ? (void*)&op->retrieve_opt : (void*)&op->delete_opt;
+      ctx.private1 = op->private1;
+      ctx.private2 = op->private2;
+      ctx.result = op->result;
+      op->post_fn(&ctx);
+
+      std::unique_lock<std::mutex> guard(lock);
+      outstanding--;
+      cond.notify_all();
+      guard.unlock();
+      delete op;
+    } else {
+      std::unique_lock<std::mutex> guard(lock);
+      op->done = true;
+      cond.notify_all();
+    }
+  }
+  ready.clear();
+}
+
+void KvsPacker::wait_locked(std::unique_lock<std::mutex> &guard) {
+  if (polling) {
+    guard.unlock();
+    ks_hd->dev->driver->process_completions(_env_queue_depth());
+    guard.lock();
+  } else {
+    cond.wait(guard);
+  }
+}
+
+// waits for a synchronous operation and frees it
+kvs_result KvsPacker::wait(pack_op *op) {
+  std::unique_lock<std::mutex> guard(lock);
+  while (!op->done) wait_locked(guard);
+  kvs_result ret = op->result;
+  outstanding--;
+  cond.notify_all();
+  guard.unlock();
+  delete op;
+  return ret;
+}
+
+/*
+ * Runs the device command of a store or delete of a packed key, the packed
+ * version is deleted by a tombstone once the command succeeded.
+ */
+kvs_result KvsPacker::forward(pack_op *op) {
+  KvsDriver *driver = ks_hd->dev->driver;
+  bool sync = (op->post_fn == NULL);
+  void *p1 = sync ? NULL : op;
+  kvs_postprocess_function cbfn = sync ? NULL : KvsPacker::on_forward_complete;
+  int32_t ret;
+
+  op->refs = 1;
+  if (op->context == KVS_CMD_STORE)
+    ret = driver->store_tuple(ks_hd, op->key, op->value, op->store_opt, p1, NULL, sync, cbfn);
+  else
+    ret = driver->delete_tuple(ks_hd, op->key, op->delete_opt, p1, NULL, sync, cbfn);
+
+  if (!sync && ret != KVS_SUCCESS) {
+    std::unique_lock<std::mutex> guard(lock);
+    outstanding--;
+    cond.notify_all();
+    guard.unlock();
+    delete op;
+    return (kvs_result)ret;
+  }
+  if (sync) forward_done(op, (kvs_result)ret, true);
+  return sync ? wait(op) : KVS_SUCCESS;
+}
+
+void KvsPacker::on_forward_complete(kvs_postprocess_context *ctx) {
+  pack_op *op = (pack_op*)ctx->private1;
+  op->owner->forward_done(op, ctx->result, false);
+}
+
+void KvsPacker::forward_done(pack_op *op, kvs_result res, bool can_submit) {
+  std::vector<pack_op*> ready;
+  std::vector<pack_buffer*> go;
+  if (op->context == KVS_CMD_DELETE && res == KVS_ERR_KEY_NOT_EXIST) res = KVS_SUCCESS;
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    if (res == KVS_SUCCESS) {
+      std::string k((const char*)op->key->key, op->key->length);
+      auto it = index.find(k);
+      if (it != index.end()) {
+        pack_loc old = it->second, loc;
+        uint64_t be_cid = htobe64(old.cid);
+        pack_buffer *b = append(PACK_ENTRY_DEL, k, &be_cid, sizeof(be_cid), op, old, &loc);
+        if (b) {
+          index.erase(it);
+          kick(b, can_submit, go);
+        } else {
+          res = KVS_ERR_SYS_IO;
+        }
+      }
+    }
+    release(op, res, ready);
+  }
+  for (auto b : go) submit_flush(b);
+  complete(ready);
+}
+
+kvs_result KvsPacker::store(const kvs_key *key, const kvs_value *value, const kvs_option_store *opt,
+    void *private1, void *private2, bool sync, kvs_postprocess_function post_fn) {
+  KvsDriver *driver = ks_hd->dev->driver;
+  std::string k((const char*)key->key, key->length);
+  std::vector<pack_buffer*> go;
+  bool small = packable(key, value);
+
+  std::unique_lock<std::mutex> guard(lock);
+  auto it = index.find(k);
+  if (it == index.end() && (!small || opt->st_type != KVS_STORE_POST)) {
+    guard.unlock();
+    return (kvs_result)driver->store_tuple(ks_hd, key, value, *opt, private1, private2, sync, post_fn);
+  }
+  if (it != index.end()) {
+    if (opt->st_type == KVS_STORE_NOOVERWRITE) return KVS_ERR_VALUE_UPDATE_NOT_ALLOWED;
+    if (opt->st_type == KVS_STORE_APPEND) return KVS_ERR_OPTION_INVALID;
+  }
+
+  pack_op *op = new pack_op(this, KVS_CMD_STORE, key, const_cast<kvs_value*>(value),
+    private1, private2, sync ? NULL : post_fn);
+  op->store_opt = *opt;
+  outstanding++;
+  if (!small) {
+    // the key exists, so the device command is a plain overwrite
+    op->store_opt.st_type = KVS_STORE_POST;
+    guard.unlock();
+    return forward(op);
+  }
+
+  pack_loc old = {0, 0, 0}, loc;
+  if (it != index.end()) old = it->second;
+  pack_buffer *b = append(PACK_ENTRY_PUT, k, value->value, value->length, op, old, &loc);
+  if (b == NULL) {
+    outstanding--;
+    guard.unlock();
+    delete op;
+    return KVS_ERR_SYS_IO;
+  }
+  index[k] = loc;
+  kick(b, true, go);
+  guard.unlock();
+
+  for (auto t : go) submit_flush(t);
+  return sync ? wait(op) : KVS_SUCCESS;
+}
+
+kvs_result KvsPacker::remove(const kvs_key *key, const kvs_option_delete *opt,
+    void *private1, void *private2, bool sync, kvs_postprocess_function post_fn) {
+  KvsDriver *driver = ks_hd->dev->driver;
+  std::string k((const char*)key->key, key->length);
+
+  std::unique_lock<std::mutex> guard(lock);
+  if (index.find(k) == index.end()) {
+    guard.unlock();
+    return (kvs_result)driver->delete_tuple(ks_hd, key, *opt, private1, private2, sync, post_fn);
+  }
+  // a stale unpacked version may exist on the device, delete it first
+  pack_op *op = new pack_op(this, KVS_CMD_DELETE, key, NULL, private1, private2,
+    sync ? NULL : post_fn);
+  op->delete_opt.kvs_delete_error = false;
+  outstanding++;
+  guard.unlock();
+  return forward(op);
+}
+
+kvs_result KvsPacker::retrieve(const kvs_key *key, kvs_value *value, const kvs_option_retrieve *opt,
+    void *private1, void *private2, bool sync, kvs_postprocess_function post_fn) {
+  KvsDriver *driver = ks_hd->dev->driver;
+  std::string k((const char*)key->key, key->length);
+
+  std::unique_lock<std::mutex> guard(lock);
+  auto it = index.find(k);
+  if (it == index.end()) {
+    guard.unlock();
+    return (kvs_result)driver->retrieve_tuple(ks_hd, key, value, *opt, private1, private2,
+      sync, post_fn);
+  }
+  if (opt->kvs_retrieve_delete) return KVS_ERR_OPTION_INVALID;
+
+  pack_loc loc = it->second;
+  pack_container &c = containers[loc.cid];
+  if (c.buf) {
+    kvs_result ret = pack_copy_value(c.buf->data + loc.off, k, value);
+    if (sync) return ret;
+    // the callback is not invoked from the caller's context
+    pack_op *op = new pack_op(this, KVS_CMD_RETRIEVE, key, value, private1, private2, post_fn);
+    op->retrieve_opt = *opt;
+    op->result = ret;
+    outstanding++;
+    deferred.push_back(op);
+    bg_cond.notify_one();
+    return KVS_SUCCESS;
+  }
+
+  // read the container from the aligned offset before the entry to its end
+  pack_op *op = new pack_op(this, KVS_CMD_RETRIEVE, key, value, private1, private2,
+    sync ? NULL : post_fn);
+  op->retrieve_opt = *opt;
+  op->loc = loc;
+  op->base = loc.off & ~(KVS_ALIGNMENT_UNIT - 1);
+  op->rbuf = (uint8_t*)kvs_malloc(read_size - op->base, PAGE_ALIGN);
+  if (op->rbuf == NULL) {
+    guard.unlock();
+    delete op;
+    return KVS_ERR_SYS_IO;
+  }
+  pack_container_key(loc.cid, op->ckeybuf, &op->ckey);
+  op->cvalue.value = op->rbuf;
+  op->cvalue.length = read_size - op->base;
+  op->cvalue.actual_value_size = 0;
+  op->cvalue.offset = op->base;
+  op->refs = 1;
+  c.readers++;
+  outstanding++;
+  guard.unlock();
+
+  kvs_option_retrieve option = {false};
+  if (sync) {
+    int32_t ret = driver->retrieve_tuple(ks_hd, &op->ckey, &op->cvalue, option, NULL, NULL,
+      true, NULL);
+    read_done(op, (kvs_result)ret);
+    return wait(op);
+  }
+  int32_t ret = driver->retrieve_tuple(ks_hd, &op->ckey, &op->cvalue, option, op, NULL,
+    false, KvsPacker::on_read_complete);
+  if (ret != KVS_SUCCESS) {
+    // the submission failed, nothing is reported through the callback
+    op->post_fn = NULL;
+    read_done(op, (kvs_result)ret);
+    wait(op);
+  }
+  return (kvs_result)ret;
+}
+
+void KvsPacker::on_read_complete(kvs_postprocess_context *ctx) {
+  pack_op *op = (pack_op*)ctx->private1;
+  op->owner->read_done(op, ctx->result);
+}
+
+void KvsPacker::read_done(pack_op *op, kvs_result res) {
+  std::vector<pack_op*> ready;
+  std::string k((const char*)op->key->key, op->key->length);
+  if (res == KVS_SUCCESS) {
+    uint32_t at = op->loc.off - op->base;
+    uint32_t end = at + pack_entry_len(k.size(), op->loc.len);
+    if (op->cvalue.length < end) res = KVS_ERR_SYS_IO;
+    else res = pack_copy_value(op->rbuf + at, k, op->value);
+  }
+
+  std::unique_lock<std::mutex> guard(lock);
+  auto c = containers.find(op->loc.cid);
+  if (c != containers.end() && --c->second.readers == 0 && c->second.delete_pending) {
+    reclaim.push_back(op->loc.cid);
+    bg_cond.notify_one();
+  }
+  release(op, res, ready);
+  guard.unlock();
+  complete(ready);
+}
+
+kvs_result KvsPacker::exist(uint32_t key_cnt, const kvs_key *keys, kvs_exist_list *list,
+    void *private1, void *private2, bool sync, kvs_postprocess_function post_fn) {
+  KvsDriver *driver = ks_hd->dev->driver;
+  if (sync) {
+    std::vector<bool> hits(key_cnt);
+    uint32_t nhit = 0;
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      for (uint32_t i = 0; i < key_cnt; i++) {
+        hits[i] = index.count(std::string((const char*)keys[i].key, keys[i].length)) != 0;
+        if (hits[i]) nhit++;
+      }
+    }
+    if (nhit != key_cnt) {
+      int32_t ret = driver->exist_tuple(ks_hd, key_cnt, keys, list, private1, private2, true, NULL);
+      if (ret != KVS_SUCCESS) return (kvs_result)ret;
+    } else {
+      memset(list->result_buffer, 0, (key_cnt + 7) / 8);
+    }
+    for (uint32_t i = 0; i < key_cnt; i++)
+      if (hits[i]) list->result_buffer[i / 8] |= (1 << (i % 8));
+    return KVS_SUCCESS;
+  }
+
+  pack_op *op = new pack_op(this, KVS_CMD_EXIST, NULL, NULL, private1, private2, post_fn);
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    outstanding++;
+  }
+  int32_t ret = driver->exist_tuple(ks_hd, key_cnt, keys, list, op, NULL, false,
+    KvsPacker::on_exist_complete);
+  if (ret != KVS_SUCCESS) {
+    std::unique_lock<std::mutex> guard(lock);
+    outstanding--;
+    cond.notify_all();
+    guard.unlock();
+    delete op;
+  }
+  return (kvs_result)ret;
+}
+
+void KvsPacker::on_exist_complete(kvs_postprocess_context *ctx) {
+  pack_op *op = (pack_op*)ctx->private1;
+  KvsPacker *packer = op->owner;
+  kvs_exist_list *list = ctx->result_buffer.list;
+  if (ctx->result == KVS_SUCCESS && list) {
+    std::unique_lock<std::mutex> guard(packer->lock);
+    for (uint32_t i = 0; i < list->num_keys; i++) {
+      std::string k((const char*)list->keys[i].key, list->keys[i].length);
+      if (packer->index.count(k)) list->result_buffer[i / 8] |= (1 << (i % 8));
+    }
+  }
+  ctx->private1 = op->private1;
+  ctx->private2 = op->private2;
+  op->post_fn(ctx);
+
+  std::unique_lock<std::mutex> guard(packer->lock);
+  packer->outstanding--;
+  packer->cond.notify_all();
+  guard.unlock();
+  delete op;
+}
+
+void KvsPacker::for_each_key(const std::function<void(const std::string &key)> &fn) {
+  std::unique_lock<std::mutex> guard(lock);
+  for (const auto &e : index)
+    fn(e.first);
+}
+
+kvs_result KvsPacker::flush() {
+  pack_op *op = new pack_op(this, KVS_CMD_STORE, NULL, NULL, NULL, NULL, NULL);
+  std::vector<pack_buffer*> go;
+  std::unique_lock<std::mutex> guard(lock);
+  for (auto b : buffers) {
+    pack_pending p = {op, std::string(), PACK_NO_ENTRY, {0, 0, 0}};
+    if (!b->pending.empty()) b->pending.push_back(p);
+    else if (b->flushing) b->inflight.push_back(p);
+    else continue;
+    op->refs++;
+    b->urgent = true;
+    if (prepare_flush(b)) go.push_back(b);
+  }
+  if (op->refs == 0) {
+    guard.unlock();
+    delete op;
+    return KVS_SUCCESS;
+  }
+  outstanding++;
+  bg_cond.notify_one();
+  guard.unlock();
+
+  for (auto b : go) submit_flush(b);
+  return wait(op);
+}
+
+/*
+ * Background thread
+ */
+
+void KvsPacker::compact(uint64_t cid) {
+  uint32_t len = read_size;
+  uint8_t *img = (uint8_t*)kvs_malloc(read_size, PAGE_ALIGN);
+  kvs_result ret = img ? container_io(KVS_CMD_RETRIEVE, cid, img, &len) : KVS_ERR_SYS_IO;
+
+  std::vector<pack_op*> ready;
+  std::vector<pack_buffer*> go;
+  std::unique_lock<std::mutex> guard(lock);
+  uint32_t used = PACK_HEADER_LEN;
+  if (ret == KVS_ERR_KEY_NOT_EXIST) {
+    // the container was never written
+    ret = KVS_SUCCESS;
+  } else if (ret == KVS_SUCCESS && !pack_decode_header(img, len, &used)) {
+    ret = KVS_ERR_SYS_IO;
+  }
+  if (ret != KVS_SUCCESS) {
+    fprintf(stderr, "WARN: failed to compact packing container %lu: 0x%x\n", (unsigned long)cid, ret);
+    containers[cid].compacting = false;
+    compaction_busy = false;
+    guard.unlock();
+    if (img) kvs_free(img);
+    return;
+  }
+
+  pack_op *op = new pack_op(this, KVS_CMD_STORE, NULL, NULL, NULL, NULL, NULL);
+  op->internal = true;
+  op->cid = cid;
+  op->refs = 1;
+  outstanding++;
+
+  uint8_t type, klen;
+  uint16_t vlen;
+  for (uint32_t off = PACK_HEADER_LEN; pack_decode_entry(img, used, off, &type, &klen, &vlen);
+       off += pack_entry_len(klen, vlen)) {
+    std::string k((const char*)img + off + PACK_ENTRY_HEADER_LEN, klen);
+    const uint8_t *v = img + off + PACK_ENTRY_HEADER_LEN + klen;
+    auto it = index.find(k);
+    pack_buffer *b = NULL;
+    pack_loc loc;
+
+    if (type == PACK_ENTRY_PUT) {
+      pack_loc cur = {cid, off, vlen};
+      if (it == index.end() || !pack_loc_equal(it->second, cur)) continue;
+      b = append(PACK_ENTRY_PUT, k, v, vlen, op, cur, &loc);
+      if (b) it->second = loc;
+    } else if (type == PACK_ENTRY_DEL && it == index.end()) {
+      // keep the tombstone while an older container may hold a version of the key
+      uint64_t prev;
+      memcpy(&prev, v, sizeof(prev));
+      prev = be64toh(prev);
+      bool older = false;
+      for (auto c = containers.begin(); c != containers.end() && c->first <= prev; ++c) {
+        if (c->first != cid) {
+          older = true;
+          break;
+        }
+      }
+      if (!older) continue;
+      pack_loc none = {0, 0, 0};
+      b = append(PACK_ENTRY_DEL, k, v, vlen, op, none, &loc);
+    } else {
+      continue;
+    }
+    if (b == NULL) {
+      op->result = KVS_ERR_SYS_IO;
+      break;
+    }
+    b->urgent = true;
+  }
+  for (auto b : buffers) {
+    if (b->urgent && prepare_flush(b)) go.push_back(b);
+  }
+  release(op, KVS_SUCCESS, ready);
+  guard.unlock();
+
+  kvs_free(img);
+  for (auto b : go) submit_flush(b);
+  complete(ready);
+}
+
+void KvsPacker::background() {
+  std::unique_lock<std::mutex> guard(lock);
+  auto last_sweep = std::chrono::steady_clock::now();
+  while (!stop) {
+    // reserve container ids ahead of the open container
+    if (next_cid + PACK_CID_BLOCK / 2 > durable_limit) {
+      uint64_t low = containers.empty() ? next_cid : containers.begin()->first;
+      uint64_t limit = next_cid + PACK_CID_BLOCK;
+      guard.unlock();
+      kvs_result ret = write_directory(low, limit);
+      guard.lock();
+      if (ret == KVS_SUCCESS) {
+        if (limit > durable_limit) durable_limit = limit;
+      } else {
+        fprintf(stderr, "WARN: failed to update packing directory of key space %s: 0x%x\n",
+          ks_hd->name, ret);
+      }
+    }
+
+    // callbacks of reads that were served from memory
+    if (!deferred.empty()) {
+      std::vector<pack_op*> ready;
+      ready.swap(deferred);
+      guard.unlock();
+      complete(ready);
+      guard.lock();
+    }
+
+    // delete compacted containers that are not being read
+    while (!reclaim.empty()) {
+      uint64_t cid = reclaim.back();
+      reclaim.pop_back();
+      auto c = containers.find(cid);
+      if (c == containers.end()) continue;
+      c->second.delete_pending = true;
+      if (c->second.readers > 0) continue;
+      guard.unlock();
+      kvs_result ret = container_io(KVS_CMD_DELETE, cid, NULL, NULL);
+      guard.lock();
+      if (ret == KVS_SUCCESS || ret == KVS_ERR_KEY_NOT_EXIST) {
+        containers.erase(cid);
+      } else {
+        fprintf(stderr, "WARN: failed to delete packing container %lu: 0x%x\n",
+          (unsigned long)cid, ret);
+      }
+      cond.notify_all();
+    }
+
+    // write containers, all of them once per flush delay
+    auto now = std::chrono::steady_clock::now();
+    bool sweep = now - last_sweep >= std::chrono::microseconds(flush_delay_us);
+    if (sweep) last_sweep = now;
+    std::vector<pack_buffer*> go;
+    for (auto b : buffers) {
+      if ((sweep || b->urgent) && prepare_flush(b)) go.push_back(b);
+    }
+    if (!go.empty()) {
+      guard.unlock();
+      for (auto b : go) submit_flush(b);
+      guard.lock();
+      continue;
+    }
+
+    if (!compaction_busy && !closing && !candidates.empty()) {
+      uint64_t cid = *candidates.begin();
+      candidates.erase(candidates.begin());
+      auto c = containers.find(cid);
+      if (c != containers.end() && !c->second.buf && !c->second.compacting &&
+          !c->second.delete_pending) {
+        c->second.compacting = true;
+        compaction_busy = true;
+        guard.unlock();
+        compact(cid);
+        guard.lock();
+      }
+      continue;
+    }
+
+    if (stop || !reclaim.empty() || !deferred.empty()) continue;
+    bool dirty = false;
+    for (auto b : buffers) dirty = dirty || !b->pending.empty();
+    if (polling && outstanding > 0) {
+      guard.unlock();
+      ks_hd->dev->driver->process_completions(_env_queue_depth());
+      guard.lock();
+    } else if (dirty) {
+      bg_cond.wait_for(guard, std::chrono::microseconds(flush_delay_us));
+    } else {
+      bg_cond.wait(guard);
+    }
+  }
+}
+
+/*
+ * Public interfaces
+ */
+
+kvs_result kvs_enable_packing(kvs_key_space_handle ks_hd, kvs_option_packing *opt) {
+  kvs_result ret = _check_key_space_handle(ks_hd);
+  if (ret != KVS_SUCCESS) return ret;
+  if (ks_hd->packer) return KVS_ERR_OPTION_INVALID;
+  ret = KvsPacker::check_option(opt);
+  if (ret != KVS_SUCCESS) return ret;
+
+  KvsPacker *packer = new KvsPacker(ks_hd, opt);
+  ret = packer->open();
+  if (ret != KVS_SUCCESS) {
+    fprintf(stderr, "Enable packing failed. error code:0x%x.\n", ret);
+    delete packer;
+    return ret;
+  }
+  ks_hd->packer = packer;
+  return KVS_SUCCESS;
+}
+
+kvs_result kvs_disable_packing(kvs_key_space_handle ks_hd) {
+  kvs_result ret = _check_key_space_handle(ks_hd);
+  if (ret != KVS_SUCCESS) return ret;
+  if (ks_hd->packer == NULL) return KVS_SUCCESS;
+
+  ret = ks_hd->packer->close();
+  delete ks_hd->packer;
+  ks_hd->packer = NULL;
+  return ret;
+}
+
+kvs_result kvs_flush_packing(kvs_key_space_handle ks_hd) {
+  kvs_result ret = _check_key_space_handle(ks_hd);
+  if (ret != KVS_SUCCESS) return ret;
+  if (ks_hd->packer == NULL) return KVS_SUCCESS;
+  return ks_hd->packer->flush();
+}
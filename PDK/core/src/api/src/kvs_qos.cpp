@@ -0,0 +1,400 @@
+/**
+ *   BSD LICENSE
+ *
+ *   Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Samsung Electronics Co., Ltd. nor the names of
+ *       its contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Host QoS scheduler, see kvs_qos.h
+ *
+ * Everything but the driver calls runs under the scheduler lock. Queued
+ * commands are only submitted by the dispatcher thread, never from a
+ * completion, so a driver that completes in the submitting thread can't
+ * recurse into the scheduler.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include "kvs_utils.h"
+#include "kvs_qos.h"
+
+thread_local kvs_qos_class KvsScheduler::thread_class = KVS_QOS_INHERIT;
+
+// refills the buckets and tells whether a command of bytes may go, or else
+// how long until it may
+static bool _tenant_ready(KvsQosTenant *t, uint64_t bytes, uint64_t now, uint64_t *wait_ns) {
+  if (!t) return true;
+  if (now > t->refill_ns) {
+    double dt = (double)(now - t->refill_ns);
+    t->iops_tokens = std::min(t->iops_burst, t->iops_tokens + dt * t->iops_rate);
+    t->bw_tokens = std::min(t->bw_burst, t->bw_tokens + dt * t->bw_rate);
+    t->refill_ns = now;
+  }
+  double wait = 0;
+  // a command larger than the burst goes once the bucket is full, the
+  // tokens it overdraws delay the next ones
+  if (t->iops_rate > 0 && t->iops_tokens < std::min(1.0, t->iops_burst))
+    wait = (std::min(1.0, t->iops_burst) - t->iops_tokens) / t->iops_rate;
+  if (t->bw_rate > 0 && t->bw_tokens < std::min((double)bytes, t->bw_burst))
+    wait = std::max(wait, (std::min((double)bytes, t->bw_burst) - t->bw_tokens) / t->bw_rate);
+  if (wait == 0) return true;
+  *wait_ns = (uint64_t)wait + 1;
+  return false;
+}
+
+static void _tenant_charge(KvsQosTenant *t, uint64_t bytes) {
+  if (!t) return;
+  if (t->iops_rate > 0) t->iops_tokens -= 1;
+  if (t->bw_rate > 0) t->bw_tokens -= (double)bytes;
+}
+
+KvsScheduler::KvsScheduler(KvsDriver *driver_): driver(driver_), vtime(0), cap(0),
+  inflight(0), queued(0), stop(false) {
+  for (int c = 0; c < KVS_QOS_CLASSES; c++) {
+    weight[c] = QOS_DEFAULT_WEIGHTS[c];
+    class_cap[c] = 0;
+    class_inflight[c] = 0;
+    pass[c] = 0;
+  }
+  worker = std::thread(&KvsScheduler::run, this);
+}
+
+KvsScheduler::~KvsScheduler() {
+  std::unique_lock<std::mutex> lk(lock);
+  stop = true;
+  cond.notify_all();
+  lk.unlock();
+  worker.join();
+
+  lk.lock();
+  while (inflight > 0)
+    idle_cond.wait(lk);
+  for (qos_op *op : free_ops)
+    delete op;
+}
+
+void KvsScheduler::configure(const kvs_qos_option *opt) {
+  std::unique_lock<std::mutex> lk(lock);
+  cap = opt->max_inflight;
+  for (int c = 0; c < KVS_QOS_CLASSES; c++) {
+    weight[c] = opt->classes[c].weight ? opt->classes[c].weight : QOS_DEFAULT_WEIGHTS[c];
+    class_cap[c] = opt->classes[c].max_inflight;
+  }
+  // raised caps may let queued commands go
+  cond.notify_all();
+}
+
+void KvsScheduler::configure(kvs_key_space_handle ks_hd, const kvs_option_key_space_qos *opt) {
+  std::unique_lock<std::mutex> lk(lock);
+  KvsQosTenant *t = ks_hd->qos;
+  if (!t) {
+    t = new KvsQosTenant();
+    ks_hd->qos = t;
+  }
+  uint32_t burst_ms = opt->burst_ms ? opt->burst_ms : KVS_QOS_BURST_MS;
+  t->qos_class = opt->qos_class;
+  t->iops_rate = opt->iops_limit / 1e9;
+  t->bw_rate = opt->bandwidth_limit / 1e9;
+  // at least one command fits in the buckets
+  t->iops_burst = std::max(1.0, t->iops_rate * burst_ms * 1e6);
+  t->bw_burst = std::max(1.0, t->bw_rate * burst_ms * 1e6);
+  t->iops_tokens = t->iops_burst;
+  t->bw_tokens = t->bw_burst;
+  t->refill_ns = kvs_stats_now();
+  cond.notify_all();
+}
+
+void KvsScheduler::release(kvs_key_space_handle ks_hd) {
+  std::unique_lock<std::mutex> lk(lock);
+  delete ks_hd->qos;
+  ks_hd->qos = NULL;
+}
+
+bool KvsScheduler::admit(qos_op *op, uint64_t now, uint64_t *wait_ns) {
+  if (cap && inflight >= cap) return false;
+  if (class_cap[op->cls] && class_inflight[op->cls] >= class_cap[op->cls]) return false;
+  return _tenant_ready(op->ks_hd->qos, op->bytes, now, wait_ns);
+}
+
+KvsScheduler::qos_op *KvsScheduler::pick(uint64_t now, uint64_t *wait_ns) {
+  int best = -1;
+  for (int c = 0; c < KVS_QOS_CLASSES; c++) {
+    if (queue[c].empty()) continue;
+    uint64_t wait = 0;
+    if (!admit(queue[c].front(), now, &wait)) {
+      if (wait && (*wait_ns == 0 || wait < *wait_ns)) *wait_ns = wait;
+      continue;
+    }
+    if (best < 0 || pass[c] < pass[best]) best = c;
+  }
+  if (best < 0) return NULL;
+
+  qos_op *op = queue[best].front();
+  queue[best].pop_front();
+  queued--;
+  vtime = pass[best];
+  pass[best] += QOS_STRIDE / weight[best];
+  _tenant_charge(op->ks_hd->qos, op->bytes);
+  inflight++;
+  class_inflight[best]++;
+  driver->stats.record_queue(best, op->bytes, now - op->enqueue_ns);
+  return op;
+}
+
+int32_t KvsScheduler::submit(qos_op *op) {
+  kvs_key_space_handle ks_hd = op->ks_hd;
+  kvs_qos_class cls = thread_class;
+  if (cls == KVS_QOS_INHERIT && ks_hd->qos) cls = ks_hd->qos->qos_class;
+  op->cls = (cls < KVS_QOS_CLASSES) ? cls : KVS_QOS_NORMAL;
+
+  std::unique_lock<std::mutex> lk(lock);
+  uint64_t now = kvs_stats_now();
+  uint64_t wait = 0;
+  // commands go straight to the driver as long as none waits, otherwise
+  // the dispatcher keeps the weights
+  if (queued == 0 && admit(op, now, &wait)) {
+    _tenant_charge(ks_hd->qos, op->bytes);
+    inflight++;
+    class_inflight[op->cls]++;
+    lk.unlock();
+    driver->stats.record_queue(op->cls, op->bytes, 0);
+    int32_t ret = issue(op);
+    if (ret != KVS_SUCCESS || op->syncio) complete(op);
+    return ret;
+  }
+
+  op->enqueue_ns = now;
+  op->dispatched = false;
+  if (queue[op->cls].empty())
+    pass[op->cls] = std::max(pass[op->cls], vtime);
+  queue[op->cls].push_back(op);
+  queued++;
+  cond.notify_one();
+  if (!op->syncio) return KVS_SUCCESS;
+
+  while (!op->dispatched)
+    sync_cond.wait(lk);
+  lk.unlock();
+  int32_t ret = issue(op);
+  complete(op);
+  return ret;
+}
+
+int32_t KvsScheduler::issue(qos_op *op) {
+  void *p1 = op->syncio ? op->private1 : op;
+  void *p2 = op->syncio ? op->private2 : NULL;
+  kvs_postprocess_function fn = op->syncio ? op->post_fn : on_complete;
+  switch (op->cmd) {
+    case KVS_CMD_STORE:
+      return driver->store_tuple(op->ks_hd, op->key, op->value, op->option.store,
+        p1, p2, op->syncio, fn, op->req_ctx);
+    case KVS_CMD_RETRIEVE:
+      return driver->retrieve_tuple(op->ks_hd, op->key, op->value, op->option.retrieve,
+        p1, p2, op->syncio, fn, op->req_ctx);
+    case KVS_CMD_DELETE:
+      return driver->delete_tuple(op->ks_hd, op->key, op->option.remove,
+        p1, p2, op->syncio, fn, op->req_ctx);
+    case KVS_CMD_EXIST:
+      return driver->exist_tuple(op->ks_hd, op->key_cnt, op->key, op->list,
+        p1, p2, op->syncio, fn, op->req_ctx);
+    case KVS_CMD_ITER_NEXT:
+      return driver->iterator_next(op->ks_hd, op->hiter, op->iter_list,
+        p1, p2, op->syncio, fn);
+    default:
+      return KVS_ERR_OPTION_INVALID;
+  }
+}
+
+void KvsScheduler::complete(qos_op *op) {
+  std::unique_lock<std::mutex> lk(lock);
+  inflight--;
+  class_inflight[op->cls]--;
+  if (!op->syncio) free_ops.push_back(op);
+  if (queued) cond.notify_one();
+  if (stop && inflight == 0) idle_cond.notify_all();
+}
+
+void KvsScheduler::on_complete(kvs_postprocess_context *ctx) {
+  qos_op *op = (qos_op*)ctx->private1;
+  ctx->private1 = op->private1;
+  ctx->private2 = op->private2;
+  op->post_fn(ctx);
+  op->owner->complete(op);
+}
+
+void KvsScheduler::run() {
+  std::unique_lock<std::mutex> lk(lock);
+  while (!stop || queued) {
+    uint64_t wait = 0;
+    qos_op *op = queued ? pick(kvs_stats_now(), &wait) : NULL;
+    if (!op) {
+      if (wait)
+        cond.wait_for(lk, std::chrono::nanoseconds(wait));
+      else
+        cond.wait(lk);
+      continue;
+    }
+    if (op->syncio) {
+      op->dispatched = true;
+      sync_cond.notify_all();
+      continue;
+    }
+
+    lk.unlock();
+    int32_t ret = issue(op);
+    if (ret != KVS_SUCCESS) {
+      // the caller already returned, it learns of the failure like of any
+      // other completion
+      kvs_postprocess_context ctx;
+      memset(&ctx, 0, sizeof(ctx));
+      ctx.context = op->cmd;
+      ctx.ks_hd = op->ks_hd;
+      ctx.key = (kvs_key*)op->key;
+      ctx.value = op->value;
+      ctx.private1 = op->private1;
+      ctx.private2 = op->private2;
+      ctx.result = (kvs_result)ret;
+      ctx.iter_hd = op->hiter;
+      if (op->cmd == KVS_CMD_ITER_NEXT)
+        ctx.result_buffer.iter_list = op->iter_list;
+      else if (op->cmd == KVS_CMD_EXIST)
+        ctx.result_buffer.list = op->list;
+      op->post_fn(&ctx);
+      complete(op);
+    }
+    lk.lock();
+  }
+}
+
+KvsScheduler::qos_op *KvsScheduler::get_op(bool syncio, qos_op *stack_op) {
+  if (syncio) {
+    memset(stack_op, 0, sizeof(qos_op));
+    stack_op->syncio = true;
+    return stack_op;
+  }
+  qos_op *op = NULL;
+  {
+    std::unique_lock<std::mutex> lk(lock);
+    if (!free_ops.empty()) {
+      op = free_ops.back();
+      free_ops.pop_back();
+    }
+  }
+  if (!op) op = new qos_op();
+  memset(op, 0, sizeof(qos_op));
+  op->owner = this;
+  return op;
+}
+
+int32_t KvsScheduler::store_tuple(kvs_key_space_handle ks_hd, const kvs_key *key,
+  const kvs_value *value, kvs_option_store option, void *private1, void *private2,
+  bool syncio, kvs_postprocess_function post_fn, void *req_ctx) {
+  qos_op sop;
+  qos_op *op = get_op(syncio, &sop);
+  op->cmd = KVS_CMD_STORE;
+  op->ks_hd = ks_hd;
+  op->key = key;
+  op->value = (kvs_value*)value;
+  op->option.store = option;
+  op->bytes = value->length;
+  op->private1 = private1;
+  op->private2 = private2;
+  op->post_fn = post_fn;
+  op->req_ctx = req_ctx;
+  return submit(op);
+}
+
+int32_t KvsScheduler::retrieve_tuple(kvs_key_space_handle ks_hd, const kvs_key *key,
+  kvs_value *value, kvs_option_retrieve option, void *private1, void *private2,
+  bool syncio, kvs_postprocess_function post_fn, void *req_ctx) {
+  qos_op sop;
+  qos_op *op = get_op(syncio, &sop);
+  op->cmd = KVS_CMD_RETRIEVE;
+  op->ks_hd = ks_hd;
+  op->key = key;
+  op->value = value;
+  op->option.retrieve = option;
+  op->bytes = value->length;
+  op->private1 = private1;
+  op->private2 = private2;
+  op->post_fn = post_fn;
+  op->req_ctx = req_ctx;
+  return submit(op);
+}
+
+int32_t KvsScheduler::delete_tuple(kvs_key_space_handle ks_hd, const kvs_key *key,
+  kvs_option_delete option, void *private1, void *private2, bool syncio,
+  kvs_postprocess_function post_fn, void *req_ctx) {
+  qos_op sop;
+  qos_op *op = get_op(syncio, &sop);
+  op->cmd = KVS_CMD_DELETE;
+  op->ks_hd = ks_hd;
+  op->key = key;
+  op->option.remove = option;
+  op->private1 = private1;
+  op->private2 = private2;
+  op->post_fn = post_fn;
+  op->req_ctx = req_ctx;
+  return submit(op);
+}
+
+int32_t KvsScheduler::exist_tuple(kvs_key_space_handle ks_hd, uint32_t key_cnt,
+  const kvs_key *keys, kvs_exist_list *list, void *private1, void *private2,
+  bool syncio, kvs_postprocess_function post_fn, void *req_ctx) {
+  qos_op sop;
+  qos_op *op = get_op(syncio, &sop);
+  op->cmd = KVS_CMD_EXIST;
+  op->ks_hd = ks_hd;
+  op->key = keys;
+  op->key_cnt = key_cnt;
+  op->list = list;
+  op->private1 = private1;
+  op->private2 = private2;
+  op->post_fn = post_fn;
+  op->req_ctx = req_ctx;
+  return submit(op);
+}
+
+int32_t KvsScheduler::iterator_next(kvs_key_space_handle ks_hd, kvs_iterator_handle hiter,
+  kvs_iterator_list *iter_list, void *private1, void *private2, bool syncio,
+  kvs_postprocess_function post_fn) {
+  qos_op sop;
+  qos_op *op = get_op(syncio, &sop);
+  op->cmd = KVS_CMD_ITER_NEXT;
+  op->ks_hd = ks_hd;
+  op->hiter = hiter;
+  op->iter_list = iter_list;
+  op->bytes = iter_list->size;
+  op->private1 = private1;
+  op->private2 = private2;
+  op->post_fn = post_fn;
+  return submit(op);
+}
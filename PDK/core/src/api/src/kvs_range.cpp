@@ -0,0 +1,337 @@
+/**
+ *   BSD LICENSE
+ *
+ *   Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Samsung Electronics Co., Ltd. nor the names of
+ *       its contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Multi-range retrieve
+ *
+ * kvs_retrieve_kvp_ranges() reads several byte ranges of one value. A
+ * driver that serves ranged reads natively (the emulator) gets the ranges
+ * in a single command. Otherwise the ranges are sorted by offset and
+ * coalesced into device reads: a read starts at the range offset rounded
+ * down to KVS_ALIGNMENT_UNIT and absorbs every following range that starts
+ * within KVS_RANGE_COALESCE_GAP bytes of its end, so that a few disjoint
+ * columns of a large value cost a few commands of roughly their own size.
+ * A read that serves one aligned range lands in the caller's buffer, the
+ * others share one bounce buffer that is copied out on completion. The
+ * reads go through kvs_retrieve_kvp_async(), hence packed key spaces work
+ * as well.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include "kvs_utils.h"
+#include "private_types.h"
+
+namespace {
+
+struct range_op;
+
+// a device read that serves ranges order[first, first + cnt) of its operation
+typedef struct {
+  range_op *op;
+  uint32_t first;
+  uint32_t cnt;
+  kvs_value value;           // offset is the aligned start of the read
+  bool direct;               // the read lands in the buffer of its only range
+  kvs_result result;
+} range_read;
+
+struct range_op {
+  kvs_key_space_handle ks_hd;
+  kvs_value_ranges *ranges;
+  std::vector<uint32_t> order;     // range indexes sorted by offset
+  std::vector<range_read> reads;
+  uint8_t *bounce;
+  kvs_value value;                 // lengths of a native ranged read
+  kvs_option_retrieve opt;
+  void *private1;
+  void *private2;
+  kvs_postprocess_function post_fn;
+  bool sync;
+  std::atomic<uint32_t> pending;   // reads in flight, plus one while submitting
+  std::mutex lock;
+  std::condition_variable cond;
+  bool done;
+  kvs_result result;
+};
+
+kvs_result range_check(kvs_key_space_handle ks_hd, const kvs_key *key,
+    const kvs_option_retrieve *opt, const kvs_value_ranges *ranges) {
+  kvs_result ret = _check_key_space_handle(ks_hd);
+  if (ret != KVS_SUCCESS) return ret;
+  if (key == NULL || opt == NULL || ranges == NULL || ranges->ranges == NULL
+      || ranges->range_cnt == 0 || ranges->range_cnt > KVS_MAX_VALUE_RANGES)
+    return KVS_ERR_PARAM_INVALID;
+  // a deleting read cannot be split into several commands
+  if (opt->kvs_retrieve_delete) return KVS_ERR_OPTION_INVALID;
+
+  for (uint32_t i = 0; i < ranges->range_cnt; i++) {
+    const kvs_value_range *r = &ranges->ranges[i];
+    if (r->value == NULL && r->length > 0) return KVS_ERR_PARAM_INVALID;
+    if ((uint64_t)r->offset + r->length > KVS_MAX_VALUE_LENGTH)
+      return KVS_ERR_VALUE_OFFSET_INVALID;
+  }
+  return (kvs_result)validate_request(key, NULL);
+}
+
+// sorts the ranges and coalesces them into device reads
+kvs_result range_plan(range_op *op) {
+  kvs_value_range *r = op->ranges->ranges;
+  uint32_t cnt = op->ranges->range_cnt;
+  op->order.resize(cnt);
+  for (uint32_t i = 0; i < cnt; i++) op->order[i] = i;
+  std::sort(op->order.begin(), op->order.end(),
+    [r](uint32_t a, uint32_t b) { return r[a].offset < r[b].offset; });
+
+  uint64_t bounce_len = 0;
+  for (uint32_t i = 0; i < cnt; ) {
+    const kvs_value_range *first = &r[op->order[i]];
+    uint32_t start = first->offset & ~(KVS_ALIGNMENT_UNIT - 1);
+    uint32_t end = first->offset + first->length;
+    uint32_t j = i + 1;
+    for (; j < cnt; j++) {
+      const kvs_value_range *next = &r[op->order[j]];
+      if ((uint64_t)(next->offset & ~(KVS_ALIGNMENT_UNIT - 1)) > (uint64_t)end + KVS_RANGE_COALESCE_GAP)
+        break;
+      end = std::max(end, next->offset + next->length);
+    }
+
+    range_read rd;
+    memset(&rd, 0, sizeof(rd));
+    rd.op = op;
+    rd.first = i;
+    rd.cnt = j - i;
+    rd.value.offset = start;
+    rd.value.length = (end - start + KVS_VALUE_LENGTH_ALIGNMENT_UNIT - 1) &
+      ~(KVS_VALUE_LENGTH_ALIGNMENT_UNIT - 1);
+    rd.direct = (rd.cnt == 1 && start == first->offset && rd.value.length == first->length
+      && first->length > 0);
+    if (rd.direct) rd.value.value = first->value;
+    else bounce_len += rd.value.length;
+    op->reads.push_back(rd);
+    i = j;
+  }
+
+  op->bounce = NULL;
+  if (bounce_len > 0) {
+    op->bounce = (uint8_t*)kvs_malloc(bounce_len, PAGE_ALIGN);
+    if (op->bounce == NULL) return KVS_ERR_SYS_IO;
+  }
+  uint8_t *p = op->bounce;
+  for (auto &rd : op->reads) {
+    if (rd.direct) continue;
+    rd.value.value = p;
+    p += rd.value.length;
+  }
+  return KVS_SUCCESS;
+}
+
+// copies the result of the reads to the ranges and sets the result of the operation
+void range_copy_out(range_op *op) {
+  kvs_value_range *r = op->ranges->ranges;
+  kvs_result res = KVS_SUCCESS;
+  uint32_t value_size = 0;
+  for (auto &rd : op->reads) {
+    if (rd.result != KVS_SUCCESS) {
+      if (res == KVS_SUCCESS) res = rd.result;
+      continue;
+    }
+    if (rd.value.length > 0)
+      value_size = std::max(value_size, rd.value.offset + rd.value.actual_value_size);
+    for (uint32_t i = rd.first; i < rd.first + rd.cnt; i++) {
+      kvs_value_range *range = &r[op->order[i]];
+      uint32_t rel = range->offset - rd.value.offset;
+      range->actual_length = (rel < rd.value.length) ?
+        std::min(range->length, rd.value.length - rel) : 0;
+      if (!rd.direct && range->actual_length > 0)
+        memcpy(range->value, (uint8_t*)rd.value.value + rel, range->actual_length);
+    }
+  }
+  op->ranges->actual_value_size = value_size;
+  op->result = res;
+}
+
+void range_notify(range_op *op) {
+  if (op->sync) {
+    std::unique_lock<std::mutex> guard(op->lock);
+    op->done = true;
+    op->cond.notify_all();
+    return;
+  }
+  kvs_postprocess_context ctx;
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.context = KVS_CMD_RETRIEVE;
+  ctx.ks_hd = op->ks_hd;
+  ctx.key = NULL;
+  ctx.value = NULL;
+  ctx.result_buffer.value_ranges = op->ranges;
+  ctx.option = (void*)&op->opt;
+  ctx.private1 = op->private1;
+  ctx.private2 = op->private2;
+  ctx.result = op->result;
+  op->post_fn(&ctx);
+  if (op->bounce) kvs_free(op->bounce);
+  delete op;
+}
+
+void range_put(range_op *op) {
+  if (--op->pending == 0) {
+    range_copy_out(op);
+    range_notify(op);
+  }
+}
+
+void range_set_result(range_read *rd, kvs_result res) {
+  // partial reads of the value are expected, as are reads past its end
+  if (res == KVS_ERR_BUFFER_SMALL) {
+    res = KVS_SUCCESS;
+  } else if (res == KVS_ERR_VALUE_OFFSET_INVALID) {
+    rd->value.length = 0;
+    res = KVS_SUCCESS;
+  }
+  rd->result = res;
+}
+
+void range_on_read_complete(kvs_postprocess_context *ctx) {
+  range_read *rd = (range_read*)ctx->private1;
+  range_set_result(rd, ctx->result);
+  range_put(rd->op);
+}
+
+void range_on_native_complete(kvs_postprocess_context *ctx) {
+  range_op *op = (range_op*)ctx->private1;
+  op->result = ctx->result;
+  op->ranges->actual_value_size = op->value.actual_value_size;
+  range_notify(op);
+}
+
+void range_wait(kvs_key_space_handle ks_hd, range_op *op) {
+  std::unique_lock<std::mutex> guard(op->lock);
+  while (!op->done) {
+    if (_env_is_polling()) {
+      guard.unlock();
+      ks_hd->dev->driver->process_completions(op->reads.size());
+      guard.lock();
+    } else {
+      op->cond.wait(guard);
+    }
+  }
+}
+
+kvs_result range_retrieve(kvs_key_space_handle ks_hd, kvs_key *key, kvs_option_retrieve *opt,
+    kvs_value_ranges *ranges, void *private1, void *private2, bool sync,
+    kvs_postprocess_function post_fn) {
+  kvs_result ret = range_check(ks_hd, key, opt, ranges);
+  if (ret != KVS_SUCCESS) return ret;
+  if (!sync && !_valid_post_fn(post_fn, private2)) return KVS_ERR_PARAM_INVALID;
+
+  range_op *op = new range_op();
+  op->ks_hd = ks_hd;
+  op->ranges = ranges;
+  op->opt = *opt;
+  op->private1 = private1;
+  op->private2 = private2;
+  op->post_fn = post_fn;
+  op->sync = sync;
+  op->done = false;
+  op->bounce = NULL;
+  op->result = KVS_SUCCESS;
+  memset(&op->value, 0, sizeof(op->value));
+
+  // under a QoS scheduler the ranges are split into reads it schedules
+  if (ks_hd->packer == NULL && ks_hd->dev->driver->qos.load(std::memory_order_acquire) == NULL
+      && ks_hd->dev->driver->native_range_read()) {
+    ret = (kvs_result)ks_hd->dev->driver->retrieve_tuple_ranges(ks_hd, key,
+      ranges->ranges, ranges->range_cnt, &op->value, op->opt, op, NULL, sync,
+      sync ? NULL : range_on_native_complete);
+    if (sync && ret == KVS_SUCCESS) ranges->actual_value_size = op->value.actual_value_size;
+    if (sync || ret != KVS_SUCCESS) delete op;
+    return ret;
+  }
+
+  ret = range_plan(op);
+  if (ret != KVS_SUCCESS) {
+    if (op->bounce) kvs_free(op->bounce);
+    delete op;
+    return ret;
+  }
+
+  uint32_t n = op->reads.size();
+  op->pending = n + 1;
+  if (_env_sync_io_only()) {
+    // the asynchronous interface is not served, the reads run one by one
+    for (auto &rd : op->reads)
+      range_set_result(&rd, kvs_retrieve_kvp(ks_hd, key, &op->opt, &rd.value));
+    op->pending -= n;
+  } else {
+    uint32_t i = 0;
+    for (; i < n; i++) {
+      ret = kvs_retrieve_kvp_async(ks_hd, key, &op->opt, &op->reads[i], NULL,
+        &op->reads[i].value, range_on_read_complete);
+      if (ret != KVS_SUCCESS) break;
+    }
+    if (i == 0) {
+      if (op->bounce) kvs_free(op->bounce);
+      delete op;
+      return ret;
+    }
+    // the reads from the failed one on never complete
+    for (uint32_t j = i; j < n; j++) op->reads[j].result = ret;
+    op->pending -= n - i;
+  }
+  range_put(op);
+
+  if (!sync) return KVS_SUCCESS;
+  range_wait(ks_hd, op);
+  ret = op->result;
+  if (op->bounce) kvs_free(op->bounce);
+  delete op;
+  return ret;
+}
+
+} // namespace
+
+kvs_result kvs_retrieve_kvp_ranges(kvs_key_space_handle ks_hd, kvs_key *key,
+    kvs_option_retrieve *opt, kvs_value_ranges *ranges) {
+  return range_retrieve(ks_hd, key, opt, ranges, NULL, NULL, true, NULL);
+}
+
+kvs_result kvs_retrieve_kvp_ranges_async(kvs_key_space_handle ks_hd, kvs_key *key,
+    kvs_option_retrieve *opt, void *private1, void *private2, kvs_value_ranges *ranges,
+    kvs_postprocess_function post_fn) {
+  return range_retrieve(ks_hd, key, opt, ranges, private1, private2, false, post_fn);
+}
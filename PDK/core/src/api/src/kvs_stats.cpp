@@ -0,0 +1,197 @@
+/**
+ *   BSD LICENSE
+ *
+ *   Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Samsung Electronics Co., Ltd. nor the names of
+ *       its contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sched.h>
+#include <errno.h>
+#include <signal.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/sysinfo.h>
+#include <atomic>
+#include "kvs_utils.h"
+#include "private_types.h"
+#include "kvs_stats.h"
+
+static std::atomic<int> stats_seq(0);
+
+static inline int _value_class(uint64_t bytes) {
+  if (bytes < 512) return 0;
+  if (bytes < 4096) return 1;
+  if (bytes < 32 * 1024) return 2;
+  if (bytes < 256 * 1024) return 3;
+  return 4;
+}
+
+static inline int _result_class(kvs_result result) {
+  if (result == KVS_SUCCESS) return 0;
+  if (result == KVS_ERR_KEY_NOT_EXIST) return 1;
+  return 2;
+}
+
+// objects left behind by processes that did not close their devices
+static void _unlink_stale_segments() {
+  DIR *dir = opendir("/dev/shm");
+  if (!dir) return;
+  struct dirent *ent;
+  while ((ent = readdir(dir)) != NULL) {
+    int pid;
+    if (sscanf(ent->d_name, KVS_STATS_SHM_PREFIX "%d.", &pid) != 1) continue;
+    if (kill(pid, 0) != 0 && errno == ESRCH) {
+      char name[300];
+      snprintf(name, sizeof(name), "/%s", ent->d_name);
+      shm_unlink(name);
+    }
+  }
+  closedir(dir);
+}
+
+KvsStats::KvsStats(): seg(NULL), seg_size(0), nshards(0) {
+  shm_name[0] = 0;
+}
+
+KvsStats::~KvsStats() {
+  if (seg) munmap(seg, seg_size);
+  if (shm_name[0]) shm_unlink(shm_name);
+}
+
+void KvsStats::open(const char *dev_path) {
+  int ncpus = get_nprocs_conf();
+  nshards = std::min(std::max(ncpus, 1), KVS_STATS_MAX_SHARDS);
+  seg_size = kvs_stats_segment_size(nshards);
+  if (stats_seq == 0) _unlink_stale_segments();
+
+  // the shards are sparse, pages are only backed once a CPU counts on them
+  snprintf(shm_name, sizeof(shm_name), "/" KVS_STATS_SHM_PREFIX "%d.%d",
+    (int)getpid(), stats_seq++);
+  void *p = MAP_FAILED;
+  int fd = shm_open(shm_name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd >= 0) {
+    if (ftruncate(fd, seg_size) == 0)
+      p = mmap(NULL, seg_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+  }
+  if (p == MAP_FAILED) {
+    if (fd >= 0) shm_unlink(shm_name);
+    WRITE_WARNING("can't publish operation statistics in /dev/shm%s\n", shm_name);
+    shm_name[0] = 0;
+    p = mmap(NULL, seg_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+      seg = NULL;
+      return;
+    }
+  }
+
+  seg = (kvs_stats_segment*)p;
+  seg->stats_size = sizeof(kvs_stats);
+  seg->nshards = nshards;
+  seg->pid = (int32_t)getpid();
+  seg->open_ns = seg->reset_ns = kvs_stats_now();
+  snprintf(seg->dev_path, sizeof(seg->dev_path), "%s", dev_path ? dev_path : "");
+  __atomic_store_n(&seg->magic, KVS_STATS_MAGIC, __ATOMIC_RELEASE);
+}
+
+void KvsStats::record(kvs_context op, kvs_key_space_handle ks_hd, uint64_t bytes,
+  kvs_result result, uint64_t submit_ns) {
+  if (!seg || op < 1 || op > KVS_STATS_OPS) return;
+  uint64_t lat = kvs_stats_now() - submit_ns;
+
+  int cpu = sched_getcpu();
+  kvs_stats *shard = kvs_stats_shard(seg, (cpu > 0) ? cpu % nshards : 0);
+  int ks = ks_hd ? std::min((int)ks_hd->keyspace_id, KVS_STATS_KEY_SPACES - 1) : 0;
+  kvs_stats_cell *cell = &shard->cells[op - 1][ks][_value_class(bytes)][_result_class(result)];
+
+  __atomic_fetch_add(&cell->count, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&cell->bytes, bytes, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&cell->latency_sum_ns, lat, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&cell->latency[kvs_stats_bucket(lat)], 1, __ATOMIC_RELAXED);
+  if ((uint32_t)result < KVS_STATS_RESULTS)
+    __atomic_fetch_add(&shard->results[op - 1][result], 1, __ATOMIC_RELAXED);
+}
+
+void KvsStats::record(const kvs_postprocess_context *iocb, kvs_result result,
+  uint64_t submit_ns) {
+  record(iocb->context, iocb->ks_hd, kvs_stats_io_bytes(iocb), result, submit_ns);
+}
+
+void KvsStats::record_queue(int cls, uint64_t bytes, uint64_t delay_ns) {
+  if (!seg || cls < 0 || cls >= KVS_QOS_CLASSES) return;
+  int cpu = sched_getcpu();
+  kvs_stats *shard = kvs_stats_shard(seg, (cpu > 0) ? cpu % nshards : 0);
+  kvs_stats_cell *cell = &shard->qos[cls];
+
+  __atomic_fetch_add(&cell->count, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&cell->bytes, bytes, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&cell->latency_sum_ns, delay_ns, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&cell->latency[kvs_stats_bucket(delay_ns)], 1, __ATOMIC_RELAXED);
+}
+
+void KvsStats::record_coalesce(bool hit) {
+  if (!seg) return;
+  int cpu = sched_getcpu();
+  kvs_stats *shard = kvs_stats_shard(seg, (cpu > 0) ? cpu % nshards : 0);
+  __atomic_fetch_add(hit ? &shard->coalesce_hits : &shard->coalesce_misses, 1, __ATOMIC_RELAXED);
+}
+
+void KvsStats::record_filter(bool negative) {
+  if (!seg) return;
+  int cpu = sched_getcpu();
+  kvs_stats *shard = kvs_stats_shard(seg, (cpu > 0) ? cpu % nshards : 0);
+  __atomic_fetch_add(negative ? &shard->filter_negatives : &shard->filter_passes, 1, __ATOMIC_RELAXED);
+}
+
+void KvsStats::get(kvs_stats *stats) {
+  if (!seg) {
+    memset(stats, 0, sizeof(kvs_stats));
+    return;
+  }
+  kvs_stats_read(seg, stats);
+}
+
+void KvsStats::reset() {
+  if (!seg) return;
+  std::unique_lock<std::mutex> lock(reset_lock);
+  kvs_stats *now = (kvs_stats*)malloc(sizeof(kvs_stats));
+  if (!now) return;
+
+  // what was counted since the last reset moves into the base
+  kvs_stats_read(seg, now);
+  now->elapsed_ns = 0;
+  uint64_t *base = (uint64_t*)kvs_stats_shard(seg, -1);
+  const uint64_t *delta = (const uint64_t*)now;
+  for (size_t j = 0; j < sizeof(kvs_stats) / sizeof(uint64_t); j++)
+    base[j] += delta[j];
+  seg->reset_ns = kvs_stats_now();
+  free(now);
+}
@@ -0,0 +1,271 @@
+/**
+ *   BSD LICENSE
+ *
+ *   Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Samsung Electronics Co., Ltd. nor the names of
+ *       its contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "kvs_utils.h"
+#include "private_types.h"
+#include "kvs_trace.h"
+
+volatile bool kvs_trace_on = false;
+
+// a ring is written by one thread at a time; the flusher reads it
+struct kvs_trace_ring {
+  kvs_trace_record records[KVS_TRACE_RING_SIZE];
+  uint64_t head;            // records written, published by the owner
+  uint64_t tail;            // records flushed, flusher only
+  uint32_t tid;
+  bool in_use;              // owned by a live thread
+  bool open;                // a record is being written
+};
+
+// gives the ring back when its thread exits, so threads started later
+// reuse it
+struct kvs_trace_owner {
+  kvs_trace_ring *ring;
+  ~kvs_trace_owner() {
+    if (ring) __atomic_store_n(&ring->in_use, false, __ATOMIC_RELEASE);
+  }
+};
+
+static thread_local kvs_trace_owner trace_owner = { NULL };
+
+static std::mutex rings_lock;
+static std::vector<kvs_trace_ring *> rings;
+
+static std::mutex trace_lock;
+static std::condition_variable trace_cond;
+static std::thread *flusher = NULL;
+static bool flusher_stop = false;
+static FILE *trace_fp = NULL;
+static kvs_trace_header trace_hdr;
+static uint64_t start_ns;
+
+static uint64_t _now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static kvs_trace_ring *_get_ring() {
+  std::unique_lock<std::mutex> lock(rings_lock);
+  kvs_trace_ring *ring = NULL;
+  for (kvs_trace_ring *r : rings) {
+    if (!__atomic_load_n(&r->in_use, __ATOMIC_ACQUIRE)) {
+      ring = r;
+      break;
+    }
+  }
+  if (!ring) {
+    ring = (kvs_trace_ring *)calloc(1, sizeof(kvs_trace_ring));
+    if (!ring) return NULL;
+    rings.push_back(ring);
+  }
+  ring->tid = (uint32_t)syscall(SYS_gettid);
+  ring->open = false;
+  ring->in_use = true;
+  trace_owner.ring = ring;
+  return ring;
+}
+
+// word at a time; only needs to tell keys apart in the trace
+static inline uint64_t _key_hash(const kvs_key *key) {
+  const uint8_t *p = (const uint8_t *)key->key;
+  uint32_t len = key->length;
+  uint64_t h = len * 0x9E3779B97F4A7C15ULL;
+  uint64_t w;
+  for (; len >= 8; p += 8, len -= 8) {
+    memcpy(&w, p, 8);
+    h = (h ^ w) * 0xff51afd7ed558ccdULL;
+    h ^= h >> 32;
+  }
+  if (len) {
+    w = 0;
+    memcpy(&w, p, len);
+    h = (h ^ w) * 0xff51afd7ed558ccdULL;
+    h ^= h >> 32;
+  }
+  return h;
+}
+
+kvs_trace_record *_kvs_trace_begin(kvs_context op, kvs_key_space_handle ks_hd,
+  const kvs_key *key, uint64_t bytes, kvs_result result, uint64_t submit_tsc,
+  uint64_t dispatch_tsc, bool sync) {
+  const uint64_t complete_tsc = kvs_trace_tsc();
+  if (!kvs_trace_on) return NULL;
+
+  kvs_trace_ring *ring = trace_owner.ring;
+  if (!ring && !(ring = _get_ring())) return NULL;
+  // a command completed from within a callback is not traced
+  if (ring->open) return NULL;
+  ring->open = true;
+
+  // the slot of head is not published yet; the flusher drops what it
+  // copied from it if head moves past while it reads
+  kvs_trace_record *rec = &ring->records[ring->head & (KVS_TRACE_RING_SIZE - 1)];
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  rec->submit_tsc = submit_tsc;
+  rec->dispatch_tsc = dispatch_tsc;
+  rec->complete_tsc = complete_tsc;
+  rec->key_hash = (key && key->key) ? _key_hash(key) : 0;
+  rec->value_bytes = (bytes < UINT32_MAX) ? (uint32_t)bytes : UINT32_MAX;
+  rec->tid = ring->tid;
+  rec->key_len = key ? key->length : 0;
+  rec->opcode = (uint8_t)op;
+  rec->result = (uint8_t)result;
+  rec->ks_id = ks_hd ? ks_hd->keyspace_id : 0;
+  rec->flags = sync ? KVS_TRACE_SYNC : 0;
+  return rec;
+}
+
+void _kvs_trace_commit() {
+  kvs_trace_ring *ring = trace_owner.ring;
+  __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+  ring->open = false;
+}
+
+// writes out what the rings hold; records that were overwritten before
+// they were copied are dropped
+static void _drain(std::vector<kvs_trace_record> &buf) {
+  std::unique_lock<std::mutex> lock(rings_lock);
+  for (kvs_trace_ring *ring : rings) {
+    const uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t from = ring->tail;
+    if (head - from >= KVS_TRACE_RING_SIZE)
+      from = head - KVS_TRACE_RING_SIZE + 1;
+    if (from >= head) continue;
+
+    buf.clear();
+    for (uint64_t i = from; i < head; i++)
+      buf.push_back(ring->records[i & (KVS_TRACE_RING_SIZE - 1)]);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    const uint64_t now = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t valid = from;
+    if (now - valid >= KVS_TRACE_RING_SIZE)
+      valid = now - KVS_TRACE_RING_SIZE + 1;
+    if (valid > head) valid = head;
+
+    if (valid < head)
+      fwrite(&buf[valid - from], sizeof(kvs_trace_record), head - valid, trace_fp);
+    trace_hdr.records += head - valid;
+    trace_hdr.dropped += valid - ring->tail;
+    ring->tail = head;
+  }
+}
+
+static void _flush_loop() {
+  std::vector<kvs_trace_record> buf;
+  buf.reserve(KVS_TRACE_RING_SIZE);
+  std::unique_lock<std::mutex> lock(trace_lock);
+  while (!flusher_stop) {
+    trace_cond.wait_for(lock, std::chrono::milliseconds(KVS_TRACE_FLUSH_MS));
+    _drain(buf);
+  }
+  // commands that were completing when tracing stopped
+  lock.unlock();
+  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  lock.lock();
+  _drain(buf);
+}
+
+kvs_result kvs_trace_start(const char *path) {
+  if (path == NULL) return KVS_ERR_PARAM_INVALID;
+  std::unique_lock<std::mutex> lock(trace_lock);
+  if (trace_fp) return KVS_ERR_PARAM_INVALID;
+
+  trace_fp = fopen(path, "wb");
+  if (!trace_fp) {
+    WRITE_ERR("can't open the trace file %s\n", path);
+    return KVS_ERR_SYS_IO;
+  }
+  memset(&trace_hdr, 0, sizeof(trace_hdr));
+  trace_hdr.magic = KVS_TRACE_MAGIC;
+  trace_hdr.version = KVS_TRACE_VERSION;
+  trace_hdr.record_size = sizeof(kvs_trace_record);
+  fwrite(&trace_hdr, sizeof(trace_hdr), 1, trace_fp);
+  {
+    // nothing from an earlier trace
+    std::unique_lock<std::mutex> rlock(rings_lock);
+    for (kvs_trace_ring *ring : rings)
+      ring->tail = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  }
+  start_ns = _now_ns();
+  trace_hdr.start_tsc = kvs_trace_tsc();
+  flusher_stop = false;
+  flusher = new std::thread(_flush_loop);
+  kvs_trace_on = true;
+  return KVS_SUCCESS;
+}
+
+kvs_result kvs_trace_stop() {
+  std::unique_lock<std::mutex> lock(trace_lock);
+  if (!trace_fp) return KVS_SUCCESS;
+
+  kvs_trace_on = false;
+  flusher_stop = true;
+  trace_cond.notify_all();
+  lock.unlock();
+  flusher->join();
+  lock.lock();
+  delete flusher;
+  flusher = NULL;
+
+  // the TSC rate over the whole trace, at least 10ms of it
+  uint64_t ns = _now_ns() - start_ns;
+  if (ns < 10000000ULL) {
+    std::this_thread::sleep_for(std::chrono::nanoseconds(10000000ULL - ns));
+    ns = _now_ns() - start_ns;
+  }
+  trace_hdr.tsc_per_ns = (double)(kvs_trace_tsc() - trace_hdr.start_tsc) / ns;
+
+  kvs_result ret = KVS_SUCCESS;
+  if (fseek(trace_fp, 0, SEEK_SET) != 0 ||
+      fwrite(&trace_hdr, sizeof(trace_hdr), 1, trace_fp) != 1)
+    ret = KVS_ERR_SYS_IO;
+  if (fclose(trace_fp) != 0)
+    ret = KVS_ERR_SYS_IO;
+  trace_fp = NULL;
+  if (trace_hdr.dropped)
+    WRITE_WARNING("trace: %lu records dropped, the flusher fell behind\n",
+      (unsigned long)trace_hdr.dropped);
+  return ret;
+}
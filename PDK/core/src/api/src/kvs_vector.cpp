@@ -0,0 +1,276 @@
+/**
+ *   BSD LICENSE
+ *
+ *   Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Samsung Electronics Co., Ltd. nor the names of
+ *       its contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Scatter-gather store and retrieve
+ *
+ * A value described by kvs_value_vec goes to the device without a host
+ * copy when the driver serves vectored IO natively or when its segments
+ * are adjacent in memory and therefore form a single buffer. Otherwise,
+ * e.g. the kernel driver whose passthrough command takes one data buffer,
+ * the segments are gathered into (or scattered from) a bounce buffer and
+ * the operation goes through the contiguous path, which also applies when
+ * the key space packs small values or the store appends.
+ */
+
+#include <string.h>
+#include "kvs_utils.h"
+#include "private_types.h"
+#include "kvs_coalesce.h"
+#include "kvs_filter.h"
+
+namespace {
+
+// a scatter-gather operation in flight
+typedef struct {
+  kvs_value_vec *vec;
+  kvs_value value;           // total length and offset, receives the result lengths
+  uint8_t *bounce;           // contiguous copy of the value, NULL if not used
+  kvs_option_store store_opt;
+  kvs_option_retrieve retrieve_opt;
+  void *private1;
+  void *private2;
+  kvs_postprocess_function post_fn;
+} vec_op;
+
+kvs_result vec_check(kvs_key_space_handle ks_hd, const kvs_key *key,
+    const kvs_value_vec *vec, uint32_t *total) {
+  kvs_result ret = _check_key_space_handle(ks_hd);
+  if (ret != KVS_SUCCESS) return ret;
+  if (key == NULL || vec == NULL || vec->segs == NULL || vec->seg_cnt == 0)
+    return KVS_ERR_PARAM_INVALID;
+
+  uint64_t len = 0;
+  for (uint32_t i = 0; i < vec->seg_cnt; i++) {
+    if (vec->segs[i].value == NULL && vec->segs[i].length > 0)
+      return KVS_ERR_PARAM_INVALID;
+    len += vec->segs[i].length;
+  }
+  if (len > KVS_MAX_VALUE_LENGTH) return KVS_ERR_VALUE_LENGTH_INVALID;
+  *total = (uint32_t)len;
+
+  // the segment buffers were checked above
+  kvs_value v = {(void*)vec->segs, *total, 0, vec->offset};
+  return (kvs_result)validate_request(key, &v);
+}
+
+// whether the segments are adjacent in memory
+bool vec_contiguous(const kvs_value_vec *vec) {
+  const uint8_t *next = (const uint8_t*)vec->segs[0].value + vec->segs[0].length;
+  for (uint32_t i = 1; i < vec->seg_cnt; i++) {
+    if (vec->segs[i].length == 0) continue;
+    if (vec->segs[i].value != next) return false;
+    next += vec->segs[i].length;
+  }
+  return true;
+}
+
+void vec_gather(const kvs_value_vec *vec, uint8_t *dst) {
+  for (uint32_t i = 0; i < vec->seg_cnt; i++) {
+    memcpy(dst, vec->segs[i].value, vec->segs[i].length);
+    dst += vec->segs[i].length;
+  }
+}
+
+void vec_scatter(const kvs_value_vec *vec, const uint8_t *src, uint32_t len) {
+  for (uint32_t i = 0; i < vec->seg_cnt && len > 0; i++) {
+    uint32_t n = vec->segs[i].length < len ? vec->segs[i].length : len;
+    memcpy(vec->segs[i].value, src, n);
+    src += n;
+    len -= n;
+  }
+}
+
+// decides how the operation reaches the driver and prepares the value it works on
+kvs_result vec_prepare(kvs_key_space_handle ks_hd, vec_op *op, uint32_t total, bool store,
+    bool *native) {
+  op->value.value = NULL;
+  op->value.length = total;
+  op->value.actual_value_size = 0;
+  op->value.offset = op->vec->offset;
+  op->bounce = NULL;
+  *native = false;
+  if (vec_contiguous(op->vec)) {
+    op->value.value = op->vec->segs[0].value;
+    return KVS_SUCCESS;
+  }
+  // a QoS scheduler only sees the per-key path, it charges the whole value there
+  if (ks_hd->packer == NULL && !(store && op->store_opt.st_type == KVS_STORE_APPEND)
+      && ks_hd->dev->driver->qos.load(std::memory_order_acquire) == NULL
+      && ks_hd->dev->driver->native_vector_io()) {
+    *native = true;
+    return KVS_SUCCESS;
+  }
+  op->bounce = (uint8_t*)kvs_malloc(total > 0 ? total : 1, PAGE_ALIGN);
+  if (op->bounce == NULL) return KVS_ERR_SYS_IO;
+  if (store) vec_gather(op->vec, op->bounce);
+  op->value.value = op->bounce;
+  return KVS_SUCCESS;
+}
+
+void vec_finish(vec_op *op, kvs_result res, bool retrieve) {
+  if (retrieve && (res == KVS_SUCCESS || res == KVS_ERR_BUFFER_SMALL)) {
+    if (op->bounce) vec_scatter(op->vec, op->bounce, op->value.length);
+    op->vec->length = op->value.length;
+    op->vec->actual_value_size = op->value.actual_value_size;
+  }
+  if (op->bounce) kvs_free(op->bounce);
+}
+
+void vec_complete(kvs_postprocess_context *ctx) {
+  vec_op *op = (vec_op*)ctx->private1;
+  bool retrieve = (ctx->context == KVS_CMD_RETRIEVE);
+  vec_finish(op, ctx->result, retrieve);
+
+  kvs_postprocess_context uctx = *ctx;
+  uctx.value = NULL;
+  uctx.result_buffer.value_vec = op->vec;
+  uctx.option = retrieve ? (void*)&op->retrieve_opt : (void*)&op->store_opt;
+  uctx.private1 = op->private1;
+  uctx.private2 = op->private2;
+  op->post_fn(&uctx);
+  delete op;
+}
+
+vec_op *vec_new(kvs_value_vec *vec, void *private1, void *private2,
+    kvs_postprocess_function post_fn) {
+  vec_op *op = new vec_op();
+  op->vec = vec;
+  op->private1 = private1;
+  op->private2 = private2;
+  op->post_fn = post_fn;
+  return op;
+}
+
+kvs_result vec_store(kvs_key_space_handle ks_hd, kvs_key *key, kvs_value_vec *vec,
+    kvs_option_store *opt, void *private1, void *private2, bool sync,
+    kvs_postprocess_function post_fn) {
+  uint32_t total = 0;
+  kvs_result ret = vec_check(ks_hd, key, vec, &total);
+  if (ret != KVS_SUCCESS) return ret;
+  if (opt == NULL || (!sync && !_valid_post_fn(post_fn, private2))) return KVS_ERR_PARAM_INVALID;
+
+  vec_op *op = vec_new(vec, private1, private2, post_fn);
+  op->store_opt = *opt;
+  bool native;
+  ret = vec_prepare(ks_hd, op, total, true, &native);
+  if (ret != KVS_SUCCESS) {
+    delete op;
+    return ret;
+  }
+
+  if (native) {
+    // kvs_store_kvp() and kvs_store_kvp_async() do this for the other stores
+    void *p1 = op, *p2 = NULL, *write = NULL;
+    kvs_postprocess_function fn = sync ? NULL : vec_complete;
+    if (ks_hd->coalescer) {
+      ks_hd->coalescer->invalidate(key);
+      if (!sync) write = ks_hd->coalescer->wrap_write(key, &p1, &p2, &fn);
+    }
+    _filter_insert(ks_hd, key);
+    ret = (kvs_result)ks_hd->dev->driver->store_tuple_vec(ks_hd, key, vec->segs, vec->seg_cnt,
+      &op->value, op->store_opt, p1, p2, sync, fn);
+    if (sync && ks_hd->coalescer) ks_hd->coalescer->invalidate(key);
+    if (ret != KVS_SUCCESS && write) KvsCoalescer::drop_write(write);
+  } else if (sync) {
+    ret = kvs_store_kvp(ks_hd, key, &op->value, &op->store_opt);
+  } else {
+    ret = kvs_store_kvp_async(ks_hd, key, &op->value, &op->store_opt, op, NULL, vec_complete);
+  }
+  if (sync || ret != KVS_SUCCESS) {
+    vec_finish(op, ret, false);
+    delete op;
+  }
+  return ret;
+}
+
+kvs_result vec_retrieve(kvs_key_space_handle ks_hd, kvs_key *key, kvs_option_retrieve *opt,
+    kvs_value_vec *vec, void *private1, void *private2, bool sync,
+    kvs_postprocess_function post_fn) {
+  uint32_t total = 0;
+  kvs_result ret = vec_check(ks_hd, key, vec, &total);
+  if (ret != KVS_SUCCESS) return ret;
+  if (opt == NULL || (!sync && !_valid_post_fn(post_fn, private2))) return KVS_ERR_PARAM_INVALID;
+  if (total & (KVS_VALUE_LENGTH_ALIGNMENT_UNIT - 1)) return KVS_ERR_PARAM_INVALID;
+
+  vec_op *op = vec_new(vec, private1, private2, post_fn);
+  op->retrieve_opt = *opt;
+  bool native;
+  ret = vec_prepare(ks_hd, op, total, false, &native);
+  if (ret != KVS_SUCCESS) {
+    delete op;
+    return ret;
+  }
+
+  if (native && _filter_excludes(ks_hd, key)) {
+    // kvs_retrieve_kvp() does this for the other retrieves
+    ret = sync ? KVS_ERR_KEY_NOT_EXIST : ks_hd->filter->complete(KVS_CMD_RETRIEVE, key,
+      &op->value, NULL, op, NULL, vec_complete);
+  } else if (native) {
+    ret = (kvs_result)ks_hd->dev->driver->retrieve_tuple_vec(ks_hd, key, vec->segs, vec->seg_cnt,
+      &op->value, op->retrieve_opt, op, NULL, sync, sync ? NULL : vec_complete);
+  } else if (sync) {
+    ret = kvs_retrieve_kvp(ks_hd, key, &op->retrieve_opt, &op->value);
+  } else {
+    ret = kvs_retrieve_kvp_async(ks_hd, key, &op->retrieve_opt, op, NULL, &op->value,
+      vec_complete);
+  }
+  if (sync || ret != KVS_SUCCESS) {
+    vec_finish(op, ret, true);
+    delete op;
+  }
+  return ret;
+}
+
+} // namespace
+
+kvs_result kvs_store_kvpv(kvs_key_space_handle ks_hd, kvs_key *key, kvs_value_vec *value,
+    kvs_option_store *opt) {
+  return vec_store(ks_hd, key, value, opt, NULL, NULL, true, NULL);
+}
+
+kvs_result kvs_store_kvpv_async(kvs_key_space_handle ks_hd, kvs_key *key, kvs_value_vec *value,
+    kvs_option_store *opt, void *private1, void *private2, kvs_postprocess_function post_fn) {
+  return vec_store(ks_hd, key, value, opt, private1, private2, false, post_fn);
+}
+
+kvs_result kvs_retrieve_kvpv(kvs_key_space_handle ks_hd, kvs_key *key,
+    kvs_option_retrieve *opt, kvs_value_vec *value) {
+  return vec_retrieve(ks_hd, key, opt, value, NULL, NULL, true, NULL);
+}
+
+kvs_result kvs_retrieve_kvpv_async(kvs_key_space_handle ks_hd, kvs_key *key,
+    kvs_option_retrieve *opt, void *private1, void *private2, kvs_value_vec *value,
+    kvs_postprocess_function post_fn) {
+  return vec_retrieve(ks_hd, key, opt, value, private1, private2, false, post_fn);
+}
@@ -32,6 +32,7 @@
  */
 
 
+#include <vector>
 #include "private_types.h"
 #include "kvs_utils.h"
 int32_t KvsDriver::init() {
@@ -50,6 +51,191 @@ void KvsDriver::operator delete(void *p) {
 	return numa_aligned_free(p);
 }
 
+class exist_fanout;
+
+typedef struct {
+	exist_fanout *batch;
+	uint32_t index;
+	uint8_t answer;		// 1 if the key exists, written by the driver
+	kvs_exist_list list;	// one key, one byte of answer
+} exist_fanout_io;
+
+/*
+ * A multi-key exist issued as single-key exists, at most the queue depth of
+ * them outstanding at a time. Each completion sets the bit of its key in the
+ * caller's list. A synchronous caller submits the keys as slots free up and
+ * waits for them; for an asynchronous caller the keys that don't fit are
+ * submitted from the completions that free their slots, so it never waits,
+ * and it is notified once, by the last one, with the first failure if any.
+ */
+class exist_fanout {
+public:
+	exist_fanout(KvsDriver *driver_, kvs_key_space_handle ks_hd_, uint32_t key_cnt,
+		const kvs_key *keys_, kvs_exist_list *list_, void *private1_, void *private2_,
+		bool syncio_, kvs_postprocess_function cbfn_):
+		driver(driver_), ks_hd(ks_hd_), keys(keys_), list(list_),
+		private1(private1_), private2(private2_), syncio(syncio_), cbfn(cbfn_),
+		depth(_env_queue_depth()), sub_syncio(_env_sync_io_only()),
+		polling(_env_is_polling()), ios(key_cnt), next(0), issued(0), inflight(0),
+		pumping(false), result(KVS_SUCCESS) {
+		if (depth == 0) depth = 1;
+	}
+
+	int32_t run() {
+		if (syncio) {
+			for (uint32_t i = 0; i < ios.size(); i++) {
+				wait_until(depth - 1);
+				std::unique_lock<std::mutex> guard(lock);
+				if (result != KVS_SUCCESS) break;
+				inflight++;
+				guard.unlock();
+				issue(i);
+			}
+			wait_until(0);
+			int32_t ret = result;
+			delete this;
+			return ret;
+		}
+
+		std::unique_lock<std::mutex> guard(lock);
+		pumping = true;
+		fill(guard);
+		if (issued == 0) {
+			// nothing will complete, the caller is told here
+			int32_t ret = result;
+			guard.unlock();
+			delete this;
+			return ret;
+		}
+		finish(guard);
+		return KVS_SUCCESS;
+	}
+
+private:
+	kvs_result issue(uint32_t i) {
+		exist_fanout_io *io = &ios[i];
+		io->batch = this;
+		io->index = i;
+		io->answer = 0;
+		io->list.num_keys = 1;
+		io->list.keys = (kvs_key*)&keys[i];
+		io->list.length = 1;
+		io->list.result_buffer = &io->answer;
+
+		int32_t ret = driver->exist_tuple(ks_hd, 1, &keys[i], &io->list,
+			sub_syncio ? NULL : io, NULL, sub_syncio,
+			sub_syncio ? NULL : exist_fanout::on_io_complete);
+
+		// a synchronous command is already done, a failed submission never completes
+		if (sub_syncio || ret != KVS_SUCCESS)
+			complete(io, (kvs_result)ret);
+		return (kvs_result)ret;
+	}
+
+	static void on_io_complete(kvs_postprocess_context *ctx) {
+		exist_fanout_io *io = (exist_fanout_io*)ctx->private1;
+		io->batch->complete(io, ctx->result);
+	}
+
+	void complete(exist_fanout_io *io, kvs_result res) {
+		std::unique_lock<std::mutex> guard(lock);
+		if (res == KVS_SUCCESS && io->answer == 1)
+			list->result_buffer[io->index / 8] |= (uint8_t)(1 << (io->index % 8));
+		if (res != KVS_SUCCESS && result == KVS_SUCCESS) result = res;
+		inflight--;
+		if (syncio) {
+			cond.notify_all();
+			return;
+		}
+		// the thread that is submitting sees the free slot itself
+		if (pumping) return;
+		pumping = true;
+		fill(guard);
+		finish(guard);
+	}
+
+	// submits keys while there are free slots; called with the lock held
+	// by the only thread that submits
+	void fill(std::unique_lock<std::mutex> &guard) {
+		while (result == KVS_SUCCESS && next < ios.size() && inflight < depth) {
+			uint32_t i = next++;
+			inflight++;
+			guard.unlock();
+			kvs_result ret = issue(i);
+			guard.lock();
+			if (ret == KVS_SUCCESS) issued++;
+		}
+	}
+
+	// the last completion, or the thread that submitted after it, notifies
+	void finish(std::unique_lock<std::mutex> &guard) {
+		pumping = false;
+		bool last = (inflight == 0);
+		guard.unlock();
+		if (last) notify();
+	}
+
+	void notify() {
+		kvs_postprocess_context ctx;
+		memset(&ctx, 0, sizeof(ctx));
+		ctx.context = KVS_CMD_EXIST;
+		ctx.ks_hd = ks_hd;
+		ctx.key = (kvs_key*)keys;
+		ctx.private1 = private1;
+		ctx.private2 = private2;
+		ctx.result = result;
+		ctx.result_buffer.list = list;
+		kvs_postprocess_function fn = cbfn;
+		delete this;
+		if (fn) fn(&ctx);
+	}
+
+	void wait_until(uint32_t limit) {
+		std::unique_lock<std::mutex> guard(lock);
+		while (inflight > limit) {
+			if (polling) {
+				guard.unlock();
+				driver->process_completions(depth);
+				guard.lock();
+			} else {
+				cond.wait(guard);
+			}
+		}
+	}
+
+	KvsDriver *driver;
+	kvs_key_space_handle ks_hd;
+	const kvs_key *keys;
+	kvs_exist_list *list;
+	void *private1;
+	void *private2;
+	bool syncio;
+	kvs_postprocess_function cbfn;
+	uint32_t depth;
+	bool sub_syncio;
+	bool polling;
+	std::vector<exist_fanout_io> ios;
+	std::mutex lock;
+	std::condition_variable cond;
+	uint32_t next;		// asynchronous: next key to submit
+	uint32_t issued;	// asynchronous: keys submitted without failure
+	uint32_t inflight;
+	bool pumping;		// asynchronous: a thread is submitting keys
+	kvs_result result;
+};
+
+int32_t KvsDriver::exist_tuple_each(kvs_key_space_handle ks_hd, uint32_t key_cnt,
+	const kvs_key *keys, kvs_exist_list *list, void *private1, void *private2,
+	bool syncio, kvs_postprocess_function cbfn) {
+	if (list->length < (key_cnt + 7) / 8)
+		return KVS_ERR_BUFFER_SMALL;
+	memset(list->result_buffer, 0, (key_cnt + 7) / 8);
+
+	exist_fanout *batch = new exist_fanout(this, ks_hd, key_cnt, keys, list,
+		private1, private2, syncio, cbfn);
+	return batch->run();
+}
+
 kv_device_priv::~kv_device_priv() {
 
 }
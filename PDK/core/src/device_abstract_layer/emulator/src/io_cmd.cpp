@@ -53,6 +53,7 @@ io_cmd::io_cmd(kv_device_internal *dev, kv_namespace_internal *ns, kv_queue_hand
     m_dev = dev;
     m_ns = ns;
     m_cmd_id = 0;  // TODO:REMOVE THIS
+    ioctx.dispatch_tsc = 0;  // stamped by the queue thread
 
     // submission Q
     ioqueue *que = (ioqueue *)que_hdl->queue;
@@ -1248,7 +1248,41 @@ kv_result kv_device_internal::kv_exist(kv_queue_handle que_hdl, kv_namespace_han
 }
 
 // ASYNC IO in a device context
-kv_result kv_device_internal::kv_retrieve(kv_queue_handle que_hdl, kv_namespace_handle ns_hdl, uint8_t ks_id, const kv_key *key, kv_retrieve_option option, const kv_postprocess_function *post_fn, kv_value *value) {
+// the segments of a vectored command must cover the value length exactly
+static kv_result validate_segments(const kv_value *value, const kv_value_segment *segs, uint32_t seg_cnt) {
+    if (segs == NULL) {
+        return (seg_cnt == 0) ? KV_SUCCESS : KV_ERR_PARAM_INVALID;
+    }
+    if (seg_cnt == 0) {
+        return KV_ERR_PARAM_INVALID;
+    }
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < seg_cnt; i++) {
+        if (segs[i].value == NULL && segs[i].length > 0) {
+            return KV_ERR_PARAM_INVALID;
+        }
+        total += segs[i].length;
+    }
+    return (total == value->length) ? KV_SUCCESS : KV_ERR_PARAM_INVALID;
+}
+
+// a ranged read carries its buffers in the ranges and never in segments
+static kv_result validate_ranges(const kv_value_segment *segs, const kv_value_range *ranges, uint32_t range_cnt) {
+    if (ranges == NULL) {
+        return (range_cnt == 0) ? KV_SUCCESS : KV_ERR_PARAM_INVALID;
+    }
+    if (range_cnt == 0 || segs != NULL) {
+        return KV_ERR_PARAM_INVALID;
+    }
+    for (uint32_t i = 0; i < range_cnt; i++) {
+        if (ranges[i].value == NULL && ranges[i].length > 0) {
+            return KV_ERR_PARAM_INVALID;
+        }
+    }
+    return KV_SUCCESS;
+}
+
+kv_result kv_device_internal::kv_retrieve(kv_queue_handle que_hdl, kv_namespace_handle ns_hdl, uint8_t ks_id, const kv_key *key, kv_retrieve_option option, const kv_postprocess_function *post_fn, kv_value *value, const kv_value_segment *segs, uint32_t seg_cnt, kv_value_range *ranges, uint32_t range_cnt) {
     if (que_hdl == NULL || ns_hdl == NULL || key == NULL || value == NULL) {
         return KV_ERR_PARAM_INVALID;
     }
@@ -1257,6 +1291,14 @@ kv_result kv_device_internal::kv_retrieve(kv_queue_handle que_hdl, kv_namespace_
     if (res != KV_SUCCESS) {
         return res;
     }
+    res = validate_segments(value, segs, seg_cnt);
+    if (res != KV_SUCCESS) {
+        return res;
+    }
+    res = validate_ranges(segs, ranges, range_cnt);
+    if (res != KV_SUCCESS) {
+        return res;
+    }
 
     if(ks_id < SAMSUNG_MIN_KEYSPACE_ID || ks_id >= SAMSUNG_MAX_KEYSPACE_CNT){
           return KV_ERR_KEYSPACE_INVALID;
@@ -1286,6 +1328,10 @@ kv_result kv_device_internal::kv_retrieve(kv_queue_handle que_hdl, kv_namespace_
 
     op_get_struct_t info; 
     info.option = option;
+    info.segs = segs;
+    info.seg_cnt = seg_cnt;
+    info.ranges = ranges;
+    info.range_cnt = range_cnt;
 
     io_cmd *cmd = new io_cmd(dev, ns, que_hdl);
     cmd->ioctx.key = key;
@@ -1307,7 +1353,7 @@ kv_result kv_device_internal::kv_retrieve(kv_queue_handle que_hdl, kv_namespace_
 
 
 // Async IO
-kv_result kv_device_internal::kv_store(kv_queue_handle que_hdl, kv_namespace_handle ns_hdl, uint8_t ks_id, const kv_key *key, const kv_value *value, kv_store_option option, const kv_postprocess_function *post_fn) {
+kv_result kv_device_internal::kv_store(kv_queue_handle que_hdl, kv_namespace_handle ns_hdl, uint8_t ks_id, const kv_key *key, const kv_value *value, kv_store_option option, const kv_postprocess_function *post_fn, const kv_value_segment *segs, uint32_t seg_cnt) {
     if (que_hdl == NULL || ns_hdl == NULL || key == NULL || value == NULL) {
         return KV_ERR_PARAM_INVALID;
     }
@@ -1316,6 +1362,10 @@ kv_result kv_device_internal::kv_store(kv_queue_handle que_hdl, kv_namespace_han
     if (res != KV_SUCCESS) {
         return res;
     }
+    res = validate_segments(value, segs, seg_cnt);
+    if (res != KV_SUCCESS) {
+        return res;
+    }
 
     if(ks_id < SAMSUNG_MIN_KEYSPACE_ID || ks_id >= SAMSUNG_MAX_KEYSPACE_CNT){
           return KV_ERR_KEYSPACE_INVALID;
@@ -1344,6 +1394,8 @@ kv_result kv_device_internal::kv_store(kv_queue_handle que_hdl, kv_namespace_han
 
     op_store_struct_t info; 
     info.option = option;
+    info.segs = segs;
+    info.seg_cnt = seg_cnt;
 
     io_cmd *cmd = new io_cmd(dev, ns, que_hdl);
 
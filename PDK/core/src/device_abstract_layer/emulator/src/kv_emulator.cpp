@@ -78,21 +78,71 @@ inline kv_key *new_kv_key(const kv_key *key) {
 }
 
 uint64_t counter = 0;
+
+// copy the value of a store command, gathering the segments of kv_store_vec()
+static void load_value(std::string &dst, const kv_value *value, void *ioctx) {
+    const op_store_struct_t &info = ((io_cmd *) ioctx)->ioctx.command.store_info;
+    if (info.segs == NULL) {
+        dst.assign((char *)value->value, value->length);
+        return;
+    }
+    dst.reserve(value->length);
+    for (uint32_t i = 0; i < info.seg_cnt; i++) {
+        dst.append((char *)info.segs[i].value, info.segs[i].length);
+    }
+}
+
+// copy a retrieved value, scattering it to the segments of kv_retrieve_vec()
+static void copy_value(kv_value *value, const char *src, uint32_t len, void *ioctx) {
+    const op_get_struct_t &info = ((io_cmd *) ioctx)->ioctx.command.get_info;
+    if (info.segs == NULL) {
+        memcpy(value->value, src, len);
+        return;
+    }
+    for (uint32_t i = 0; i < info.seg_cnt && len > 0; i++) {
+        uint32_t n = std::min(len, info.segs[i].length);
+        memcpy(info.segs[i].value, src, n);
+        src += n;
+        len -= n;
+    }
+}
+
+// serve the ranges of kv_retrieve_ranges() from a stored value, returns false for a plain read
+static bool copy_ranges(kv_value *value, const std::string &data, void *ioctx) {
+    const op_get_struct_t &info = ((io_cmd *) ioctx)->ioctx.command.get_info;
+    if (info.ranges == NULL) {
+        return false;
+    }
+    uint32_t dlen = data.length();
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < info.range_cnt; i++) {
+        kv_value_range &r = info.ranges[i];
+        r.actual_length = 0;
+        if (r.offset < dlen) {
+            r.actual_length = std::min(dlen - r.offset, r.length);
+            memcpy(r.value, data.data() + r.offset, r.actual_length);
+        }
+        total += r.actual_length;
+    }
+    value->length = total;
+    value->actual_value_size = dlen;
+    return true;
+}
 // basic operations
 
 kv_result kv_emulator::kv_store(uint8_t ks_id, const kv_key *key, const kv_value *value, uint8_t option, uint32_t *consumed_bytes, void *ioctx) {
-    (void) ioctx;
     // track consumed spaced
     if (m_capacity <= 0 && m_available < (value->length + key->length)) {
         // fprintf(stderr, "No more device space left\n");
         return KV_ERR_DEV_CAPACITY;
     }
 
-    if (option != KV_STORE_OPT_DEFAULT && option != KV_STORE_OPT_IDEMPOTENT) {
+    if (option != KV_STORE_OPT_DEFAULT && option != KV_STORE_OPT_IDEMPOTENT && option != KV_STORE_OPT_APPEND) {
         return KV_ERR_OPTION_INVALID;
     }
 
-    const std::string valstr = std::string((char *)value->value, value->length);
+    std::string valstr;
+    load_value(valstr, value, ioctx);
     struct timespec begin;
     if (m_use_iops_model) {
         kv_emul_timer.start2(&begin);
@@ -106,11 +156,20 @@ kv_result kv_emulator::kv_store(uint8_t ks_id, const kv_key *key, const kv_value
         if (it != m_map[ks_id].end()) {
             if (option == KV_STORE_OPT_IDEMPOTENT) return KV_ERR_KEY_EXIST;
 
-            // update space
-            m_available -= value->length + it->second.length();
-
-            // overwrite
-            it->second = valstr;
+            if (option == KV_STORE_OPT_APPEND) {
+                // the appended value must still fit in a single value
+                if (it->second.length() + value->length > SAMSUNG_KV_MAX_VALUE_LEN) {
+                    return KV_ERR_VALUE_LENGTH_INVALID;
+                }
+                m_available -= value->length;
+                it->second.append(valstr);
+            } else {
+                // update space
+                m_available -= value->length + it->second.length();
+
+                // overwrite
+                it->second = std::move(valstr);
+            }
             
             *consumed_bytes = value->length;
             if (m_use_iops_model) {
@@ -141,7 +200,6 @@ kv_result kv_emulator::kv_store(uint8_t ks_id, const kv_key *key, const kv_value
 }
 
 kv_result kv_emulator::kv_retrieve(uint8_t ks_id, const kv_key *key, uint8_t option, kv_value *value, void *ioctx) {
-    (void) ioctx;
 
     kv_result ret = KV_ERR_KEY_NOT_EXIST;
 
@@ -161,23 +219,27 @@ kv_result kv_emulator::kv_retrieve(uint8_t ks_id, const kv_key *key, uint8_t opt
         auto it = m_map[ks_id].find((kv_key*)key);
         if (it != m_map[ks_id].end()) {
             uint32_t dlen = it->second.length();
-            if(value->offset != 0 && (value->offset >= dlen)){
-                return KV_ERR_VALUE_OFFSET_INVALID;
+            if (copy_ranges(value, it->second, ioctx)) {
+                ret = KV_SUCCESS;
+            } else {
+                if(value->offset != 0 && (value->offset >= dlen)){
+                    return KV_ERR_VALUE_OFFSET_INVALID;
+                }
+                uint32_t copylen = std::min(dlen - value->offset, value->length);
+
+                copy_value(value, it->second.data() + value->offset, copylen, ioctx);
+
+                if (value->length < dlen - value->offset)
+                  ret = KV_ERR_BUFFER_SMALL;
+                else
+                  ret = KV_SUCCESS;
+
+                value->length = copylen;
+                value->actual_value_size = dlen;
             }
-            uint32_t copylen = std::min(dlen - value->offset, value->length);
-
-            memcpy(value->value, it->second.data() + value->offset, copylen);
-
-            if (value->length < dlen - value->offset)
-              ret = KV_ERR_BUFFER_SMALL;
-            else
-              ret = KV_SUCCESS;
-
-            value->length = copylen;
-            value->actual_value_size = dlen;
 
             if (m_use_iops_model) {
-                stat.collect(STAT_READ, copylen);
+                stat.collect(STAT_READ, value->length);
             }
         } else {
             return KV_ERR_KEY_NOT_EXIST;
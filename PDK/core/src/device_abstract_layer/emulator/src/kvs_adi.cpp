@@ -238,6 +238,35 @@ kv_result kv_store(kv_queue_handle que_hdl, kv_namespace_handle ns_hdl,
     return (dev->kv_store(que_hdl, ns_hdl, ks_id, key, value, option, post_fn));
 }
 
+kv_result kv_retrieve_vec(kv_queue_handle que_hdl, kv_namespace_handle ns_hdl, uint8_t ks_id, const kv_key *key, kv_retrieve_option option, const kv_value_segment *segs, uint32_t seg_cnt, kv_value *value, const kv_postprocess_function *post_fn) {
+    if (que_hdl == NULL || ns_hdl == NULL || key == NULL || value == NULL || segs == NULL) {
+        return KV_ERR_PARAM_INVALID;
+    }
+
+    kv_device_internal *dev = (kv_device_internal *) que_hdl->dev;
+    return (dev->kv_retrieve(que_hdl, ns_hdl, ks_id, key, option, post_fn, value, segs, seg_cnt));
+}
+
+kv_result kv_retrieve_ranges(kv_queue_handle que_hdl, kv_namespace_handle ns_hdl, uint8_t ks_id, const kv_key *key, kv_retrieve_option option, kv_value_range *ranges, uint32_t range_cnt, kv_value *value, const kv_postprocess_function *post_fn) {
+    if (que_hdl == NULL || ns_hdl == NULL || key == NULL || value == NULL || ranges == NULL) {
+        return KV_ERR_PARAM_INVALID;
+    }
+
+    kv_device_internal *dev = (kv_device_internal *) que_hdl->dev;
+    return (dev->kv_retrieve(que_hdl, ns_hdl, ks_id, key, option, post_fn, value, NULL, 0, ranges, range_cnt));
+}
+
+kv_result kv_store_vec(kv_queue_handle que_hdl, kv_namespace_handle ns_hdl,
+  uint8_t ks_id, const kv_key *key, const kv_value_segment *segs, uint32_t seg_cnt,
+  const kv_value *value, kv_store_option option, const kv_postprocess_function *post_fn) {
+    if (que_hdl == NULL || ns_hdl == NULL || key == NULL || value == NULL || segs == NULL) {
+        return KV_ERR_PARAM_INVALID;
+    }
+
+    kv_device_internal *dev = (kv_device_internal *) que_hdl->dev;
+    return (dev->kv_store(que_hdl, ns_hdl, ks_id, key, value, option, post_fn, segs, seg_cnt));
+}
+
 kv_result kv_poll_completion(kv_queue_handle que_hdl, uint32_t timeout_usec, uint32_t *num_events) {
     if (que_hdl == NULL || num_events == NULL) {
         return KV_ERR_PARAM_INVALID;
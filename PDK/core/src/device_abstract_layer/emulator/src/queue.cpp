@@ -127,11 +127,6 @@ kv_result emul_ioqueue::poll_completion(uint32_t timeout_usec, uint32_t *num_eve
         if (cmd) {
             cmd->call_post_process_func();
 
-#ifdef ENABLE_LATENCY_TRACING
-        cmd->evicted_o = std::chrono::system_clock::now();
-        cmd->print_latency();
-#endif
-
             delete cmd;
             num_completed++;
         }
@@ -156,9 +151,7 @@ static void process_submitted_commands(void *que_)
         kv_result res = que->dequeue(&cmd, true);
         if (res != KV_SUCCESS || cmd == 0) continue;
 
-#ifdef ENABLE_LATENCY_TRACING
-        cmd->evicted_i = std::chrono::system_clock::now();
-#endif
+        cmd->ioctx.dispatch_tsc = __builtin_ia32_rdtsc();
 
         cmd->execute_cmd();
 
@@ -439,6 +439,29 @@ typedef struct {
 
 } kv_value;
 
+/**
+  kv_value_segment
+
+  a host buffer that holds a part of a value which is scattered over several
+  buffers, see kv_store_vec() and kv_retrieve_vec()
+  */
+typedef struct {
+  void *value;        ///< buffer address of the segment
+  kv_value_t length;  ///< segment length in byte unit
+} kv_value_segment;
+
+/**
+  kv_value_range
+
+  a byte range of a value and the host buffer it is read to, see kv_retrieve_ranges()
+  */
+typedef struct {
+  kv_value_t offset;        ///< offset of the range in the value
+  kv_value_t length;        ///< range length in byte unit, the size of the buffer
+  void *value;              ///< buffer address of the range
+  kv_value_t actual_length; ///< bytes of the range that were retrieved
+} kv_value_range;
+
 /**
   kv_namespace
   kv_namespace represents namespace information. 
@@ -600,10 +623,16 @@ kv_result kv_get_device_waf(const kv_device_handle dev_hdl, uint32_t *waf);
 
 typedef struct {
     kv_retrieve_option option;
+    const kv_value_segment *segs;   // value buffers of kv_retrieve_vec(), NULL otherwise
+    uint32_t seg_cnt;
+    kv_value_range *ranges;         // ranges of kv_retrieve_ranges(), NULL otherwise
+    uint32_t range_cnt;
 } op_get_struct_t;
 
 typedef struct {
     kv_store_option option;
+    const kv_value_segment *segs;   // value buffers of kv_store_vec(), NULL otherwise
+    uint32_t seg_cnt;
 } op_store_struct_t;
 
 typedef struct {
@@ -675,6 +704,7 @@ struct kv_io_context{
         void *buf;
         int buflength;
     } hiter;
+    uint64_t dispatch_tsc;      ///< TSC when the device picked up the command, 0 if unknown
 };
 
 
@@ -703,6 +733,7 @@ typedef struct {
         void *buf;
         int buflength;
     } hiter;
+    uint64_t dispatch_tsc;
 
 //private
     void (*post_fn)(kv_io_context *op);   ///< asynchronous notification callback (valid only for async I/O)
@@ -1490,6 +1521,84 @@ kv_result kv_retrieve(kv_queue_handle que_hdl, kv_namespace_handle ns_hdl, uint8
   */
 kv_result kv_store(kv_queue_handle que_hdl, kv_namespace_handle ns_hdl, uint8_t ks_id, const kv_key *key, const kv_value *value, kv_store_option option, const kv_postprocess_function *post_fn);
 
+/**
+  kv_retrieve_vec
+
+  This interface works as kv_retrieve() but scatters the value into seg_cnt buffers in the order given, and the value buffer of kv_value is not used. kv_value.length shall be the sum of the segment lengths; on return it is set to the number of bytes that were retrieved. kv_value.offset is handled as in kv_retrieve().
+
+  [EMULATOR] only the emulator implements this interface.
+
+  PARAMETERS
+  IN que_hdl	queue handle
+  IN ns_hdl		namespace handle, or KV_NAMESPACE_DEFAULT
+  IN key		key
+  IN option		options defined in kv_retrieve_option
+  IN segs		segments of the value buffer
+  IN seg_cnt	number of segments
+  IN post_fn	a postprocess function which is called when the operation completes
+  OUT value	value length available at the time of IO complettion
+
+  RETURNS
+  KV_SUCCESS
+
+  ERROR CODE
+  the error codes of kv_retrieve()
+  KV_ERR_PARAM_INVALID 		segs is NULL, seg_cnt is 0, or kv_value.length is not the sum of the segment lengths
+  */
+kv_result kv_retrieve_vec(kv_queue_handle que_hdl, kv_namespace_handle ns_hdl, uint8_t ks_id, const kv_key *key, kv_retrieve_option option, const kv_value_segment *segs, uint32_t seg_cnt, kv_value *value, const kv_postprocess_function *post_fn);
+
+/**
+  kv_retrieve_ranges
+
+  This interface reads range_cnt byte ranges of one value with a single command. Each range is copied to its own buffer; the ranges need not be aligned, sorted or disjoint. A range that extends past the end of the value receives the bytes that exist and a range that starts past the end receives none, kv_value_range.actual_length tells the number of bytes retrieved. The value buffer and the offset of kv_value are not used; on return kv_value.length is the number of bytes retrieved over all ranges and kv_value.actual_value_size is the size of the value.
+
+  [EMULATOR] only the emulator implements this interface.
+
+  PARAMETERS
+  IN que_hdl	queue handle
+  IN ns_hdl		namespace handle, or KV_NAMESPACE_DEFAULT
+  IN key		key
+  IN option		options defined in kv_retrieve_option
+  IN ranges		ranges to read and their buffers
+  IN range_cnt	number of ranges
+  IN post_fn	a postprocess function which is called when the operation completes
+  OUT value	bytes retrieved and value length available at the time of IO complettion
+
+  RETURNS
+  KV_SUCCESS
+
+  ERROR CODE
+  KV_ERR_KEY_NOT_EXIST		the key does not exist
+  KV_ERR_PARAM_INVALID 		ranges is NULL, range_cnt is 0 or a range buffer is NULL
+  */
+kv_result kv_retrieve_ranges(kv_queue_handle que_hdl, kv_namespace_handle ns_hdl, uint8_t ks_id, const kv_key *key, kv_retrieve_option option, kv_value_range *ranges, uint32_t range_cnt, kv_value *value, const kv_postprocess_function *post_fn);
+
+/**
+  kv_store_vec
+
+  This interface works as kv_store() but gathers the value from seg_cnt buffers in the order given, and the value buffer of kv_value is not used. kv_value.length shall be the sum of the segment lengths.
+
+  [EMULATOR] only the emulator implements this interface.
+
+  PARAMETERS
+  IN que_hdl	queue handle
+  IN ns_hdl		namespace handle, or KV_NAMESPACE_DEFAULT
+  IN key		key
+  IN segs		segments of the value
+  IN seg_cnt	number of segments
+  IN value		value length and offset
+  IN option		options defined in KV_STORE_OPTION
+  IN post_fn	a postprocess function which is called when the operation completes
+
+  RETURNS
+  KV_SUCCESS
+
+  ERROR CODE
+  the error codes of kv_store()
+  KV_ERR_PARAM_INVALID 		segs is NULL, seg_cnt is 0, or kv_value.length is not the sum of the segment lengths
+  */
+kv_result kv_store_vec(kv_queue_handle que_hdl, kv_namespace_handle ns_hdl, uint8_t ks_id, const kv_key *key, const kv_value_segment *segs, uint32_t seg_cnt, const kv_value *value, kv_store_option option, const kv_postprocess_function *post_fn);
+
 /**
  \ingroup Completion Interfaces
   kv_poll_completion
@@ -39,8 +39,6 @@
 #include "kvs_adi_internal.h"
 
 
-//#define ENABLE_LATENCY_TRACING
-
 namespace kvadi {
 
 class kv_device_internal;
@@ -82,19 +80,6 @@ public:
     // return nanoseconds since epoch for the cmd
     //uint64_t get_cmd_time_nanoseconds();
 
-#ifdef ENABLE_LATENCY_TRACING
-    std::chrono::time_point<std::chrono::system_clock> inserted_i;
-    std::chrono::time_point<std::chrono::system_clock> evicted_i;
-    std::chrono::time_point<std::chrono::system_clock> inserted_o;
-    std::chrono::time_point<std::chrono::system_clock> evicted_o;
-
-    void print_latency() {
-        fprintf(stderr, "submission queue insert - submission queue evict: %ld ns \n", std::chrono::duration_cast<std::chrono::nanoseconds>(evicted_i - inserted_i).count() );
-        fprintf(stderr, "processing time : %ld ns \n", std::chrono::duration_cast<std::chrono::nanoseconds>(inserted_o - evicted_i ).count() );
-        fprintf(stderr, "completion queue insert - evict : %ld ns \n", std::chrono::duration_cast<std::chrono::nanoseconds>(evicted_o - evicted_i ).count() );
-    }
-
-#endif
 private:
     // command context info, hold all info for command execution and return
     // opcode, key, value, option, timeout etc.
@@ -41,6 +41,7 @@
 #include <list>
 #include <bitset>
 #include <unordered_map>
+#include <endian.h>
 #include "kvs_adi_internal.h"
 #include "history.hpp"
 
@@ -58,11 +59,17 @@ struct CmpEmulPrefix {
         const char *strA = (const char *)a->key;
         const char *strB = (const char *)b->key;
 
-        // using leading 4 bytes in ascending order for group and iteration
+        // using leading 4 bytes in ascending order for group and iteration;
+        // compared as big-endian, so that the keys of a group condition
+        // (a prefix of the first byte downwards) are next to each other.
+        // Iterators therefore return keys ordered by their leading 4 bytes
+        // as unsigned bytes, then by length, then by the remaining bytes
         uint32_t intA = 0;
         memcpy(&intA, strA, 4);
+        intA = be32toh(intA);
         uint32_t intB = 0;
         memcpy(&intB, strB, 4);
+        intB = be32toh(intB);
 
         // first compare first 32 bits
         if (intA == intB) {
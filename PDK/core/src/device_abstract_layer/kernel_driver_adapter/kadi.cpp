@@ -88,6 +88,7 @@ int KADI::open(std::string &devpath)
             ctx->index = i;
         }
         free_cmdctxs.push_back(ctx);
+        all_cmdctxs.push_back(ctx);
     }
 #ifdef EPOLL_DEV
     EpollFD_dev = epoll_create(1024);
@@ -158,9 +159,11 @@ int KADI::close()
     {
         this->cb_thread.stop();
 
-        for (aio_cmd_ctx *p: free_cmdctxs) {
+        for (aio_cmd_ctx *p: all_cmdctxs) {
             free((void*)p);
         }
+        free_cmdctxs.clear();
+        all_cmdctxs.clear();
 
         if(ioctl(fd, NVME_IOCTL_DEL_AIOCTX, &aioctx) < 0){
             std::cerr << "KV device is closed error!" << std::endl;
@@ -200,7 +203,7 @@ KADI::aio_cmd_ctx *KADI::get_cmd_ctx(const kv_postprocess_function *cb)
       p->post_fn = NULL;
       p->post_data = NULL;
     }
-    pending_cmdctxs.insert(std::make_pair(p->index, p));
+    p->pending = true;
     return p;
 }
 
@@ -208,7 +211,7 @@ void KADI::release_cmd_ctx(aio_cmd_ctx *p)
 {
     std::lock_guard<std::mutex> lock(cmdctx_lock);
 
-    pending_cmdctxs.erase(p->index);
+    p->pending = false;
     free_cmdctxs.push_back(p);
     cmdctx_cond.notify_one();
 }
@@ -277,6 +280,7 @@ kv_result KADI::iter_read_async(kv_iter_context *iter_handle, const kv_postproce
 #ifdef DUMP_ISSUE_CMD
     dump_cmd(&cmd);
 #endif
+    ioctx->dispatch_tsc = __builtin_ia32_rdtsc();
     int ret = ioctl(fd, NVME_IOCTL_AIO_CMD, &ioctx->cmd);
     if (ret < 0)
     {
@@ -458,6 +462,20 @@ uint32_t KADI::get_dev_waf()
 }
 kv_result KADI::kv_store(uint8_t ks_id, kv_key *key, kv_value *value,
   nvme_kv_store_option option, const kv_postprocess_function *cb)
+{
+    return submit_store(nvme_cmd_kv_store, ks_id, key, value, option, cb);
+}
+
+// the device appends the value to an existing pair, or creates the pair
+// when the key does not exist yet
+kv_result KADI::kv_append(uint8_t ks_id, kv_key *key, kv_value *value,
+  const kv_postprocess_function *cb)
+{
+    return submit_store(nvme_cmd_kv_append, ks_id, key, value, STORE_OPTION_NOTHING, cb);
+}
+
+kv_result KADI::submit_store(nvme_kv_opcode opcode, uint8_t ks_id, kv_key *key,
+  kv_value *value, nvme_kv_store_option option, const kv_postprocess_function *cb)
 {
   if (!key || !key->key || !value)
    {
@@ -469,7 +487,7 @@ kv_result KADI::kv_store(uint8_t ks_id, kv_key *key, kv_value *value,
     ioctx->key = key;
     ioctx->value = value;
 
-    ioctx->cmd.opcode = nvme_cmd_kv_store;
+    ioctx->cmd.opcode = opcode;
     ioctx->cmd.nsid = nsid;
     ioctx->cmd.cdw3 = ks_id;
     if (key->length > KVCMD_INLINE_KEY_MAX)
@@ -492,9 +510,10 @@ kv_result KADI::kv_store(uint8_t ks_id, kv_key *key, kv_value *value,
  
 #ifdef DUMP_ISSUE_CMD
     //dump_cmd(&ioctx->cmd);
-    std::cerr << "IO:kv_store: key = " << print_key((const char *)key->key, key->length) << ", len = " << (int)key->length << std::endl;
+    std::cerr << "IO:kv_store(" << std::hex << (int)opcode << std::dec << "): key = " << print_key((const char *)key->key, key->length) << ", len = " << (int)key->length << std::endl;
 #endif
 
+    ioctx->dispatch_tsc = __builtin_ia32_rdtsc();
     int ret;
     if ((ret = ioctl(fd, NVME_IOCTL_AIO_CMD, &ioctx->cmd)) < 0)
     {
@@ -540,6 +559,7 @@ kv_result KADI::kv_retrieve(uint8_t ks_id, kv_key *key, kv_value *value, const k
     dump_retrieve_cmd(&ioctx->cmd);
     std::cerr << "IO:kv_retrieve: key = " << print_key((const char *)key->key, key->length) << ", len = " << (int)key->length << std::endl;
 #endif
+    ioctx->dispatch_tsc = __builtin_ia32_rdtsc();
     int ret = ioctl(fd, NVME_IOCTL_AIO_CMD, &ioctx->cmd);
     if (ret < 0)
     {
@@ -671,6 +691,7 @@ bool KADI::exist(uint8_t ks_id, void *key, int length, const kv_postprocess_func
         release_cmd_ctx(ioctx);
     } else {
         // async 
+        ioctx->dispatch_tsc = __builtin_ia32_rdtsc();
         ret = ioctl(fd, NVME_IOCTL_AIO_CMD, &ioctx->cmd);
         if (ret < 0)
         {
@@ -720,6 +741,7 @@ kv_result KADI::kv_delete(uint8_t ks_id, kv_key *key,
     std::cerr << "IO:kv_delete: key = " << print_key((const char *)key->key, key->length) << ", len = " << (int)key->length << std::endl;
 #endif
 
+    ioctx->dispatch_tsc = __builtin_ia32_rdtsc();
     if (ioctl(fd, NVME_IOCTL_AIO_CMD, &ioctx->cmd) < 0)
     {
         release_cmd_ctx(ioctx);
@@ -825,6 +847,7 @@ kv_result KADI::fill_ioresult(const aio_cmd_ctx &ioctx, const struct nvme_aioeve
     ioresult.key = ioctx.key;
     ioresult.value = ioctx.value;
     ioresult.private_data = ioctx.post_data;
+    ioresult.dispatch_tsc = ioctx.dispatch_tsc;
 
     // exceptions
     switch (ioresult.retcode)
@@ -205,6 +205,8 @@ public:
 
         void (*post_fn)(kv_io_context *result);
         void *post_data;
+        uint64_t dispatch_tsc;      // TSC when the command was handed to the driver
+        bool pending;               // submitted and not yet released
 
         volatile struct nvme_passthru_kv_cmd cmd;
 
@@ -232,7 +234,7 @@ private:
     std::condition_variable cmdctx_cond;
 
     std::vector<aio_cmd_ctx *>   free_cmdctxs;
-    std::map<unsigned, aio_cmd_ctx *> pending_cmdctxs;
+    std::vector<aio_cmd_ctx *>   all_cmdctxs;   // indexed by aio_cmd_ctx::index
 
     int qdepth;
     
@@ -242,18 +244,19 @@ private:
     
     inline aio_cmd_ctx* get_cmdctx(int reqid) {
         std::unique_lock<std::mutex> lock (cmdctx_lock);
-        auto p = pending_cmdctxs.find(reqid);
-        if (p == pending_cmdctxs.end())
+        if (reqid < 0 || (unsigned)reqid >= all_cmdctxs.size() || !all_cmdctxs[reqid]->pending)
             return 0;
-        return p->second;
+        return all_cmdctxs[reqid];
     }
 
     void release_cmd_ctx(aio_cmd_ctx *p);
+    kv_result submit_store(nvme_kv_opcode opcode, uint8_t ks_id, kv_key *key, kv_value *value, nvme_kv_store_option option, const kv_postprocess_function* cb);
 
 public:
 
     uint32_t  get_dev_waf();
     kv_result kv_store(uint8_t ks_id, kv_key *key, kv_value *value, nvme_kv_store_option option, const kv_postprocess_function* cb);
+    kv_result kv_append(uint8_t ks_id, kv_key *key, kv_value *value, const kv_postprocess_function* cb);
     kv_result kv_retrieve(uint8_t ks_id, kv_key *key, kv_value *value, const kv_postprocess_function* cb);
     kv_result kv_retrieve_sync(uint8_t ks_id, kv_key *key, kv_value *value);
     kv_result kv_delete(uint8_t ks_id, kv_key *key, const kv_postprocess_function* cb, int check_exist = 0);
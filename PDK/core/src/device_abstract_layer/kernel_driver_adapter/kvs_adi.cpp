@@ -582,6 +582,8 @@ kv_result kv_store(kv_queue_handle que_hdl, kv_namespace_handle ns_hdl,
       case KV_STORE_OPT_UPDATE_ONLY:
         dev_option = STORE_OPTION_UPDATE_ONLY;
         break;
+      case KV_STORE_OPT_APPEND:
+        return dev->kv_append(ks_id, (kv_key*)key, (kv_value*)value, post_fn);
       default:
         return KV_ERR_OPTION_INVALID;
     }
@@ -0,0 +1,270 @@
+/**
+ *   BSD LICENSE
+ *
+ *   Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Samsung Electronics Co., Ltd. nor the names of
+ *       its contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * kvstop: operation statistics of the processes that use the KV API
+ *
+ * Every device opened through the API library publishes its statistics in
+ * /dev/shm/kvs_stats.<pid>.<n>. kvstop reads them periodically and prints
+ * rates and latency percentiles by operation, like top.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <map>
+#include <string>
+#include "kvs_stats.h"
+
+static const char *op_names[KVS_STATS_OPS] = {
+  "delete", "delete_group", "exist", "iter_create", "iter_delete", "iter_next", "retrieve", "store"
+};
+static const char *value_class_names[KVS_STATS_VALUE_CLASSES] = {
+  "<512", "<4K", "<32K", "<256K", ">=256K"
+};
+static const char *result_class_names[KVS_STATS_RESULT_CLASSES] = {
+  "ok", "not_found", "error"
+};
+static const char *qos_class_names[KVS_QOS_CLASSES] = {
+  "high", "normal", "low"
+};
+
+static void usage(const char *prog) {
+  fprintf(stderr, "usage: %s [-d seconds] [-n count] [-p pid] [-v]\n", prog);
+  fprintf(stderr, "  -d  refresh interval in seconds (default 1)\n");
+  fprintf(stderr, "  -n  number of refreshes, 0 for no limit (default 0)\n");
+  fprintf(stderr, "  -p  only show the devices of this process\n");
+  fprintf(stderr, "  -v  break operations down by key space, value length and result\n");
+}
+
+// latency in us at quantile q of a histogram, the middle of its bucket
+static double percentile(const uint64_t *latency, uint64_t count, double q) {
+  uint64_t target = (uint64_t)(q * count + 0.5), sum = 0;
+  if (target == 0) target = 1;
+  for (uint32_t b = 0; b < KVS_STATS_LAT_BUCKETS; b++) {
+    sum += latency[b];
+    if (sum >= target) {
+      uint64_t lo = kvs_stats_bucket_ns(b);
+      uint64_t hi = (b + 1 < KVS_STATS_LAT_BUCKETS) ? kvs_stats_bucket_ns(b + 1) : lo;
+      return (lo + (hi - lo) / 2.0) / 1000.0;
+    }
+  }
+  return 0;
+}
+
+static void add_cell(kvs_stats_cell *sum, const kvs_stats_cell *cell) {
+  sum->count += cell->count;
+  sum->bytes += cell->bytes;
+  sum->latency_sum_ns += cell->latency_sum_ns;
+  for (uint32_t b = 0; b < KVS_STATS_LAT_BUCKETS; b++)
+    sum->latency[b] += cell->latency[b];
+}
+
+static void print_row(const char *name, const kvs_stats_cell *c, uint64_t not_found,
+  uint64_t errors, double secs) {
+  printf("%-34s %10.0f %9.2f %9.1f %9.1f %9.1f %9.1f %9.0f %9.0f\n", name,
+    c->count / secs, c->bytes / secs / 1000000.0,
+    c->latency_sum_ns / 1000.0 / c->count,
+    percentile(c->latency, c->count, 0.5), percentile(c->latency, c->count, 0.99),
+    percentile(c->latency, c->count, 0.999), not_found / secs, errors / secs);
+}
+
+static void print_stats(const kvs_stats_segment *seg, const kvs_stats *s, double secs, bool verbose) {
+  printf("\npid %d  %s  up %.0fs  since reset %.0fs\n", seg->pid, seg->dev_path,
+    (kvs_stats_now() - seg->open_ns) / 1e9, (kvs_stats_now() - seg->reset_ns) / 1e9);
+  printf("%-34s %10s %9s %9s %9s %9s %9s %9s %9s\n", "operation", "ops/s", "MB/s",
+    "avg(us)", "p50(us)", "p99(us)", "p99.9(us)", "nf/s", "err/s");
+
+  for (int op = 0; op < KVS_STATS_OPS; op++) {
+    kvs_stats_cell sum;
+    uint64_t res[KVS_STATS_RESULT_CLASSES] = {0};
+    memset(&sum, 0, sizeof(sum));
+    for (int ks = 0; ks < KVS_STATS_KEY_SPACES; ks++)
+      for (int vc = 0; vc < KVS_STATS_VALUE_CLASSES; vc++)
+        for (int rc = 0; rc < KVS_STATS_RESULT_CLASSES; rc++) {
+          add_cell(&sum, &s->cells[op][ks][vc][rc]);
+          res[rc] += s->cells[op][ks][vc][rc].count;
+        }
+    if (sum.count == 0) continue;
+    print_row(op_names[op], &sum, res[1], res[2], secs);
+
+    if (!verbose) continue;
+    for (int ks = 0; ks < KVS_STATS_KEY_SPACES; ks++)
+      for (int vc = 0; vc < KVS_STATS_VALUE_CLASSES; vc++)
+        for (int rc = 0; rc < KVS_STATS_RESULT_CLASSES; rc++) {
+          const kvs_stats_cell *c = &s->cells[op][ks][vc][rc];
+          if (c->count == 0) continue;
+          char name[64];
+          snprintf(name, sizeof(name), "  ks %d %s %s", ks, value_class_names[vc],
+            result_class_names[rc]);
+          print_row(name, c, (rc == 1) ? c->count : 0, (rc == 2) ? c->count : 0, secs);
+        }
+    for (int r = 1; r < KVS_STATS_RESULTS; r++) {
+      if (s->results[op][r] && r != KVS_ERR_KEY_NOT_EXIST)
+        printf("  result 0x%02x: %lu\n", r, (unsigned long)s->results[op][r]);
+    }
+  }
+
+  // commands of the QoS scheduler, latency is the time they were queued
+  for (int c = 0; c < KVS_QOS_CLASSES; c++) {
+    if (s->qos[c].count == 0) continue;
+    char name[64];
+    snprintf(name, sizeof(name), "qos %s (queueing)", qos_class_names[c]);
+    print_row(name, &s->qos[c], 0, 0, secs);
+  }
+
+  uint64_t coalesced = s->coalesce_hits + s->coalesce_misses;
+  if (coalesced)
+    printf("coalesced retrieves %.0f/s of %.0f/s (%.1f%%)\n", s->coalesce_hits / secs,
+      coalesced / secs, 100.0 * s->coalesce_hits / coalesced);
+
+  uint64_t filtered = s->filter_negatives + s->filter_passes;
+  if (filtered)
+    printf("filtered lookups %.0f/s of %.0f/s (%.1f%%)\n", s->filter_negatives / secs,
+      filtered / secs, 100.0 * s->filter_negatives / filtered);
+}
+
+// maps a statistics object, NULL if it is not one or its process is gone
+static kvs_stats_segment *map_segment(const char *name, size_t *size) {
+  char path[512];
+  struct stat st;
+  snprintf(path, sizeof(path), "/dev/shm/%s", name);
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return NULL;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < KVS_STATS_PAGE) {
+    close(fd);
+    return NULL;
+  }
+  void *p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) return NULL;
+
+  kvs_stats_segment *seg = (kvs_stats_segment*)p;
+  if (__atomic_load_n(&seg->magic, __ATOMIC_ACQUIRE) != KVS_STATS_MAGIC ||
+      seg->stats_size != sizeof(kvs_stats) || seg->nshards == 0 ||
+      seg->nshards > KVS_STATS_MAX_SHARDS ||
+      kvs_stats_segment_size(seg->nshards) > (size_t)st.st_size ||
+      (kill(seg->pid, 0) != 0 && errno == ESRCH)) {
+    munmap(p, st.st_size);
+    return NULL;
+  }
+  *size = st.st_size;
+  return seg;
+}
+
+int main(int argc, char *argv[]) {
+  double delay = 1;
+  long count = 0;
+  int pid = 0;
+  bool verbose = false;
+  int c;
+
+  while ((c = getopt(argc, argv, "d:n:p:vh")) != -1) {
+    switch (c) {
+      case 'd': delay = atof(optarg); break;
+      case 'n': count = atol(optarg); break;
+      case 'p': pid = atoi(optarg); break;
+      case 'v': verbose = true; break;
+      default: usage(argv[0]); return 1;
+    }
+  }
+  if (delay <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  // the previous snapshot of each object, for the rates of an interval
+  std::map<std::string, kvs_stats*> prev;
+  kvs_stats *cur = (kvs_stats*)malloc(sizeof(kvs_stats));
+  bool tty = isatty(STDOUT_FILENO);
+
+  for (long n = 0; count == 0 || n < count; n++) {
+    if (n) usleep((useconds_t)(delay * 1000000));
+    if (tty) printf("\033[H\033[2J");
+    printf("kvstop - every %.1fs\n", delay);
+
+    DIR *dir = opendir("/dev/shm");
+    if (!dir) {
+      perror("/dev/shm");
+      return 1;
+    }
+    int found = 0;
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+      if (strncmp(ent->d_name, KVS_STATS_SHM_PREFIX, strlen(KVS_STATS_SHM_PREFIX)))
+        continue;
+      size_t size;
+      kvs_stats_segment *seg = map_segment(ent->d_name, &size);
+      if (!seg) continue;
+      if (pid && seg->pid != pid) {
+        munmap(seg, size);
+        continue;
+      }
+      found++;
+      kvs_stats_read(seg, cur);
+
+      kvs_stats *&last = prev[ent->d_name];
+      if (!last) {
+        last = (kvs_stats*)calloc(1, sizeof(kvs_stats));
+        memcpy(last, cur, sizeof(kvs_stats));
+        print_stats(seg, cur, cur->elapsed_ns / 1e9, verbose);
+      } else {
+        kvs_stats *delta = (kvs_stats*)malloc(sizeof(kvs_stats));
+        uint64_t *d = (uint64_t*)delta;
+        const uint64_t *a = (const uint64_t*)cur, *b = (const uint64_t*)last;
+        bool reset = cur->elapsed_ns < last->elapsed_ns;
+        for (size_t j = 0; j < sizeof(kvs_stats) / sizeof(uint64_t); j++)
+          d[j] = reset ? a[j] : a[j] - b[j];
+        double secs = (reset ? cur->elapsed_ns : cur->elapsed_ns - last->elapsed_ns) / 1e9;
+        print_stats(seg, delta, secs, verbose);
+        memcpy(last, cur, sizeof(kvs_stats));
+        free(delta);
+      }
+      munmap(seg, size);
+    }
+    closedir(dir);
+    if (!found) printf("\nno process has a KV device open\n");
+    fflush(stdout);
+  }
+
+  for (auto &it : prev) free(it.second);
+  free(cur);
+  return 0;
+}
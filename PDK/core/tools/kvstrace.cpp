@@ -0,0 +1,260 @@
+/**
+ *   BSD LICENSE
+ *
+ *   Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Samsung Electronics Co., Ltd. nor the names of
+ *       its contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * kvstrace: decoder of the binary command traces of the KV API
+ *
+ * A trace is started with kvs_start_trace() or KVSSD_TRACE=<file>. kvstrace
+ * breaks the latency of every operation down into the stages a command
+ * goes through and prints their distributions, the slowest commands, a
+ * folded stack summary for flamegraph.pl or the records as CSV.
+ *
+ *   queue     submission to the driver until dispatch to the device
+ *   device    dispatch until the driver sees the completion
+ *   driver    submission until completion, where dispatch isn't known
+ *   callback  completion until the user callback returned, or the
+ *             synchronous caller was woken up
+ *   total     submission until the end of the callback
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include "kvs_trace.h"
+
+enum { STAGE_QUEUE, STAGE_DEVICE, STAGE_DRIVER, STAGE_CALLBACK, STAGE_TOTAL, NSTAGES };
+
+static const char *stage_names[NSTAGES] = {
+  "queue", "device", "driver", "callback", "total"
+};
+static const char *op_names[KVS_STATS_OPS] = {
+  "delete", "delete_group", "exist", "iter_create", "iter_delete", "iter_next", "retrieve", "store"
+};
+
+static double tsc_per_ns;
+
+static void usage(const char *prog) {
+  fprintf(stderr, "usage: %s [-n count] [-f | -c] trace_file\n", prog);
+  fprintf(stderr, "  -n  number of slowest commands to list (default 10)\n");
+  fprintf(stderr, "  -f  print folded stacks for flamegraph.pl, in us\n");
+  fprintf(stderr, "  -c  print the records as CSV, times in ns from the start of the trace\n");
+}
+
+static const char *op_name(uint8_t op) {
+  return (op >= 1 && op <= KVS_STATS_OPS) ? op_names[op - 1] : "unknown";
+}
+
+// us between two stamps, 0 if either is missing or they are out of order
+// (stamps taken on different CPUs)
+static double span(uint64_t from, uint64_t to) {
+  if (!from || !to || to < from) return 0;
+  return (to - from) / tsc_per_ns / 1000.0;
+}
+
+static void stages(const kvs_trace_record &r, double *us) {
+  for (int s = 0; s < NSTAGES; s++) us[s] = -1;
+  if (r.dispatch_tsc) {
+    us[STAGE_QUEUE] = span(r.submit_tsc, r.dispatch_tsc);
+    us[STAGE_DEVICE] = span(r.dispatch_tsc, r.complete_tsc);
+  } else {
+    us[STAGE_DRIVER] = span(r.submit_tsc, r.complete_tsc);
+  }
+  us[STAGE_CALLBACK] = span(r.complete_tsc, r.callback_tsc);
+  us[STAGE_TOTAL] = span(r.submit_tsc, r.callback_tsc);
+}
+
+static double percentile(const std::vector<double> &sorted, double q) {
+  size_t i = (size_t)(q * sorted.size());
+  return sorted[std::min(i, sorted.size() - 1)];
+}
+
+static void print_summary(const kvs_trace_header &hdr, const std::vector<kvs_trace_record> &recs,
+  int top) {
+  uint64_t first = UINT64_MAX, last = 0;
+  for (const auto &r : recs) {
+    first = std::min(first, r.submit_tsc);
+    last = std::max(last, r.callback_tsc);
+  }
+  const double secs = (recs.empty() || last < first) ? 0 : (last - first) / tsc_per_ns / 1e9;
+  printf("%lu records, %lu dropped, %.3fs, TSC %.3f GHz\n", (unsigned long)recs.size(),
+    (unsigned long)hdr.dropped, secs, tsc_per_ns);
+
+  std::vector<double> lat[KVS_STATS_OPS][NSTAGES];
+  uint64_t not_found[KVS_STATS_OPS] = {0}, errors[KVS_STATS_OPS] = {0}, sync[KVS_STATS_OPS] = {0};
+  for (const auto &r : recs) {
+    if (r.opcode < 1 || r.opcode > KVS_STATS_OPS) continue;
+    double us[NSTAGES];
+    stages(r, us);
+    for (int s = 0; s < NSTAGES; s++)
+      if (us[s] >= 0) lat[r.opcode - 1][s].push_back(us[s]);
+    if (r.result == KVS_ERR_KEY_NOT_EXIST) not_found[r.opcode - 1]++;
+    else if (r.result != KVS_SUCCESS) errors[r.opcode - 1]++;
+    if (r.flags & KVS_TRACE_SYNC) sync[r.opcode - 1]++;
+  }
+
+  printf("\n%-14s %-9s %10s %10s %10s %10s %10s %10s %10s\n", "operation", "stage", "count",
+    "avg(us)", "p50(us)", "p99(us)", "p99.9(us)", "max(us)", "ops/s");
+  for (int op = 0; op < KVS_STATS_OPS; op++) {
+    if (lat[op][STAGE_TOTAL].empty()) continue;
+    const char *name = op_names[op];
+    for (int s = 0; s < NSTAGES; s++) {
+      std::vector<double> &v = lat[op][s];
+      if (v.empty()) continue;
+      std::sort(v.begin(), v.end());
+      double sum = 0;
+      for (double x : v) sum += x;
+      printf("%-14s %-9s %10lu %10.1f %10.1f %10.1f %10.1f %10.1f", name, stage_names[s],
+        (unsigned long)v.size(), sum / v.size(), percentile(v, 0.5), percentile(v, 0.99),
+        percentile(v, 0.999), v.back());
+      if (s == STAGE_TOTAL && secs > 0) printf(" %10.0f", v.size() / secs);
+      printf("\n");
+      name = "";
+    }
+    printf("%-14s %lu sync, %lu not found, %lu errors\n", "",
+      (unsigned long)sync[op], (unsigned long)not_found[op], (unsigned long)errors[op]);
+  }
+
+  if (top <= 0 || recs.empty()) return;
+  std::vector<const kvs_trace_record *> slow;
+  for (const auto &r : recs) slow.push_back(&r);
+  const size_t n = std::min((size_t)top, slow.size());
+  std::partial_sort(slow.begin(), slow.begin() + n, slow.end(),
+    [](const kvs_trace_record *a, const kvs_trace_record *b) {
+      return span(a->submit_tsc, a->callback_tsc) > span(b->submit_tsc, b->callback_tsc);
+    });
+  printf("\nslowest commands\n");
+  printf("%12s %-12s %4s %8s %2s %16s %4s %8s %6s %10s %10s %10s %10s\n", "at(ms)",
+    "operation", "mode", "tid", "ks", "key hash", "klen", "bytes", "result", "queue(us)",
+    "device(us)", "cb(us)", "total(us)");
+  for (size_t i = 0; i < n; i++) {
+    const kvs_trace_record &r = *slow[i];
+    double us[NSTAGES];
+    stages(r, us);
+    const double device = (us[STAGE_DEVICE] >= 0) ? us[STAGE_DEVICE] : us[STAGE_DRIVER];
+    printf("%12.3f %-12s %4s %8u %2u %016lx %4u %8u %#6x", span(first, r.submit_tsc) / 1000.0,
+      op_name(r.opcode), (r.flags & KVS_TRACE_SYNC) ? "sync" : "aio", r.tid, r.ks_id,
+      (unsigned long)r.key_hash, r.key_len, r.value_bytes, r.result);
+    if (us[STAGE_QUEUE] >= 0) printf(" %10.1f", us[STAGE_QUEUE]);
+    else printf(" %10s", "-");
+    printf(" %10.1f %10.1f %10.1f\n", device, us[STAGE_CALLBACK], us[STAGE_TOTAL]);
+  }
+}
+
+// one line per operation, mode and stage with the total time in us,
+// the input of flamegraph.pl
+static void print_folded(const std::vector<kvs_trace_record> &recs) {
+  std::map<std::string, double> folded;
+  for (const auto &r : recs) {
+    double us[NSTAGES];
+    stages(r, us);
+    std::string prefix = std::string("kvs;") + op_name(r.opcode) + ";" +
+      ((r.flags & KVS_TRACE_SYNC) ? "sync" : "aio") + ";";
+    if (r.result == KVS_ERR_KEY_NOT_EXIST) prefix += "not_found;";
+    else if (r.result != KVS_SUCCESS) prefix += "error;";
+    for (int s = 0; s < STAGE_TOTAL; s++)
+      if (us[s] >= 0) folded[prefix + stage_names[s]] += us[s];
+  }
+  for (const auto &f : folded)
+    printf("%s %.0f\n", f.first.c_str(), f.second);
+}
+
+static void print_csv(const kvs_trace_header &hdr, const std::vector<kvs_trace_record> &recs) {
+  printf("submit_ns,dispatch_ns,complete_ns,callback_ns,operation,sync,tid,ks,"
+    "key_hash,key_len,value_bytes,result\n");
+  for (const auto &r : recs) {
+    const uint64_t base = hdr.start_tsc;
+    auto ns = [&](uint64_t tsc) -> long long {
+      return tsc ? (long long)(((double)tsc - (double)base) / tsc_per_ns) : -1;
+    };
+    printf("%lld,%lld,%lld,%lld,%s,%d,%u,%u,%016lx,%u,%u,%u\n", ns(r.submit_tsc),
+      ns(r.dispatch_tsc), ns(r.complete_tsc), ns(r.callback_tsc), op_name(r.opcode),
+      (r.flags & KVS_TRACE_SYNC) ? 1 : 0, r.tid, r.ks_id, (unsigned long)r.key_hash,
+      r.key_len, r.value_bytes, r.result);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int top = 10;
+  bool folded = false, csv = false;
+  int c;
+
+  while ((c = getopt(argc, argv, "n:fch")) != -1) {
+    switch (c) {
+      case 'n': top = atoi(optarg); break;
+      case 'f': folded = true; break;
+      case 'c': csv = true; break;
+      default: usage(argv[0]); return 1;
+    }
+  }
+  if (optind != argc - 1 || (folded && csv)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  FILE *fp = fopen(argv[optind], "rb");
+  if (!fp) {
+    perror(argv[optind]);
+    return 1;
+  }
+  kvs_trace_header hdr;
+  if (fread(&hdr, sizeof(hdr), 1, fp) != 1 || hdr.magic != KVS_TRACE_MAGIC) {
+    fprintf(stderr, "%s: not a trace file\n", argv[optind]);
+    return 1;
+  }
+  if (hdr.version != KVS_TRACE_VERSION || hdr.record_size != sizeof(kvs_trace_record)) {
+    fprintf(stderr, "%s: trace version %u is not supported\n", argv[optind], hdr.version);
+    return 1;
+  }
+  if (hdr.tsc_per_ns <= 0) {
+    // the writer didn't stop the trace
+    fprintf(stderr, "%s: trace is incomplete\n", argv[optind]);
+    return 1;
+  }
+  tsc_per_ns = hdr.tsc_per_ns;
+
+  std::vector<kvs_trace_record> recs;
+  kvs_trace_record r;
+  while (fread(&r, sizeof(r), 1, fp) == 1)
+    recs.push_back(r);
+  fclose(fp);
+
+  if (folded) print_folded(recs);
+  else if (csv) print_csv(hdr, recs);
+  else print_summary(hdr, recs, top);
+  return 0;
+}
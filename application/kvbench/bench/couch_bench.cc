@@ -24,6 +24,10 @@
 #include "stopwatch.h"
 #include "iniparser.h"
 #include "workload.h"
+#include "arrival.h"
+#include "results.h"
+#include "sweep.h"
+#include "perfctr.h"
 
 #include "arch.h"
 #include "zipfian_random.h"
@@ -85,6 +89,22 @@ couchstore_error_t couchstore_close_db(Db *db);
 #endif
 int64_t DATABUF_MAXLEN = 0;
 
+// what the benchmark threads issue
+enum workload_type {
+    WORKLOAD_RATIO = 0,   // read_write_insert_delete ratio or dedicated threads
+    WORKLOAD_YCSB,        // YCSB core workloads A-F
+    WORKLOAD_TRACE,       // replay of a trace loaded by keyloader
+};
+
+struct workload_info {
+    int type;
+    char ycsb;                 // 'a' ~ 'f'
+    int ratio[KL_OP_NTYPES];   // ycsb op mix in percent, indexed by KL_OP_*
+    uint32_t max_scan_length;
+    double trace_speed;        // 0: as fast as possible
+    uint64_t trace_ts0;        // timestamp of the first op of the trace
+};
+
 struct bench_info {
     uint8_t initialize;  // flag for initialization
     uint64_t cache_size; // buffer cache size (for fdb, rdb, ldb)
@@ -115,6 +135,14 @@ struct bench_info {
     char *core_ids;
     char *cq_thread_ids;
     int mem_size_mb;
+    uint8_t kv_packing;
+    uint32_t kv_packing_max_value;
+    uint8_t kv_packing_threshold;
+    uint8_t kv_qos;
+    uint32_t kv_qos_max_inflight;
+    uint32_t kv_qos_iops_limit;
+    uint64_t kv_qos_bandwidth_limit;
+    uint8_t kv_qos_class[5];    // by bench thread mode
     uint8_t with_iterator;
     uint8_t iterator_mode;
     //uint8_t is_polling;
@@ -146,8 +174,10 @@ struct bench_info {
     int split_pct;      // WiredTiger size of newly split page
     size_t leaf_pg_size, int_pg_size; //WiredTiger page sizes
 
-    uint32_t latency_rate; // sampling rate for latency monitoring
-    uint32_t latency_max; // max samples for latency monitoring
+    uint32_t latency_rate; // latency monitoring on/off (every op is recorded)
+    struct arrival_info arrival; // open-loop arrival process & target rate
+    struct workload_info workload;
+    struct sweep_info sweep;     // [sweep] parameters, npoints == 0 if none
 
     // # docs, # files, DB module name, filename
     //size_t ndocs;
@@ -158,6 +188,7 @@ struct bench_info {
     char *init_filename;
     char *filename;
     char *log_filename;
+    char *results;      // prefix of the machine-readable results or ""
     size_t nfiles;
 
     // population
@@ -185,6 +216,15 @@ struct bench_info {
     size_t writer_ops;
     int disjoint_write;
 
+    // scanner threads per DB instance, next to the benchmark threads
+    size_t nscanners;
+    uint8_t scan_prefix;        // prefix scans, full scans otherwise
+    uint8_t scan_values;        // key+value scans, key-only otherwise
+    uint8_t scan_bitmask[4];    // key group of a prefix scan, in key order
+    uint8_t scan_pattern[4];
+    uint8_t scan_rnd_pattern;   // the pattern is taken from a random key
+    uint8_t perf_counters;      // cpu cost per phase with perf_event counters
+
     // benchmark details
     struct rndinfo keylen;
     struct rndinfo prefixlen;
@@ -194,8 +234,16 @@ struct bench_info {
     size_t nbatches;
     size_t nops;
     size_t warmup_secs;
+    // warming up goes on after warmup_secs until the throughput is steady
+    double steady_cv;
+    int steady_window;
+    size_t steady_max_secs;
     size_t bench_secs;
     struct rndinfo batch_dist;
+    double hot_keys;            // hotspot: fraction of the keys in the hot set
+    double hot_ops;             // fraction of the ops going to the hot set
+    double hot_move;            // keys per second the hot set moves forward
+    uint64_t hot_epoch_ns;      // start of the movement
     struct rndinfo rbatchsize;
     struct rndinfo ibatchsize;
     struct rndinfo wbatchsize;
@@ -222,12 +270,19 @@ static uint32_t rnd_seed;
 static int print_term_ms = 100;
 static int filesize_chk_term = 4;
 static std::atomic<std::uint64_t> max_key_id;
+static std::atomic<int> workload_done_threads;
 
 FILE *log_fp = NULL;
 FILE *insert_latency_fp = NULL;
 FILE *insert_ops_fp = NULL;
 FILE *run_latency_fp = NULL;
 FILE *run_ops_fp = NULL;
+FILE *sweep_fp = NULL;
+// machine-readable results, see [log] results
+static struct results results_out;
+static bool results_on = false;
+// name of the current sweep point, "" if not sweeping
+static char sweep_tag[128] = "";
 
 #if defined(__KV_BENCH)
 extern int couch_kv_min_key_len;
@@ -376,6 +431,17 @@ int get_value_size_by_ratio(struct bench_info *binfo, size_t idx) {
   return value_size; 
 }
 
+// generates the key of seed r; keylen is 0 for variable-length keys, which
+// then keep the length the key generator picked for them
+static size_t _seed2key(struct bench_info *binfo, uint64_t r, char *buf,
+                        int keylen)
+{
+  size_t len = keygen_seed2key(&binfo->keygen, r, buf, keylen);
+
+  // fixed-length keys include the terminating NUL
+  return (keylen > 0) ? (size_t)keylen : len;
+}
+
 void _create_doc(struct bench_info *binfo,
                  size_t idx, Doc **pdoc,
                  DocInfo **pinfo, int seq_fill,
@@ -418,8 +484,7 @@ void _create_doc(struct bench_info *binfo,
 	      doc->id.size = binfo->keylen.a;
 	      keygen_seqfill(idx, doc->id.buf, binfo->keylen.a);
       } else {
-	      doc->id.size = binfo->keylen.a;
-	      keygen_seed2key(&binfo->keygen, idx, doc->id.buf, keylen);
+	      doc->id.size = _seed2key(binfo, idx, doc->id.buf, keylen);
       }
     }
 
@@ -524,13 +589,6 @@ void _create_doc(struct bench_info *binfo,
 
 }
 
-struct latency_thread_stat {
-  uint64_t cursor;
-  uint64_t nsamples;
-  uint64_t max_samples;
-  uint32_t *samples;
-};
-
 struct pop_thread_args {
     int tid;
     int n;
@@ -547,9 +605,414 @@ struct pop_thread_args {
     //uint64_t iocount;
     struct stopwatch *sw;
     struct stopwatch *sw_long;
-    struct latency_stat *l_write;
+    struct latency_stat *l_stat;
+};
+
+static const char *lat_op_name[LAT_NOPS] = {
+  "read", "write", "insert", "delete", "iterate", "scan", "rmw"
+};
+
+static struct latency_stat *_latency_stat_create()
+{
+  int k;
+  struct latency_stat *l_stat;
+
+  l_stat = (struct latency_stat *)calloc(1, sizeof(struct latency_stat));
+  for (k = 0; k < LAT_NOPS; ++k) {
+    if (hdr_init(&l_stat->hist[k])) {
+      fprintf(stderr, "WARN: failed to allocate latency histogram\n");
+      exit(1);
+    }
+  }
+  return l_stat;
+}
+
+static void _latency_stat_free(struct latency_stat *l_stat)
+{
+  int k;
+
+  for (k = 0; k < LAT_NOPS; ++k) {
+    hdr_free(&l_stat->hist[k]);
+  }
+  free(l_stat);
+}
+
+static void _latency_stat_reset(struct latency_stat *l_stat)
+{
+  int k;
+
+  for (k = 0; k < LAT_NOPS; ++k) {
+    hdr_reset(&l_stat->hist[k]);
+  }
+}
+
+// dst += src; src may be recorded into by its thread meanwhile
+static void _latency_stat_add(struct latency_stat *dst,
+                              struct latency_stat *src)
+{
+  int k;
+
+  for (k = 0; k < LAT_NOPS; ++k) {
+    hdr_add(&dst->hist[k], &src->hist[k]);
+  }
+}
+
+// dst -= src, src being an earlier merge of the same threads
+static void _latency_stat_sub(struct latency_stat *dst,
+                              struct latency_stat *src)
+{
+  int k;
+
+  for (k = 0; k < LAT_NOPS; ++k) {
+    hdr_sub(&dst->hist[k], &src->hist[k]);
+  }
+}
+
+// latency of each print_term_ms window, derived from the running totals
+struct latency_interval {
+  struct latency_stat *total;   // merged thread stats at this window
+  struct latency_stat *prev;    // merged thread stats at the last window
+  struct latency_stat *diff;    // this window only
+};
+
+static void _latency_interval_init(struct latency_interval *iv)
+{
+  iv->total = _latency_stat_create();
+  iv->prev = _latency_stat_create();
+  iv->diff = _latency_stat_create();
+}
+
+static void _latency_interval_free(struct latency_interval *iv)
+{
+  _latency_stat_free(iv->total);
+  _latency_stat_free(iv->prev);
+  _latency_stat_free(iv->diff);
+}
+
+// start a new window: add every thread's stats to iv->total afterwards
+static void _latency_interval_next(struct latency_interval *iv)
+{
+  struct latency_stat *tmp = iv->prev;
+
+  iv->prev = iv->total;
+  iv->total = tmp;
+  _latency_stat_reset(iv->total);
+}
+
+static void _latency_interval_diff(struct latency_interval *iv)
+{
+  _latency_stat_reset(iv->diff);
+  _latency_stat_add(iv->diff, iv->total);
+  _latency_stat_sub(iv->diff, iv->prev);
+}
+
+// ops .csv columns: p50, p99, p99.9 and max of a window in us
+static void _fprint_interval_header(FILE *fp, int op)
+{
+  const char *name = lat_op_name[op];
+
+  fprintf(fp, ",%s_p50,%s_p99,%s_p99.9,%s_max", name, name, name, name);
+}
+
+static void _fprint_run_ops_header(FILE *fp, struct bench_info *binfo)
+{
+  int k;
+
+  fprintf(fp, "time,ops_avg,ops_i,read_cnt,write_cnt,bytes_written");
+  if (binfo->arrival.process != ARRIVAL_CLOSED) {
+    fprintf(fp, ",ops_target");
+  }
+  if (binfo->latency_rate) {
+    for (k = 0; k < LAT_NOPS; ++k) {
+      _fprint_interval_header(fp, k);
+    }
+  }
+  fprintf(fp, "\n");
+}
+
+static void _fprint_interval(FILE *fp, struct hdr_hist *h)
+{
+  fprintf(fp, ",%.1f,%.1f,%.1f,%.1f",
+          hdr_value_at_percentile(h, 50) / 1000.0,
+          hdr_value_at_percentile(h, 99) / 1000.0,
+          hdr_value_at_percentile(h, 99.9) / 1000.0,
+          hdr_value_at_percentile(h, 100) / 1000.0);
+}
+
+// used capacity of the devices in %, < 0 if the DB module does not report it
+static double _device_util(Db **db, size_t ndb)
+{
+#if defined __KV_BENCH
+  DbInfo info;
+  double util = 0;
+  size_t i;
+
+  for (i = 0; i < ndb; ++i) {
+    memset(&info, 0, sizeof(info));
+    if (couchstore_db_info(db[i], &info) != COUCHSTORE_SUCCESS ||
+        info.file_size == 0) {
+      return -1;
+    }
+    util += info.space_used * 100.0 / info.file_size;
+  }
+  return (ndb) ? util / ndb : -1;
+#else
+  return -1;
+#endif
+}
+
+// each sweep point gets phases of its own, e.g. "run.qd16"
+static void _results_begin_phase(const char *phase)
+{
+  static char name[160];
+
+  if (sweep_tag[0]) {
+    snprintf(name, sizeof(name), "%s.%s", phase, sweep_tag);
+    phase = name;
+  }
+  results_begin_phase(&results_out, phase);
+}
+
+// adds the cpu and device utilization to an interval of the results
+static void _results_interval(struct results_interval *ri,
+                              struct results_cpu *prev, Db **db, size_t ndb)
+{
+  struct results_cpu now;
+
+  results_cpu_sample(&now);
+  results_cpu_util(prev, &now, &ri->cpu_proc, &ri->cpu_sys);
+  *prev = now;
+  ri->dev_util = _device_util(db, ndb);
+  results_interval(&results_out, ri);
+}
+
+static void _results_end_phase(double secs, uint64_t reads, uint64_t writes,
+                               uint64_t deletes, double target,
+                               struct results_cpu *begin, Db **db, size_t ndb,
+                               struct latency_stat *l_stat,
+                               double scan_keys, double scan_bytes,
+                               double *perf)
+{
+  struct results_summary rs;
+  struct results_cpu now;
+
+  results_cpu_sample(&now);
+  memset(&rs, 0, sizeof(rs));
+  rs.secs = secs;
+  rs.reads = reads;
+  rs.writes = writes;
+  rs.deletes = deletes;
+  rs.ops = (secs > 0) ? (reads + writes + deletes) / secs : 0;
+  rs.target = target;
+  results_cpu_util(begin, &now, &rs.cpu_proc, &rs.cpu_sys);
+  rs.dev_util = _device_util(db, ndb);
+  rs.scan_keys = scan_keys;
+  rs.scan_bytes = scan_bytes;
+  rs.cycles_op = (perf) ? perf[0] : -1;
+  rs.instr_op = (perf) ? perf[1] : -1;
+  rs.cpu_s_gb = (perf) ? perf[2] : -1;
+  rs.lat = (l_stat) ? l_stat->hist : NULL;
+  results_end_phase(&results_out, &rs);
+}
+
+// opens the perf_event counters of a phase if [perf] counters is set
+static bool _perf_begin(struct bench_info *binfo, struct perf_set *ps)
+{
+  if (!binfo->perf_counters) {
+    return false;
+  }
+  if (perf_open(ps) < 0) {
+    printf("WARN: perf_event counters are not available, "
+           "see /proc/sys/kernel/perf_event_paranoid\n");
+    perf_close(ps);
+    return false;
+  }
+  return true;
+}
+
+static void _perf_row(const char *name, int nthreads, const uint64_t *val,
+                      const int *avail, uint64_t ops)
+{
+  char buf[PERF_NCTRS][32], ipc[16] = "-";
+  double per_op[PERF_NCTRS];
+  int c;
+
+  for (c = 0; c < PERF_NCTRS; ++c) {
+    per_op[c] = (ops) ? (double)val[c] / ops : 0;
+    if (!avail[c]) {
+      strcpy(buf[c], "-");
+    } else if (c == PERF_TASK_CLOCK) {
+      sprintf(buf[c], "%.3f", val[c] / 1e9);
+    } else if (c == PERF_CONTEXT_SWITCHES) {
+      sprintf(buf[c], "%.4f", per_op[c]);
+    } else {
+      sprintf(buf[c], "%.1f", per_op[c]);
+    }
+  }
+  if (avail[PERF_CYCLES] && avail[PERF_INSTRUCTIONS] && val[PERF_CYCLES]) {
+    sprintf(ipc, "%.2f", (double)val[PERF_INSTRUCTIONS] / val[PERF_CYCLES]);
+  }
+  lprintf("%-8s %4d %10s %12s %12s %6s %10s %12s\n", name, nthreads,
+          buf[PERF_TASK_CLOCK], buf[PERF_CYCLES], buf[PERF_INSTRUCTIONS], ipc,
+          buf[PERF_CONTEXT_SWITCHES], buf[PERF_CACHE_MISSES]);
+}
+
+// prints the host cpu cost of a phase that did 'ops' ops and moved 'bytes'
+// bytes of keys and values, then closes the counters. perf[] gets cycles/op,
+// instructions/op and cpu-seconds per GB of all threads, < 0 if not counted
+static void _perf_end(struct perf_set *ps, struct perf_values *base,
+                      uint64_t ops, uint64_t bytes, double *perf)
+{
+  struct perf_values v;
+  uint64_t total[PERF_NCTRS];
+  int k, c, nthreads = 0;
+
+  perf_read(ps, &v);
+  if (base) {
+    perf_sub(&v, base);
+  }
+  memset(total, 0, sizeof(total));
+  for (k = 0; k < PERF_NCLASSES; ++k) {
+    nthreads += v.nthreads[k];
+    for (c = 0; c < PERF_NCTRS; ++c) {
+      total[c] += v.val[k][c];
+    }
+  }
+
+  lprintf("\ncpu counters (perf_event), per op of %" _F64 " ops:\n", ops);
+  lprintf("%-8s %4s %10s %12s %12s %6s %10s %12s\n", "threads", "n",
+          "cpu-s", "cycles", "instructions", "IPC", "ctx-sw", "cache-miss");
+  for (k = 0; k < PERF_NCLASSES; ++k) {
+    _perf_row(perf_class_name(k), v.nthreads[k], v.val[k], ps->avail, ops);
+  }
+  _perf_row("total", nthreads, total, ps->avail, ops);
+  if (ps->avail[PERF_TASK_CLOCK] && bytes) {
+    lprintf("cpu-s per GB moved: %.3f (bench %.3f, driver %.3f)\n",
+            total[PERF_TASK_CLOCK] / (bytes / 1e9) / 1e9,
+            v.val[PERF_BENCH][PERF_TASK_CLOCK] / (bytes / 1e9) / 1e9,
+            v.val[PERF_DRIVER][PERF_TASK_CLOCK] / (bytes / 1e9) / 1e9);
+  }
+
+  perf[0] = (ps->avail[PERF_CYCLES] && ops) ?
+            (double)total[PERF_CYCLES] / ops : -1;
+  perf[1] = (ps->avail[PERF_INSTRUCTIONS] && ops) ?
+            (double)total[PERF_INSTRUCTIONS] / ops : -1;
+  perf[2] = (ps->avail[PERF_TASK_CLOCK] && bytes) ?
+            total[PERF_TASK_CLOCK] / (bytes / 1e9) / 1e9 : -1;
+  perf_close(ps);
+}
+
+// one row per step of an open-loop rate profile
+struct arrival_step {
+  double begin, end;      // seconds into the profile
+  double target;          // target ops/sec
+  double achieved;        // ops/sec actually issued
+  uint64_t p50, p99, p999, max;
+};
+
+// results of each step of the rate profile, used to find the knee of the
+// latency/throughput curve
+struct arrival_report {
+  size_t seg;                 // current step
+  double begin;               // when the current step started
+  uint64_t ops_begin;         // ops issued before the current step
+  struct latency_stat *base;  // latencies recorded before the current step
+  struct arrival_step *steps;
+  size_t nsteps;
+  size_t cap;
 };
 
+static void _arrival_report_init(struct arrival_report *rep,
+                                 struct bench_info *binfo)
+{
+  memset(rep, 0, sizeof(struct arrival_report));
+  if (binfo->latency_rate) {
+    rep->base = _latency_stat_create();
+  }
+}
+
+static void _arrival_report_free(struct arrival_report *rep)
+{
+  if (rep->base) {
+    _latency_stat_free(rep->base);
+  }
+  free(rep->steps);
+}
+
+// close the current step when the profile has moved on (or at the end of
+// the run when 'last' is set); total is the latency of the whole run so far
+static void _arrival_report_tick(struct arrival_report *rep,
+                                 struct arrival_info *ai, double t,
+                                 uint64_t ops, struct latency_stat *total,
+                                 int last)
+{
+  struct arrival_step *step;
+  struct latency_stat *diff;
+  struct hdr_hist merged;
+  size_t seg = arrival_segment(ai, t);
+  int k;
+
+  if (seg == rep->seg && !last) {
+    return;
+  }
+  if (t > rep->begin) {
+    if (rep->nsteps == rep->cap) {
+      rep->cap = (rep->cap) ? rep->cap * 2 : 16;
+      rep->steps = (struct arrival_step *)
+        realloc(rep->steps, sizeof(struct arrival_step) * rep->cap);
+    }
+    step = &rep->steps[rep->nsteps++];
+    memset(step, 0, sizeof(struct arrival_step));
+    step->begin = rep->begin;
+    step->end = t;
+    step->target = (arrival_ops(ai, t) - arrival_ops(ai, rep->begin)) /
+                   (t - rep->begin);
+    step->achieved = (ops - rep->ops_begin) / (t - rep->begin);
+    if (rep->base && total) {
+      // latency of this step over all op types
+      diff = _latency_stat_create();
+      _latency_stat_add(diff, total);
+      _latency_stat_sub(diff, rep->base);
+      hdr_init(&merged);
+      for (k = 0; k < LAT_NOPS; ++k) {
+        hdr_add(&merged, &diff->hist[k]);
+      }
+      step->p50 = hdr_value_at_percentile(&merged, 50);
+      step->p99 = hdr_value_at_percentile(&merged, 99);
+      step->p999 = hdr_value_at_percentile(&merged, 99.9);
+      step->max = hdr_value_at_percentile(&merged, 100);
+      hdr_free(&merged);
+      _latency_stat_free(diff);
+    }
+  }
+  rep->seg = seg;
+  rep->begin = t;
+  rep->ops_begin = ops;
+  if (rep->base && total) {
+    _latency_stat_reset(rep->base);
+    _latency_stat_add(rep->base, total);
+  }
+}
+
+static void _arrival_report_print(struct arrival_report *rep)
+{
+  size_t i;
+  struct arrival_step *step;
+
+  if (rep->nsteps == 0) {
+    return;
+  }
+  lprintf("\nrate steps\n");
+  lprintf("begin,end,ops_target,ops_achieved,p50,p99,p99.9,max (us)\n");
+  for (i = 0; i < rep->nsteps; ++i) {
+    step = &rep->steps[i];
+    lprintf("%.1f,%.1f,%.2f,%.2f,%.1f,%.1f,%.1f,%.1f\n",
+            step->begin, step->end, step->target, step->achieved,
+            step->p50 / 1000.0, step->p99 / 1000.0,
+            step->p999 / 1000.0, step->max / 1000.0);
+  }
+}
+
 #define SET_DOC_RANGE(ndocs, nfiles, idx, begin, end) \
     begin = (ndocs) * ((idx)+0) / (nfiles); \
     end = (ndocs) * ((idx)+1) / (nfiles);
@@ -600,7 +1063,10 @@ static void _get_file_range(int t_idx, int num_threads, int num_files,
 
 int getevents(Db *db, int min, int max, IoContext **context, int tid);
 int release_context(Db *db, IoContext **contexts, int nr);
-void pass_lstat_to_db(Db *db, latency_stat *l_read, latency_stat *l_write, latency_stat *l_delete);
+void pass_lstat_to_db(Db *db, latency_stat *l_stat);
+void pass_op_start_to_db(Db *db, uint64_t start_ns);
+void reserve_ops_in_db(Db *db, int tid, int nops);
+couchstore_error_t couchstore_kvs_set_thread_qos(int qos_class);
 void *pop_thread(void *voidargs){
 
   //size_t i, k, c, n, db_idx, j;
@@ -619,21 +1085,17 @@ void *pop_thread(void *voidargs){
 #endif
 
   // Insertion latency monitoring
-  struct stopwatch sw_monitor, sw_latency;
-  struct timeval gap;
-  int curfile_no, sampling_ms, monitoring;
-  uint64_t cur_sample;
-  struct latency_stat *l_stat = args->l_write;
+  int curfile_no, monitoring;
+  uint64_t start_ns;
+  struct latency_stat *l_stat = args->l_stat;
 
   prctl(PR_SET_NAME, "Population", NULL, NULL, NULL);
+#if defined(__KV_BENCH)
+  couchstore_kvs_set_thread_qos(binfo->kv_qos_class[1]);
+#endif
 
-  if (binfo->latency_rate) {
-    sampling_ms = 1000 / binfo->latency_rate;
-  } else {
-    sampling_ms = 0;
-  }
+  monitoring = (l_stat) ? LAT_MONITOR(LAT_INSERT) : 0;
 
-  stopwatch_init_start(&sw_monitor);
 #if defined __AS_BENCH
   db_idx = args->n;
 #else  
@@ -643,8 +1105,10 @@ void *pop_thread(void *voidargs){
   c = (args->n % binfo->pop_nthreads) * batchsize;
 
 #if defined __KV_BENCH || defined __AS_BENCH  
-  if(binfo->kv_write_mode == 0)
-    pass_lstat_to_db(db, NULL, l_stat, NULL);
+  if(binfo->kv_write_mode == 0) {
+    pass_lstat_to_db(db, l_stat);
+    reserve_ops_in_db(db, args->tid, binfo->queue_depth);
+  }
 #endif
   
   if(binfo->kv_write_mode == 1) { // sync mode
@@ -676,22 +1140,8 @@ void *pop_thread(void *voidargs){
 #endif
       }
 
-      // TODO: add time check here
-      if (sampling_ms &&
-	      stopwatch_check_ms(&sw_monitor, sampling_ms)) {
-      	if (l_stat->cursor >= binfo->latency_max) {
-      	  l_stat->cursor = l_stat->cursor % binfo->latency_max;
-      	  l_stat->nsamples = binfo->latency_max;
-      	} else {
-      	  l_stat->nsamples = l_stat->cursor + 1;
-      	}
-      	cur_sample = l_stat->cursor;
-      	stopwatch_init_start(&sw_latency);
-      	stopwatch_start(&sw_monitor);
-      	monitoring = 1;
-      	l_stat->cursor++;
-      } else {
-	      monitoring = 0;
+      if (monitoring) {
+      	start_ns = latency_now_ns();
       }
 
 #if defined __KV_BENCH || defined __AS_BENCH
@@ -707,8 +1157,8 @@ void *pop_thread(void *voidargs){
       }
 
       if (monitoring) {
-      	gap = stopwatch_get_curtime(&sw_latency);
-      	l_stat->samples[cur_sample] = _timeval_to_us(gap);
+      	// one sample per batch
+      	latency_record(l_stat, LAT_INSERT, start_ns);
       }
       
       c += binfo->pop_nthreads * batchsize;
@@ -751,14 +1201,6 @@ void *pop_thread(void *voidargs){
       	_create_doc(binfo, c, &docs[0], NULL, binfo->seq_fill,
       		    args->socketid, args->keypool, args->valuepool, args->tid);
 
-      	if (sampling_ms &&
-      	    stopwatch_check_ms(&sw_monitor, sampling_ms)) {
-      	  stopwatch_start(&sw_monitor);
-      	  monitoring = 1;
-      	} else {
-      	  monitoring = 0;
-      	}
-
 	couchstore_save_documents(db, docs, NULL, 1, monitoring);
 	args->cur_qdepth++;
 
@@ -804,6 +1246,7 @@ void *pop_thread(void *voidargs){
   if(args->valuepool)
     destroy(binfo->allocatortype, args->valuepool);
 
+  return NULL;
 }
 
 
@@ -822,6 +1265,14 @@ void * pop_print_time(void *voidargs)
     struct pop_thread_args *args = (struct pop_thread_args *)voidargs;
     struct bench_info *binfo = args->binfo;
     struct timeval tv, tv_i;
+    struct latency_interval iv;
+    struct results_cpu cpu_prev;
+
+    prctl(PR_SET_NAME, "BenchPrinter", NULL, NULL, NULL);
+    if (binfo->latency_rate) {
+      _latency_interval_init(&iv);
+    }
+    results_cpu_sample(&cpu_prev);
 
     while(counter < binfo->ndocs * binfo->nfiles)
     {
@@ -870,11 +1321,35 @@ void * pop_print_time(void *voidargs)
       	printf(" (-%d s)", (int)remain_sec);
       	fflush(stdout);
 
+      	if (binfo->latency_rate && (insert_ops_fp || results_on)) {
+      	  _latency_interval_next(&iv);
+      	  for(i = 0; i < (int)(binfo->pop_nthreads * binfo->nfiles); i++) {
+      	    _latency_stat_add(iv.total, args->pop_args[i].l_stat);
+      	  }
+      	  _latency_interval_diff(&iv);
+      	}
       	if (insert_ops_fp) {
       	  fprintf(insert_ops_fp,
-      		  "%d.%01d,%.2f,%.2f,%" _F64 ",%" _F64 "\n",
+      		  "%d.%01d,%.2f,%.2f,%" _F64 ",%" _F64,
       		  (int)tv.tv_sec, (int)(tv.tv_usec/100000),
       		  iops, iops_i, (uint64_t)counter, bytes_written);
+      	  if (binfo->latency_rate) {
+      	    _fprint_interval(insert_ops_fp, &iv.diff->hist[LAT_INSERT]);
+      	  }
+      	  fprintf(insert_ops_fp, "\n");
+      	}
+      	if (results_on) {
+      	  struct results_interval ri;
+
+      	  memset(&ri, 0, sizeof(ri));
+      	  ri.time = tv.tv_sec + tv.tv_usec / 1000000.0;
+      	  ri.ops_avg = iops;
+      	  ri.ops_i = iops_i;
+      	  ri.target = -1;
+      	  ri.scan_keys_i = -1;
+      	  ri.writes = counter;
+      	  ri.lat = (binfo->latency_rate) ? iv.diff->hist : NULL;
+      	  _results_interval(&ri, &cpu_prev, args->db, binfo->nfiles);
       	}
       } else {
       	usleep(print_term_ms * 1000);
@@ -883,15 +1358,16 @@ void * pop_print_time(void *voidargs)
 
     }
 
+    if (binfo->latency_rate) {
+      _latency_interval_free(&iv);
+    }
     return NULL;
 }
 
 void _wait_leveldb_compaction(struct bench_info *binfo, Db **db);
 void _print_percentile(struct bench_info *binfo,
-		       struct latency_stat *l_wstat,
-		       struct latency_stat *l_rstat,
-		       struct latency_stat *l_dstat,
-		       const char *unit, int mode);
+		       struct latency_stat *l_stat, int mode);
+static uint64_t _avg_docsize(struct bench_info *binfo);
 void population(Db **db, struct bench_info *binfo)
 {
     size_t i, j;
@@ -903,9 +1379,18 @@ void population(Db **db, struct bench_info *binfo)
     struct timeval t1, t3;
     unsigned long long totalmicrosecs = 0;
     double iops = 0, latency_ms = 0;
+    struct latency_stat *l_stat = NULL;
+    struct results_cpu cpu_begin;
+    struct perf_set perf;
+    double perf_res[3];
+    bool perf_on;
     
     int keylen = (binfo->keylen.type == RND_FIXED)? binfo->keylen.a : 0;
     gettimeofday(&t1, NULL);
+    if (results_on) {
+      _results_begin_phase("load");
+      results_cpu_sample(&cpu_begin);
+    }
 
     stopwatch_init(&sw);
     stopwatch_start(&sw);
@@ -989,8 +1474,7 @@ void population(Db **db, struct bench_info *binfo)
       fprintf(stdout, "thread %d initialize key pool - base is %p, next free %p free %d\n", (int)i, args[i].keypool->base, args[i].keypool->nextfreeblock, args[i].keypool->num_freeblocks);
       fprintf(stdout, "thread %d initialize value pool - base is %p, next free %p free %d, unit size %ld\n", (int)i, args[i].valuepool->base, args[i].valuepool->nextfreeblock, args[i].valuepool->num_freeblocks, info_value.unitsize);
 
-      args[i].l_write = (struct latency_stat *)calloc(1, sizeof(struct latency_stat));
-      args[i].l_write->samples = (uint32_t*)malloc(sizeof(uint32_t) * binfo->latency_max);
+      args[i].l_stat = (binfo->latency_rate) ? _latency_stat_create() : NULL;
 
     }
 
@@ -1011,12 +1495,17 @@ void population(Db **db, struct bench_info *binfo)
       //thread_create(&tid[i], pop_thread, &args[i]);
 #endif
       } else {
-    	  if(insert_ops_fp)
-    	    fprintf(insert_ops_fp, "time,iops,iops_i,counter\n");
+    	  if(insert_ops_fp) {
+    	    fprintf(insert_ops_fp, "time,iops,iops_i,counter,bytes_written");
+    	    if (binfo->latency_rate)
+    	      _fprint_interval_header(insert_ops_fp, LAT_INSERT);
+    	    fprintf(insert_ops_fp, "\n");
+    	  }
     	  args[i].pop_args = args;
     	  thread_create(&tid[i], pop_print_time, &args[i]);
       }
     }
+    perf_on = _perf_begin(binfo, &perf);
 
     for (i=0; i<=binfo->pop_nthreads * binfo->nfiles; ++i) {
         thread_join(tid[i], &ret[i]);
@@ -1035,24 +1524,30 @@ void population(Db **db, struct bench_info *binfo)
     latency_ms = (long double)totalmicrosecs / ((long double) binfo->ndocs * (long double) binfo->nfiles);
     iops = 1000000 / latency_ms;
     lprintf("\nThroughput(Insertion) %.2f latency=%lf\n", iops, latency_ms);
+    if (perf_on) {
+      _perf_end(&perf, NULL, binfo->ndocs * binfo->nfiles,
+                binfo->ndocs * binfo->nfiles * _avg_docsize(binfo), perf_res);
+    }
 
     if(binfo->latency_rate){
 
-      struct latency_stat l_stat;
-      uint32_t *tmp;
-      memset(&l_stat, 0, sizeof(struct latency_stat));
-      l_stat.samples = (uint32_t*)malloc(sizeof(uint32_t) * binfo->latency_max * binfo->pop_nthreads * binfo->nfiles);
-      tmp = l_stat.samples;
+      l_stat = _latency_stat_create();
       for(i = 0; i < binfo->pop_nthreads * binfo->nfiles; i++){
-        l_stat.nsamples += args[i].l_write->nsamples;
-        memcpy(tmp, args[i].l_write->samples, sizeof(uint32_t) * args[i].l_write->nsamples);
-        tmp += args[i].l_write->nsamples;
-        free(args[i].l_write->samples);
+        _latency_stat_add(l_stat, args[i].l_stat);
+        _latency_stat_free(args[i].l_stat);
       }
 
-      _print_percentile(binfo, &l_stat, NULL, NULL, "us", 1);
+      _print_percentile(binfo, l_stat, 1);
       lprintf("\n");
-      free(l_stat.samples);
+    }
+    if (results_on) {
+      _results_end_phase(totalmicrosecs / 1000000.0, 0,
+                         binfo->ndocs * binfo->nfiles, 0, -1, &cpu_begin,
+                         db, binfo->nfiles, l_stat, -1, 0,
+                         (perf_on) ? perf_res : NULL);
+    }
+    if (l_stat) {
+      _latency_stat_free(l_stat);
     }
 #ifdef THREADPOOL
     //thpool_wait(thpool);
@@ -1233,19 +1728,13 @@ struct bench_thread_args {
     struct bench_result *result;
     struct zipf_rnd *zipf;
     struct bench_shared_stat *b_stat;
-    struct latency_stat *l_read;
-    struct latency_stat *l_write;
-    struct latency_stat *l_delete;
+    struct latency_stat *l_stat;
     std::atomic_uint_fast64_t op_read;
     std::atomic_uint_fast64_t op_write;
     std::atomic_uint_fast64_t op_delete;
     std::atomic_uint_fast64_t op_iter_key;
     mempool_t *keypool;
     mempool_t *valuepool;
-#ifdef __TIME_CHECK
-    struct latency_stat *l_prep;
-    struct latency_stat *l_real;
-#endif
     uint8_t terminate_signal;
     uint8_t op_signal;
 #if defined(__BLOBFS_ROCKS_BENCH)
@@ -1266,6 +1755,20 @@ struct compactor_args {
     spin_t *lock;
 };
 
+// scanner thread: scans key groups over and over until the end of the run
+struct scan_thread_args {
+    int id;
+    Db *db;
+    int own_db;                 // opened by the scanner, closed at the end
+    uint64_t rnd;
+    struct bench_info *binfo;
+    struct hdr_hist *scan_time; // ns per complete scan, shared by all scanners
+    std::atomic_uint_fast64_t keys;
+    std::atomic_uint_fast64_t bytes;
+    std::atomic_uint_fast64_t scans;
+    uint8_t terminate_signal;
+};
+
 #if defined(__COUCH_BENCH)
 couchstore_error_t couchstore_close_db(Db *db)
 {
@@ -1470,76 +1973,333 @@ couchstore_error_t couchstore_open_document_kvrocks(Db *db, const void *id,
 					    Doc **pDoc, couchstore_open_options options);
 couchstore_error_t couchstore_delete_document_kv(Db *db, sized_buf *key,
 						 couchstore_open_options options);
+couchstore_error_t couchstore_rmw_document_kv(Db *db, sized_buf *key,
+					      sized_buf *value,
+					      couchstore_open_options options);
 couchstore_error_t couchstore_iterator_open(Db *db, int options);
 couchstore_error_t couchstore_iterator_close(Db *db);
 couchstore_error_t couchstore_iterator_next(Db *db);
 bool couchstore_iterator_check_status(Db *db);
 int couchstore_iterator_get_numentries(Db *db);
 int couchstore_iterator_has_finish(Db *db);
-void * bench_thread(void *voidargs)
-{
-  struct bench_thread_args *args = (struct bench_thread_args *)voidargs;
-  size_t i;
-  int j;
-  int batchsize;
-  int write_mode = 0, write_mode_r;
-  int commit_mask[args->binfo->nfiles]; (void)commit_mask;
-  int curfile_no, sampling_ms, monitoring;
-  //double prob;
-  uint64_t cur_op_idx = 0;
-  char curfile[256], keybuf[MAX_KEYLEN];
-  uint64_t r, crc, op_med;
-  //uint64_t op_w, op_r, op_d, op_w_cum, op_r_cum, op_d_cum, op_w_turn, op_r_turn, op_d_turn;
-  uint64_t expected_us, elapsed_us, elapsed_sec;
-  uint64_t cur_sample;
-  Db **db;
-  int db_idx;
-  Doc *rq_doc = NULL;
-  sized_buf rq_id, rq_value;
-  struct rndinfo op_dist; //write_mode_random, op_dist;
-  struct bench_info *binfo = args->binfo;
-#ifdef __BENCH_RESULT
-  struct bench_result *result = args->result;
-#endif
-  struct zipf_rnd *zipf = args->zipf;
-  struct latency_stat *l_stat;
-  struct stopwatch sw, sw_monitor, sw_latency;
-  struct timeval gap;
-  couchstore_error_t err = COUCHSTORE_SUCCESS;
-  int keylen = (binfo->keylen.type == RND_FIXED)? binfo->keylen.a : 0;
-  long int total_entries = 0;
-  int iterator_send = 0;
-  uint64_t max_key_index = 0;
-  int singledb_thread_num = binfo->nreaders + binfo->niterators + binfo->nwriters + binfo->ndeleters;
-  uint64_t key_offset = 0;
 
-  prctl(PR_SET_NAME, THREAD_NAME[args->mode], NULL, NULL, NULL);
+// next op of a ycsb or trace workload, kept until it has been issued
+struct workload_cursor {
+  uint64_t idx;          // trace: next op to look at
+  uint64_t nops;         // ycsb: ops picked so far
+  uint64_t rnd;
+  uint64_t r;            // key index of the op
+  uint32_t value_size;   // trace: value size of a write, 0 if not given
+  uint32_t scan_len;
+  int write_mode;
+  uint8_t insert;
+  uint8_t pending;       // picked but not issued yet
+  uint8_t done;          // trace: no op left for this thread
+};
 
-  if (binfo->key_existing) {
-    if (args->mode == 0) {
-      max_key_index = binfo->ndocs;
-      if ((max_key_index % singledb_thread_num) > (args->id % singledb_thread_num)) {
-        max_key_index = max_key_index / singledb_thread_num + 1;
-      } else {
-        max_key_index = max_key_index / singledb_thread_num;
+// bench_thread write_mode of each KL_OP_*
+static const int workload_write_mode[KL_OP_NTYPES] = {2, 1, 1, 4, 6, 7};
+
+// picks the next op of a ycsb or trace workload for thread 'id' of
+// 'nthreads'; a timed trace op sets ag->next_ns to its scheduled start.
+// returns 0 when the trace has no op left for the thread
+static int _workload_pick(struct bench_info *binfo, struct workload_cursor *wc,
+                          int id, int nthreads, uint64_t op_med,
+                          struct arrival_gen *ag)
+{
+  struct workload_info *wl = &binfo->workload;
+  struct keyloader_op_info *op;
+  uint64_t nkeys;
+  int kl_op, acc;
+
+  if (wc->pending) {
+    return 1;
+  }
+  wc->value_size = 0;
+
+  if (wl->type == WORKLOAD_TRACE) {
+    // ops on the same key go to the same thread and keep their order
+    while ((op = keyloader_get_op(&binfo->kl, wc->idx)) != NULL &&
+           op->khash % nthreads != (uint32_t)id) {
+      wc->idx++;
+    }
+    if (op == NULL) {
+      if (!wc->done) {
+        wc->done = 1;
+        workload_done_threads++;
       }
-      key_offset = args->id % singledb_thread_num;
+      return 0;
+    }
+    kl_op = op->op;
+    wc->r = wc->idx++;
+    if (kl_op == KL_OP_SCAN) {
+      wc->scan_len = (op->value_size) ? op->value_size : 1;
+    } else {
+      wc->value_size = op->value_size;
+    }
+    if (wl->trace_speed > 0) {
+      ag->next_ns = ag->epoch_ns +
+        (uint64_t)((op->ts_us - wl->trace_ts0) * 1000.0 / wl->trace_speed);
+    }
+  } else {
+    // the op mix is applied the same way as read_write_insert_delete
+    acc = 0;
+    for (kl_op = 0; kl_op < KL_OP_NTYPES - 1; ++kl_op) {
+      acc += wl->ratio[kl_op];
+      if ((int)(wc->nops % 100) < acc) {
+        break;
+      }
+    }
+    wc->nops++;
+    nkeys = max_key_id.load();
+    if (nkeys == 0) {
+      nkeys = 1;
+    }
+    if (kl_op == KL_OP_INSERT) {
+      wc->r = max_key_id++;
+    } else {
+      wc->r = op_med % nkeys;
+    }
+    if (kl_op == KL_OP_SCAN) {
+      wc->rnd ^= wc->rnd << 13;
+      wc->rnd ^= wc->rnd >> 7;
+      wc->rnd ^= wc->rnd << 17;
+      wc->scan_len = wc->rnd % wl->max_scan_length + 1;
     }
   }
-#if defined(__BLOBFS_ROCKS_BENCH)
-  // Set up SPDK-specific stuff for this thread
-  rocksdb::SpdkInitializeThread();
-#endif
+  wc->insert = (kl_op == KL_OP_INSERT);
+  wc->write_mode = workload_write_mode[kl_op];
+  wc->pending = 1;
+  return 1;
+}
 
-#if defined (__FDB_BENCH) || defined(__WT_BENCH)
-  DocInfo *rq_info = NULL;
-#endif  
+static int _scan_callback(Db *db, int depth, const DocInfo *doc_info,
+                          uint64_t subtree_size, const sized_buf *reduce_value,
+                          void *ctx)
+{
+  uint32_t *remain = (uint32_t *)ctx;
 
-  rq_id.buf = NULL;
-  db = args->db;
-#if defined __KV_BENCH
-  db_idx = args->id / singledb_thread_num; // match each db to multiple-thread
-#elif defined __BLOBFS_ROCKS_BENCH
+  // a negative value stops the walk
+  return (doc_info && --(*remain) == 0) ? -1 : 0;
+}
+
+// key of document r
+static size_t _doc_key(struct bench_info *binfo, uint64_t r, char *keybuf)
+{
+  int keylen = (binfo->keylen.type == RND_FIXED)? binfo->keylen.a : 0;
+
+  if (binfo->keyfile) {
+    return keyloader_get_key(&binfo->kl, r, keybuf);
+  } else if (binfo->seq_fill) {
+    keygen_seqfill(r, keybuf, binfo->keylen.a);
+  } else {
+    return _seed2key(binfo, r, keybuf, keylen);
+  }
+  return binfo->keylen.a;
+}
+
+// visits up to len keys starting from the key of document r
+static couchstore_error_t _scan_docs(struct bench_info *binfo, Db *db,
+                                     uint64_t r, uint32_t len)
+{
+  char keybuf[MAX_KEYLEN];
+  sized_buf key;
+
+  key.buf = keybuf;
+  key.size = _doc_key(binfo, r, keybuf);
+#if defined __AS_BENCH
+  return COUCHSTORE_ERROR_INVALID_ARGUMENTS;
+#else
+  return couchstore_walk_id_tree(db, &key, COUCHSTORE_NO_DELETES,
+                                 _scan_callback, &len);
+#endif
+}
+
+#if !defined(__COUCH_BENCH) && !defined(__AS_BENCH) && !defined(__KVROCKS_BENCH)
+static int _scanner_callback(Db *db, int depth, const DocInfo *doc_info,
+                             uint64_t subtree_size, const sized_buf *reduce_value,
+                             void *ctx)
+{
+  struct scan_thread_args *args = (struct scan_thread_args *)ctx;
+
+  if (doc_info) {
+    args->keys.fetch_add(1, std::memory_order_relaxed);
+    args->bytes.fetch_add(doc_info->id.size + doc_info->size,
+                          std::memory_order_relaxed);
+  }
+  // the end of the run cuts a long scan short
+  return (args->terminate_signal) ? -1 : 0;
+}
+
+void * scan_thread(void *voidargs)
+{
+  struct scan_thread_args *args = (struct scan_thread_args *)voidargs;
+  struct bench_info *binfo = args->binfo;
+  char keybuf[MAX_KEYLEN];
+  uint8_t pattern[4];
+  uint64_t start_ns;
+  size_t i, len;
+  couchstore_error_t err;
+
+  prctl(PR_SET_NAME, "BenchScanner", NULL, NULL, NULL);
+#if defined(__KV_BENCH)
+  couchstore_kvs_set_thread_qos(binfo->kv_qos_class[3]);
+#endif
+  memcpy(pattern, binfo->scan_pattern, sizeof(pattern));
+
+  while (!args->terminate_signal) {
+    if (binfo->scan_prefix && binfo->scan_rnd_pattern && binfo->ndocs) {
+      // the key group of a random document, so that the scan finds keys
+      args->rnd ^= args->rnd << 13;
+      args->rnd ^= args->rnd >> 7;
+      args->rnd ^= args->rnd << 17;
+      len = _doc_key(binfo, args->rnd % binfo->ndocs, keybuf);
+      for (i = 0; i < sizeof(pattern); ++i) {
+        pattern[i] = (i < len) ? keybuf[i] & binfo->scan_bitmask[i] : 0;
+      }
+    }
+
+    start_ns = latency_now_ns();
+    err = couchstore_scan_docs(args->db,
+                               (binfo->scan_prefix) ? binfo->scan_bitmask : NULL,
+                               pattern, binfo->scan_values,
+                               _scanner_callback, args);
+    if (err != COUCHSTORE_SUCCESS) {
+      printf("WARN: scanner %d stopped: scan error %d\n", args->id, (int)err);
+      break;
+    }
+    if (!args->terminate_signal) {
+      hdr_record(args->scan_time, latency_now_ns() - start_ns);
+      args->scans.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  return NULL;
+}
+#endif
+
+// hotspot: hot_ops of the ops go to a hot set of hot_keys of the key range,
+// the rest to the other keys, uniform within each. The hot set moves forward
+// by hot_move keys per second, derived from the clock so that the threads
+// share no state
+static uint64_t _hotspot_get(struct bench_info *binfo, uint64_t r1, uint64_t r2)
+{
+  uint64_t nkeys = (binfo->batch_dist.b > 0) ? binfo->batch_dist.b : 1;
+  uint64_t hot, base = 0;
+
+  hot = (uint64_t)(nkeys * binfo->hot_keys);
+  if (hot == 0) {
+    hot = 1;
+  } else if (hot > nkeys) {
+    hot = nkeys;
+  }
+  if (binfo->hot_move > 0) {
+    base = (uint64_t)((latency_now_ns() - binfo->hot_epoch_ns) / 1e9 *
+                      binfo->hot_move) % nkeys;
+  }
+  if (hot == nkeys || r1 % 1000000 < binfo->hot_ops * 1000000) {
+    return (base + r2 % hot) % nkeys;
+  }
+  return (base + hot + r2 % (nkeys - hot)) % nkeys;
+}
+
+// sleep (or spin, when close) until the next arrival of an open-loop run;
+// returns 0 if the thread is asked to stop meanwhile
+static int _arrival_wait(struct arrival_gen *ag, struct bench_thread_args *args)
+{
+  uint64_t now, remain;
+
+  while (!args->terminate_signal && !(args->op_signal & OP_CLOSE)) {
+    now = latency_now_ns();
+    if (arrival_gen_due(ag, now)) {
+      return 1;
+    }
+    remain = ag->next_ns - now;
+    if (remain > 100000) {
+      // wake up a little early, usleep tends to oversleep
+      usleep(MIN(remain - 50000, 1000000) / 1000);
+    }
+  }
+  return 0;
+}
+
+void * bench_thread(void *voidargs)
+{
+  struct bench_thread_args *args = (struct bench_thread_args *)voidargs;
+  size_t i;
+  int j;
+  int batchsize;
+  int write_mode = 0, write_mode_r;
+  int commit_mask[args->binfo->nfiles]; (void)commit_mask;
+  int curfile_no, monitoring, lat_op;
+  //double prob;
+  uint64_t cur_op_idx = 0;
+  char curfile[256], keybuf[MAX_KEYLEN];
+  uint64_t r, crc, op_med, zrnd;
+  //uint64_t op_w, op_r, op_d, op_w_cum, op_r_cum, op_d_cum, op_w_turn, op_r_turn, op_d_turn;
+  uint64_t expected_us, elapsed_us, elapsed_sec;
+  // start of the op being timed: its intended start in open loop, its
+  // issue time in closed loop; only read for monitored ops
+  uint64_t start_ns = 0, intended_ns = 0;
+  Db **db;
+  int db_idx;
+  Doc *rq_doc = NULL;
+  sized_buf rq_id, rq_value;
+  struct rndinfo op_dist; //write_mode_random, op_dist;
+  struct bench_info *binfo = args->binfo;
+#ifdef __BENCH_RESULT
+  struct bench_result *result = args->result;
+#endif
+  struct zipf_rnd *zipf = args->zipf;
+  struct latency_stat *l_stat = args->l_stat;
+  struct stopwatch sw;
+  struct arrival_gen ag;
+  struct workload_cursor wc;
+  int trace = (binfo->workload.type == WORKLOAD_TRACE);
+  // ops have an intended start time, from the arrival process or the trace
+  int open_loop = (binfo->arrival.process != ARRIVAL_CLOSED) ||
+                  (trace && binfo->workload.trace_speed > 0);
+  int rmw_stage = 0;
+  uint64_t rmw_start_ns = 0;
+  couchstore_error_t err = COUCHSTORE_SUCCESS;
+  int keylen = (binfo->keylen.type == RND_FIXED)? binfo->keylen.a : 0;
+  long int total_entries = 0;
+  int iterator_send = 0;
+  uint64_t max_key_index = 0;
+  int singledb_thread_num = binfo->nreaders + binfo->niterators + binfo->nwriters + binfo->ndeleters;
+  uint64_t key_offset = 0;
+
+  prctl(PR_SET_NAME, THREAD_NAME[args->mode], NULL, NULL, NULL);
+#if defined(__KV_BENCH)
+  if (args->mode < 5) {
+    couchstore_kvs_set_thread_qos(binfo->kv_qos_class[args->mode]);
+  }
+#endif
+
+  if (binfo->key_existing) {
+    if (args->mode == 0) {
+      max_key_index = binfo->ndocs;
+      if ((max_key_index % singledb_thread_num) > (args->id % singledb_thread_num)) {
+        max_key_index = max_key_index / singledb_thread_num + 1;
+      } else {
+        max_key_index = max_key_index / singledb_thread_num;
+      }
+      key_offset = args->id % singledb_thread_num;
+    }
+  }
+#if defined(__BLOBFS_ROCKS_BENCH)
+  // Set up SPDK-specific stuff for this thread
+  rocksdb::SpdkInitializeThread();
+#endif
+
+#if defined (__FDB_BENCH) || defined(__WT_BENCH)
+  DocInfo *rq_info = NULL;
+#endif  
+
+  rq_id.buf = NULL;
+  db = args->db;
+#if defined __KV_BENCH
+  db_idx = args->id / singledb_thread_num; // match each db to multiple-thread
+#elif defined __BLOBFS_ROCKS_BENCH
   db_idx = args->id / singledb_thread_num;
 #else
   db_idx = 0; 
@@ -1548,8 +2308,11 @@ void * bench_thread(void *voidargs)
   elapsed_us = 0;
 
 #if defined __KV_BENCH || defined __AS_BENCH
-  if(binfo->kv_write_mode == 0)
-    pass_lstat_to_db(db[db_idx], args->l_read, args->l_write, args->l_delete);
+  if(binfo->kv_write_mode == 0) {
+    pass_lstat_to_db(db[db_idx], l_stat);
+    // one more for an iterator op
+    reserve_ops_in_db(db[db_idx], args->tid, binfo->queue_depth + 1);
+  }
 #endif
   
   /*
@@ -1564,13 +2327,14 @@ void * bench_thread(void *voidargs)
   BDR_RNG_NEXTPAIR;
   BDR_RNG_NEXTPAIR;
 
+  // the target rate is shared by all benchmark threads
+  arrival_gen_init(&ag, &binfo->arrival, singledb_thread_num * binfo->nfiles,
+                   crc, latency_now_ns());
+  memset(&wc, 0, sizeof(wc));
+  wc.rnd = crc | 1;
+  zrnd = MurmurHash64A(&crc, sizeof(crc), 1) | 1;
+
   stopwatch_init_start(&sw);
-  stopwatch_init_start(&sw_monitor);
-  if (binfo->latency_rate) {
-    sampling_ms = 1000 / binfo->latency_rate;
-  } else {
-    sampling_ms = 0;
-  }
   IoContext_t *contexts[COUCH_MAX_QUEUE_DEPTH];
 
 #if defined __KV_BENCH
@@ -1651,17 +2415,48 @@ void * bench_thread(void *voidargs)
       // uniform distribution
       BDR_RNG_NEXTPAIR;
       op_med = get_random(&binfo->batch_dist, rngz, rngz2);
+    } else if (binfo->batch_dist.type == RND_HOTSPOT) {
+      BDR_RNG_NEXTPAIR;
+      op_med = _hotspot_get(binfo, rngz, rngz2);
     } else {
-      // zipfian distribution
+      // zipfian distribution over groups of batch_dist.b documents; the
+      // latest distribution counts the ranks back from the newest key
       BDR_RNG_NEXTPAIR;
-      op_med = zipf_rnd_get(zipf);
+      op_med = zipf_rnd_get(zipf, &zrnd);
       op_med = op_med * binfo->batch_dist.b + (rngz % binfo->batch_dist.b);
+      if (binfo->batch_dist.type == RND_LATEST) {
+        uint64_t nkeys = max_key_id.load();
+        op_med = (nkeys) ? nkeys - 1 - op_med % nkeys : 0;
+      }
     }
     r = op_med;
 
+    if (binfo->workload.type != WORKLOAD_RATIO) {
+      if (!_workload_pick(binfo, &wc, args->id,
+                          singledb_thread_num * binfo->nfiles, op_med, &ag) &&
+          (binfo->kv_write_mode == 1 || args->cur_qdepth == 0)) {
+        // this thread is done with the trace
+        usleep(1000);
+        continue;
+      }
+      r = wc.r;
+    }
+
     if (binfo->kv_write_mode == 1) { // sync mode
 
-      if(args->mode > 0){
+      if (open_loop) {
+        // latency is measured from the intended start, so an op that is
+        // late because the previous one took too long is charged for it
+        if (!_arrival_wait(&ag, args)) {
+          continue;
+        }
+        intended_ns = (trace) ? ag.next_ns : arrival_gen_next(&ag);
+      }
+
+      if (binfo->workload.type != WORKLOAD_RATIO) {
+        write_mode = wc.write_mode;
+        wc.pending = 0;
+      } else if(args->mode > 0){
 	      write_mode = args->mode;
       } else {
       	if(cur_op_idx % 100 < binfo->ratio[1] + binfo->ratio[2]){
@@ -1675,47 +2470,43 @@ void * bench_thread(void *voidargs)
       	}
       	cur_op_idx++;
       }
-      
+
+      if (write_mode == 7) {
+        // read-modify-write: the read is followed by a write of the same key
+        rmw_stage = 1;
+        write_mode = 2;
+      }
+
+sync_op:
       if(write_mode == 1 || write_mode == 5) { // write
+        lat_op = (wc.insert) ? LAT_INSERT : LAT_WRITE;
         if (binfo->key_existing) {
           if (args->mode == 0) {
             if (write_mode == 5 && max_key_index != 0) { //update
               r = r % max_key_index;
             } else { //insert
               r = max_key_index++;
+              lat_op = LAT_INSERT;
             }
             r = r * singledb_thread_num + key_offset;
             write_mode = 1;
           } else {
              if (r > max_key_id) {
                r = max_key_id++;
+               lat_op = LAT_INSERT;
              }
           }
         }
 	      _create_doc(binfo, r, &rq_doc, NULL, binfo->seq_fill,
 		    args->socketid, args->keypool, args->valuepool, args->tid);
-
-      	if (sampling_ms && stopwatch_check_ms(&sw_monitor, sampling_ms)) {
-      	  if(write_mode == 2)
-      	    l_stat = args->l_read;
-      	  else if(write_mode == 1)
-      	    l_stat = args->l_write;
-      	  else
-      	    l_stat = args->l_delete;
-
-      	  l_stat->cursor++;
-      	  if (l_stat->cursor >= binfo->latency_max) {
-      	    l_stat->cursor = l_stat->cursor % binfo->latency_max;
-      	    l_stat->nsamples = binfo->latency_max;
-      	  } else {
-      	    l_stat->nsamples = l_stat->cursor;
-      	  }
-      	  cur_sample = l_stat->cursor;
-      	  stopwatch_init_start(&sw_latency);
-      	  stopwatch_start(&sw_monitor);
-      	  monitoring = 1;
-      	} else {
-      	  monitoring = 0;
+	      if (wc.value_size) {
+	        // value size of the trace op
+	        rq_doc->data.size = MIN(wc.value_size, binfo->vp_unitsize);
+	      }
+
+      	monitoring = (l_stat) ? LAT_MONITOR(lat_op) : 0;
+      	if (monitoring) {
+      	  start_ns = (open_loop) ? intended_ns : latency_now_ns();
       	}
 #if defined __AS_BENCH
       	err = couchstore_save_document(NULL, rq_doc,
@@ -1767,8 +2558,7 @@ void * bench_thread(void *voidargs)
     	    rq_id.size = binfo->keylen.a;
     	    keygen_seqfill(r, rq_id.buf, binfo->keylen.a);
     	  }else {
-    	    rq_id.size = binfo->keylen.a;
-    	    keygen_seed2key(&binfo->keygen, r, rq_id.buf, keylen);
+    	    rq_id.size = _seed2key(binfo, r, rq_id.buf, keylen);
     	  }
     	}
 #else
@@ -1804,8 +2594,7 @@ void * bench_thread(void *voidargs)
           rq_doc->id.size = binfo->keylen.a;
           keygen_seqfill(r, rq_doc->id.buf, binfo->keylen.a);
         } else {
-          rq_doc->id.size = binfo->keylen.a;
-          keygen_seed2key(&binfo->keygen, r, rq_doc->id.buf, keylen );
+          rq_doc->id.size = _seed2key(binfo, r, rq_doc->id.buf, keylen);
         }
       }
 
@@ -1816,29 +2605,16 @@ void * bench_thread(void *voidargs)
     	  rq_doc->data.size = get_value_size_by_ratio(binfo, r);
     	else
     	  rq_doc->data.size = binfo->bodylen.a; //binfo.binfo->vp_unitsize;
+    	if (trace) {
+    	  // any value size of the trace fits
+    	  rq_doc->data.size = binfo->vp_unitsize;
+    	}
 #endif
 
-    	if (sampling_ms &&
-    	    stopwatch_check_ms(&sw_monitor, sampling_ms)) {
-    	  if(write_mode == 2)
-    	    l_stat = args->l_read;
-    	  else if(write_mode == 1)
-    	    l_stat = args->l_write;
-    	  else
-    	    l_stat = args->l_delete;
-    	  l_stat->cursor++;
-    	  if (l_stat->cursor >= binfo->latency_max) {
-    	    l_stat->cursor = l_stat->cursor % binfo->latency_max;
-    	    l_stat->nsamples = binfo->latency_max;
-    	  } else {
-    	    l_stat->nsamples = l_stat->cursor;
-    	  }
-    	  cur_sample = l_stat->cursor;
-    	  stopwatch_init_start(&sw_latency);
-    	  stopwatch_start(&sw_monitor);
-    	  monitoring = 1;
-    	} else {
-    	  monitoring = 0;
+    	lat_op = LAT_READ;
+    	monitoring = (l_stat) ? LAT_MONITOR(lat_op) : 0;
+    	if (monitoring) {
+    	  start_ns = (open_loop) ? intended_ns : latency_now_ns();
     	}
 
 #if defined __KV_BENCH
@@ -1881,6 +2657,16 @@ void * bench_thread(void *voidargs)
     	  //rq_doc = NULL;
     	}
 
+      } else if (write_mode == 6) { // scan
+      	lat_op = LAT_SCAN;
+      	monitoring = (l_stat) ? LAT_MONITOR(lat_op) : 0;
+      	if (monitoring) {
+      	  start_ns = (open_loop) ? intended_ns : latency_now_ns();
+      	}
+      	err = _scan_docs(binfo, db[db_idx], r, wc.scan_len);
+      	if (err != COUCHSTORE_SUCCESS) {
+      	  printf("scan error: document number %" _F64 "\n", r);
+      	}
       } else { // delete
       	if(rq_doc == NULL) {
       	  rq_doc = (Doc *)malloc(sizeof(Doc));
@@ -1903,8 +2689,7 @@ void * bench_thread(void *voidargs)
       	    rq_doc->id.size = binfo->keylen.a;
       	    keygen_seqfill(r, rq_doc->id.buf, binfo->keylen.a);
       	  } else {
-      	    rq_doc->id.size = binfo->keylen.a;
-      	    keygen_seed2key(&binfo->keygen, r, rq_doc->id.buf, keylen);
+      	    rq_doc->id.size = _seed2key(binfo, r, rq_doc->id.buf, keylen);
       	  }
       	}
 
@@ -1912,29 +2697,10 @@ void * bench_thread(void *voidargs)
       	  rq_doc->data.buf = (char *)Allocate(args->valuepool);
       	rq_doc->data.size = binfo->bodylen.a; //binfo->vp_unitsize;
 
-      	if (sampling_ms &&
-      	  stopwatch_check_ms(&sw_monitor, sampling_ms)) {
-      	  if(write_mode == 2)
-      	    l_stat = args->l_read;
-      	  else if(write_mode == 1)
-      	    l_stat = args->l_write;
-      	  else
-      	    l_stat = args->l_delete;
-
-      	  l_stat->cursor++;
-      	  if (l_stat->cursor >= binfo->latency_max) {
-      	    l_stat->cursor = l_stat->cursor % binfo->latency_max;
-      	    l_stat->nsamples = binfo->latency_max;
-      	  } else {
-      	    l_stat->nsamples = l_stat->cursor;
-      	  }
-
-      	  cur_sample = l_stat->cursor;
-      	  stopwatch_init_start(&sw_latency);
-      	  stopwatch_start(&sw_monitor);
-      	  monitoring = 1;
-      	} else {
-      	  monitoring = 0;
+      	lat_op = LAT_DELETE;
+      	monitoring = (l_stat) ? LAT_MONITOR(lat_op) : 0;
+      	if (monitoring) {
+      	  start_ns = (open_loop) ? intended_ns : latency_now_ns();
       	}
 
       #if defined __KV_BENCH || defined __AS_BENCH
@@ -1948,14 +2714,27 @@ void * bench_thread(void *voidargs)
         rq_doc->data.buf = NULL;
       }
 
+      if (rmw_stage == 1) {
+        // write back the key just read
+        rmw_stage = 2;
+        // the read may not have been timed, the write may be
+        rmw_start_ns = (monitoring) ? start_ns :
+                       (open_loop) ? intended_ns : latency_now_ns();
+        write_mode = 1;
+        goto sync_op;
+      }
+      if (rmw_stage == 2) {
+        lat_op = LAT_RMW;
+        start_ns = rmw_start_ns;
+        rmw_stage = 0;
+      }
       if (monitoring) {
-      	gap = stopwatch_get_curtime(&sw_latency);
-      	l_stat->samples[cur_sample] = _timeval_to_us(gap);
+      	latency_record(l_stat, lat_op, start_ns);
       }
 
       if(write_mode == 1) {
       	args->op_write.fetch_add(1, std::memory_order_release);
-      } else if(write_mode == 2){
+      } else if(write_mode == 2 || write_mode == 6){
 	      args->op_read.fetch_add(1, std::memory_order_release);
       } else {
 	      args->op_delete.fetch_add(1, std::memory_order_release);
@@ -2003,8 +2782,15 @@ void * bench_thread(void *voidargs)
       	}
       }
 #endif
-      if(args->cur_qdepth < binfo->queue_depth) {
+      if(args->cur_qdepth < binfo->queue_depth && !wc.done &&
+         (!open_loop || arrival_gen_due(&ag, latency_now_ns()))) {
 	      if(args->terminate_signal) break;
+	      if (open_loop) {
+	        // the op keeps its intended start even if it was held back by
+	        // a full queue
+	        intended_ns = (trace) ? ag.next_ns : arrival_gen_next(&ag);
+	        pass_op_start_to_db(db[db_idx], intended_ns);
+	      }
 #if defined __KV_BENCH
       	if(binfo->with_iterator == 1  && args->tid == 0 && iterator_send == 0 && args->cur_qdepth < binfo->queue_depth - 1) {
       	  // Do one iterator operation first if (curr qdepth + 1 < max qdepth)
@@ -2021,7 +2807,10 @@ void * bench_thread(void *voidargs)
       	}
 #endif
 
-      	if(args->mode > 0){
+      	if (binfo->workload.type != WORKLOAD_RATIO) {
+      	  write_mode = wc.write_mode;
+      	  wc.pending = 0;
+      	} else if(args->mode > 0){
       	  write_mode = args->mode;
       	} else {
       	  if(cur_op_idx % 100 < binfo->ratio[1] + binfo->ratio[2]){
@@ -2037,40 +2826,41 @@ void * bench_thread(void *voidargs)
       	}
 
       	if (write_mode == 1 || write_mode == 5) { // write
+          lat_op = (wc.insert) ? LAT_INSERT : LAT_WRITE;
           if (binfo->key_existing) {
             if (args->mode == 0) {
               if (write_mode == 5 && max_key_index != 0) {
                 r = r % max_key_index;
               } else {
                 r = max_key_index++;
+                lat_op = LAT_INSERT;
               }
               r = r * singledb_thread_num + key_offset;
               write_mode = 1;
             } else if (args->mode > 0) {
-              if (r > max_key_id)
+              if (r > max_key_id) {
                 r = max_key_id++;
+                lat_op = LAT_INSERT;
+              }
             }
           }
       	  if(rq_doc == NULL) rq_doc = (Doc *)malloc(sizeof(Doc));
       	  _create_doc(binfo, r, &rq_doc, NULL, binfo->seq_fill,
       		      args->socketid, args->keypool, args->valuepool, args->tid);
+      	  if (wc.value_size) {
+      	    rq_doc->data.size = MIN(wc.value_size, binfo->vp_unitsize);
+      	  }
 #if !defined __KV_BENCH && !defined __AS_BENCH
 
 #else
-      	  if (sampling_ms &&
-      	      stopwatch_check_ms(&sw_monitor, sampling_ms)) {
-      	    stopwatch_start(&sw_monitor);
-      	    monitoring = 1;
-      	  }else {
-      	    monitoring = 0;
-      	  }
+      	  monitoring = (l_stat) ? LAT_MONITOR(lat_op) : 0;
 
       	  err = couchstore_save_document(db[db_idx], rq_doc,
       					 NULL, monitoring);
 
 #endif
 
-        } else if(write_mode == 2) { // read
+        } else if(write_mode == 2 || write_mode == 7) { // read, read-modify-write
 
       	  if(rq_doc == NULL) rq_doc = (Doc *)malloc(sizeof(Doc));
       	  rq_doc->id.buf = (char *)Allocate(args->keypool);
@@ -2091,8 +2881,7 @@ void * bench_thread(void *voidargs)
       	      rq_doc->id.size = binfo->keylen.a;
       	      keygen_seqfill(r, rq_doc->id.buf, binfo->keylen.a);
       	    } else{
-      	      rq_doc->id.size = binfo->keylen.a;
-      	      keygen_seed2key(&binfo->keygen, r, rq_doc->id.buf, keylen);
+      	      rq_doc->id.size = _seed2key(binfo, r, rq_doc->id.buf, keylen);
       	    }
       	  }
 
@@ -2102,18 +2891,21 @@ void * bench_thread(void *voidargs)
       	    rq_doc->data.size = get_value_size_by_ratio(binfo, r);
       	  else
       	    rq_doc->data.size = binfo->bodylen.a; //binfo->vp_unitsize;
-#endif
-      	  if (sampling_ms &&
-      	      stopwatch_check_ms(&sw_monitor, sampling_ms)) {
-      	    stopwatch_start(&sw_monitor);
-      	    monitoring = 1;
-      	  }else {
-      	    monitoring = 0;
+      	  if (trace) {
+      	    rq_doc->data.size = binfo->vp_unitsize;
       	  }
+#endif
+      	  lat_op = (write_mode == 7) ? LAT_RMW : LAT_READ;
+      	  monitoring = (l_stat) ? LAT_MONITOR(lat_op) : 0;
 
 #if defined __KV_BENCH
           rq_doc->id.tid = args->tid;
-      	  couchstore_open_document_kv(db[db_idx], &rq_doc->id, &rq_doc->data, monitoring);
+      	  if (write_mode == 7) {
+      	    // the wrapper writes the key back once the read completes
+      	    couchstore_rmw_document_kv(db[db_idx], &rq_doc->id, &rq_doc->data, monitoring);
+      	  } else {
+      	    couchstore_open_document_kv(db[db_idx], &rq_doc->id, &rq_doc->data, monitoring);
+      	  }
 
       	  //DeAllocate(rq_doc->id.buf, args->keypool);
 
@@ -2121,6 +2913,14 @@ void * bench_thread(void *voidargs)
 
       	  couchstore_open_document(db[db_idx], rq_doc->id.buf, rq_doc->id.size, NULL, monitoring);
 #endif
+        } else if (write_mode == 6) { // scan, issued synchronously
+      	  start_ns = (open_loop) ? intended_ns : latency_now_ns();
+      	  if (_scan_docs(binfo, db[db_idx], r, wc.scan_len) != COUCHSTORE_SUCCESS) {
+      	    printf("scan error: document number %" _F64 "\n", r);
+      	  }
+      	  if (l_stat) {
+      	    latency_record(l_stat, LAT_SCAN, start_ns);
+      	  }
         } else { // delete
       	  if(rq_doc == NULL) rq_doc = (Doc *)malloc(sizeof(Doc));
 
@@ -2140,8 +2940,7 @@ void * bench_thread(void *voidargs)
       	      rq_doc->id.size = binfo->keylen.a;
       	      keygen_seqfill(r, rq_doc->id.buf, binfo->keylen.a);
       	    } else {
-      	      rq_doc->id.size = binfo->keylen.a;
-      	      keygen_seed2key(&binfo->keygen, r, rq_doc->id.buf, keylen);
+      	      rq_doc->id.size = _seed2key(binfo, r, rq_doc->id.buf, keylen);
       	    }
       	  }
 
@@ -2149,13 +2948,8 @@ void * bench_thread(void *voidargs)
       	    rq_doc->data.buf = (char *)Allocate(args->valuepool);
       	  rq_doc->data.size = binfo->bodylen.a;// binfo->vp_unitsize;
 
-      	  if (sampling_ms &&
-      	      stopwatch_check_ms(&sw_monitor, sampling_ms)) {
-      	    stopwatch_start(&sw_monitor);
-      	    monitoring = 1;
-      	  }else {
-      	    monitoring = 0;
-      	  }
+      	  lat_op = LAT_DELETE;
+      	  monitoring = (l_stat) ? LAT_MONITOR(lat_op) : 0;
 
 #if defined __KV_BENCH || defined __AS_BENCH
           rq_doc->id.tid = args->tid;
@@ -2164,10 +2958,11 @@ void * bench_thread(void *voidargs)
       	  couchstore_delete_document(db[db_idx], rq_doc->id.buf, rq_doc->id.size, monitoring);
 #endif
       	}
-      	args->cur_qdepth++;
-      	if(write_mode == 1) {
+      	if (write_mode != 6)
+      	  args->cur_qdepth++;
+      	if(write_mode == 1 || write_mode == 7) {
       	  args->op_write.fetch_add(1, std::memory_order_release);
-      	} else if(write_mode == 2){
+      	} else if(write_mode == 2 || write_mode == 6){
       	  args->op_read.fetch_add(1, std::memory_order_release);
       	} else {
       	  args->op_delete.fetch_add(1, std::memory_order_release);
@@ -2203,6 +2998,13 @@ void * bench_thread(void *voidargs)
 
       if(args->cur_qdepth == binfo->queue_depth)
 	      usleep(1);
+      else if (open_loop && !arrival_gen_due(&ag, latency_now_ns())) {
+	      // nothing to issue yet, leave the CPU to the completions
+	      if (args->cur_qdepth == 0)
+	        _arrival_wait(&ag, args);
+	      else
+	        usleep(1);
+      }
 #endif
     } // end of async
     
@@ -2348,7 +3150,8 @@ couchstore_error_t couchstore_kvs_set_aio_option(int queue_depth, char *core_mas
 couchstore_error_t couchstore_kvs_set_aiothreads(int aio_threads);
 couchstore_error_t couchstore_kvs_set_coremask(char *core_ids);
 couchstore_error_t couchstore_kvs_get_aiocompletion(int32_t *count);
-couchstore_error_t couchstore_kvs_set_max_sample(uint32_t sample_num);
+couchstore_error_t couchstore_kvs_set_packing(int enable, uint32_t max_value_len, uint8_t compaction_threshold);
+couchstore_error_t couchstore_kvs_set_qos(int enable, uint32_t max_inflight, uint32_t iops_limit, uint64_t bandwidth_limit);
 
 static int _does_file_exist(char *filename) {
     struct stat st;
@@ -2386,78 +3189,18 @@ static char *_get_filename_pos(char *filename)
     return NULL;
 }
 
-static int _cmp_uint32_t(const void *key1, const void *key2)
-{
-    uint32_t a, b;
-    // must ensure that key1 and key2 are pointers to uint64_t values
-    a = *(uint32_t*)key1;
-    b = *(uint32_t*)key2;
-
-    if (a < b) {
-        return -1;
-    } else if (a > b) {
-        return 1;
-    } else {
-        return 0;
-    }
-}
-
-#ifdef __TIME_CHECK
-void _print_time(struct latency_stat *l_prep, struct latency_stat *l_real)
+void _print_latency(struct hdr_hist *h)
 {
+  double percentile[6] = {50, 90, 99, 99.9, 99.99, 99.999};
   int i;
-  if(timelog_fp) {
-    for(i = 0; i < l_prep->nsamples; i++) {
-      fprintf(timelog_fp, "%d %d\n", (int)l_prep->samples[i], (int)l_real->samples[i]);
-    }
-  }
-}
-#endif
 
-void _print_latency(struct bench_info *binfo,
-		    struct latency_stat *l_stat,
-		    const char *unit)
-{
-
-  int percentile[6] = {100, 500, 5000, 9500, 9900, 9999};
-  uint64_t i, pos, begin, end;
-  double avg = 0;
-
-  if (l_stat->nsamples < 100) {
-    // more than 100 samples are necessary
-    printf("not enough samples %ld\n", l_stat->nsamples);
-    return;
-  }
-
-  // sort
-  qsort(l_stat->samples, l_stat->nsamples, sizeof(uint32_t), _cmp_uint32_t);
-
-  // average (discard beyond 1% & 99%)
-  begin = l_stat->nsamples / 100;
-  end = l_stat->nsamples*99 / 100;
-  for (i=begin; i<end; ++i){
-    avg += l_stat->samples[i];
-  }
-  avg /= (end - begin);
-  lprintf("%d samples (%d Hz), average: %.2f %s\n",
-	  (int)l_stat->nsamples, (int)binfo->latency_rate,
-	  avg, unit);
-
-  for (i=0; i<6; ++i) { // screen: only 7 percentiles
-    pos = l_stat->nsamples * percentile[i] / 10000;
-    if( i == 5 && l_stat->nsamples < 10000){
-      lprintf("N/A %s (%.2f%%)",
-	      unit, (double)percentile[i] / 100);
-    }else {
-      lprintf("%d %s (%.2f%%)", (int)l_stat->samples[pos],
-	      unit, (double)percentile[i] / 100);
-    }
-    if (i+1 < 6) {
-      lprintf(", ");
-    } else {
-      lprintf("\n");
-    }
+  lprintf("%" _F64 " ops, average: %.2f us\n",
+	  h->count, hdr_mean(h) / 1000.0);
+  for (i=0; i<6; ++i) {
+    lprintf("%.2f us (%g%%), ",
+	    hdr_value_at_percentile(h, percentile[i]) / 1000.0, percentile[i]);
   }
+  lprintf("%.2f us (max)\n", h->max / 1000.0);
 }
 
 /*
@@ -2465,68 +3208,34 @@ void _print_latency(struct bench_info *binfo,
   mode = 2: evaluation  
  */
 void _print_percentile(struct bench_info *binfo,
-		       struct latency_stat *wl_stat,
-		       struct latency_stat *rl_stat,
-		       struct latency_stat *dl_stat,
-		       const char *unit, int mode)
+		       struct latency_stat *l_stat, int mode)
 {
-    int percentile[6] = {100, 500, 5000, 9500, 9900, 9999};
-    uint64_t i, pos1, pos2;
+    double tail[4] = {99.9, 99.99, 99.999, 100};
+    int i, k;
     FILE *tmp;
 
-    if(wl_stat) {
-      lprintf("\nwrite latency distribution\n"); 
-      _print_latency(binfo, wl_stat, unit);
-    }
-    if(rl_stat) {
-      lprintf("\nread latency distribution\n");
-      _print_latency(binfo, rl_stat, unit);
-    }
-    if(dl_stat) {
-      lprintf("\ndelete latency distribution\n");
-      _print_latency(binfo, dl_stat, unit);
+    for (k = 0; k < LAT_NOPS; ++k) {
+      if (l_stat->hist[k].count) {
+	lprintf("\n%s latency distribution\n", lat_op_name[k]);
+	_print_latency(&l_stat->hist[k]);
+      }
     }
 
-
     tmp = (mode == 1) ? insert_latency_fp : run_latency_fp; 
-    //TODO: add deletion stats
-    if (tmp) { // log file: all percentiles
-      fprintf(tmp, "pos,write,read,delete\n");
-      for (i=1;i<100;++i){
-      	/*
-      	if (wl_stat && rl_stat) {
-      	  pos1 = wl_stat->nsamples * i / 100;
-      	  pos2 = rl_stat->nsamples * i / 100;
-      	  fprintf(tmp, "%d,%d,%d\n", (int)i, (int)wl_stat->samples[pos1],(int)rl_stat->samples[pos2]);
-      	}
-      	else if(wl_stat) {
-      	  pos1 = wl_stat->nsamples * i / 100;
-      	  fprintf(tmp, "%d,%d,0\n", (int)i, (int)wl_stat->samples[pos1]);
-      	}
-      	else if(rl_stat) {
-      	  pos2 = rl_stat->nsamples * i / 100;
-      	  fprintf(tmp, "%d,0,%d\n", (int)i, (int)rl_stat->samples[pos2]);
-      	}
-      } // for loop
-      */
-      	if (wl_stat){
-      	  pos1 = wl_stat->nsamples * i / 100;
-      	  fprintf(tmp, "%d,%d,", (int)i, (int)wl_stat->samples[pos1]);
-      	} else {
-      	  fprintf(tmp, "%d,0,", (int)i);
-      	}
-      	if(rl_stat) {
-      	  pos1 = rl_stat->nsamples * i / 100;
-      	  fprintf(tmp, "%d,", (int)rl_stat->samples[pos1]);
-      	} else {
-      	  fprintf(tmp, "0,");
-      	}
-      	if(dl_stat) {
-      	  pos1 = dl_stat->nsamples * i / 100;
-      	  fprintf(tmp, "%d\n", (int)dl_stat->samples[pos1]);
-      	} else {
-      	  fprintf(tmp, "0\n");
-      	}
+    if (tmp) { // log file: all percentiles in us, 100 is the max
+      fprintf(tmp, "pos");
+      for (k = 0; k < LAT_NOPS; ++k) {
+	fprintf(tmp, ",%s", lat_op_name[k]);
+      }
+      fprintf(tmp, "\n");
+      for (i = 1; i < 100 + 4; ++i) {
+	double pos = (i < 100) ? i : tail[i - 100];
+	fprintf(tmp, "%g", pos);
+	for (k = 0; k < LAT_NOPS; ++k) {
+	  fprintf(tmp, ",%.1f",
+		  hdr_value_at_percentile(&l_stat->hist[k], pos) / 1000.0);
+	}
+	fprintf(tmp, "\n");
       }
     }
 }
@@ -2573,7 +3282,8 @@ void db_env_setup(struct bench_info *binfo){
     couchstore_kvs_set_aio_option(binfo->queue_depth, binfo->core_ids, binfo->cq_thread_ids, binfo->mem_size_mb);
     couchstore_kvs_set_aiothreads(binfo->aiothreads_per_device);
     couchstore_kvs_set_coremask(binfo->core_ids);
-    couchstore_kvs_set_max_sample(binfo->latency_max);
+    couchstore_kvs_set_packing(binfo->kv_packing, binfo->kv_packing_max_value, binfo->kv_packing_threshold);
+    couchstore_kvs_set_qos(binfo->kv_qos, binfo->kv_qos_max_inflight, binfo->kv_qos_iops_limit, binfo->kv_qos_bandwidth_limit);
     //}
     couchstore_setup_device(binfo->kv_device_path, NULL, binfo->kv_emul_configfile, binfo->nfiles, binfo->kv_write_mode, 0/*binfo->is_polling*/);
 #endif
@@ -2589,95 +3299,387 @@ void db_env_setup(struct bench_info *binfo){
 
 }
 
+// outcome of a benchmark run, one per sweep point
+struct bench_summary {
+  double secs;
+  uint64_t reads;
+  uint64_t writes;
+  uint64_t deletes;
+  int steady;                    // warming up found a steady state, -1: not checked
+  double scan_keys;              // keys/sec of the scanners, < 0 without
+  double scan_bytes;             // bytes/sec of the scanners
+  struct latency_stat *l_stat;   // latencies are added to it if not NULL
+};
+
+static uint64_t _avg_docsize(struct bench_info *binfo)
+{
+  uint64_t avg_docsize;
+
+  if (binfo->bodylen.type == RND_NORMAL || binfo->bodylen.type == RND_FIXED) {
+    avg_docsize = binfo->bodylen.a;
+  } else {
+    avg_docsize = (binfo->bodylen.a + binfo->bodylen.b)/2;
+  }
+
+  if (binfo->keylen.type == RND_NORMAL || binfo->keylen.type == RND_FIXED) {
+    avg_docsize += binfo->keylen.a;
+  } else {
+    avg_docsize += ((binfo->keylen.a + binfo->keylen.b)/2);
+  }
+  return avg_docsize;
+}
+
+// with steady_cv, warming up goes on after warmup_secs until the throughput
+// is steady, but not longer than steady_max_secs
+static bool _warmup_done(struct bench_info *binfo, bool steady, size_t secs)
+{
+  if (binfo->steady_cv <= 0) {
+    return true;
+  }
+  if (steady) {
+    lprintf("\nsteady state after %d s\n", (int)secs);
+    return true;
+  }
+  if (secs >= binfo->steady_max_secs) {
+    lprintf("\nWARN: no steady state after %d s (steady_cv %.1f %%)\n",
+            (int)secs, binfo->steady_cv);
+    return true;
+  }
+  return false;
+}
+
+// opens the DB instances the population phase writes to
+static void _pop_open_db(struct bench_info *binfo, Db **db, char **dev_path)
+{
+  int i;
+#if !defined(__KV_BENCH)
+  char curfile[256];
+#endif
+
+#if defined(__LEVEL_BENCH) || defined(__ROCKS_BENCH) || defined(__BLOBFS_ROCKS_BENCH) || defined(__KVDB_BENCH)
+  // LevelDB, RocksDB: set WBS size
+  couchstore_set_wbs_size(binfo->wbs_init);
+#endif
+
+#if defined __AS_BENCH
+  for (i = 0; i < (int)binfo->nfiles * binfo->pop_nthreads; ++i) {
+    couchstore_open_db(curfile, COUCHSTORE_OPEN_FLAG_CREATE, &db[i]);
+  }
+#else
+  for (i=0; i<(int)binfo->nfiles; ++i) {
+#if !defined(__KV_BENCH)
+    sprintf(curfile, "%s/%d", binfo->init_filename, i);
+    printf("db %d name is %s\n", i, curfile);
+#endif
+#if defined(__KV_BENCH)
+    couchstore_open_db_kvs(dev_path[i], &db[i], i);
+
+#elif defined(__KVROCKS_BENCH)
+    fprintf(stdout, "=== opening dev %s\n", dev_path[i]);
+    couchstore_open_db(dev_path[i], COUCHSTORE_OPEN_FLAG_CREATE, &db[i]);
+#else
+#if defined(__FDB_BENCH)
+    if (!binfo->pop_commit) {
+      // set wal_flush_before_commit flag (0x1)
+      // clear auto_commit (0x10)
+      couchstore_set_flags(0x1);
+    }
+#endif
+    couchstore_open_db(curfile, COUCHSTORE_OPEN_FLAG_CREATE, &db[i]);
+#endif
+#if defined(__LEVEL_BENCH) || defined(__ROCKS_BENCH) || defined(__KVROCKS_BENCH) || defined(__BLOBFS_ROCKS_BENCH) || defined(__KVDB_BENCH)
+    if (!binfo->pop_commit) {
+      couchstore_set_sync(db[i], 0);
+    }
+#endif
+  }
+#endif
+}
+
+#if !defined __KVROCKS_BENCH && !defined __KV_BENCH && !defined __BLOBFS_ROCKS_BENCH
+// closes what _pop_open_db() opened, for the modules whose benchmark
+// threads open DB instances of their own
+static void _pop_close_db(struct bench_info *binfo, Db **db)
+{
+  int i;
+
+#if defined __AS_BENCH
+  for (i=0; i<(int)binfo->nfiles * binfo->pop_nthreads; ++i){
+    printf("close db %d\n", i);
+    couchstore_close_db(db[i]);
+  }
+#else
+  for (i=0; i<(int)binfo->nfiles; ++i){
+    printf("close db %d\n", i);
+    couchstore_close_db(db[i]);
+  }
+#endif
+}
+#endif
+
+void _set_keygen(struct bench_info *binfo);
+static void _bench_run(struct bench_info *binfo, Db **db, int *compaction_no,
+                       uint64_t written_init, struct stopwatch *sw_setup,
+                       struct bench_summary *sum);
+
+// sets the parameters of sweep point 'idx'
+static void _sweep_apply(struct bench_info *binfo, size_t idx)
+{
+  struct sweep_point p;
+  int val;
+
+  sweep_get_point(&binfo->sweep, idx, &p);
+  sweep_point_name(&binfo->sweep, &p, sweep_tag, sizeof(sweep_tag));
+
+  if ((val = p.val[SWEEP_QUEUE_DEPTH]) > 0) {
+    binfo->queue_depth = val;
+  }
+  if ((val = p.val[SWEEP_THREADS]) > 0) {
+    // every thread runs the mixed workload
+    binfo->nreaders = val;
+    binfo->nwriters = binfo->ndeleters = binfo->niterators = 0;
+  }
+  if ((val = p.val[SWEEP_SCANNERS]) >= 0) {
+    binfo->nscanners = val;
+  }
+  if ((val = p.val[SWEEP_VALUE_SIZE]) > 0) {
+    binfo->bodylen.type = RND_FIXED;
+    binfo->bodylen.a = binfo->bodylen.b = val;
+  }
+  if ((val = p.val[SWEEP_KEY_LENGTH]) > 0 &&
+      (binfo->keylen.type != RND_FIXED || (int)binfo->keylen.a != val)) {
+    binfo->keylen.type = RND_FIXED;
+    binfo->keylen.a = binfo->keylen.b = val;
+    keygen_free(&binfo->keygen);
+    _set_keygen(binfo);
+  }
+}
+
+// populates the DB instances again for a point with other keys or values
+static void _sweep_populate(struct bench_info *binfo, Db **db, char **dev_path)
+{
+  if (binfo->pop_nthreads == 0 || binfo->nfiles == 0 || binfo->ndocs == 0) {
+    return;
+  }
+  lprintf("\npopulate for %s\n", sweep_tag);
+#if defined(__KV_BENCH) || defined(__KVROCKS_BENCH) || defined(__BLOBFS_ROCKS_BENCH)
+  // the DB instances stay open
+  (void)dev_path;
+  population(db, binfo);
+#else
+  _pop_open_db(binfo, db, dev_path);
+  population(db, binfo);
+  _pop_close_db(binfo, db);
+#endif
+}
+
+// latency-vs-throughput table: one block per curve, i.e. per combination of
+// all but the innermost swept parameter
+static void _sweep_print(struct bench_info *binfo, struct bench_summary *sums,
+                         size_t npoints)
+{
+  struct sweep_info *si = &binfo->sweep;
+  struct sweep_point p;
+  struct bench_summary *s;
+  int inner = -1, k, d;
+  bool active[LAT_NOPS], scans = false;
+  double ops;
+  size_t i;
+
+  for (d = 0; d < SWEEP_NPARAMS && inner < 0; ++d) {
+    if (si->dim[d].n > 1) {
+      inner = d;
+    }
+  }
+  for (d = 0; d < SWEEP_NPARAMS && inner < 0; ++d) {
+    if (si->dim[d].n) {
+      inner = d;
+    }
+  }
+  for (k = 0; k < LAT_NOPS; ++k) {
+    active[k] = false;
+    for (i = 0; i < npoints; ++i) {
+      if (sums[i].l_stat && sums[i].l_stat->hist[k].count) {
+        active[k] = true;
+      }
+    }
+  }
+  for (i = 0; i < npoints; ++i) {
+    if (sums[i].scan_keys >= 0) {
+      scans = true;
+    }
+  }
+
+  lprintf("\nsweep: %d point%s, latency in us\n", (int)npoints,
+          (npoints == 1) ? "" : "s");
+  for (i = 0; i < npoints; ++i) {
+    s = &sums[i];
+    sweep_get_point(si, i, &p);
+    if (i == 0 || sweep_curve(si, i) != sweep_curve(si, i - 1)) {
+      // header of a curve: the parameters it holds fixed
+      lprintf("\ncurve %d:", (int)sweep_curve(si, i) + 1);
+      for (d = SWEEP_NPARAMS - 1; d >= 0; --d) {
+        if (d != inner && si->dim[d].n) {
+          lprintf(" %s %d", sweep_param_name(d), p.val[d]);
+        }
+      }
+      lprintf("\n%12s %12s %6s", sweep_param_name(inner), "ops/s", "steady");
+      if (scans) {
+        lprintf(" %12s %10s", "scan_keys/s", "scan_MB/s");
+      }
+      for (k = 0; k < LAT_NOPS; ++k) {
+        if (active[k]) {
+          lprintf(" %8s_p50 %8s_p99 %7s_p99.9", lat_op_name[k],
+                  lat_op_name[k], lat_op_name[k]);
+        }
+      }
+      lprintf("\n");
+    }
+    ops = (s->secs > 0) ? (s->reads + s->writes + s->deletes) / s->secs : 0;
+    lprintf("%12d %12.2f %6s", p.val[inner], ops,
+            (s->steady < 0) ? "-" : (s->steady) ? "yes" : "no");
+    if (scans) {
+      lprintf(" %12.2f %10.2f", (s->scan_keys > 0) ? s->scan_keys : 0,
+              (s->scan_keys > 0) ? s->scan_bytes / 1000000.0 : 0);
+    }
+    for (k = 0; k < LAT_NOPS; ++k) {
+      if (active[k]) {
+        struct hdr_hist *h = &s->l_stat->hist[k];
+        lprintf(" %12.1f %12.1f %13.1f",
+                hdr_value_at_percentile(h, 50) / 1000.0,
+                hdr_value_at_percentile(h, 99) / 1000.0,
+                hdr_value_at_percentile(h, 99.9) / 1000.0);
+      }
+    }
+    lprintf("\n");
+
+    if (sweep_fp) {
+      fprintf(sweep_fp, "%d", (int)sweep_curve(si, i) + 1);
+      for (d = 0; d < SWEEP_NPARAMS; ++d) {
+        fprintf(sweep_fp, ",%d", p.val[d]);
+      }
+      fprintf(sweep_fp, ",%.2f,%.2f,%" _F64 ",%" _F64 ",%" _F64 ",%d,%.2f,%.2f",
+              s->secs, ops, s->reads, s->writes, s->deletes, s->steady,
+              (s->scan_keys > 0) ? s->scan_keys : 0,
+              (s->scan_keys > 0) ? s->scan_bytes : 0);
+      if (binfo->latency_rate) {
+        for (k = 0; k < LAT_NOPS; ++k) {
+          _fprint_interval(sweep_fp, &s->l_stat->hist[k]);
+        }
+      }
+      fprintf(sweep_fp, "\n");
+    }
+  }
+  lprintf("\n");
+}
+
+// runs every point of the sweep on the populated DB instances; the dataset
+// is kept while the key and value size stay the same
+static void _sweep_run(struct bench_info *binfo, Db **db, int *compaction_no,
+                       char **dev_path, uint64_t written_init,
+                       struct stopwatch *sw_setup)
+{
+  struct sweep_info *si = &binfo->sweep;
+  struct bench_summary *sums;
+  struct rndinfo keylen, bodylen;
+  char cmd[256];
+  size_t i, npoints = 0;
+  int d, k;
+
+  sums = (struct bench_summary *)calloc(si->npoints, sizeof(struct bench_summary));
+  if (sweep_fp) {
+    fprintf(sweep_fp, "curve");
+    for (d = 0; d < SWEEP_NPARAMS; ++d) {
+      fprintf(sweep_fp, ",%s", sweep_param_name(d));
+    }
+    fprintf(sweep_fp, ",secs,ops,reads,writes,deletes,steady,scan_keys,scan_bytes");
+    if (binfo->latency_rate) {
+      for (k = 0; k < LAT_NOPS; ++k) {
+        _fprint_interval_header(sweep_fp, k);
+      }
+    }
+    fprintf(sweep_fp, "\n");
+  }
+
+  for (i = 0; i < si->npoints && !got_signal; ++i) {
+    keylen = binfo->keylen;
+    bodylen = binfo->bodylen;
+    _sweep_apply(binfo, i);
+    lprintf("\n=== sweep point %d/%d: %s\n", (int)i + 1, (int)si->npoints,
+            sweep_tag);
+    if (i > 0 &&
+        (memcmp(&keylen, &binfo->keylen, sizeof(keylen)) ||
+         memcmp(&bodylen, &binfo->bodylen, sizeof(bodylen)))) {
+      if (binfo->initialize && binfo->pop_first) {
+        _sweep_populate(binfo, db, dev_path);
+      } else {
+        printf("WARN: %s changes the key or value size of a dataset "
+               "that is not populated by kvbench\n", sweep_tag);
+      }
+    }
+#if !defined __KV_BENCH && !defined __AS_BENCH
+    if (i > 0) {
+      written_init = print_proc_io_stat(cmd, 0);
+    }
+#endif
+    (void)cmd;
+    sums[i].l_stat = (binfo->latency_rate) ? _latency_stat_create() : NULL;
+    _bench_run(binfo, db, compaction_no, written_init,
+               (i == 0) ? sw_setup : NULL, &sums[i]);
+    npoints++;
+  }
+  sweep_tag[0] = 0;
+
+  _sweep_print(binfo, sums, npoints);
+  for (i = 0; i < npoints; ++i) {
+    if (sums[i].l_stat) {
+      _latency_stat_free(sums[i].l_stat);
+    }
+  }
+  free(sums);
+}
+
 void do_bench(struct bench_info *binfo)
 {
-  BDR_RNG_VARS;
-  int i, j, ret; (void)j; (void)ret;
-  int curfile_no, compaction_turn;
-  int compaction_no[binfo->nfiles], total_compaction = 0;
-  int cur_compaction = -1;
-  int bench_threads, singledb_thread_num, first_db_idx;
-  uint64_t op_count_read, op_count_write, op_count_delete, op_count_iter_key, display_tick = 0;
-  uint64_t prev_op_count_read, prev_op_count_write, prev_op_count_delete;
+  int i, ret; (void)ret;
+  int compaction_no[binfo->nfiles];
   uint64_t written_init, written_final, written_prev;
-  uint64_t nand_written_init, nand_written_final;
+#if !defined __KV_BENCH && !defined __AS_BENCH
   uint64_t avg_docsize;
-  char curfile[256], newfile[256], bodybuf[1024], cmd[256];
-  char fsize1[128], fsize2[128], *str;
-  char spaces[128];
-  void *compactor_ret;
-  void **bench_worker_ret;
+  char bodybuf[1024], cmd[256];
+#endif
   double gap_double;
-  bool warmingup = false;
-  bool startlog = false;
 #if defined __AS_BENCH
   Db *db[binfo->nfiles * binfo->pop_nthreads];
 #else
   Db *db[binfo->nfiles];
 #endif
-  
-#ifdef __FDB_BENCH
-  Db *info_handle[binfo->nfiles];
-#endif
 #if defined(__KV_BENCH) || defined(__AS_BENCH) || defined(__KVROCKS_BENCH)
   //int32_t dev_id[binfo->nfiles];
   char *dev_path[binfo->nfiles]; 
+#else
+  char **dev_path = NULL;
 #endif
-#if defined(__AS_BENCH)
-  // hosts & port
-  const char *host;
-  uint16_t port;
-#endif
-#ifdef __BLOBFS_ROCKS_BENCH
-  //rocksdb::Env *blobfs_env;
-#endif
-  DbInfo *dbinfo;
-  thread_t tid_compactor;
-  thread_t *bench_worker;
-  spin_t cur_compaction_lock;
-  struct stopwatch sw, sw_compaction, progress;
-  struct timeval gap, _gap;
-  struct zipf_rnd zipf;
+  struct stopwatch sw, sw_bench;
+  struct timeval gap;
   struct bench_result result;
-  struct bench_shared_stat b_stat;
-  struct bench_thread_args *b_args;
-  //struct latency_stat l_read, l_write, l_delete;
-#if defined(__FDB_BENCH) || defined(__COUCH_BENCH)
-  struct compactor_args c_args;
-#endif
-  FILE *tmp;
 
   memleak_start();
 
-  spin_init(&cur_compaction_lock);
-
-  dbinfo = (DbInfo *)malloc(sizeof(DbInfo));
   stopwatch_init(&sw);
-  stopwatch_init(&sw_compaction);
 
   _bench_result_init(&result, binfo);
 
   written_init = written_final = written_prev = 0;
-  memset(&tid_compactor, 0x0, sizeof(tid_compactor));
-
-  if (binfo->bodylen.type == RND_NORMAL || binfo->bodylen.type == RND_FIXED) {
-    avg_docsize = binfo->bodylen.a;
-  } else {
-    avg_docsize = (binfo->bodylen.a + binfo->bodylen.b)/2;
-  }
-  
-  if (binfo->keylen.type == RND_NORMAL || binfo->keylen.type == RND_FIXED) {
-    avg_docsize += binfo->keylen.a;
-  } else {
-    avg_docsize += ((binfo->keylen.a + binfo->keylen.b)/2);
-  }
-
-  strcpy(fsize1, print_filesize_approx(0, cmd));
-  strcpy(fsize2, print_filesize_approx(0, cmd));
-  memset(spaces, ' ', 80);
-  spaces[80] = 0;
 
   db_env_setup(binfo);
+  if (binfo->sweep.npoints) {
+    // the dataset is populated for the first point
+    _sweep_apply(binfo, 0);
+  }
+#if !defined __KV_BENCH && !defined __AS_BENCH
+  avg_docsize = _avg_docsize(binfo);
+#endif
   
 #if defined(__KV_BENCH) || defined (__KVROCKS_BENCH) 
   // open device only once
@@ -2705,7 +3707,6 @@ void do_bench(struct bench_info *binfo)
       if (ret && !(answer[0] == 'Y' || answer[0] == 'y')) {
       	lprintf("Terminate benchmark ..\n\n");
 
-      	free(dbinfo);
       	_bench_result_free(&result);
       	memleak_end();
       	return;
@@ -2731,46 +3732,10 @@ void do_bench(struct bench_info *binfo)
       couchstore_set_idx_type(binfo->wt_type);
       couchstore_open_conn((char*)binfo->filename);
 #endif
-#if defined(__LEVEL_BENCH) || defined(__ROCKS_BENCH) || defined(__BLOBFS_ROCKS_BENCH) || defined(__KVDB_BENCH)
-      // LevelDB, RocksDB: set WBS size
-      couchstore_set_wbs_size(binfo->wbs_init);
-#endif
-
-
-#if defined __AS_BENCH
-      for (i = 0; i < (int)binfo->nfiles * binfo->pop_nthreads; ++i) {
-	      couchstore_open_db(curfile, COUCHSTORE_OPEN_FLAG_CREATE, &db[i]);
-      }
-#else
       for (i=0; i<(int)binfo->nfiles; ++i) {
-	      compaction_no[i] = 0;
-#if !defined(__KV_BENCH)
-      	sprintf(curfile, "%s/%d", binfo->init_filename, i);
-      	printf("db %d name is %s\n", i, curfile);
-#endif
-#if defined(__KV_BENCH)
-      	couchstore_open_db_kvs(dev_path[i], &db[i], i);
-
-#elif defined(__KVROCKS_BENCH)
-      	fprintf(stdout, "=== opening dev %s\n", dev_path[i]);
-      	couchstore_open_db(dev_path[i], COUCHSTORE_OPEN_FLAG_CREATE, &db[i]);
-#else
-#if defined(__FDB_BENCH)
-      	if (!binfo->pop_commit) {
-      	  // set wal_flush_before_commit flag (0x1)
-      	  // clear auto_commit (0x10)
-      	  couchstore_set_flags(0x1);
-      	}
-#endif
-        couchstore_open_db(curfile, COUCHSTORE_OPEN_FLAG_CREATE, &db[i]);
-#endif
-#if defined(__LEVEL_BENCH) || defined(__ROCKS_BENCH) || defined(__KVROCKS_BENCH) || defined(__BLOBFS_ROCKS_BENCH) || defined(__KVDB_BENCH)
-      	if (!binfo->pop_commit) {
-      	  couchstore_set_sync(db[i], 0);
-      	}
-#endif
+        compaction_no[i] = 0;
       }
-#endif
+      _pop_open_db(binfo, db, dev_path);
 
       stopwatch_start(&sw);
       if(binfo->pop_nthreads != 0 && binfo->nfiles != 0 && binfo->ndocs != 0)
@@ -2804,17 +3769,7 @@ void do_bench(struct bench_info *binfo)
 #endif
 
 #if !defined __KVROCKS_BENCH && !defined __KV_BENCH && !defined __BLOBFS_ROCKS_BENCH
-#if defined __AS_BENCH
-      for (i=0; i<(int)binfo->nfiles * binfo->pop_nthreads; ++i){
-      	printf("close db %d\n", i);
-      	couchstore_close_db(db[i]);
-      }
-#else
-      for (i=0; i<(int)binfo->nfiles; ++i){
-      	printf("close db %d\n", i);
-      	couchstore_close_db(db[i]);
-      }
-#endif
+      _pop_close_db(binfo, db);
 #endif
       gap = stopwatch_stop(&sw);
 #if defined(__LEVEL_BENCH) || defined(__ROCKS_BENCH) || defined(__BLOBFS_ROCKS_BENCH) || defined(__KVDB_BENCH)
@@ -2857,9 +3812,208 @@ void do_bench(struct bench_info *binfo)
       couchstore_open_db_kvs(dev_path[i], &db[i], i);
     }
 #endif
-  } // load existing files
+  } // load existing files
+
+  stopwatch_init_start(&sw_bench);
+  if (binfo->sweep.npoints) {
+    _sweep_run(binfo, db, compaction_no, dev_path, written_init, &sw);
+  } else {
+    _bench_run(binfo, db, compaction_no, written_init, &sw, NULL);
+  }
+
+  keygen_free(&binfo->keygen);
+  if (binfo->keyfile) {
+    keyloader_free(&binfo->kl);
+  }
+  arrival_free(&binfo->arrival);
+
+#ifdef __FDB_BENCH
+  // print ForestDB's own block cache info (internal function call)
+  //bcache_print_items();
+#endif
+
+  printf("waiting for termination of DB module..\n");
+#if defined(__KV_BENCH) || defined(__KVROCKS_BENCH) || defined __BLOBFS_ROCKS_BENCH
+  for (i=0;i<(int)binfo->nfiles;++i){
+    couchstore_close_db(db[i]);
+  }
+#endif
+
+#if defined(__KV_BENCH) ||  defined(__BLOBFS_ROCKS_BENCH)
+  //for (j = 0; j< binfo->nfiles; j++)
+  //couchstore_close_device(dev_id[j]);
+  couchstore_exit_env();
+#endif
+#if defined (__AS_BENCH)
+  couchstore_close_device(binfo->ndocs);
+#endif
+#if defined(__WT_BENCH) || defined(__FDB_BENCH)
+  couchstore_close_conn();
+#endif
+  
+  lprintf("\n");
+  stopwatch_stop(&sw_bench);
+  gap = sw_bench.elapsed;
+  LOG_PRINT_TIME(gap, " sec elapsed\n");
+
+  _bench_result_print(&result);
+  _bench_result_free(&result);
+  /*
+  spin_destroy(&b_stat.lock);
+  spin_destroy(&l_read.lock);
+  spin_destroy(&l_write.lock);
+
+  free(l_read.samples);
+  free(l_write.samples);
+  */
+  memleak_end();
+}
+
+// keys, bytes and complete scans of all scanner threads so far
+static void _scanners_sum(struct bench_info *binfo,
+                          struct scan_thread_args *s_args,
+                          uint64_t *keys, uint64_t *bytes, uint64_t *scans)
+{
+  size_t i;
+
+  *keys = *bytes = *scans = 0;
+  for (i = 0; s_args && i < binfo->nscanners * binfo->nfiles; ++i) {
+    *keys += s_args[i].keys.load();
+    *bytes += s_args[i].bytes.load();
+    *scans += s_args[i].scans.load();
+  }
+}
+
+#if !defined(__COUCH_BENCH) && !defined(__AS_BENCH) && !defined(__KVROCKS_BENCH)
+// starts binfo->nscanners scanner threads per DB instance; they use the DB
+// handles of the benchmark threads where the module shares them
+static struct scan_thread_args * _scanners_start(struct bench_info *binfo,
+                                                 Db **db,
+                                                 struct bench_thread_args *b_args,
+                                                 int *compaction_no,
+                                                 int singledb_thread_num,
+                                                 struct hdr_hist *scan_time,
+                                                 thread_t *scan_worker)
+{
+  struct scan_thread_args *s_args;
+  int i, db_idx;
+  int scan_threads = binfo->nscanners * binfo->nfiles;
+  char curfile[256];
+  (void)db; (void)b_args; (void)compaction_no; (void)singledb_thread_num;
+  (void)curfile;
+
+  s_args = (struct scan_thread_args *)calloc(scan_threads,
+                                             sizeof(struct scan_thread_args));
+  for (i = 0; i < scan_threads; ++i) {
+    db_idx = i / binfo->nscanners;
+    s_args[i].id = i;
+    s_args[i].binfo = binfo;
+    s_args[i].scan_time = scan_time;
+    s_args[i].rnd = MurmurHash64A(&i, sizeof(i), rnd_seed) | 1;
+    s_args[i].keys = s_args[i].bytes = s_args[i].scans = 0;
+    s_args[i].terminate_signal = 0;
+#if defined(__FDB_BENCH) || defined(__WT_BENCH)
+    // a handle is used by one thread only
+    sprintf(curfile, "%s%d.%d", binfo->filename, db_idx, compaction_no[db_idx]);
+    couchstore_open_db(curfile, COUCHSTORE_OPEN_FLAG_CREATE, &s_args[i].db);
+    s_args[i].own_db = 1;
+#elif defined(__ROCKS_BENCH) || defined (__LEVEL_BENCH) || defined(__KVDB_BENCH)
+    s_args[i].db = b_args[db_idx * singledb_thread_num].db[0];
+#else
+    s_args[i].db = db[db_idx];
+#endif
+    thread_create(&scan_worker[i], scan_thread, (void*)&s_args[i]);
+  }
+  return s_args;
+}
+
+static void _scanners_stop(struct bench_info *binfo,
+                           struct scan_thread_args *s_args,
+                           thread_t *scan_worker)
+{
+  int i;
+  int scan_threads = binfo->nscanners * binfo->nfiles;
+  void *ret;
+
+  for (i = 0; i < scan_threads; ++i) {
+    s_args[i].terminate_signal = 1;
+  }
+  for (i = 0; i < scan_threads; ++i) {
+    thread_join(scan_worker[i], &ret);
+    if (s_args[i].own_db) {
+      couchstore_close_db(s_args[i].db);
+    }
+  }
+}
+#endif
+
+// benchmark phase on the DB instances do_bench() has set up; sw_setup, if
+// given, measured the setup. The outcome is added to 'sum' if not NULL
+static void _bench_run(struct bench_info *binfo, Db **db, int *compaction_no,
+                       uint64_t written_init, struct stopwatch *sw_setup,
+                       struct bench_summary *sum)
+{
+  BDR_RNG_VARS;
+  int i, j, k, ret; (void)j; (void)ret;
+  int curfile_no, compaction_turn;
+  int total_compaction = 0;
+  int cur_compaction = -1;
+  int bench_threads, singledb_thread_num, first_db_idx;
+  uint64_t op_count_read, op_count_write, op_count_delete, op_count_iter_key, display_tick = 0;
+  uint64_t prev_op_count_read, prev_op_count_write, prev_op_count_delete;
+  uint64_t written_final, written_prev;
+  uint64_t avg_docsize;
+#if !defined __KV_BENCH && !defined __KVROCKS_BENCH && !defined __BLOBFS_ROCKS_BENCH
+  char curfile[256];
+#endif
+  char bodybuf[1024], cmd[256];
+  char fsize1[128], fsize2[128];
+  char spaces[128];
+  void **bench_worker_ret;
+  double gap_double;
+  bool warmingup = false;
+  bool startlog = false;
+  bool steady = false;
+#ifdef __FDB_BENCH
+  Db *info_handle[binfo->nfiles];
+#endif
+  DbInfo *dbinfo;
+  thread_t *bench_worker;
+  struct stopwatch sw, sw_compaction, progress;
+  struct timeval gap, _gap;
+  struct zipf_rnd zipf;
+  struct bench_shared_stat b_stat;
+  struct bench_thread_args *b_args;
+  struct latency_interval l_iv;
+  struct latency_stat *l_base = NULL;  // totals at the end of warming up
+  struct arrival_report a_rep;
+  struct steady_state ss;
+  int open_loop = (binfo->arrival.process != ARRIVAL_CLOSED);
+  double t_arrival = 0, t_arrival_prev = 0;
+  struct results_cpu r_cpu_begin, r_cpu_prev;
+  struct scan_thread_args *s_args = NULL;
+  thread_t *scan_worker = NULL;
+  struct hdr_hist scan_time, scan_base;
+  uint64_t scan_keys = 0, scan_bytes = 0, scan_count = 0, prev_scan_keys = 0;
+  double scan_keys_i = -1, scan_keys_sec = -1, scan_bytes_sec = 0;
+  struct perf_set perf;
+  struct perf_values perf_base;
+  double perf_res[3];
+  bool perf_on, perf_warm = false;
+  FILE *tmp;
+
+  dbinfo = (DbInfo *)malloc(sizeof(DbInfo));
+  stopwatch_init(&sw);
+  stopwatch_init(&sw_compaction);
+
+  written_final = written_prev = written_init;
+  avg_docsize = _avg_docsize(binfo);
+
+  strcpy(fsize1, print_filesize_approx(0, cmd));
+  strcpy(fsize2, print_filesize_approx(0, cmd));
+  memset(spaces, ' ', 80);
+  spaces[80] = 0;
 
-    
   // ==== perform benchmark ====
   lprintf("\nbenchmark\n");
   lprintf("opening DB instance .. \n");
@@ -2880,16 +4034,20 @@ void do_bench(struct bench_info *binfo)
   }
 #endif
 
-  if (binfo->batch_dist.type == RND_ZIPFIAN) {
-    // zipfian distribution .. initialize zipf_rnd
+  if (binfo->batch_dist.type == RND_ZIPFIAN ||
+      binfo->batch_dist.type == RND_LATEST) {
+    // zipfian distribution .. initialize zipf_rnd; the hot groups are
+    // scrambled over the key space, except for the latest distribution
+    uint64_t seed = (binfo->batch_dist.type == RND_ZIPFIAN) ? rnd_seed | 1 : 0;
     if(binfo->nops > 0) {
       zipf_rnd_init(&zipf, (binfo->ndocs + binfo->nops * binfo->ratio[2] * 2) / binfo->batch_dist.b,
-		    binfo->batch_dist.a/100.0, 1024*1024);
+		    binfo->batch_dist.a/100.0, seed);
     } else {
       zipf_rnd_init(&zipf, binfo->ndocs * binfo->amp_factor / binfo->batch_dist.b,
-		    binfo->batch_dist.a/100.0, 1024*1024);
+		    binfo->batch_dist.a/100.0, seed);
     }
   }
+  binfo->hot_epoch_ns = latency_now_ns();
 
   // set signal handler
   old_handler = signal(SIGINT, signal_handler);
@@ -2931,7 +4089,8 @@ void do_bench(struct bench_info *binfo)
   info_value.alignment = binfo->vp_alignment;
   
   for (i=0;i<bench_threads;++i){
-    if(total_ratio > 0 && total_ratio <= 100) {   
+    if((total_ratio > 0 && total_ratio <= 100) ||
+       binfo->workload.type != WORKLOAD_RATIO) {
       b_args[i].mode = 0; // mixed workload in one thread
     } else { // no ratio control, dedicated thread for each operation
       if ((size_t)i % singledb_thread_num < binfo->nwriters) {
@@ -2950,12 +4109,7 @@ void do_bench(struct bench_info *binfo)
     b_args[i].rnd_seed = rnd_seed;
     b_args[i].compaction_no = compaction_no;
     b_args[i].b_stat = &b_stat;
-    b_args[i].l_read = (struct latency_stat *)calloc(1, sizeof(struct latency_stat));
-    b_args[i].l_write = (struct latency_stat *)calloc(1, sizeof(struct latency_stat));
-    b_args[i].l_delete = (struct latency_stat *)calloc(1, sizeof(struct latency_stat));
-    b_args[i].l_read->samples = (uint32_t*)malloc(sizeof(uint32_t) * binfo->latency_max);
-    b_args[i].l_write->samples = (uint32_t*)malloc(sizeof(uint32_t) * binfo->latency_max);
-    b_args[i].l_delete->samples = (uint32_t*)malloc(sizeof(uint32_t) * binfo->latency_max);
+    b_args[i].l_stat = (binfo->latency_rate) ? _latency_stat_create() : NULL;
     b_args[i].op_read = b_args[i].op_write = b_args[i].op_delete = b_args[i].op_iter_key = 0;
     b_args[i].cur_qdepth = 0;
     
@@ -3076,15 +4230,39 @@ void do_bench(struct bench_info *binfo)
 
   bench_worker_ret = alca(void*, bench_threads);
 
+  // the rate profile starts now, and starts over at the end of warming up
+  binfo->arrival.epoch_ns = latency_now_ns();
+  workload_done_threads = 0;
+  if (binfo->workload.type == WORKLOAD_YCSB && max_key_id == 0) {
+    // population was skipped, the keys of an earlier run are in use
+    max_key_id = binfo->ndocs;
+  }
+  if (open_loop) {
+    _arrival_report_init(&a_rep, binfo);
+  }
+
   for(i = 0; i < bench_threads; ++i){
     b_args[i].tid = i;
     pthread_create(&bench_worker[i], &attr[i], bench_thread, (void*)&b_args[i]);
   }
+  if (binfo->nscanners) {
+    hdr_init(&scan_time);
+    hdr_init(&scan_base);
+    scan_worker = (thread_t *)malloc(sizeof(thread_t) *
+                                     binfo->nscanners * binfo->nfiles);
+#if !defined(__COUCH_BENCH) && !defined(__AS_BENCH) && !defined(__KVROCKS_BENCH)
+    s_args = _scanners_start(binfo, db, b_args, compaction_no,
+                             singledb_thread_num, &scan_time, scan_worker);
+#endif
+  }
+  perf_on = _perf_begin(binfo, &perf);
 
   prev_op_count_read = prev_op_count_write = prev_op_count_delete = 0;
-  gap = stopwatch_stop(&sw);
-  if(binfo->pop_first)
-    LOG_PRINT_TIME(gap, " sec elapsed\n");
+  if (sw_setup) {
+    gap = stopwatch_stop(sw_setup);
+    if(binfo->pop_first)
+      LOG_PRINT_TIME(gap, " sec elapsed\n");
+  }
   
   // timer for total elapsed time
   stopwatch_init(&sw);
@@ -3094,14 +4272,28 @@ void do_bench(struct bench_info *binfo)
   stopwatch_init(&progress);
   stopwatch_start(&progress);
 
+  if (binfo->latency_rate) {
+    _latency_interval_init(&l_iv);
+  }
+
   if (binfo->warmup_secs) {
     warmingup = true;
+    if (binfo->steady_cv > 0) {
+      steady_init(&ss, binfo->steady_window, binfo->steady_cv);
+    }
     lprintf("\nwarming up\n");
-    lprintf("time,ops_avg,ops_i,read_cnt,write_cnt,bytes_written\n");
+    printf("time,ops_avg,ops_i,read_cnt,write_cnt,bytes_written\n");
+    if (log_fp)
+      _fprint_run_ops_header(log_fp, binfo);
   }
 
   if(run_ops_fp)
-    fprintf(run_ops_fp, "time,ops_avg,ops_i,read_cnt,write_cnt,bytes_written\n");
+    _fprint_run_ops_header(run_ops_fp, binfo);
+  if (results_on && !warmingup) {
+    _results_begin_phase("run");
+    results_cpu_sample(&r_cpu_begin);
+    r_cpu_prev = r_cpu_begin;
+  }
 
   i = 0;
   while (i < (int)binfo->nbatches || binfo->nbatches == 0) {
@@ -3195,11 +4387,29 @@ void do_bench(struct bench_info *binfo)
 		  printf("%8.2f ops/s, ",
 			 (double)(op_count_read + op_count_write + op_count_delete) / elapsed_time);
 		  // instant throughput
-		  printf("%8.2f ops/s)",
+		  printf("%8.2f ops/s",
 			 (double)((op_count_read + op_count_write + op_count_delete) -
 				  (prev_op_count_read + prev_op_count_write +
 				   prev_op_count_delete)) /
 			 (_gap.tv_sec + (double)_gap.tv_usec / 1000000.0));
+		  if (open_loop) {
+		    // target throughput of this period
+		    t_arrival_prev = t_arrival;
+		    t_arrival = (latency_now_ns() - binfo->arrival.epoch_ns) / 1e9;
+		    printf(", target %8.2f ops/s",
+			   (arrival_ops(&binfo->arrival, t_arrival) -
+			    arrival_ops(&binfo->arrival, t_arrival_prev)) /
+			   (t_arrival - t_arrival_prev));
+		  }
+		  if (s_args) {
+		    // instant scan throughput
+		    _scanners_sum(binfo, s_args, &scan_keys, &scan_bytes, &scan_count);
+		    scan_keys_i = (double)(scan_keys - prev_scan_keys) /
+				  (_gap.tv_sec + (double)_gap.tv_usec / 1000000.0);
+		    printf(", scan %8.2f keys/s", scan_keys_i);
+		    prev_scan_keys = scan_keys;
+		  }
+		  printf(")");
 
 #if defined (__KV_BENCH) || defined(__KVROCKS_BENCH) || defined (__AS_BENCH)
 		  // TBD: get KVS bytes written
@@ -3210,6 +4420,19 @@ void do_bench(struct bench_info *binfo)
 		  }
 #endif
 
+		  if (binfo->latency_rate) {
+		    _latency_interval_next(&l_iv);
+		    for (j = 0; j < bench_threads; j++) {
+		      _latency_stat_add(l_iv.total, b_args[j].l_stat);
+		    }
+		    _latency_interval_diff(&l_iv);
+		  }
+		  if (open_loop && !warmingup) {
+		    _arrival_report_tick(&a_rep, &binfo->arrival, t_arrival,
+					 op_count_read + op_count_write + op_count_delete,
+					 (binfo->latency_rate) ? l_iv.total : NULL, 0);
+		  }
+
 		  tmp = (warmingup == true) ? log_fp : run_ops_fp;
 		  //if (log_fp) {
 		  if(tmp){
@@ -3219,9 +4442,11 @@ void do_bench(struct bench_info *binfo)
 		    // 4. # reads
 		    // 5. # writes
 		    // 6. # bytes written by host
+		    // 7. target throughput of this period (open-loop only)
+		    // 8. p50, p99, p99.9 & max of each op type in this period
 		    fprintf(tmp,
 			                            "%d.%01d,%.2f,%.2f,"
-			    "%" _F64",%" _F64 ",%" _F64 "\n",
+			    "%" _F64",%" _F64 ",%" _F64,
 			    (int)gap.tv_sec, (int)gap.tv_usec / 100000,
 			    (double)(op_count_read + op_count_write + op_count_delete) /
 			    (elapsed_time),
@@ -3231,6 +4456,46 @@ void do_bench(struct bench_info *binfo)
 			    (_gap.tv_sec + (double)_gap.tv_usec / 1000000.0),
 			    op_count_read, op_count_write,
 			    written_final - written_init);
+		    if (open_loop) {
+		      fprintf(tmp, ",%.2f",
+			      (arrival_ops(&binfo->arrival, t_arrival) -
+			       arrival_ops(&binfo->arrival, t_arrival_prev)) /
+			      (t_arrival - t_arrival_prev));
+		    }
+		    if (binfo->latency_rate) {
+		      for (k = 0; k < LAT_NOPS; k++) {
+			_fprint_interval(tmp, &l_iv.diff->hist[k]);
+		      }
+		    }
+		    fprintf(tmp, "\n");
+		  }
+		  if (results_on && !warmingup) {
+		    struct results_interval ri;
+
+		    memset(&ri, 0, sizeof(ri));
+		    ri.time = elapsed_time;
+		    ri.reads = op_count_read;
+		    ri.writes = op_count_write;
+		    ri.deletes = op_count_delete;
+		    ri.ops_avg = (ri.reads + ri.writes + ri.deletes) / elapsed_time;
+		    ri.ops_i = ((ri.reads + ri.writes + ri.deletes) -
+				(prev_op_count_read + prev_op_count_write +
+				 prev_op_count_delete)) /
+			       (_gap.tv_sec + (double)_gap.tv_usec / 1000000.0);
+		    ri.target = (open_loop) ?
+				(arrival_ops(&binfo->arrival, t_arrival) -
+				 arrival_ops(&binfo->arrival, t_arrival_prev)) /
+				(t_arrival - t_arrival_prev) : -1;
+		    ri.scan_keys_i = scan_keys_i;
+		    ri.lat = (binfo->latency_rate) ? l_iv.diff->hist : NULL;
+		    _results_interval(&ri, &r_cpu_prev, db, binfo->nfiles);
+		  }
+		  if (warmingup && binfo->steady_cv > 0) {
+		    steady = steady_add(&ss,
+					(double)((op_count_read + op_count_write + op_count_delete) -
+						 (prev_op_count_read + prev_op_count_write +
+						  prev_op_count_delete)) /
+					(_gap.tv_sec + (double)_gap.tv_usec / 1000000.0));
 		  }
 
 		  printf("\n");
@@ -3298,7 +4563,9 @@ void do_bench(struct bench_info *binfo)
 		      (size_t)sw.elapsed.tv_sec >= binfo->bench_secs)
 		    break;
 
-		  if ((size_t)sw.elapsed.tv_sec >= binfo->warmup_secs){
+		  if ((size_t)sw.elapsed.tv_sec >= binfo->warmup_secs &&
+		      (!warmingup || _warmup_done(binfo, steady,
+						  sw.elapsed.tv_sec))){
 		    if (warmingup) {
 		      // end of warming up .. initialize stats
 		      stopwatch_init_start(&sw);
@@ -3328,12 +4595,41 @@ void do_bench(struct bench_info *binfo)
 		      */
 		      for (j=0; j<bench_threads; j++) {
       			b_args[j].op_read = b_args[j].op_write = b_args[j].op_delete = b_args[j].op_iter_key = 0;
-      			b_args[j].l_read->nsamples = b_args[j].l_write->nsamples
-      			  = b_args[j].l_delete->nsamples = 0;
-      			b_args[j].l_read->cursor = b_args[j].l_write->cursor
-      			  = b_args[j].l_delete->cursor = 0;
+		      }
+		      for (j = 0; s_args && j < (int)(binfo->nscanners * binfo->nfiles); j++) {
+			s_args[j].keys = s_args[j].bytes = s_args[j].scans = 0;
+		      }
+		      prev_scan_keys = 0;
+		      if (s_args) {
+			hdr_add(&scan_base, &scan_time);
+		      }
+		      if (perf_on) {
+			perf_read(&perf, &perf_base);
+			perf_warm = true;
+		      }
+		      // threads keep recording, so latencies of warming up
+		      // are subtracted at the end instead of being reset
+		      if (binfo->latency_rate) {
+			l_base = _latency_stat_create();
+			_latency_stat_add(l_base, l_iv.total);
+		      }
+		      if (open_loop) {
+			// restart the rate profile for the evaluation
+			__atomic_store_n(&binfo->arrival.epoch_ns, latency_now_ns(),
+					 __ATOMIC_RELEASE);
+			t_arrival = 0;
+			_arrival_report_free(&a_rep);
+			_arrival_report_init(&a_rep, binfo);
+			if (binfo->latency_rate) {
+			  _latency_stat_add(a_rep.base, l_iv.total);
+			}
 		      }
 		      warmingup = false;
+		      if (results_on) {
+			_results_begin_phase("run");
+			results_cpu_sample(&r_cpu_begin);
+			r_cpu_prev = r_cpu_begin;
+		      }
 		      lprintf("\nevaluation\n");
 		      lprintf("time,ops_avg,ops_i,read_cnt,write_cnt,bytes_written\n");
 		      //if(run_ops_fp)
@@ -3356,6 +4652,10 @@ void do_bench(struct bench_info *binfo)
 	    (op_count_read + op_count_write + op_count_delete) >= binfo->nops * binfo->nfiles)
       break;
 
+    if (binfo->workload.type == WORKLOAD_TRACE &&
+        workload_done_threads.load() == bench_threads)
+      break;
+
     if (got_signal) {
       break;
     }
@@ -3366,6 +4666,10 @@ void do_bench(struct bench_info *binfo)
     */
   }
 
+  if (open_loop) {
+    t_arrival = (latency_now_ns() - binfo->arrival.epoch_ns) / 1e9;
+  }
+
   // terminate all bench_worker threads
   for (i=0;i<bench_threads;++i){
     b_args[i].terminate_signal = 1;
@@ -3374,6 +4678,30 @@ void do_bench(struct bench_info *binfo)
   for (i=0;i<bench_threads;++i){
     thread_join(bench_worker[i], &bench_worker_ret[i]);
   }
+#if !defined(__COUCH_BENCH) && !defined(__AS_BENCH) && !defined(__KVROCKS_BENCH)
+  if (s_args) {
+    _scanners_stop(binfo, s_args, scan_worker);
+  }
+#endif
+
+  if (open_loop && !warmingup) {
+    // close the last step of the rate profile
+    if (binfo->latency_rate) {
+      _latency_interval_next(&l_iv);
+      for (j = 0; j < bench_threads; j++) {
+        _latency_stat_add(l_iv.total, b_args[j].l_stat);
+      }
+    }
+    op_count_read = op_count_write = op_count_delete = 0;
+    for (j = 0; j < bench_threads; j++) {
+      op_count_read += b_args[j].op_read.load();
+      op_count_write += b_args[j].op_write.load();
+      op_count_delete += b_args[j].op_delete.load();
+    }
+    _arrival_report_tick(&a_rep, &binfo->arrival, t_arrival,
+                         op_count_read + op_count_write + op_count_delete,
+                         (binfo->latency_rate) ? l_iv.total : NULL, 1);
+  }
   
 #if defined (__KV_BENCH) || defined (__AS_BENCH)
 
@@ -3415,10 +4743,36 @@ void do_bench(struct bench_info *binfo)
 	  op_count_read + op_count_write + op_count_delete);
 
     lprintf("Throughput(Benchmark) %.2f ops/sec\n", (double)(op_count_read + op_count_write + op_count_delete) / gap_double);
+    if (open_loop && t_arrival > 0) {
+      lprintf("Throughput(Target)    %.2f ops/sec\n",
+              arrival_ops(&binfo->arrival, t_arrival) / t_arrival);
+    }
   }
   if(op_count_iter_key > 0) {
     lprintf("Throughput(Iterator)  %.2f keys/sec; total %ld keys\n", (double)(op_count_iter_key) / gap_double, op_count_iter_key);
   }
+  if (s_args) {
+    _scanners_sum(binfo, s_args, &scan_keys, &scan_bytes, &scan_count);
+    hdr_sub(&scan_time, &scan_base);
+    scan_keys_sec = (double)scan_keys / gap_double;
+    scan_bytes_sec = (double)scan_bytes / gap_double;
+    lprintf("Throughput(Scan)      %.2f keys/sec, %.2f MB/sec; total %" _F64
+            " keys, %" _F64 " complete scans\n", scan_keys_sec,
+            scan_bytes_sec / 1000000.0, scan_keys, scan_count);
+    if (scan_time.count) {
+      lprintf("scan time (ms): avg %.2f, p50 %.2f, p99 %.2f, max %.2f\n",
+              hdr_mean(&scan_time) / 1000000.0,
+              hdr_value_at_percentile(&scan_time, 50) / 1000000.0,
+              hdr_value_at_percentile(&scan_time, 99) / 1000000.0,
+              scan_time.max / 1000000.0);
+    }
+  }
+  if (perf_on) {
+    _perf_end(&perf, (perf_warm) ? &perf_base : NULL,
+              op_count_read + op_count_write + op_count_delete,
+              (op_count_read + op_count_write + op_count_delete) * avg_docsize +
+              scan_bytes, perf_res);
+  }
   
   if(op_count_read + op_count_write + op_count_delete > 0) {
     lprintf("average latency %f\n", gap_double * 1000000 /
@@ -3461,68 +4815,68 @@ void do_bench(struct bench_info *binfo)
 
   // TODO: update latency rate
   if(binfo->latency_rate && binfo->with_iterator != 2) {
-    struct latency_stat w_stat;
-    struct latency_stat r_stat;
-    struct latency_stat d_stat;
-    uint32_t *t1, *t2, *t3;
-    memset(&w_stat, 0, sizeof(struct latency_stat));
-    memset(&r_stat, 0, sizeof(struct latency_stat));
-    memset(&d_stat, 0, sizeof(struct latency_stat));
-
-    w_stat.samples = (uint32_t*)malloc(sizeof(uint32_t) *
-				       binfo->latency_max * bench_threads);
-    r_stat.samples = (uint32_t*)malloc(sizeof(uint32_t) *
-				       binfo->latency_max * bench_threads);
-    d_stat.samples = (uint32_t*)malloc(sizeof(uint32_t) *
-				       binfo->latency_max * bench_threads);
-    t1 = w_stat.samples;
-    t2 = r_stat.samples;
-    t3 = d_stat.samples;
+    struct latency_stat *l_stat = _latency_stat_create();
 
     for(i = 0; i < bench_threads; i++){
-      w_stat.nsamples += b_args[i].l_write->nsamples;
-      r_stat.nsamples += b_args[i].l_read->nsamples;
-      d_stat.nsamples += b_args[i].l_delete->nsamples;
-
-      memcpy(t1, b_args[i].l_write->samples, sizeof(uint32_t) *
-	     b_args[i].l_write->nsamples);
-      memcpy(t2, b_args[i].l_read->samples, sizeof(uint32_t) *
-	     b_args[i].l_read->nsamples);
-      memcpy(t3, b_args[i].l_delete->samples, sizeof(uint32_t) *
-	     b_args[i].l_delete->nsamples);
-
-      t1 += b_args[i].l_write->nsamples;
-      t2 += b_args[i].l_read->nsamples;
-      t3 += b_args[i].l_delete->nsamples;
-      free(b_args[i].l_write->samples);
-      free(b_args[i].l_read->samples);
-      free(b_args[i].l_delete->samples);
-    }
-
-    _print_percentile(binfo, (w_stat.nsamples == 0? NULL: &w_stat),
-		      (r_stat.nsamples == 0? NULL : &r_stat),
-		      (d_stat.nsamples == 0? NULL : &d_stat), "us", 2);
-    free(w_stat.samples);
-    free(r_stat.samples);
-    free(d_stat.samples);    
+      _latency_stat_add(l_stat, b_args[i].l_stat);
+    }
+    if (l_base) {
+      _latency_stat_sub(l_stat, l_base);
+    }
+
+    _print_percentile(binfo, l_stat, 2);
+    if (sum && sum->l_stat) {
+      _latency_stat_add(sum->l_stat, l_stat);
+    }
+    if (results_on && !warmingup) {
+      _results_end_phase(gap_double, op_count_read, op_count_write,
+                         op_count_delete,
+                         (open_loop && t_arrival > 0) ?
+                         arrival_ops(&binfo->arrival, t_arrival) / t_arrival : -1,
+                         &r_cpu_begin, db, binfo->nfiles, l_stat,
+                         scan_keys_sec, scan_bytes_sec,
+                         (perf_on) ? perf_res : NULL);
+    }
+    _latency_stat_free(l_stat);
+  } else if (results_on && !warmingup) {
+    _results_end_phase(gap_double, op_count_read, op_count_write,
+                       op_count_delete,
+                       (open_loop && t_arrival > 0) ?
+                       arrival_ops(&binfo->arrival, t_arrival) / t_arrival : -1,
+                       &r_cpu_begin, db, binfo->nfiles, NULL,
+                       scan_keys_sec, scan_bytes_sec,
+                       (perf_on) ? perf_res : NULL);
+  }
+  if (open_loop) {
+    _arrival_report_print(&a_rep);
+    _arrival_report_free(&a_rep);
+  }
+  if (binfo->latency_rate) {
+    for(i = 0; i < bench_threads; i++){
+      _latency_stat_free(b_args[i].l_stat);
+    }
+    if (l_base) {
+      _latency_stat_free(l_base);
+    }
+    _latency_interval_free(&l_iv);
   }
 
   lprintf("\n");
-  
-  keygen_free(&binfo->keygen);
-  if (binfo->keyfile) {
-    keyloader_free(&binfo->kl);
-  }
-  if (binfo->batch_dist.type == RND_ZIPFIAN) {
+
+  if (binfo->batch_dist.type == RND_ZIPFIAN ||
+      binfo->batch_dist.type == RND_LATEST) {
     zipf_rnd_free(&zipf);
   }
+  if (binfo->warmup_secs && binfo->steady_cv > 0) {
+    steady_free(&ss);
+  }
+  if (binfo->nscanners) {
+    hdr_free(&scan_time);
+    hdr_free(&scan_base);
+    free(scan_worker);
+    free(s_args);
+  }
 
-#ifdef __FDB_BENCH
-  // print ForestDB's own block cache info (internal function call)
-  //bcache_print_items();
-#endif
-
-  printf("waiting for termination of DB module..\n");
 #if defined(__FDB_BENCH) || defined(__COUCH_BENCH) || defined(__WT_BENCH)
   for (i=0;i<bench_threads;++i){
     for (j=0;j<(int)binfo->nfiles;++j){
@@ -3535,10 +4889,6 @@ void do_bench(struct bench_info *binfo)
     }
     free(b_args[i].db);
   }
-#elif defined(__KV_BENCH) || defined(__KVROCKS_BENCH) || defined __BLOBFS_ROCKS_BENCH
-  for (j=0;j<(int)binfo->nfiles;++j){
-    couchstore_close_db(db[j]);
-  }
 #elif defined (__LEVEL_BENCH) //|| defined __BLOBFS_ROCKS_BENCH
   //for (j=0;j<(int)binfo->nfiles;++j){
   for (j = 0; j < bench_threads; j+= singledb_thread_num){
@@ -3561,36 +4911,17 @@ void do_bench(struct bench_info *binfo)
   }
 #endif
 
-#if defined(__KV_BENCH) ||  defined(__BLOBFS_ROCKS_BENCH)
-  //for (j = 0; j< binfo->nfiles; j++)
-  //couchstore_close_device(dev_id[j]);
-  couchstore_exit_env();
-#endif
-#if defined (__AS_BENCH)
-  couchstore_close_device(binfo->ndocs);
-#endif
-#if defined(__WT_BENCH) || defined(__FDB_BENCH)
-  couchstore_close_conn();
-#endif
-  
-  lprintf("\n");
-  stopwatch_stop(&sw);
-  gap = sw.elapsed;
-  LOG_PRINT_TIME(gap, " sec elapsed\n");
-
   free(dbinfo);
 
-  _bench_result_print(&result);
-  _bench_result_free(&result);
-  /*
-  spin_destroy(&b_stat.lock);
-  spin_destroy(&l_read.lock);
-  spin_destroy(&l_write.lock);
-
-  free(l_read.samples);
-  free(l_write.samples);
-  */
-  memleak_end();
+  if (sum) {
+    sum->secs = gap_double;
+    sum->reads = op_count_read;
+    sum->writes = op_count_write;
+    sum->deletes = op_count_delete;
+    sum->steady = (binfo->warmup_secs && binfo->steady_cv > 0) ? steady : -1;
+    sum->scan_keys = scan_keys_sec;
+    sum->scan_bytes = scan_bytes_sec;
+  }
 }
 
 void _print_benchinfo(struct bench_info *binfo)
@@ -3650,6 +4981,28 @@ void _print_benchinfo(struct bench_info *binfo)
         lprintf("enabled disjoint write among %d writers over %d files\n",
                 (int)binfo->nwriters, (int)binfo->nfiles);
     }
+    if (binfo->nscanners || sweep_max(&binfo->sweep, SWEEP_SCANNERS) > 0) {
+        lprintf("# scanners: %d per DB, %s %s scans", (int)binfo->nscanners,
+                (binfo->scan_values) ? "key+value" : "key-only",
+                (binfo->scan_prefix) ? "prefix" : "full");
+        if (binfo->scan_prefix) {
+            lprintf(" (bitmask %02x%02x%02x%02x, pattern ",
+                    binfo->scan_bitmask[0], binfo->scan_bitmask[1],
+                    binfo->scan_bitmask[2], binfo->scan_bitmask[3]);
+            if (binfo->scan_rnd_pattern) {
+                lprintf("of a random key)");
+            } else {
+                lprintf("%02x%02x%02x%02x)",
+                        binfo->scan_pattern[0], binfo->scan_pattern[1],
+                        binfo->scan_pattern[2], binfo->scan_pattern[3]);
+            }
+        }
+        lprintf("\n");
+    }
+
+    if (binfo->perf_counters) {
+        lprintf("perf_event counters: enabled\n");
+    }
 
     lprintf("# auto-compaction threads: %d\n", binfo->auto_compaction_threads);
 
@@ -3736,8 +5089,16 @@ void _print_benchinfo(struct bench_info *binfo)
     lprintf("batch distribution: ");
     if (binfo->batch_dist.type == RND_UNIFORM) {
         lprintf("Uniform\n");
+    } else if (binfo->batch_dist.type == RND_HOTSPOT) {
+        lprintf("Hotspot (%.1f %% of the ops on %.1f %% of the keys",
+                binfo->hot_ops * 100, binfo->hot_keys * 100);
+        if (binfo->hot_move > 0) {
+            lprintf(", moving %.0f keys/sec", binfo->hot_move);
+        }
+        lprintf(")\n");
     }else{
-        lprintf("Zipfian (s=%.2f, group: %d documents)\n",
+        lprintf("%s (s=%.2f, group: %d documents)\n",
+                (binfo->batch_dist.type == RND_LATEST) ? "Latest" : "Zipfian",
                 (double)binfo->batch_dist.a/100.0, (int)binfo->batch_dist.b);
     }
 
@@ -3775,6 +5136,33 @@ void _print_benchinfo(struct bench_info *binfo)
     }
     lprintf(" (%s)\n", ((binfo->sync_write)?("synchronous"):("asynchronous")));
     lprintf("insertion order: %s\n", ((binfo->seq_fill)?("sequential fill"):("random fill")));
+    if (binfo->arrival.process != ARRIVAL_CLOSED) {
+        static const char *profiles[] = {"flat", "ramp", "step", "schedule"};
+        struct arrival_info *ai = &binfo->arrival;
+
+        lprintf("arrival: open-loop, %s, %s profile (%.0f ops/sec",
+                (ai->process == ARRIVAL_POISSON)?("poisson"):("constant"),
+                profiles[ai->profile], ai->points[0].rate);
+        if (ai->npoints > 1) {
+            lprintf(" -> %.0f ops/sec in %d steps",
+                    ai->points[ai->npoints - 1].rate, (int)ai->npoints);
+        }
+        lprintf(")\n");
+    } else {
+        lprintf("arrival: closed-loop\n");
+    }
+    if (binfo->workload.type == WORKLOAD_YCSB) {
+        lprintf("workload: ycsb %c (max scan length %d)\n",
+                binfo->workload.ycsb, (int)binfo->workload.max_scan_length);
+    } else if (binfo->workload.type == WORKLOAD_TRACE) {
+        lprintf("workload: trace %s (%lu ops, ", binfo->keyfile,
+                (unsigned long)binfo->ndocs);
+        if (binfo->workload.trace_speed > 0) {
+            lprintf("%.2fx speed)\n", binfo->workload.trace_speed);
+        } else {
+            lprintf("as fast as possible)\n");
+        }
+    }
 
 #if defined(__FDB_BENCH)
     lprintf("compaction threshold: %d %% "
@@ -3841,12 +5229,15 @@ void _set_keygen(struct bench_info *binfo)
     keygen_init(&binfo->keygen, level, rnd_len, rnd_dist, &opt);
 }
 
-void _set_keyloader(struct bench_info *binfo)
+void _set_keyloader(struct bench_info *binfo, int format)
 {
     int ret;
     struct keyloader_option option;
 
-    option.max_nkeys = binfo->ndocs;
+    memset(&option, 0, sizeof(option));
+    // a trace is replayed as a whole
+    option.max_nkeys = (format == KEYLOADER_KEYS) ? binfo->ndocs : 0;
+    option.format = format;
     ret = keyloader_init(&binfo->kl, binfo->keyfile, &option);
     if (ret < 0) {
         printf("error occured during loading file %s\n", binfo->keyfile);
@@ -3998,6 +5389,7 @@ struct bench_info get_benchinfo(char* bench_config_filename, int config_only)
     char *filename = (char*)malloc(256);
     char *init_filename = (char*)malloc(256);
     char *log_filename = (char*)malloc(256);
+    char *results = (char*)malloc(256);
     char *device_path = (char*)malloc(256);
     char *kv_device_path = (char*)malloc(1024);
     char *kv_emul_configfile = (char*)malloc(1024);
@@ -4056,6 +5448,7 @@ struct bench_info get_benchinfo(char* bench_config_filename, int config_only)
     binfo.filename = filename;
     binfo.init_filename = init_filename;
     binfo.log_filename = log_filename;
+    binfo.results = results;
     binfo.device_path = device_path;
     binfo.kv_device_path = kv_device_path;
     binfo.kv_emul_configfile = kv_emul_configfile;
@@ -4071,10 +5464,54 @@ struct bench_info get_benchinfo(char* bench_config_filename, int config_only)
     if (strcmp(str, "")) {
         binfo.keyfile = (char*)malloc(256);
         strcpy(binfo.keyfile, str);
-        _set_keyloader(&binfo);
+        _set_keyloader(&binfo, KEYLOADER_KEYS);
     } else {
         binfo.keyfile = NULL;
     }
+
+    memset(&binfo.workload, 0, sizeof(struct workload_info));
+    str = iniparser_getstring(cfg, (char*)"workload:type", (char*)"ratio");
+    if (str[0] == 'y') {
+        binfo.workload.type = WORKLOAD_YCSB;
+    } else if (str[0] == 't') {
+        binfo.workload.type = WORKLOAD_TRACE;
+    } else {
+        binfo.workload.type = WORKLOAD_RATIO;
+    }
+    if (binfo.workload.type == WORKLOAD_TRACE) {
+        // the keys of the trace take the place of the key file, so that
+        // the population phase loads every key the trace refers to
+        uint64_t k;
+        int format;
+
+        str = iniparser_getstring(cfg, (char*)"workload:trace_file", (char*)"");
+        if (binfo.keyfile || !strcmp(str, "")) {
+            printf("WARN: trace workload needs 'trace_file' and no 'key_file'\n");
+            iniparser_free(cfg);
+            exit(0);
+        }
+        binfo.keyfile = (char*)malloc(256);
+        strcpy(binfo.keyfile, str);
+        str = iniparser_getstring(cfg, (char*)"workload:trace_format",
+                                  (char*)"csv");
+        format = (str[0] == 'b') ? KEYLOADER_TRACE_BIN : KEYLOADER_TRACE_CSV;
+        _set_keyloader(&binfo, format);
+        if (binfo.ndocs == 0) {
+            printf("WARN: no op found in trace %s\n", binfo.keyfile);
+            iniparser_free(cfg);
+            exit(0);
+        }
+        binfo.workload.trace_ts0 = UINT64_MAX;
+        for (k = 0; k < binfo.ndocs; ++k) {
+            binfo.workload.trace_ts0 = MIN(binfo.workload.trace_ts0,
+                                           keyloader_get_op(&binfo.kl, k)->ts_us);
+        }
+        binfo.workload.trace_speed =
+            iniparser_getdouble(cfg, (char*)"workload:trace_speed", 1.0);
+        if (binfo.workload.trace_speed < 0) {
+            binfo.workload.trace_speed = 0;
+        }
+    }
     binfo.amp_factor = iniparser_getdouble(cfg, (char*)"document:amp_factor", 1);
     
     pool_info_t info;
@@ -4178,6 +5615,25 @@ struct bench_info get_benchinfo(char* bench_config_filename, int config_only)
     strcpy(binfo.cq_thread_ids, str);
     
     binfo.mem_size_mb = iniparser_getint(cfg, (char*)"kvs:mem_size_mb", 1024);
+
+    str = iniparser_getstring(cfg, (char*)"kvs:packing", (char*)"false");
+    binfo.kv_packing = (str[0]=='t')?(1):(0);
+    binfo.kv_packing_max_value = iniparser_getint(cfg, (char*)"kvs:packing_max_value", 0);
+    binfo.kv_packing_threshold = iniparser_getint(cfg, (char*)"kvs:packing_compaction_threshold", 0);
+    str = iniparser_getstring(cfg, (char*)"kvs:qos", (char*)"false");
+    binfo.kv_qos = (str[0]=='t')?(1):(0);
+    binfo.kv_qos_max_inflight = iniparser_getint(cfg, (char*)"kvs:qos_max_inflight", 0);
+    binfo.kv_qos_iops_limit = iniparser_getint(cfg, (char*)"kvs:qos_iops_limit", 0);
+    binfo.kv_qos_bandwidth_limit = (uint64_t)iniparser_getint(cfg, (char*)"kvs:qos_bandwidth_limit_MB", 0) * 1024 * 1024;
+    {
+      const char *qos_keys[5] = {"kvs:qos_mixer_class", "kvs:qos_writer_class",
+                                 "kvs:qos_reader_class", "kvs:qos_iterator_class",
+                                 "kvs:qos_deleter_class"};
+      for (i = 0; i < 5; ++i) {
+        str = iniparser_getstring(cfg, (char*)qos_keys[i], (char*)"normal");
+        binfo.kv_qos_class[i] = (str[0]=='h')?(0):((str[0]=='l')?(2):(1));
+      }
+    }
     str = iniparser_getstring(cfg, (char*)"kvs:device_path", (char*)"");
     strcpy(binfo.kv_device_path, str);
 #ifdef __KV_BENCH
@@ -4248,6 +5704,8 @@ struct bench_info get_benchinfo(char* bench_config_filename, int config_only)
     
     str = iniparser_getstring(cfg, (char*)"log:filename", (char*)"");
     strcpy(binfo.log_filename, str);
+    str = iniparser_getstring(cfg, (char*)"log:results", (char*)"");
+    strcpy(binfo.results, str);
 
     binfo.cache_size =
         iniparser_getint(cfg, (char*)"db_config:cache_size_MB", 128);
@@ -4611,6 +6069,15 @@ struct bench_info get_benchinfo(char* bench_config_filename, int config_only)
     binfo.nbatches = iniparser_getint(cfg, (char*)"operation:nbatches", 0);
     binfo.nops = iniparser_getint(cfg, (char*)"operation:nops", 0);
     binfo.warmup_secs = iniparser_getint(cfg, (char*)"operation:warmingup", 0);
+    binfo.steady_cv = iniparser_getdouble(cfg, (char*)"operation:steady_cv", 0);
+    binfo.steady_window =
+        iniparser_getint(cfg, (char*)"operation:steady_window", 10);
+    binfo.steady_max_secs =
+        iniparser_getint(cfg, (char*)"operation:steady_max_secs", 60);
+    if (binfo.steady_cv > 0 && binfo.warmup_secs == 0) {
+        // steady state is looked for while warming up
+        binfo.warmup_secs = 1;
+    }
     binfo.bench_secs = iniparser_getint(cfg, (char*)"operation:duration", 0);
     if (binfo.nbatches == 0 && binfo.nops == 0 && binfo.bench_secs == 0) {
         binfo.bench_secs = 60;
@@ -4746,7 +6213,7 @@ struct bench_info get_benchinfo(char* bench_config_filename, int config_only)
     str = iniparser_getstring(cfg,
 			      (char*)"operation:batch_distribution",
 			      (char*)"uniform");
-    if (str[0] == 'u') {
+    if (str[0] == 'u' || str[0] == 'h') {
       binfo.batch_dist.type = RND_UNIFORM;
       binfo.batch_dist.a = 0;
       //binfo.batch_dist.b = binfo.ndocs;
@@ -4758,10 +6225,25 @@ struct bench_info get_benchinfo(char* bench_config_filename, int config_only)
       } else {
       	binfo.batch_dist.b = binfo.ndocs * binfo.amp_factor;
       }
+      if (str[0] == 'h') {
+        // hotspot over the same key range
+        binfo.batch_dist.type = RND_HOTSPOT;
+        binfo.hot_keys = iniparser_getdouble(cfg, (char*)"operation:hotspot_keys", 0.2);
+        binfo.hot_ops = iniparser_getdouble(cfg, (char*)"operation:hotspot_ops", 0.8);
+        binfo.hot_move = iniparser_getdouble(cfg, (char*)"operation:hotspot_move", 0);
+        if (binfo.hot_keys <= 0 || binfo.hot_keys > 1 ||
+            binfo.hot_ops < 0 || binfo.hot_ops > 1 || binfo.hot_move < 0) {
+          printf("WARN: hotspot_keys should be in (0, 1], hotspot_ops in "
+                 "[0, 1] and hotspot_move not negative\n");
+          iniparser_free(cfg);
+          exit(0);
+        }
+      }
     }else{
       double s = iniparser_getdouble(cfg, (char*)"operation:"
 				     "batch_parameter1", 1);
-      binfo.batch_dist.type = RND_ZIPFIAN;
+      // zipfian, or zipfian over the age of the keys for 'latest'
+      binfo.batch_dist.type = (str[0] == 'l') ? RND_LATEST : RND_ZIPFIAN;
       binfo.batch_dist.a = (int64_t)(s * 100);
       binfo.batch_dist.b =
 		    iniparser_getint(cfg, (char*)"operation:batch_parameter2", 64);
@@ -4772,6 +6254,78 @@ struct bench_info get_benchinfo(char* bench_config_filename, int config_only)
     binfo.sync_write = (str[0]=='s')?(1):(0);
     binfo.key_existing = iniparser_getboolean(cfg, (char*)"operation:key_existing", false);
 
+    if (binfo.workload.type == WORKLOAD_YCSB) {
+        int *ratio = binfo.workload.ratio;
+
+        str = iniparser_getstring(cfg, (char*)"workload:ycsb", (char*)"a");
+        binfo.workload.ycsb = str[0] | 0x20; // lower case
+        switch (binfo.workload.ycsb) {
+        case 'a': ratio[KL_OP_READ] = 50; ratio[KL_OP_UPDATE] = 50; break;
+        case 'b': ratio[KL_OP_READ] = 95; ratio[KL_OP_UPDATE] = 5; break;
+        case 'c': ratio[KL_OP_READ] = 100; break;
+        case 'd': ratio[KL_OP_READ] = 95; ratio[KL_OP_INSERT] = 5; break;
+        case 'e': ratio[KL_OP_SCAN] = 95; ratio[KL_OP_INSERT] = 5; break;
+        case 'f': ratio[KL_OP_READ] = 50; ratio[KL_OP_RMW] = 50; break;
+        default:
+            printf("WARN: ycsb workload should be one of a ~ f\n");
+            iniparser_free(cfg);
+            exit(0);
+        }
+        if (binfo.keyfile && ratio[KL_OP_INSERT]) {
+            printf("WARN: ycsb workload %c inserts new keys, "
+                   "which cannot be taken from 'key_file'\n", binfo.workload.ycsb);
+            iniparser_free(cfg);
+            exit(0);
+        }
+#if defined __AS_BENCH
+        if (ratio[KL_OP_SCAN]) {
+            printf("WARN: scan is not supported for aerospike\n");
+            iniparser_free(cfg);
+            exit(0);
+        }
+#endif
+        binfo.workload.max_scan_length =
+            iniparser_getint(cfg, (char*)"workload:max_scan_length", 100);
+        if (binfo.workload.max_scan_length == 0) {
+            binfo.workload.max_scan_length = 1;
+        }
+        if (!iniparser_find_entry(cfg, (char*)"operation:batch_distribution")) {
+            // YCSB's default request distribution; d reads the recently
+            // inserted keys the most
+            binfo.batch_dist.type = (binfo.workload.ycsb == 'd') ?
+                                    RND_LATEST : RND_ZIPFIAN;
+            binfo.batch_dist.a = 99;
+            binfo.batch_dist.b =
+                iniparser_getint(cfg, (char*)"operation:batch_parameter2", 64);
+        }
+    }
+    if (binfo.workload.type != WORKLOAD_RATIO) {
+        // keys are chosen by the workload itself
+        binfo.key_existing = 0;
+    }
+#if defined __AS_BENCH
+    if (binfo.workload.type != WORKLOAD_RATIO && binfo.kv_write_mode == 0) {
+        // the async wrapper can't issue the write from the read's completion
+        int rmw = (binfo.workload.type == WORKLOAD_YCSB &&
+                   binfo.workload.ratio[KL_OP_RMW]);
+        for (uint64_t k = 0; !rmw && binfo.workload.type == WORKLOAD_TRACE &&
+                             k < binfo.ndocs; ++k) {
+            rmw = (keyloader_get_op(&binfo.kl, k)->op == KL_OP_RMW);
+        }
+        if (rmw) {
+            printf("WARN: read-modify-write needs 'write_mode = sync' "
+                   "for aerospike\n");
+            iniparser_free(cfg);
+            exit(0);
+        }
+    }
+#endif
+    if (binfo.workload.type == WORKLOAD_TRACE && binfo.warmup_secs) {
+        printf("WARN: warming up is skipped for trace replay\n");
+        binfo.warmup_secs = 0;
+        binfo.steady_cv = 0;
+    }
+
     binfo.compact_thres =
         iniparser_getint(cfg, (char*)"compaction:threshold", 30);
     binfo.compact_period =
@@ -4793,19 +6347,9 @@ struct bench_info get_benchinfo(char* bench_config_filename, int config_only)
 #endif
     }
 
-    // latency monitoring
+    // latency monitoring: 0 disables it, otherwise every op is recorded
     binfo.latency_rate =
         iniparser_getint(cfg, (char*)"latency_monitor:rate", 100);
-    if (binfo.latency_rate > 1000) {
-        binfo.latency_rate = 1000;
-    }
-    binfo.latency_max =
-        iniparser_getint(cfg, (char*)"latency_monitor:max_samples", 1000000);
-    if (!binfo.latency_max) {
-      printf("WARN: max_sample cannot be 0\n");
-      iniparser_free(cfg);
-      exit(0);
-    }
     print_term_ms =
         iniparser_getint(cfg, (char*)"latency_monitor:print_term_ms", 100);
     if (!print_term_ms) {
@@ -4815,6 +6359,238 @@ struct bench_info get_benchinfo(char* bench_config_filename, int config_only)
     }
     if (binfo.bench_secs != 0 && print_term_ms > binfo.bench_secs * 1000)
       print_term_ms = binfo.bench_secs * 1000;
+
+    // open-loop load: ops arrive at a target rate regardless of completions
+    {
+        int process, profile;
+        char *schedule_file;
+
+        str = iniparser_getstring(cfg, (char*)"arrival:process",
+                                  (char*)"closed");
+        if (str[0] == 'c' && str[1] == 'o' && str[2] == 'n') {
+            process = ARRIVAL_CONSTANT;
+        } else if (str[0] == 'p') {
+            process = ARRIVAL_POISSON;
+        } else {
+            process = ARRIVAL_CLOSED;
+        }
+        str = iniparser_getstring(cfg, (char*)"arrival:profile",
+                                  (char*)"flat");
+        if (str[0] == 'r') {
+            profile = RATE_RAMP;
+        } else if (str[0] == 's' && str[1] == 't') {
+            profile = RATE_STEP;
+        } else if (str[0] == 's') {
+            profile = RATE_SCHEDULE;
+        } else {
+            profile = RATE_FLAT;
+        }
+        schedule_file = iniparser_getstring(cfg, (char*)"arrival:schedule_file",
+                                            NULL);
+        if (arrival_init(&binfo.arrival, process, profile,
+                         iniparser_getdouble(cfg, (char*)"arrival:rate", 0),
+                         iniparser_getdouble(cfg, (char*)"arrival:rate_end", 0),
+                         iniparser_getdouble(cfg, (char*)"arrival:step_rate", 0),
+                         iniparser_getdouble(cfg, (char*)"arrival:step_secs", 0),
+                         binfo.bench_secs, schedule_file) < 0) {
+            printf("WARN: invalid arrival rate profile (ramp needs duration, "
+                   "step needs step_secs, schedule needs a valid "
+                   "schedule_file)\n");
+            iniparser_free(cfg);
+            exit(0);
+        }
+        if (process != ARRIVAL_CLOSED && binfo.with_iterator == 2) {
+            printf("WARN: open-loop arrivals are ignored by iterator alone mode\n");
+        }
+        if (process != ARRIVAL_CLOSED &&
+            binfo.workload.type == WORKLOAD_TRACE) {
+            // the trace timestamps decide when ops are issued
+            printf("WARN: [arrival] is ignored for trace replay, "
+                   "use 'trace_speed' instead\n");
+            arrival_free(&binfo.arrival);
+            binfo.arrival.process = ARRIVAL_CLOSED;
+        }
+    }
+
+    // scanner threads: full or prefix scans next to the benchmark threads
+    {
+        unsigned long mask = 0, pattern = 0;
+        char *end;
+
+        binfo.nscanners = iniparser_getint(cfg, (char*)"scan:scanners", 0);
+        str = iniparser_getstring(cfg, (char*)"scan:mode", (char*)"full");
+        binfo.scan_prefix = (str[0] == 'p' || str[0] == 'P');
+        str = iniparser_getstring(cfg, (char*)"scan:values", (char*)"false");
+        binfo.scan_values = (str[0] == 't' || str[0] == 'T' ||
+                             str[0] == 'e' || str[0] == 'E');
+        memset(binfo.scan_bitmask, 0, sizeof(binfo.scan_bitmask));
+        memset(binfo.scan_pattern, 0, sizeof(binfo.scan_pattern));
+        binfo.scan_rnd_pattern = 0;
+        if (binfo.scan_prefix) {
+            // 32-bit masks, the first key byte is the most significant one
+            str = iniparser_getstring(cfg, (char*)"scan:bitmask",
+                                      (char*)"ffff0000");
+            mask = strtoul(str, &end, 16);
+            if (end == str || mask == 0 || mask > 0xffffffffUL ||
+                ((~mask & 0xffffffffUL) & ((~mask & 0xffffffffUL) + 1))) {
+                printf("WARN: invalid scan bitmask '%s', expected a nonzero "
+                       "prefix mask such as ffff0000\n", str);
+                iniparser_free(cfg);
+                exit(0);
+            }
+            str = iniparser_getstring(cfg, (char*)"scan:pattern", (char*)"");
+            if (str[0]) {
+                pattern = strtoul(str, &end, 16);
+                if (end == str || pattern > 0xffffffffUL) {
+                    printf("WARN: invalid scan pattern '%s'\n", str);
+                    iniparser_free(cfg);
+                    exit(0);
+                }
+            } else {
+                // each scan takes the group of a random key
+                binfo.scan_rnd_pattern = 1;
+            }
+            for (i = 0; i < 4; ++i) {
+                binfo.scan_bitmask[i] = (mask >> (24 - i * 8)) & 0xff;
+                binfo.scan_pattern[i] = (pattern >> (24 - i * 8)) & 0xff;
+            }
+            if (binfo.scan_rnd_pattern &&
+                binfo.workload.type == WORKLOAD_TRACE) {
+                printf("WARN: prefix scans of a trace replay need "
+                       "an explicit scan pattern\n");
+                iniparser_free(cfg);
+                exit(0);
+            }
+        }
+    }
+
+    // cpu cost of each phase from perf_event counters on every thread
+    str = iniparser_getstring(cfg, (char*)"perf:counters", (char*)"false");
+    binfo.perf_counters = (str[0] == 't' || str[0] == 'T' ||
+                           str[0] == 'e' || str[0] == 'E');
+
+    // parameter sweep: every combination of the values is run in turn
+    {
+        static const char *keys[SWEEP_NPARAMS] = {
+            "sweep:queue_depth", "sweep:threads", "sweep:scanners",
+            "sweep:value_size", "sweep:key_length"
+        };
+        struct sweep_dim *d;
+        size_t total_ratio = binfo.ratio[0] + binfo.ratio[1] +
+                             binfo.ratio[2] + binfo.ratio[3];
+        int max;
+
+        memset(&binfo.sweep, 0, sizeof(binfo.sweep));
+        for (i = 0; i < SWEEP_NPARAMS; ++i) {
+            str = iniparser_getstring(cfg, (char*)keys[i], NULL);
+            if (str && sweep_set(&binfo.sweep, i, str) < 0) {
+                printf("WARN: invalid sweep %s '%s', expected a list of "
+                       "values and/or lo:hi[:step] ranges\n",
+                       sweep_param_name(i), str);
+                iniparser_free(cfg);
+                exit(0);
+            }
+        }
+
+        max = sweep_max(&binfo.sweep, SWEEP_QUEUE_DEPTH);
+        if (max > 0) {
+#if defined(__KV_BENCH) || defined(__AS_BENCH)
+            if (binfo.kv_write_mode == 1) {
+                printf("WARN: sweep of queue_depth needs 'write_mode = async'\n");
+                iniparser_free(cfg);
+                exit(0);
+            }
+            if (max > COUCH_MAX_QUEUE_DEPTH ||
+                max > (int)binfo.kp_numunits || max > (int)binfo.vp_numunits) {
+                printf("WARN: sweep of queue_depth goes up to %d, larger than "
+                       "%d or the key/value pool size\n",
+                       max, COUCH_MAX_QUEUE_DEPTH);
+                iniparser_free(cfg);
+                exit(0);
+            }
+            // the device queues are set up for the deepest point
+            binfo.queue_depth = max;
+#else
+            printf("WARN: sweep of queue_depth is supported for KV SSD and "
+                   "aerospike only\n");
+            iniparser_free(cfg);
+            exit(0);
+#endif
+        }
+
+        max = sweep_max(&binfo.sweep, SWEEP_THREADS);
+        if (max > 0) {
+#if defined __KVROCKS_BENCH
+            printf("WARN: sweep of threads is not supported, "
+                   "KV SSD only support one thread per device now\n");
+            iniparser_free(cfg);
+            exit(0);
+#endif
+            if (binfo.workload.type == WORKLOAD_RATIO &&
+                (total_ratio == 0 || total_ratio > 100)) {
+                printf("WARN: sweep of threads needs a mixed workload, i.e. "
+                       "[operation] read_write_insert_delete or [workload]\n");
+                iniparser_free(cfg);
+                exit(0);
+            }
+            j = binfo.nreaders + binfo.niterators + binfo.nwriters +
+                binfo.ndeleters;
+            for (i = 0; max > j && i < (int)binfo.nfiles; ++i) {
+                // cores of the threads that cpu.txt does not cover
+                binfo.instances[i].coreids_bench = (int*)
+                    realloc(binfo.instances[i].coreids_bench, sizeof(int) * max);
+                for (int t = j; t < max; ++t) {
+                    binfo.instances[i].coreids_bench[t] = -1;
+                }
+            }
+        }
+
+        max = sweep_max(&binfo.sweep, SWEEP_SCANNERS);
+        if (max > 0 || binfo.nscanners) {
+#if defined(__COUCH_BENCH) || defined(__AS_BENCH) || defined(__KVROCKS_BENCH)
+            printf("WARN: scans are not supported by %s\n", binfo.dbname);
+            iniparser_free(cfg);
+            exit(0);
+#endif
+#if defined(__KV_BENCH)
+            if (binfo.with_iterator) {
+                // a key group has one open iterator at a time
+                printf("WARN: [scan] cannot be used with kvs:with_iterator\n");
+                iniparser_free(cfg);
+                exit(0);
+            }
+#endif
+        }
+
+        max = sweep_max(&binfo.sweep, SWEEP_VALUE_SIZE);
+        if (max > (int)binfo.vp_unitsize) {
+            printf("WARN: sweep of value_size goes up to %d, larger than "
+                   "'value_pool_unit'\n", max);
+            iniparser_free(cfg);
+            exit(0);
+        }
+
+        d = &binfo.sweep.dim[SWEEP_KEY_LENGTH];
+        if (d->n && (binfo.keyfile || binfo.workload.type == WORKLOAD_TRACE)) {
+            printf("WARN: sweep of key_length does not apply to keys "
+                   "taken from a file\n");
+            iniparser_free(cfg);
+            exit(0);
+        }
+        for (j = 0; j < d->n; ++j) {
+            if (d->vals[j] > (int)binfo.kp_unitsize
+#if defined(__KV_BENCH)
+                || d->vals[j] < couch_kv_min_key_len ||
+                d->vals[j] > couch_kv_max_key_len
+#endif
+                ) {
+                printf("WARN: sweep of key_length: %d is out of range or "
+                       "larger than 'key_pool_unit'\n", d->vals[j]);
+                iniparser_free(cfg);
+                exit(0);
+            }
+        }
+    }
     iniparser_free(cfg);
     return binfo;
 }
@@ -4824,7 +6600,9 @@ int main(int argc, char **argv){
     int initialize = 1;
     int config_only = 0;
     char config_filename[256];
-    const char *short_opt = "hecf:";
+    char *compare_base = NULL;
+    double compare_threshold = 5.0;
+    const char *short_opt = "hecf:r:t:";
     char filename[256], timelog_filename[256];
     char insert_latency_filename[256], insert_ops_filename[256];
     char run_latency_filename[256], run_ops_filename[256];
@@ -4842,6 +6620,8 @@ int main(int argc, char **argv){
 	    {"config",        no_argument,       NULL, 'c'},
         {"help",          no_argument,       NULL, 'h'},
         {"file",          optional_argument, NULL, 'f'},
+        {"compare",       required_argument, NULL, 'r'},
+        {"threshold",     required_argument, NULL, 't'},
         {NULL,            0,                 NULL, 0  }
     };
 
@@ -4867,11 +6647,22 @@ int main(int argc, char **argv){
       		    config_only = 1;
 		        break;
 
+            case 'r':
+                compare_base = optarg;
+                break;
+
+            case 't':
+                compare_threshold = atof(optarg);
+                break;
+
             case 'h':
                 printf("Usage: %s [OPTIONS]\n", argv[0]);
                 printf("  -f file                   file\n");
                 printf("  -e, --database            use existing database file\n");
 		printf("  -c, --config only         generate CPU config file\n");
+                printf("  -r, --compare base new    compare the .manifest of a run against a baseline\n");
+                printf("  -t, --threshold pct       change of throughput or tail latency reported\n");
+                printf("                            as a regression by --compare (default 5)\n");
                 printf("  -h, --help                print this help and exit\n");
                 printf("\n");
                 return(0);
@@ -4888,6 +6679,22 @@ int main(int argc, char **argv){
         };
     };
 
+    if (compare_base) {
+        int nregressions;
+
+        if (optind >= argc) {
+            fprintf(stderr, "%s: --compare needs a baseline and a new manifest\n", argv[0]);
+            return(-2);
+        }
+        nregressions = results_compare(compare_base, argv[optind],
+                                       compare_threshold, stdout);
+        if (nregressions < 0) {
+            fprintf(stderr, "can not read %s or %s\n", compare_base, argv[optind]);
+            return(2);
+        }
+        return (nregressions) ? 1 : 0;
+    }
+
     binfo = get_benchinfo(config_filename, config_only);
 
     if (strcmp(binfo.log_filename, "")){
@@ -4929,6 +6736,28 @@ int main(int argc, char **argv){
       	  run_latency_fp = fopen(run_latency_filename, "w");
       	  run_ops_fp = fopen(run_ops_filename, "w");
       	}
+      	if (binfo.sweep.npoints) {
+      	  sprintf(filename, "%s/%s-sweep.csv", str, binfo.dbname);
+      	  sweep_fp = fopen(filename, "w");
+      	}
+    }
+
+    if (strcmp(binfo.results, "")) {
+        char temp[256], cmd[256], *str;
+        int ret;
+
+        str = _get_dirname(binfo.results, temp);
+        if (str && !_does_file_exist(str)) {
+            sprintf(cmd, "mkdir -p %s > errorlog.txt", str);
+            ret = system(cmd);
+            (void)ret;
+        }
+        if (results_open(&results_out, binfo.results, config_filename,
+                         binfo.dbname, lat_op_name, LAT_NOPS) < 0) {
+            printf("WARN: can not write results to %s.*\n", binfo.results);
+        } else {
+            results_on = true;
+        }
     }
 
     binfo.initialize = initialize;
@@ -4937,6 +6766,10 @@ int main(int argc, char **argv){
 
     do_bench(&binfo);
 
+    if (results_on) {
+        results_close(&results_out);
+    }
+
     if (log_fp) {
         fclose(log_fp);
     }
@@ -4948,6 +6781,9 @@ int main(int argc, char **argv){
       fclose(run_latency_fp);
     if(run_ops_fp)
       fclose(run_ops_fp);
+    if(sweep_fp)
+      fclose(sweep_fp);
+    sweep_free(&binfo.sweep);
     if(binfo.cpuinfo){
       if(binfo.cpuinfo->cpulist)
 	      free(binfo.cpuinfo->cpulist);
@@ -4974,6 +6810,8 @@ int main(int argc, char **argv){
       free(binfo.init_filename);
     if(binfo.log_filename)
       free(binfo.log_filename);
+    if(binfo.results)
+      free(binfo.results);
     if(binfo.device_path)
       free(binfo.device_path);
     if(binfo.kv_device_path)
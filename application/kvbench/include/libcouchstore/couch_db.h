@@ -602,6 +602,34 @@ extern "C" {
                                                 couchstore_walk_tree_callback_fn callback,
                                                 void *ctx);
 
+    /**
+     * Scan the documents of a key group, in the order the store keeps them.
+     *
+     * A key group is defined as in the KV API: the first four bytes of a key
+     * match pattern under bitmask, where bitmask is a prefix (leading one
+     * bits, from the first byte on). Keys shorter than four bytes are padded
+     * with zeros. The callback gets each document with doc_info->size set to
+     * the size of its value, or 0 for a key-only scan.
+     *
+     * kvbench extension, not supported by the couchstore and aerospike modules.
+     *
+     * @param db the database to scan
+     * @param bitmask 4 bytes in key order, or NULL to scan every document
+     * @param pattern 4 bytes in key order, ignored without bitmask
+     * @param with_value non-zero to read the values as well as the keys
+     * @param callback called for every document, a negative return value
+     *          stops the scan
+     * @param ctx client context (passed to the callback)
+     * @return COUCHSTORE_SUCCESS upon success
+     */
+    LIBCOUCHSTORE_API
+    couchstore_error_t couchstore_scan_docs(Db *db,
+                                            const uint8_t *bitmask,
+                                            const uint8_t *pattern,
+                                            int with_value,
+                                            couchstore_walk_tree_callback_fn callback,
+                                            void *ctx);
+
     /*////////////////////  LOCAL DOCUMENTS: */
 
     /**
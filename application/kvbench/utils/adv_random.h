@@ -86,6 +86,8 @@ typedef enum {
     RND_ZIPFIAN,
     RND_FIXED,
     RND_RATIO,
+    RND_LATEST,     // zipfian over the age of the keys, the newest is hottest
+    RND_HOTSPOT,    // uniform within a hot set and within the other keys
 } rndtype_t;
 
 struct rndinfo{
@@ -0,0 +1,266 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "arrival.h"
+#include "memleak.h"
+
+// the number of steps generated when the benchmark has no fixed duration
+#define ARRIVAL_MAX_STEPS (1024)
+
+static int _arrival_add_point(struct arrival_info *ai, size_t *cap,
+                              double t, double rate)
+{
+    struct arrival_point *p;
+
+    if (ai->npoints == *cap) {
+        *cap = (*cap) ? (*cap) * 2 : 16;
+        p = (struct arrival_point *)
+            realloc(ai->points, sizeof(struct arrival_point) * (*cap));
+        if (p == NULL) {
+            return -1;
+        }
+        ai->points = p;
+    }
+    ai->points[ai->npoints].t = t;
+    ai->points[ai->npoints].rate = (rate > 0) ? rate : 0;
+    ai->npoints++;
+    return 0;
+}
+
+// each line of the schedule file is '<seconds> <ops/sec>'; the times must
+// be ascending and the first rate also applies before its time
+static int _arrival_load_schedule(struct arrival_info *ai, size_t *cap,
+                                  char *filename)
+{
+    FILE *fp;
+    char line[256];
+    double t, rate;
+    int ret = 0;
+
+    fp = fopen(filename, "r");
+    if (fp == NULL) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        char *c = line;
+        while (*c == ' ' || *c == '\t') c++;
+        if (*c == '#' || *c == '\n' || *c == '\r' || *c == 0) {
+            continue;
+        }
+        if (sscanf(c, "%lf %lf", &t, &rate) != 2 || t < 0 ||
+            (ai->npoints && t <= ai->points[ai->npoints - 1].t)) {
+            ret = -1;
+            break;
+        }
+        if (ai->npoints == 0 && t > 0) {
+            t = 0;
+        }
+        if (_arrival_add_point(ai, cap, t, rate) < 0) {
+            ret = -1;
+            break;
+        }
+    }
+    fclose(fp);
+
+    return (ret == 0 && ai->npoints == 0) ? -1 : ret;
+}
+
+int arrival_init(struct arrival_info *ai, int process, int profile,
+                 double rate, double rate_end, double step_rate,
+                 double step_secs, double total_secs, char *schedule_file)
+{
+    size_t i, nsteps, cap = 0;
+    int ret = 0;
+
+    memset(ai, 0, sizeof(struct arrival_info));
+    ai->process = process;
+    ai->profile = profile;
+    if (process == ARRIVAL_CLOSED) {
+        return 0;
+    }
+
+    switch (profile) {
+    case RATE_RAMP:
+        if (total_secs <= 0) {
+            return -1;
+        }
+        ret |= _arrival_add_point(ai, &cap, 0, rate);
+        ret |= _arrival_add_point(ai, &cap, total_secs, rate_end);
+        break;
+    case RATE_STEP:
+        if (step_secs <= 0) {
+            return -1;
+        }
+        nsteps = (total_secs > 0) ?
+                 (size_t)ceil(total_secs / step_secs) : ARRIVAL_MAX_STEPS;
+        for (i = 0; i < nsteps && ret == 0; ++i) {
+            ret = _arrival_add_point(ai, &cap, i * step_secs,
+                                     rate + i * step_rate);
+        }
+        break;
+    case RATE_SCHEDULE:
+        if (schedule_file == NULL) {
+            return -1;
+        }
+        ret = _arrival_load_schedule(ai, &cap, schedule_file);
+        break;
+    default:
+        ret = _arrival_add_point(ai, &cap, 0, rate);
+        break;
+    }
+
+    if (ret < 0) {
+        arrival_free(ai);
+        return -1;
+    }
+    return 0;
+}
+
+void arrival_free(struct arrival_info *ai)
+{
+    free(ai->points);
+    ai->points = NULL;
+    ai->npoints = 0;
+}
+
+size_t arrival_segment(struct arrival_info *ai, double t)
+{
+    size_t lo = 0, hi = ai->npoints, mid;
+
+    // the last point whose time is not after t
+    while (hi - lo > 1) {
+        mid = (lo + hi) / 2;
+        if (ai->points[mid].t <= t) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+double arrival_rate(struct arrival_info *ai, double t)
+{
+    size_t i;
+    struct arrival_point *a, *b;
+
+    if (ai->npoints == 0) {
+        return 0;
+    }
+    i = arrival_segment(ai, t);
+    a = &ai->points[i];
+    if (ai->profile != RATE_RAMP || i + 1 == ai->npoints) {
+        return a->rate;
+    }
+    b = &ai->points[i + 1];
+    return a->rate + (b->rate - a->rate) * (t - a->t) / (b->t - a->t);
+}
+
+double arrival_ops(struct arrival_info *ai, double t)
+{
+    size_t i;
+    double ops = 0, end, rate_end;
+    struct arrival_point *a;
+
+    for (i = 0; i < ai->npoints && ai->points[i].t < t; ++i) {
+        a = &ai->points[i];
+        end = (i + 1 < ai->npoints && ai->points[i + 1].t < t) ?
+              ai->points[i + 1].t : t;
+        rate_end = a->rate;
+        if (ai->profile == RATE_RAMP && i + 1 < ai->npoints) {
+            rate_end = a->rate + (ai->points[i + 1].rate - a->rate) *
+                       (end - a->t) / (ai->points[i + 1].t - a->t);
+        }
+        // the rate is linear within a segment, so its mean is exact
+        ops += (end - a->t) * (a->rate + rate_end) / 2;
+    }
+    return ops;
+}
+
+static inline double _arrival_uniform(struct arrival_gen *ag)
+{
+    // xorshift64*, returns (0, 1]
+    ag->rnd ^= ag->rnd >> 12;
+    ag->rnd ^= ag->rnd << 25;
+    ag->rnd ^= ag->rnd >> 27;
+    return ((ag->rnd * 2685821657736338717ULL) >> 11) / 9007199254740992.0 +
+           1.0 / 9007199254740992.0;
+}
+
+// move the schedule past periods whose target rate is zero
+static void _arrival_skip_idle(struct arrival_gen *ag, uint64_t epoch)
+{
+    struct arrival_info *ai = ag->info;
+    double t;
+    size_t i;
+
+    t = (ag->next_ns > epoch) ? (ag->next_ns - epoch) / 1e9 : 0;
+    if (arrival_rate(ai, t) > 0) {
+        return;
+    }
+    for (i = arrival_segment(ai, t) + 1; i < ai->npoints; ++i) {
+        if (ai->points[i].rate > 0) {
+            ag->next_ns = epoch + (uint64_t)(ai->points[i].t * 1e9);
+            return;
+        }
+    }
+    ag->next_ns = UINT64_MAX;
+}
+
+void arrival_gen_init(struct arrival_gen *ag, struct arrival_info *ai,
+                      uint32_t nthreads, uint64_t seed, uint64_t now_ns)
+{
+    double rate;
+
+    ag->info = ai;
+    ag->nthreads = (nthreads) ? nthreads : 1;
+    ag->rnd = (seed) ? seed : 0x9e3779b97f4a7c15ULL;
+    ag->next_ns = now_ns;
+    ag->epoch_ns = __atomic_load_n(&ai->epoch_ns, __ATOMIC_ACQUIRE);
+    if (ai->process == ARRIVAL_CLOSED) {
+        return;
+    }
+    // stagger the threads so that constant arrivals do not come in bursts
+    rate = arrival_rate(ai, 0) / ag->nthreads;
+    if (rate > 0) {
+        ag->next_ns += (uint64_t)(_arrival_uniform(ag) * 1e9 / rate);
+    }
+    _arrival_skip_idle(ag, ag->epoch_ns);
+}
+
+int arrival_gen_due(struct arrival_gen *ag, uint64_t now_ns)
+{
+    uint64_t epoch = __atomic_load_n(&ag->info->epoch_ns, __ATOMIC_ACQUIRE);
+
+    if (epoch != ag->epoch_ns) {
+        // ops still pending from the previous run of the profile are dropped
+        ag->epoch_ns = epoch;
+        ag->next_ns = epoch;
+        _arrival_skip_idle(ag, epoch);
+    }
+    return (now_ns >= ag->next_ns);
+}
+
+uint64_t arrival_gen_next(struct arrival_gen *ag)
+{
+    struct arrival_info *ai = ag->info;
+    uint64_t cur = ag->next_ns;
+    uint64_t epoch = ag->epoch_ns;
+    double t, rate, gap;
+
+    if (cur == UINT64_MAX) {
+        return cur;
+    }
+    t = (cur > epoch) ? (cur - epoch) / 1e9 : 0;
+    rate = arrival_rate(ai, t) / ag->nthreads;
+    if (ai->process == ARRIVAL_POISSON) {
+        gap = -log(_arrival_uniform(ag)) / rate;
+    } else {
+        gap = 1.0 / rate;
+    }
+    ag->next_ns = cur + (uint64_t)(gap * 1e9);
+    _arrival_skip_idle(ag, epoch);
+    return cur;
+}
@@ -0,0 +1,76 @@
+#ifndef _KVBENCH_ARRIVAL_H
+#define _KVBENCH_ARRIVAL_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// arrival process of an open-loop run
+enum arrival_process {
+    ARRIVAL_CLOSED = 0,   // issue the next op as soon as the previous one
+                          // (or a queue slot in async mode) completes
+    ARRIVAL_CONSTANT,     // evenly spaced arrivals
+    ARRIVAL_POISSON,      // exponentially distributed inter-arrival times
+};
+
+// shape of the target rate over time
+enum arrival_profile {
+    RATE_FLAT = 0,        // constant target rate
+    RATE_RAMP,            // linear from rate to rate_end, then hold
+    RATE_STEP,            // rate + k * step_rate for the k-th step
+    RATE_SCHEDULE,        // piecewise constant, read from a file
+};
+
+// the target rate is described by (time, rate) points; between two points
+// the rate is held (flat/step/schedule) or interpolated (ramp)
+struct arrival_point {
+    double t;             // seconds since the start of the profile
+    double rate;          // ops/sec summed over all benchmark threads
+};
+
+struct arrival_info {
+    int process;
+    int profile;
+    struct arrival_point *points;
+    size_t npoints;
+    // start of the profile in latency_now_ns() units; moved forward at the
+    // end of warming up so that the profile covers the evaluation only
+    uint64_t epoch_ns;
+};
+
+// per-thread arrival schedule
+struct arrival_gen {
+    struct arrival_info *info;
+    uint32_t nthreads;    // the target rate is split among this many threads
+    uint64_t next_ns;     // intended start of the next op
+    uint64_t epoch_ns;    // profile start the schedule is based on
+    uint64_t rnd;
+};
+
+int arrival_init(struct arrival_info *ai, int process, int profile,
+                 double rate, double rate_end, double step_rate,
+                 double step_secs, double total_secs, char *schedule_file);
+void arrival_free(struct arrival_info *ai);
+
+// target rate (ops/sec) at t seconds into the profile
+double arrival_rate(struct arrival_info *ai, double t);
+// number of ops that should have arrived during [0, t)
+double arrival_ops(struct arrival_info *ai, double t);
+// index of the point (step) the profile is in at t seconds
+size_t arrival_segment(struct arrival_info *ai, double t);
+
+void arrival_gen_init(struct arrival_gen *ag, struct arrival_info *ai,
+                      uint32_t nthreads, uint64_t seed, uint64_t now_ns);
+// whether the next op is due at now_ns; the schedule starts over when the
+// profile has been restarted
+int arrival_gen_due(struct arrival_gen *ag, uint64_t now_ns);
+// intended start time of the next op; advances the schedule
+uint64_t arrival_gen_next(struct arrival_gen *ag);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
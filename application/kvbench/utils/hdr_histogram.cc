@@ -0,0 +1,175 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "hdr_histogram.h"
+#include "memleak.h"
+
+#define HDR_HALF (1ULL << (HDR_SUB_BITS - 1))
+
+static inline int _hdr_index(uint64_t value)
+{
+    int msb, shift;
+
+    if (value >= (1ULL << HDR_MAX_BITS)) {
+        value = (1ULL << HDR_MAX_BITS) - 1;
+    }
+    if (value < (1ULL << HDR_SUB_BITS)) {
+        return (int)value;
+    }
+    msb = 63 - __builtin_clzll(value);
+    shift = msb - HDR_SUB_BITS + 1;
+    return (int)(((uint64_t)shift << (HDR_SUB_BITS - 1)) + (value >> shift));
+}
+
+static inline int _hdr_shift(int idx)
+{
+    if (idx < (1 << HDR_SUB_BITS)) {
+        return 0;
+    }
+    return (int)(idx >> (HDR_SUB_BITS - 1)) - 1;
+}
+
+static inline uint64_t _hdr_lowest(int idx)
+{
+    int shift = _hdr_shift(idx);
+    return ((uint64_t)idx - ((uint64_t)shift << (HDR_SUB_BITS - 1))) << shift;
+}
+
+static inline uint64_t _hdr_highest(int idx)
+{
+    return _hdr_lowest(idx) + (1ULL << _hdr_shift(idx)) - 1;
+}
+
+static inline uint64_t _load(uint64_t *p)
+{
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+int hdr_init(struct hdr_hist *h)
+{
+    memset(h, 0, sizeof(struct hdr_hist));
+    h->min = UINT64_MAX;
+    h->buckets = (uint64_t *)calloc(HDR_NBUCKETS, sizeof(uint64_t));
+    return (h->buckets == NULL) ? -1 : 0;
+}
+
+void hdr_free(struct hdr_hist *h)
+{
+    free(h->buckets);
+    h->buckets = NULL;
+}
+
+void hdr_reset(struct hdr_hist *h)
+{
+    int i;
+
+    for (i = 0; i < HDR_NBUCKETS; ++i) {
+        __atomic_store_n(&h->buckets[i], 0, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&h->count, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&h->sum, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&h->min, UINT64_MAX, __ATOMIC_RELAXED);
+    __atomic_store_n(&h->max, 0, __ATOMIC_RELAXED);
+}
+
+void hdr_record(struct hdr_hist *h, uint64_t value)
+{
+    uint64_t cur;
+
+    __atomic_fetch_add(&h->buckets[_hdr_index(value)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->sum, value, __ATOMIC_RELAXED);
+
+    cur = _load(&h->max);
+    while (value > cur &&
+           !__atomic_compare_exchange_n(&h->max, &cur, value, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    cur = _load(&h->min);
+    while (value < cur &&
+           !__atomic_compare_exchange_n(&h->min, &cur, value, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+void hdr_add(struct hdr_hist *dst, struct hdr_hist *src)
+{
+    int i;
+    uint64_t n, v;
+
+    for (i = 0; i < HDR_NBUCKETS; ++i) {
+        n = _load(&src->buckets[i]);
+        if (n) {
+            dst->buckets[i] += n;
+            dst->count += n;
+        }
+    }
+    dst->sum += _load(&src->sum);
+    v = _load(&src->max);
+    if (v > dst->max) dst->max = v;
+    v = _load(&src->min);
+    if (v < dst->min) dst->min = v;
+}
+
+void hdr_sub(struct hdr_hist *dst, struct hdr_hist *src)
+{
+    int i, lo = -1, hi = -1;
+
+    dst->count = 0;
+    for (i = 0; i < HDR_NBUCKETS; ++i) {
+        dst->buckets[i] -= src->buckets[i];
+        if (dst->buckets[i]) {
+            dst->count += dst->buckets[i];
+            if (lo < 0) lo = i;
+            hi = i;
+        }
+    }
+    dst->sum -= src->sum;
+    if (hi < 0) {
+        dst->min = UINT64_MAX;
+        dst->max = 0;
+        return;
+    }
+    // keep the exact extremes when they fall into the interval's buckets
+    if (_hdr_index(dst->min) != lo) dst->min = _hdr_lowest(lo);
+    if (_hdr_index(dst->max) != hi) dst->max = _hdr_highest(hi);
+}
+
+uint64_t hdr_value_at_percentile(struct hdr_hist *h, double percentile)
+{
+    int i;
+    uint64_t total = 0, target, acc = 0, v;
+
+    for (i = 0; i < HDR_NBUCKETS; ++i) {
+        total += _load(&h->buckets[i]);
+    }
+    if (total == 0) {
+        return 0;
+    }
+    if (percentile >= 100.0) {
+        return _load(&h->max);
+    }
+
+    target = (uint64_t)ceil(percentile / 100.0 * total);
+    if (target == 0) target = 1;
+
+    for (i = 0; i < HDR_NBUCKETS; ++i) {
+        acc += _load(&h->buckets[i]);
+        if (acc >= target) {
+            break;
+        }
+    }
+    if (i == HDR_NBUCKETS) i = HDR_NBUCKETS - 1;
+
+    // report the bucket's upper bound, clamped to the recorded extremes
+    v = _hdr_highest(i);
+    if (v > _load(&h->max)) v = _load(&h->max);
+    if (v < _load(&h->min)) v = _load(&h->min);
+    return v;
+}
+
+double hdr_mean(struct hdr_hist *h)
+{
+    uint64_t count = _load(&h->count);
+
+    return (count) ? (double)_load(&h->sum) / count : 0;
+}
@@ -0,0 +1,42 @@
+#ifndef _KVBENCH_HDR_HISTOGRAM_H
+#define _KVBENCH_HDR_HISTOGRAM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// log-linear buckets: values below 2^HDR_SUB_BITS are exact, larger values
+// keep HDR_SUB_BITS-1 significant bits (< 0.8% error) up to 2^HDR_MAX_BITS
+#define HDR_SUB_BITS (8)
+#define HDR_MAX_BITS (42)
+#define HDR_NBUCKETS ((HDR_MAX_BITS - HDR_SUB_BITS + 2) << (HDR_SUB_BITS - 1))
+
+// a single histogram may be recorded into by several threads at once and
+// read by a reporter at the same time; all updates are relaxed atomics
+struct hdr_hist {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t *buckets;
+};
+
+int hdr_init(struct hdr_hist *h);
+void hdr_free(struct hdr_hist *h);
+void hdr_reset(struct hdr_hist *h);
+void hdr_record(struct hdr_hist *h, uint64_t value);
+// dst += src, src may be concurrently recorded into
+void hdr_add(struct hdr_hist *dst, struct hdr_hist *src);
+// dst -= src, where src is an earlier snapshot of dst; min/max of the
+// difference are rebuilt from the buckets
+void hdr_sub(struct hdr_hist *dst, struct hdr_hist *src);
+uint64_t hdr_value_at_percentile(struct hdr_hist *h, double percentile);
+double hdr_mean(struct hdr_hist *h);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -9,6 +9,169 @@
 #include "keyloader.h"
 #include "memleak.h"
 
+static uint32_t _keyloader_hash(const char *key, size_t len)
+{
+    // FNV-1a
+    uint32_t h = 2166136261U;
+    size_t i;
+
+    for (i = 0; i < len; ++i) {
+        h = (h ^ (uint8_t)key[i]) * 16777619U;
+    }
+    return h;
+}
+
+static int _keyloader_grow(struct keyloader *handle, uint64_t *segsize)
+{
+    void *arr, *ops;
+
+    if (handle->nkeys < *segsize) {
+        return 0;
+    }
+    *segsize *= 2;
+    arr = realloc(handle->arr, sizeof(struct keyloader_array) * (*segsize));
+    if (arr) {
+        handle->arr = (struct keyloader_array*)arr;
+    }
+    ops = realloc(handle->ops, sizeof(struct keyloader_op_info) * (*segsize));
+    if (ops) {
+        handle->ops = (struct keyloader_op_info*)ops;
+    }
+    return (arr && ops) ? 0 : -1;
+}
+
+static int _keyloader_parse_op(const char *name, size_t len)
+{
+    static const struct {
+        const char *name;
+        int op;
+    } names[] = {
+        {"read", KL_OP_READ}, {"get", KL_OP_READ},
+        {"update", KL_OP_UPDATE}, {"write", KL_OP_UPDATE},
+        {"set", KL_OP_UPDATE}, {"put", KL_OP_UPDATE},
+        {"insert", KL_OP_INSERT},
+        {"delete", KL_OP_DELETE}, {"del", KL_OP_DELETE},
+        {"scan", KL_OP_SCAN},
+        {"rmw", KL_OP_RMW},
+    };
+    size_t i;
+
+    for (i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+        if (strlen(names[i].name) == len &&
+            !strncasecmp(names[i].name, name, len)) {
+            return names[i].op;
+        }
+    }
+    return -1;
+}
+
+// csv trace: 'timestamp_us,op,key,value_size' per line, '#' for comments
+static int _keyloader_init_trace_csv(struct keyloader *handle,
+                                     struct keyloader_option *option)
+{
+    uint64_t pos = 0, end, segsize = 256;
+    const char *line, *field[4];
+    size_t flen[4];
+    int nfields, op;
+    struct keyloader_op_info *info;
+
+    while (pos < handle->filesize) {
+        line = handle->map + pos;
+        end = pos;
+        while (end < handle->filesize &&
+               handle->map[end] != 0x0a && handle->map[end] != 0x0d) {
+            end++;
+        }
+        if (end == pos || line[0] == '#') {
+            pos = end + 1;
+            continue;
+        }
+
+        // split the line into its fields
+        nfields = 0;
+        field[0] = line;
+        for (const char *c = line; c < handle->map + end; ++c) {
+            if (*c == ',') {
+                if (++nfields == 4) {
+                    break;
+                }
+                field[nfields] = c + 1;
+            }
+        }
+        if (nfields != 3) {
+            return -3;
+        }
+        for (nfields = 0; nfields < 3; ++nfields) {
+            flen[nfields] = field[nfields + 1] - field[nfields] - 1;
+        }
+        flen[3] = handle->map + end - field[3];
+
+        op = _keyloader_parse_op(field[1], flen[1]);
+        if (op < 0 || flen[2] == 0) {
+            return -3;
+        }
+        if (_keyloader_grow(handle, &segsize) < 0) {
+            return -4;
+        }
+        info = &handle->ops[handle->nkeys];
+        info->ts_us = strtoull(field[0], NULL, 10);
+        info->value_size = strtoul(field[3], NULL, 10);
+        info->op = op;
+        info->khash = _keyloader_hash(field[2], flen[2]);
+        handle->arr[handle->nkeys].offset = field[2] - handle->map;
+        handle->arr[handle->nkeys].len = flen[2];
+        handle->avg_keysize += flen[2];
+        handle->nkeys++;
+        if (option->max_nkeys && handle->nkeys >= option->max_nkeys) {
+            break;
+        }
+        pos = end + 1;
+    }
+    return 0;
+}
+
+// binary trace: the magic, then a struct keyloader_trace_rec and the key
+// for each op
+static int _keyloader_init_trace_bin(struct keyloader *handle,
+                                     struct keyloader_option *option)
+{
+    uint64_t pos, segsize = 256;
+    size_t magic_len = strlen(KEYLOADER_TRACE_MAGIC);
+    struct keyloader_trace_rec rec;
+    struct keyloader_op_info *info;
+
+    if (handle->filesize < magic_len ||
+        memcmp(handle->map, KEYLOADER_TRACE_MAGIC, magic_len)) {
+        return -3;
+    }
+    pos = magic_len;
+    while (pos + sizeof(rec) <= handle->filesize) {
+        memcpy(&rec, handle->map + pos, sizeof(rec));
+        pos += sizeof(rec);
+        if (rec.op >= KL_OP_NTYPES || rec.keylen == 0 ||
+            pos + rec.keylen > handle->filesize) {
+            return -3;
+        }
+        if (_keyloader_grow(handle, &segsize) < 0) {
+            return -4;
+        }
+        info = &handle->ops[handle->nkeys];
+        info->ts_us = rec.ts_us;
+        info->value_size = rec.value_size;
+        info->op = rec.op;
+        info->khash = _keyloader_hash(handle->map + pos, rec.keylen);
+        handle->arr[handle->nkeys].offset = pos;
+        handle->arr[handle->nkeys].len = rec.keylen;
+        handle->avg_keysize += rec.keylen;
+        handle->nkeys++;
+        pos += rec.keylen;
+        if (option->max_nkeys && handle->nkeys >= option->max_nkeys) {
+            break;
+        }
+    }
+    return 0;
+}
+
 int keyloader_init(struct keyloader *handle,
                    char *filename,
                    struct keyloader_option *option)
@@ -26,6 +189,8 @@ int keyloader_init(struct keyloader *handle,
     }
     handle->nkeys = 0;
     handle->avg_keysize = 0;
+    handle->format = option->format;
+    handle->ops = NULL;
     handle->filesize = lseek(handle->fd, 0, SEEK_END);
 
     handle->map = (char*)mmap(0, handle->filesize, PROT_READ,
@@ -38,6 +203,26 @@ int keyloader_init(struct keyloader *handle,
     handle->arr = (struct keyloader_array*)
                   malloc(sizeof(struct keyloader_array) * segsize);
 
+    if (option->format != KEYLOADER_KEYS) {
+        int ret;
+
+        handle->ops = (struct keyloader_op_info*)
+                      malloc(sizeof(struct keyloader_op_info) * segsize);
+        if (option->format == KEYLOADER_TRACE_BIN) {
+            ret = _keyloader_init_trace_bin(handle, option);
+        } else {
+            ret = _keyloader_init_trace_csv(handle, option);
+        }
+        if (ret < 0) {
+            keyloader_free(handle);
+            return ret;
+        }
+        if (handle->nkeys) {
+            handle->avg_keysize /= handle->nkeys;
+        }
+        return 0;
+    }
+
     r_flag = first_key_found = 0;
     for (i=0;i<handle->filesize;++i) {
         if (handle->map[i] == 0x0d || handle->map[i] == 0x0a) {
@@ -113,10 +298,21 @@ size_t keyloader_get_key(struct keyloader *handle, uint64_t idx, char *buf)
     return len;
 }
 
+struct keyloader_op_info *keyloader_get_op(struct keyloader *handle,
+                                           uint64_t idx)
+{
+    if (handle->ops == NULL || idx >= handle->nkeys) {
+        return NULL;
+    }
+    return &handle->ops[idx];
+}
+
 void keyloader_free(struct keyloader *handle)
 {
     munmap(handle->map, handle->filesize);
     free(handle->arr);
+    free(handle->ops);
+    handle->ops = NULL;
     close(handle->fd);
 }
 
@@ -7,8 +7,47 @@
 extern "C" {
 #endif
 
+// formats of the file given to keyloader_init()
+enum keyloader_format {
+    KEYLOADER_KEYS = 0,     // one key per line
+    KEYLOADER_TRACE_CSV,    // one op per line: 'timestamp_us,op,key,value_size'
+    KEYLOADER_TRACE_BIN,    // KEYLOADER_TRACE_MAGIC, then for each op a
+                            // struct keyloader_trace_rec followed by the key
+};
+
+// op types of a trace; 'op' in a csv trace is one of the names in
+// parentheses
+enum keyloader_op {
+    KL_OP_READ = 0,         // (read, get)
+    KL_OP_UPDATE,           // (update, write, set, put)
+    KL_OP_INSERT,           // (insert)
+    KL_OP_DELETE,           // (delete, del)
+    KL_OP_SCAN,             // (scan) value_size is the number of keys to scan
+    KL_OP_RMW,              // (rmw) read-modify-write
+    KL_OP_NTYPES,
+};
+
+#define KEYLOADER_TRACE_MAGIC "KVTRACE1"
+
+struct keyloader_trace_rec {
+    uint64_t ts_us;
+    uint32_t value_size;
+    uint16_t keylen;
+    uint8_t op;
+    uint8_t reserved;
+};
+
 struct keyloader_option {
     uint64_t max_nkeys;
+    int format;
+};
+
+// per-op info of a trace, the key of op idx is read by keyloader_get_key()
+struct keyloader_op_info {
+    uint64_t ts_us;
+    uint32_t value_size;
+    uint32_t khash;         // hash of the key, to spread ops over threads
+    uint8_t op;
 };
 
 struct keyloader_array {
@@ -23,6 +62,8 @@ struct keyloader {
     char *map;
     struct keyloader_array *arr;
     uint64_t avg_keysize;
+    int format;
+    struct keyloader_op_info *ops;  // traces only
 };
 
 int keyloader_init(struct keyloader *handle,
@@ -33,6 +74,8 @@ uint64_t keyloader_get_nkeys(struct keyloader *handle);
 size_t keyloader_get_avg_keylen(struct keyloader *handle);
 
 size_t keyloader_get_key(struct keyloader *handle, uint64_t idx, char *buf);
+struct keyloader_op_info *keyloader_get_op(struct keyloader *handle,
+                                           uint64_t idx);
 void keyloader_free(struct keyloader *handle);
 
 #ifdef __cplusplus
@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "perfctr.h"
+#include "memleak.h"
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+    const char *name;
+} perf_events[PERF_NCTRS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles"},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions"},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "cache_misses"},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "context_switches"},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, "task_clock"},
+};
+static const char *perf_classes[PERF_NCLASSES] = {"bench", "driver", "other"};
+
+static int _perf_event_open(struct perf_event_attr *attr, pid_t tid)
+{
+    return (int)syscall(__NR_perf_event_open, attr, tid, -1, -1, 0);
+}
+
+static int _perf_class(pid_t tid)
+{
+    char path[64], name[32] = "";
+    FILE *fp;
+
+    if (tid == getpid()) {
+        return PERF_OTHER;
+    }
+    snprintf(path, sizeof(path), "/proc/self/task/%d/comm", (int)tid);
+    fp = fopen(path, "r");
+    if (fp) {
+        if (fgets(name, sizeof(name), fp) == NULL) {
+            name[0] = 0;
+        }
+        fclose(fp);
+    }
+    if (!strncmp(name, "Bench", 5) || !strncmp(name, "Population", 10)) {
+        return (!strncmp(name, "BenchPrinter", 12)) ? PERF_OTHER : PERF_BENCH;
+    }
+    // threads of the driver and of the DB libraries keep the name of the
+    // thread that started them or have names of their own
+    return PERF_DRIVER;
+}
+
+int perf_open(struct perf_set *ps)
+{
+    struct perf_event_attr attr;
+    struct perf_thread *t;
+    struct dirent *ent;
+    DIR *dir;
+    int i, n = 0, max = 0;
+
+    memset(ps, 0, sizeof(struct perf_set));
+    dir = opendir("/proc/self/task");
+    if (dir == NULL) {
+        return -1;
+    }
+    while ((ent = readdir(dir)) != NULL) {
+        if (ent->d_name[0] == '.') {
+            continue;
+        }
+        if (ps->nthreads == max) {
+            max = (max) ? max * 2 : 64;
+            ps->threads = (struct perf_thread *)
+                realloc(ps->threads, sizeof(struct perf_thread) * max);
+        }
+        t = &ps->threads[ps->nthreads++];
+        t->tid = (pid_t)atoi(ent->d_name);
+        t->cls = _perf_class(t->tid);
+        for (i = 0; i < PERF_NCTRS; ++i) {
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = perf_events[i].type;
+            attr.config = perf_events[i].config;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                               PERF_FORMAT_TOTAL_TIME_RUNNING;
+            t->fd[i] = _perf_event_open(&attr, t->tid);
+            if (t->fd[i] < 0 && !attr.exclude_kernel) {
+                // perf_event_paranoid may allow user space counts only
+                attr.exclude_kernel = attr.exclude_hv = 1;
+                t->fd[i] = _perf_event_open(&attr, t->tid);
+            }
+            if (t->fd[i] >= 0) {
+                ps->avail[i] = 1;
+                n++;
+            }
+        }
+    }
+    closedir(dir);
+    return (n) ? 0 : -1;
+}
+
+void perf_read(struct perf_set *ps, struct perf_values *v)
+{
+    struct perf_thread *t;
+    uint64_t buf[3]; // value, time enabled, time running
+    double val;
+    int i, c;
+
+    memset(v, 0, sizeof(struct perf_values));
+    for (i = 0; i < ps->nthreads; ++i) {
+        t = &ps->threads[i];
+        v->nthreads[t->cls]++;
+        for (c = 0; c < PERF_NCTRS; ++c) {
+            if (t->fd[c] < 0 ||
+                read(t->fd[c], buf, sizeof(buf)) != (ssize_t)sizeof(buf)) {
+                continue;
+            }
+            val = (double)buf[0];
+            if (buf[2] && buf[2] < buf[1]) {
+                // the counter shared the pmu with others
+                val = val * buf[1] / buf[2];
+            }
+            v->val[t->cls][c] += (uint64_t)val;
+        }
+    }
+}
+
+void perf_sub(struct perf_values *v, const struct perf_values *base)
+{
+    int i, c;
+
+    for (i = 0; i < PERF_NCLASSES; ++i) {
+        for (c = 0; c < PERF_NCTRS; ++c) {
+            v->val[i][c] = (v->val[i][c] > base->val[i][c]) ?
+                           v->val[i][c] - base->val[i][c] : 0;
+        }
+    }
+}
+
+void perf_close(struct perf_set *ps)
+{
+    int i, c;
+
+    for (i = 0; i < ps->nthreads; ++i) {
+        for (c = 0; c < PERF_NCTRS; ++c) {
+            if (ps->threads[i].fd[c] >= 0) {
+                close(ps->threads[i].fd[c]);
+            }
+        }
+    }
+    free(ps->threads);
+    ps->threads = NULL;
+    ps->nthreads = 0;
+}
+
+const char *perf_ctr_name(int ctr)
+{
+    return perf_events[ctr].name;
+}
+
+const char *perf_class_name(int cls)
+{
+    return perf_classes[cls];
+}
@@ -0,0 +1,66 @@
+#ifndef _KVBENCH_PERFCTR_H
+#define _KVBENCH_PERFCTR_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// host cpu cost of a phase, counted with perf_event_open(2) on every thread
+// of the process; no external profiler is needed
+enum perf_ctr {
+    PERF_CYCLES = 0,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,
+    PERF_CONTEXT_SWITCHES,
+    PERF_TASK_CLOCK,      // cpu time in ns
+    PERF_NCTRS,
+};
+
+// threads are told apart by their names
+enum perf_class {
+    PERF_BENCH = 0,       // threads issuing the ops ("Bench*", "Population")
+    PERF_DRIVER,          // threads of the storage stack: driver submission
+                          // and completion threads, DB background threads
+    PERF_OTHER,           // main thread and kvbench helpers ("BenchPrinter")
+    PERF_NCLASSES,
+};
+
+struct perf_values {
+    uint64_t val[PERF_NCLASSES][PERF_NCTRS];
+    int nthreads[PERF_NCLASSES];
+};
+
+struct perf_thread {
+    pid_t tid;
+    int cls;
+    int fd[PERF_NCTRS];   // -1 if the counter is not available
+};
+
+struct perf_set {
+    struct perf_thread *threads;
+    int nthreads;
+    int avail[PERF_NCTRS]; // the counter is open on at least one thread
+};
+
+// attaches the counters to every thread running now; threads started later
+// are not counted, so call it once the threads of a phase are up. Returns
+// -1 if no counter at all could be opened (e.g. perf_event_paranoid)
+int perf_open(struct perf_set *ps);
+// counts since perf_open(), scaled up when the kernel multiplexed counters;
+// threads that exited meanwhile keep their final counts
+void perf_read(struct perf_set *ps, struct perf_values *v);
+// v -= base, for an earlier perf_read() of the same set
+void perf_sub(struct perf_values *v, const struct perf_values *base);
+void perf_close(struct perf_set *ps);
+
+const char *perf_ctr_name(int ctr);
+const char *perf_class_name(int cls);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,772 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/utsname.h>
+
+#include "results.h"
+#include "iniparser.h"
+#include "crc32.h"
+#include "memleak.h"
+
+// significance level of compare mode
+#define RESULTS_ALPHA (0.05)
+
+static const double summary_pct[] = {50, 90, 99, 99.9, 99.99};
+static const char *summary_name[] = {"p50", "p90", "p99", "p999", "p9999"};
+#define NSUMMARY_PCT (sizeof(summary_pct) / sizeof(summary_pct[0]))
+
+/*
+ * JSON writer
+ */
+
+static void _json_string(FILE *fp, const char *s)
+{
+    fputc('"', fp);
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') {
+            fprintf(fp, "\\%c", *s);
+        } else if ((unsigned char)*s < 0x20) {
+            fprintf(fp, "\\u%04x", (unsigned char)*s);
+        } else {
+            fputc(*s, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+static void _json_indent(struct results *r)
+{
+    int i;
+
+    fputc('\n', r->json);
+    for (i = 0; i < r->depth; ++i) {
+        fputs("  ", r->json);
+    }
+}
+
+// starts the next item of the current object (key) or array (key == NULL)
+static void _json_key(struct results *r, const char *key)
+{
+    if (r->nitems[r->depth]++) {
+        fputc(',', r->json);
+    }
+    _json_indent(r);
+    if (key) {
+        _json_string(r->json, key);
+        fputs(": ", r->json);
+    }
+}
+
+static void _json_open(struct results *r, const char *key, char c)
+{
+    if (r->depth >= 0) {
+        _json_key(r, key);
+    }
+    fputc(c, r->json);
+    r->nitems[++r->depth] = 0;
+}
+
+static void _json_close(struct results *r, char c)
+{
+    int n = r->nitems[r->depth--];
+
+    if (n) {
+        _json_indent(r);
+    }
+    fputc(c, r->json);
+}
+
+static void _json_str(struct results *r, const char *key, const char *val)
+{
+    _json_key(r, key);
+    _json_string(r->json, val);
+}
+
+static void _json_num(struct results *r, const char *key, double val)
+{
+    _json_key(r, key);
+    if (isfinite(val)) {
+        fprintf(r->json, "%.3f", val);
+    } else {
+        fputs("null", r->json);
+    }
+}
+
+static void _json_u64(struct results *r, const char *key, uint64_t val)
+{
+    _json_key(r, key);
+    fprintf(r->json, "%llu", (unsigned long long)val);
+}
+
+// whether a config value can be written as it is as a JSON number
+static int _json_is_number(const char *s)
+{
+    if (*s == '-') s++;
+    if (*s == '0') {
+        s++;
+    } else if (*s >= '1' && *s <= '9') {
+        while (*s >= '0' && *s <= '9') s++;
+    } else {
+        return 0;
+    }
+    if (*s == '.') {
+        s++;
+        if (*s < '0' || *s > '9') return 0;
+        while (*s >= '0' && *s <= '9') s++;
+    }
+    if (*s == 'e' || *s == 'E') {
+        s++;
+        if (*s == '+' || *s == '-') s++;
+        if (*s < '0' || *s > '9') return 0;
+        while (*s >= '0' && *s <= '9') s++;
+    }
+    return (*s == 0);
+}
+
+/*
+ * writer
+ */
+
+// identifies the configuration of a run; comments, formatting and [log],
+// which only tells where the results go, do not count
+static uint32_t _config_crc(dictionary *cfg)
+{
+    uint32_t crc = 0;
+    int i;
+
+    for (i = 0; cfg && i < cfg->size; ++i) {
+        if (cfg->key[i] == NULL || cfg->val[i] == NULL ||
+            !strncmp(cfg->key[i], "log:", 4)) {
+            continue;
+        }
+        crc = crc32_8(cfg->key[i], strlen(cfg->key[i]), crc);
+        crc = crc32_8(cfg->val[i], strlen(cfg->val[i]) + 1, crc);
+    }
+    return crc;
+}
+
+static void _info(struct results *r, const char *key, const char *val)
+{
+    _json_str(r, key, val);
+    fprintf(r->manifest, "%s = %s\n", key, val);
+}
+
+static void _write_config(struct results *r, dictionary *cfg)
+{
+    char section[256] = "";
+    const char *key, *colon;
+    int i;
+
+    _json_open(r, "config", '{');
+    for (i = 0; cfg && i < cfg->size; ++i) {
+        key = cfg->key[i];
+        if (key == NULL || cfg->val[i] == NULL ||
+            (colon = strchr(key, ':')) == NULL) {
+            continue;
+        }
+        if (strncmp(section, key, colon - key) ||
+            section[colon - key] != 0) {
+            if (section[0]) {
+                _json_close(r, '}');
+            }
+            snprintf(section, sizeof(section), "%.*s", (int)(colon - key), key);
+            _json_open(r, section, '{');
+        }
+        if (_json_is_number(cfg->val[i])) {
+            _json_key(r, colon + 1);
+            fputs(cfg->val[i], r->json);
+        } else {
+            _json_str(r, colon + 1, cfg->val[i]);
+        }
+    }
+    if (section[0]) {
+        _json_close(r, '}');
+    }
+    _json_close(r, '}');
+}
+
+int results_open(struct results *r, const char *prefix,
+                 const char *config_file, const char *backend,
+                 const char **op_names, int nops)
+{
+    char filename[1024], buf[256];
+    const char *base;
+    dictionary *cfg;
+    struct utsname un;
+    time_t now;
+    int i;
+
+    memset(r, 0, sizeof(struct results));
+    r->op_names = op_names;
+    r->nops = nops;
+    r->depth = -1;
+
+    snprintf(filename, sizeof(filename), "%s.json", prefix);
+    r->json = fopen(filename, "w");
+    snprintf(filename, sizeof(filename), "%s.csv", prefix);
+    r->csv = fopen(filename, "w");
+    snprintf(filename, sizeof(filename), "%s.manifest", prefix);
+    r->manifest = fopen(filename, "w");
+    if (!r->json || !r->csv || !r->manifest) {
+        results_close(r);
+        return -1;
+    }
+
+    fprintf(r->csv, "phase,time,ops_avg,ops_i,target,reads,writes,deletes,"
+            "cpu_proc,cpu_sys,dev_util,scan_keys_i");
+    for (i = 0; i < nops; ++i) {
+        fprintf(r->csv, ",%s_count,%s_p50,%s_p99,%s_p999,%s_max",
+                op_names[i], op_names[i], op_names[i], op_names[i],
+                op_names[i]);
+    }
+    fprintf(r->csv, "\n");
+
+    _json_open(r, NULL, '{');
+    _json_open(r, "info", '{');
+    fprintf(r->manifest, "[info]\n");
+
+    now = time(NULL);
+    strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+    _info(r, "date", buf);
+    if (gethostname(buf, sizeof(buf)) == 0) {
+        buf[sizeof(buf) - 1] = 0;
+        _info(r, "host", buf);
+    }
+    if (uname(&un) == 0) {
+        snprintf(buf, sizeof(buf), "%s %s %s",
+                 un.sysname, un.release, un.machine);
+        _info(r, "kernel", buf);
+    }
+    _info(r, "backend", backend);
+    _info(r, "config", config_file);
+    cfg = iniparser_new((char *)config_file);
+    snprintf(buf, sizeof(buf), "%08x", _config_crc(cfg));
+    _info(r, "config_crc", buf);
+    // the time series is looked up next to the manifest
+    base = strrchr(prefix, '/');
+    base = (base) ? base + 1 : prefix;
+    snprintf(buf, sizeof(buf), "%s.csv", base);
+    _info(r, "csv", buf);
+    _json_close(r, '}');
+
+    _write_config(r, cfg);
+    if (cfg) {
+        iniparser_free(cfg);
+    }
+    _json_open(r, "phases", '{');
+    fflush(r->manifest);
+    return 0;
+}
+
+void results_close(struct results *r)
+{
+    if (r->json) {
+        // an unfinished phase still has its intervals array open
+        while (r->depth >= 0) {
+            _json_close(r, (r->depth == 3 && r->phase) ? ']' : '}');
+        }
+        fputc('\n', r->json);
+        fclose(r->json);
+    }
+    if (r->csv) {
+        fclose(r->csv);
+    }
+    if (r->manifest) {
+        fclose(r->manifest);
+    }
+    memset(r, 0, sizeof(struct results));
+}
+
+void results_begin_phase(struct results *r, const char *phase)
+{
+    r->phase = phase;
+    r->nintervals = 0;
+    _json_open(r, phase, '{');
+    _json_open(r, "intervals", '[');
+}
+
+void results_interval(struct results *r, struct results_interval *iv)
+{
+    struct hdr_hist *h;
+    int i;
+
+    r->nintervals++;
+
+    _json_open(r, NULL, '{');
+    _json_num(r, "time", iv->time);
+    _json_num(r, "ops_avg", iv->ops_avg);
+    _json_num(r, "ops_i", iv->ops_i);
+    if (iv->target >= 0) {
+        _json_num(r, "target", iv->target);
+    }
+    _json_u64(r, "reads", iv->reads);
+    _json_u64(r, "writes", iv->writes);
+    _json_u64(r, "deletes", iv->deletes);
+    _json_num(r, "cpu_proc", iv->cpu_proc);
+    _json_num(r, "cpu_sys", iv->cpu_sys);
+    if (iv->dev_util >= 0) {
+        _json_num(r, "dev_util", iv->dev_util);
+    }
+    if (iv->scan_keys_i >= 0) {
+        _json_num(r, "scan_keys_i", iv->scan_keys_i);
+    }
+    if (iv->lat) {
+        _json_open(r, "latency_us", '{');
+        for (i = 0; i < r->nops; ++i) {
+            h = &iv->lat[i];
+            if (h->count == 0) {
+                continue;
+            }
+            _json_open(r, r->op_names[i], '{');
+            _json_u64(r, "count", h->count);
+            _json_num(r, "p50", hdr_value_at_percentile(h, 50) / 1000.0);
+            _json_num(r, "p99", hdr_value_at_percentile(h, 99) / 1000.0);
+            _json_num(r, "p999", hdr_value_at_percentile(h, 99.9) / 1000.0);
+            _json_num(r, "max", h->max / 1000.0);
+            _json_close(r, '}');
+        }
+        _json_close(r, '}');
+    }
+    _json_close(r, '}');
+
+    fprintf(r->csv, "%s,%.1f,%.2f,%.2f,%.2f,%llu,%llu,%llu,%.1f,%.1f,%.2f,%.2f",
+            r->phase, iv->time, iv->ops_avg, iv->ops_i,
+            (iv->target >= 0) ? iv->target : 0,
+            (unsigned long long)iv->reads, (unsigned long long)iv->writes,
+            (unsigned long long)iv->deletes, iv->cpu_proc, iv->cpu_sys,
+            (iv->dev_util >= 0) ? iv->dev_util : 0,
+            (iv->scan_keys_i >= 0) ? iv->scan_keys_i : 0);
+    for (i = 0; i < r->nops; ++i) {
+        h = (iv->lat) ? &iv->lat[i] : NULL;
+        if (h == NULL || h->count == 0) {
+            fprintf(r->csv, ",0,0,0,0,0");
+            continue;
+        }
+        fprintf(r->csv, ",%llu,%.1f,%.1f,%.1f,%.1f",
+                (unsigned long long)h->count,
+                hdr_value_at_percentile(h, 50) / 1000.0,
+                hdr_value_at_percentile(h, 99) / 1000.0,
+                hdr_value_at_percentile(h, 99.9) / 1000.0,
+                h->max / 1000.0);
+    }
+    fprintf(r->csv, "\n");
+}
+
+void results_end_phase(struct results *r, struct results_summary *s)
+{
+    struct hdr_hist *h;
+    const char *op;
+    double v;
+    size_t k;
+    int i;
+
+    _json_close(r, ']');
+    _json_open(r, "summary", '{');
+    fprintf(r->manifest, "\n[%s]\n", r->phase);
+
+    _json_num(r, "secs", s->secs);
+    _json_num(r, "ops_per_sec", s->ops);
+    _json_u64(r, "reads", s->reads);
+    _json_u64(r, "writes", s->writes);
+    _json_u64(r, "deletes", s->deletes);
+    _json_num(r, "cpu_proc", s->cpu_proc);
+    _json_num(r, "cpu_sys", s->cpu_sys);
+    fprintf(r->manifest, "secs = %.3f\nops_per_sec = %.2f\n"
+            "reads = %llu\nwrites = %llu\ndeletes = %llu\n"
+            "cpu_proc = %.1f\ncpu_sys = %.1f\nintervals = %d\n",
+            s->secs, s->ops, (unsigned long long)s->reads,
+            (unsigned long long)s->writes, (unsigned long long)s->deletes,
+            s->cpu_proc, s->cpu_sys, r->nintervals);
+    if (s->target >= 0) {
+        _json_num(r, "target", s->target);
+        fprintf(r->manifest, "target = %.2f\n", s->target);
+    }
+    if (s->dev_util >= 0) {
+        _json_num(r, "dev_util", s->dev_util);
+        fprintf(r->manifest, "dev_util = %.2f\n", s->dev_util);
+    }
+    if (s->cycles_op >= 0) {
+        _json_num(r, "cycles_per_op", s->cycles_op);
+        fprintf(r->manifest, "cycles_per_op = %.1f\n", s->cycles_op);
+    }
+    if (s->instr_op >= 0) {
+        _json_num(r, "instructions_per_op", s->instr_op);
+        fprintf(r->manifest, "instructions_per_op = %.1f\n", s->instr_op);
+    }
+    if (s->cpu_s_gb >= 0) {
+        _json_num(r, "cpu_sec_per_gb", s->cpu_s_gb);
+        fprintf(r->manifest, "cpu_sec_per_gb = %.3f\n", s->cpu_s_gb);
+    }
+    if (s->scan_keys >= 0) {
+        _json_num(r, "scan_keys_per_sec", s->scan_keys);
+        _json_num(r, "scan_bytes_per_sec", s->scan_bytes);
+        fprintf(r->manifest, "scan_keys_per_sec = %.2f\n"
+                "scan_bytes_per_sec = %.2f\n", s->scan_keys, s->scan_bytes);
+    }
+
+    if (s->lat) {
+        _json_open(r, "latency_us", '{');
+        for (i = 0; i < r->nops; ++i) {
+            h = &s->lat[i];
+            op = r->op_names[i];
+            if (h->count == 0) {
+                continue;
+            }
+            _json_open(r, op, '{');
+            _json_u64(r, "count", h->count);
+            _json_num(r, "mean", hdr_mean(h) / 1000.0);
+            fprintf(r->manifest, "%s_count = %llu\n%s_mean = %.2f\n",
+                    op, (unsigned long long)h->count, op, hdr_mean(h) / 1000.0);
+            for (k = 0; k < NSUMMARY_PCT; ++k) {
+                v = hdr_value_at_percentile(h, summary_pct[k]) / 1000.0;
+                _json_num(r, summary_name[k], v);
+                fprintf(r->manifest, "%s_%s = %.2f\n", op, summary_name[k], v);
+            }
+            _json_num(r, "max", h->max / 1000.0);
+            fprintf(r->manifest, "%s_max = %.2f\n", op, h->max / 1000.0);
+            _json_close(r, '}');
+        }
+        _json_close(r, '}');
+    }
+    _json_close(r, '}');
+    _json_close(r, '}');
+    r->phase = NULL;
+
+    fflush(r->json);
+    fflush(r->csv);
+    fflush(r->manifest);
+}
+
+void results_cpu_sample(struct results_cpu *c)
+{
+    struct timespec ts;
+    struct rusage ru;
+    unsigned long long v[10];
+    FILE *fp;
+    int i, n;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    c->wall_ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+    getrusage(RUSAGE_SELF, &ru);
+    c->proc_ns = ((uint64_t)ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) *
+                 1000000000ULL +
+                 ((uint64_t)ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000;
+
+    c->sys_busy = c->sys_total = 0;
+    fp = fopen("/proc/stat", "r");
+    if (fp == NULL) {
+        return;
+    }
+    // cpu user nice system idle iowait irq softirq steal guest guest_nice
+    memset(v, 0, sizeof(v));
+    n = fscanf(fp, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+               &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]);
+    fclose(fp);
+    for (i = 0; i < n; ++i) {
+        c->sys_total += v[i];
+    }
+    c->sys_busy = c->sys_total - v[3] - v[4];
+}
+
+void results_cpu_util(struct results_cpu *from, struct results_cpu *to,
+                      double *cpu_proc, double *cpu_sys)
+{
+    uint64_t wall = to->wall_ns - from->wall_ns;
+    uint64_t total = to->sys_total - from->sys_total;
+
+    *cpu_proc = (wall) ? (to->proc_ns - from->proc_ns) * 100.0 / wall : 0;
+    *cpu_sys = (total) ? (to->sys_busy - from->sys_busy) * 100.0 / total : 0;
+}
+
+/*
+ * compare mode
+ */
+
+struct samples {
+    double *v;
+    int n;
+    int cap;
+};
+
+// values of a column of the time series for one phase; zeros of latency
+// columns are intervals without that op and are skipped
+static void _csv_samples(const char *filename, const char *phase,
+                         const char *column, int skip_zero, struct samples *s)
+{
+    FILE *fp;
+    char line[8192], *tok, *save;
+    int col, phase_col = -1, value_col = -1, match;
+    double v;
+
+    s->n = 0;
+    fp = fopen(filename, "r");
+    if (fp == NULL) {
+        return;
+    }
+    if (fgets(line, sizeof(line), fp)) {
+        line[strcspn(line, "\r\n")] = 0;
+        for (col = 0, tok = strtok_r(line, ",", &save); tok;
+             ++col, tok = strtok_r(NULL, ",", &save)) {
+            if (!strcmp(tok, "phase")) phase_col = col;
+            if (!strcmp(tok, column)) value_col = col;
+        }
+    }
+    while (phase_col >= 0 && value_col >= 0 && fgets(line, sizeof(line), fp)) {
+        match = 0;
+        for (col = 0, tok = strtok_r(line, ",", &save); tok;
+             ++col, tok = strtok_r(NULL, ",", &save)) {
+            if (col == phase_col) {
+                match = !strcmp(tok, phase);
+            } else if (col == value_col && match) {
+                v = atof(tok);
+                if (skip_zero && v <= 0) {
+                    break;
+                }
+                if (s->n == s->cap) {
+                    s->cap = (s->cap) ? s->cap * 2 : 64;
+                    s->v = (double *)realloc(s->v, sizeof(double) * s->cap);
+                }
+                s->v[s->n++] = v;
+                break;
+            }
+        }
+    }
+    fclose(fp);
+}
+
+static double _mean_var(struct samples *s, double *var)
+{
+    double mean = 0, d;
+    int i;
+
+    for (i = 0; i < s->n; ++i) {
+        mean += s->v[i];
+    }
+    mean /= s->n;
+    *var = 0;
+    for (i = 0; i < s->n; ++i) {
+        d = s->v[i] - mean;
+        *var += d * d;
+    }
+    *var /= (s->n - 1);
+    return mean;
+}
+
+// continued fraction of the incomplete beta function (modified Lentz)
+static double _betacf(double a, double b, double x)
+{
+    const double tiny = 1e-300;
+    double c = 1, d, h, del, aa;
+    int m, m2;
+
+    d = 1 - (a + b) * x / (a + 1);
+    if (fabs(d) < tiny) d = tiny;
+    d = 1 / d;
+    h = d;
+    for (m = 1; m <= 300; ++m) {
+        m2 = 2 * m;
+        aa = m * (b - m) * x / ((a + m2 - 1) * (a + m2));
+        d = 1 + aa * d;
+        if (fabs(d) < tiny) d = tiny;
+        c = 1 + aa / c;
+        if (fabs(c) < tiny) c = tiny;
+        d = 1 / d;
+        h *= d * c;
+        aa = -(a + m) * (a + b + m) * x / ((a + m2) * (a + m2 + 1));
+        d = 1 + aa * d;
+        if (fabs(d) < tiny) d = tiny;
+        c = 1 + aa / c;
+        if (fabs(c) < tiny) c = tiny;
+        d = 1 / d;
+        del = d * c;
+        h *= del;
+        if (fabs(del - 1) < 1e-12) break;
+    }
+    return h;
+}
+
+// regularized incomplete beta function I_x(a, b)
+static double _ibeta(double a, double b, double x)
+{
+    double bt;
+
+    if (x <= 0) return 0;
+    if (x >= 1) return 1;
+    bt = exp(lgamma(a + b) - lgamma(a) - lgamma(b) +
+             a * log(x) + b * log(1 - x));
+    if (x < (a + 1) / (a + b + 2)) {
+        return bt * _betacf(a, b, x) / a;
+    }
+    return 1 - bt * _betacf(b, a, 1 - x) / b;
+}
+
+// two-sided p-value of Welch's t-test, < 0 if there are too few samples
+static double _welch_p(struct samples *a, struct samples *b)
+{
+    double ma, mb, va, vb, se, t, df;
+
+    if (a->n < 2 || b->n < 2) {
+        return -1;
+    }
+    ma = _mean_var(a, &va);
+    mb = _mean_var(b, &vb);
+    se = va / a->n + vb / b->n;
+    if (se <= 0) {
+        return (ma == mb) ? 1 : 0;
+    }
+    t = (ma - mb) / sqrt(se);
+    df = se * se / ((va / a->n) * (va / a->n) / (a->n - 1) +
+                    (vb / b->n) * (vb / b->n) / (b->n - 1));
+    return _ibeta(df / 2, 0.5, df / (df + t * t));
+}
+
+static void _csv_path(const char *manifest, dictionary *d, char *buf,
+                      size_t len)
+{
+    const char *csv = iniparser_getstring(d, (char *)"info:csv", (char *)"");
+    const char *slash = strrchr(manifest, '/');
+
+    if (csv[0] == '/' || slash == NULL) {
+        snprintf(buf, len, "%s", csv);
+    } else {
+        snprintf(buf, len, "%.*s/%s", (int)(slash - manifest), manifest, csv);
+    }
+}
+
+struct compare_ctx {
+    const char *phase;
+    dictionary *base, *cur;
+    char base_csv[1024], cur_csv[1024];
+    double threshold;
+    FILE *out;
+    int nregressions;
+};
+
+// compares one headline number; higher_better tells the direction of a
+// regression, column is the per-interval series used for the test
+static void _compare_metric(struct compare_ctx *c, const char *name,
+                            const char *key, const char *column,
+                            int higher_better)
+{
+    char k[256];
+    double vb, vc, change, p;
+    struct samples sb = {NULL, 0, 0}, sc = {NULL, 0, 0};
+    const char *verdict = "";
+    int worse, better;
+
+    snprintf(k, sizeof(k), "%s:%s", c->phase, key);
+    vb = iniparser_getdouble(c->base, k, -1);
+    vc = iniparser_getdouble(c->cur, k, -1);
+    if (vb < 0 || vc < 0) {
+        return;
+    }
+
+    _csv_samples(c->base_csv, c->phase, column, !higher_better, &sb);
+    _csv_samples(c->cur_csv, c->phase, column, !higher_better, &sc);
+    p = _welch_p(&sb, &sc);
+    free(sb.v);
+    free(sc.v);
+
+    change = (vb > 0) ? (vc - vb) * 100.0 / vb : 0;
+    worse = (higher_better) ? (change < -c->threshold) : (change > c->threshold);
+    better = (higher_better) ? (change > c->threshold) : (change < -c->threshold);
+    // without a time series the threshold alone decides
+    if (worse && (p < 0 || p < RESULTS_ALPHA)) {
+        verdict = "REGRESSION";
+        c->nregressions++;
+    } else if (better && (p < 0 || p < RESULTS_ALPHA)) {
+        verdict = "improved";
+    }
+
+    fprintf(c->out, "%-6s %-20s %14.2f %14.2f %+9.2f%% ",
+            c->phase, name, vb, vc, change);
+    if (p < 0) {
+        fprintf(c->out, "%9s", "n/a");
+    } else {
+        fprintf(c->out, "%9.4f", p);
+    }
+    fprintf(c->out, "  %s\n", verdict);
+}
+
+int results_compare(const char *base, const char *cur, double threshold_pct,
+                    FILE *out)
+{
+    static const char *tails[][2] = {{"p99", "p99"}, {"p999", "p99.9"}};
+    struct compare_ctx c;
+    char name[256], key[256], column[256];
+    const char *k, *op;
+    size_t t, len;
+    int i, j;
+
+    memset(&c, 0, sizeof(c));
+    c.base = iniparser_new((char *)base);
+    c.cur = iniparser_new((char *)cur);
+    if (c.base == NULL || c.cur == NULL) {
+        if (c.base) iniparser_free(c.base);
+        if (c.cur) iniparser_free(c.cur);
+        return -1;
+    }
+    c.threshold = threshold_pct;
+    c.out = out;
+    _csv_path(base, c.base, c.base_csv, sizeof(c.base_csv));
+    _csv_path(cur, c.cur, c.cur_csv, sizeof(c.cur_csv));
+
+    fprintf(out, "base: %s (%s, %s)\n", base,
+            iniparser_getstring(c.base, (char *)"info:backend", (char *)"?"),
+            iniparser_getstring(c.base, (char *)"info:date", (char *)"?"));
+    fprintf(out, "new:  %s (%s, %s)\n", cur,
+            iniparser_getstring(c.cur, (char *)"info:backend", (char *)"?"),
+            iniparser_getstring(c.cur, (char *)"info:date", (char *)"?"));
+    if (strcmp(iniparser_getstring(c.base, (char *)"info:config_crc", (char *)""),
+               iniparser_getstring(c.cur, (char *)"info:config_crc", (char *)""))) {
+        fprintf(out, "WARN: the runs used different configurations\n");
+    }
+    fprintf(out, "threshold %.1f%%, significance level %.2f\n\n",
+            threshold_pct, RESULTS_ALPHA);
+    fprintf(out, "%-6s %-20s %14s %14s %10s %9s\n",
+            "phase", "metric", "base", "new", "change", "p-value");
+
+    // every phase of the baseline: load, run and those of sweep points
+    for (i = 0; i < iniparser_getnsec(c.base); ++i) {
+        c.phase = iniparser_getsecname(c.base, i);
+        if (c.phase == NULL || !strcmp(c.phase, "info")) {
+            continue;
+        }
+        _compare_metric(&c, "ops/sec", "ops_per_sec", "ops_i", 1);
+        _compare_metric(&c, "scan keys/sec", "scan_keys_per_sec",
+                        "scan_keys_i", 1);
+
+        // every op type the baseline has tail latencies of
+        len = strlen(c.phase);
+        for (j = 0; j < c.base->size; ++j) {
+            k = c.base->key[j];
+            if (k == NULL || strncmp(k, c.phase, len) || k[len] != ':' ||
+                strlen(k) < len + 1 + 4 ||
+                strcmp(k + strlen(k) - 4, "_p99")) {
+                continue;
+            }
+            op = k + len + 1;
+            for (t = 0; t < 2; ++t) {
+                snprintf(name, sizeof(name), "%.*s %s (us)",
+                         (int)(strlen(op) - 4), op, tails[t][1]);
+                snprintf(key, sizeof(key), "%.*s_%s",
+                         (int)(strlen(op) - 4), op, tails[t][0]);
+                snprintf(column, sizeof(column), "%s", key);
+                _compare_metric(&c, name, key, column, 0);
+            }
+        }
+    }
+
+    fprintf(out, "\n%d regression%s\n", c.nregressions,
+            (c.nregressions == 1) ? "" : "s");
+    iniparser_free(c.base);
+    iniparser_free(c.cur);
+    return c.nregressions;
+}
@@ -0,0 +1,103 @@
+#ifndef _KVBENCH_RESULTS_H
+#define _KVBENCH_RESULTS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "hdr_histogram.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RESULTS_MAX_DEPTH (8)
+
+// machine-readable results of a run, written next to each other:
+//   <prefix>.json      run info, configuration echo, every interval and
+//                      the summary of each phase
+//   <prefix>.csv       one line per interval of every phase
+//   <prefix>.manifest  ini file with the run info and the headline numbers
+//                      of each phase; compare mode works on two of these
+struct results {
+    FILE *json;
+    FILE *csv;
+    FILE *manifest;
+    const char **op_names;
+    int nops;
+    const char *phase;
+    int nintervals;
+    // JSON writer: number of items written at each nesting level
+    int depth;
+    int nitems[RESULTS_MAX_DEPTH];
+};
+
+// one print term of a phase
+struct results_interval {
+    double time;          // seconds since the start of the phase
+    double ops_avg;       // ops/sec since the start of the phase
+    double ops_i;         // ops/sec of this interval
+    double target;        // open-loop target ops/sec, < 0 for closed loop
+    uint64_t reads;       // ops completed since the start of the phase
+    uint64_t writes;
+    uint64_t deletes;
+    double cpu_proc;      // cpu used by kvbench in %, 100 is one core
+    double cpu_sys;       // busy time of all cpus of the host in %
+    double dev_util;      // used capacity of the device in %, < 0 if unknown
+    double scan_keys_i;   // keys/sec of the scanner threads in this interval,
+                          // < 0 without scanners
+    struct hdr_hist *lat; // nops latency histograms (ns), NULL if not monitored
+};
+
+struct results_summary {
+    double secs;
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t deletes;
+    double ops;           // ops/sec
+    double target;        // < 0 for closed loop
+    double cpu_proc;
+    double cpu_sys;
+    double dev_util;
+    double scan_keys;     // keys/sec of the scanner threads, < 0 without
+    double scan_bytes;    // bytes/sec of the scanner threads
+    double cycles_op;     // perf_event counters of all threads, < 0 if not
+    double instr_op;      // counted
+    double cpu_s_gb;      // cpu-seconds per GB of keys and values moved
+    struct hdr_hist *lat;
+};
+
+// cpu time consumed up to a point, see results_cpu_util()
+struct results_cpu {
+    uint64_t wall_ns;
+    uint64_t proc_ns;     // user + system time of this process
+    uint64_t sys_busy;    // jiffies from /proc/stat
+    uint64_t sys_total;
+};
+
+int results_open(struct results *r, const char *prefix,
+                 const char *config_file, const char *backend,
+                 const char **op_names, int nops);
+void results_close(struct results *r);
+
+void results_begin_phase(struct results *r, const char *phase);
+void results_interval(struct results *r, struct results_interval *iv);
+void results_end_phase(struct results *r, struct results_summary *s);
+
+void results_cpu_sample(struct results_cpu *c);
+// utilization between two samples
+void results_cpu_util(struct results_cpu *from, struct results_cpu *to,
+                      double *cpu_proc, double *cpu_sys);
+
+// compares the manifest of a new run against a baseline and prints every
+// headline number of the phases both have. Throughput drops and tail latency
+// increases larger than threshold_pct are reported as regressions when they
+// are also significant (Welch's t-test over the intervals, p < 0.05).
+// Returns the number of regressions or -1 if a file can not be read.
+int results_compare(const char *base, const char *cur, double threshold_pct,
+                    FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "sweep.h"
+#include "memleak.h"
+
+// upper bound of the values of one parameter
+#define SWEEP_MAX_VALUES (1024)
+
+static const char *sweep_names[SWEEP_NPARAMS] = {
+    "queue_depth", "threads", "scanners", "value_size", "key_length"
+};
+static const char *sweep_tags[SWEEP_NPARAMS] = {"qd", "t", "s", "v", "k"};
+
+// only the number of scanners can be swept from 0 (no scans)
+static int _sweep_add(struct sweep_dim *d, long val, long min)
+{
+    int *vals;
+
+    if (val < min || val > 0x7fffffff || d->n == SWEEP_MAX_VALUES) {
+        return -1;
+    }
+    vals = (int *)realloc(d->vals, sizeof(int) * (d->n + 1));
+    if (vals == NULL) {
+        return -1;
+    }
+    d->vals = vals;
+    d->vals[d->n++] = (int)val;
+    return 0;
+}
+
+// one element of the list: a value or a range
+static int _sweep_parse(struct sweep_dim *d, char *str, long min)
+{
+    char *lo_str, *hi_str, *step_str, *end;
+    long lo, hi, step = 1, val;
+    int mult = 0;
+
+    lo_str = str;
+    hi_str = strchr(lo_str, ':');
+    if (hi_str == NULL) {
+        val = strtol(lo_str, &end, 10);
+        return (end == lo_str) ? -1 : _sweep_add(d, val, min);
+    }
+    *hi_str++ = 0;
+    step_str = strchr(hi_str, ':');
+    if (step_str) {
+        *step_str++ = 0;
+        while (*step_str == ' ') step_str++;
+        if (*step_str == 'x' || *step_str == 'X') {
+            mult = 1;
+            step_str++;
+        }
+        step = strtol(step_str, &end, 10);
+        if (end == step_str || step < (mult ? 2 : 1)) {
+            return -1;
+        }
+    }
+    lo = strtol(lo_str, &end, 10);
+    if (end == lo_str) {
+        return -1;
+    }
+    hi = strtol(hi_str, &end, 10);
+    if (end == hi_str || hi < lo) {
+        return -1;
+    }
+    if (mult && lo <= 0) {
+        return -1;
+    }
+    for (val = lo; val <= hi; val = (mult) ? val * step : val + step) {
+        if (_sweep_add(d, val, min) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void _sweep_count(struct sweep_info *si)
+{
+    int i;
+
+    si->npoints = 0;
+    for (i = 0; i < SWEEP_NPARAMS; ++i) {
+        if (si->dim[i].n) {
+            si->npoints = ((si->npoints) ? si->npoints : 1) * si->dim[i].n;
+        }
+    }
+}
+
+int sweep_set(struct sweep_info *si, int param, const char *str)
+{
+    struct sweep_dim *d = &si->dim[param];
+    char *buf, *pt, *save;
+    int ret = 0;
+
+    free(d->vals);
+    d->vals = NULL;
+    d->n = 0;
+
+    buf = strdup(str);
+    for (pt = strtok_r(buf, ",", &save); pt && ret == 0;
+         pt = strtok_r(NULL, ",", &save)) {
+        ret = _sweep_parse(d, pt, (param == SWEEP_SCANNERS) ? 0 : 1);
+    }
+    free(buf);
+    if (ret < 0 || d->n == 0) {
+        free(d->vals);
+        d->vals = NULL;
+        d->n = 0;
+        ret = -1;
+    }
+    _sweep_count(si);
+    return ret;
+}
+
+void sweep_free(struct sweep_info *si)
+{
+    int i;
+
+    for (i = 0; i < SWEEP_NPARAMS; ++i) {
+        free(si->dim[i].vals);
+        si->dim[i].vals = NULL;
+        si->dim[i].n = 0;
+    }
+    si->npoints = 0;
+}
+
+int sweep_max(struct sweep_info *si, int param)
+{
+    struct sweep_dim *d = &si->dim[param];
+    int i, max = -1;
+
+    for (i = 0; i < d->n; ++i) {
+        if (d->vals[i] > max) {
+            max = d->vals[i];
+        }
+    }
+    return max;
+}
+
+void sweep_get_point(struct sweep_info *si, size_t idx, struct sweep_point *p)
+{
+    int i;
+
+    for (i = 0; i < SWEEP_NPARAMS; ++i) {
+        if (si->dim[i].n == 0) {
+            p->val[i] = -1;
+            continue;
+        }
+        p->val[i] = si->dim[i].vals[idx % si->dim[i].n];
+        idx /= si->dim[i].n;
+    }
+}
+
+size_t sweep_curve(struct sweep_info *si, size_t idx)
+{
+    int i;
+
+    for (i = 0; i < SWEEP_NPARAMS; ++i) {
+        if (si->dim[i].n > 1) {
+            return idx / si->dim[i].n;
+        }
+    }
+    return idx;
+}
+
+void sweep_point_name(struct sweep_info *si, struct sweep_point *p,
+                      char *buf, size_t len)
+{
+    size_t pos = 0;
+    int i;
+
+    buf[0] = 0;
+    // outermost first, so that names sort like the sweep runs
+    for (i = SWEEP_NPARAMS - 1; i >= 0 && pos < len; --i) {
+        if (si->dim[i].n == 0) {
+            continue;
+        }
+        pos += snprintf(buf + pos, len - pos, "%s%s%d",
+                        (pos) ? "." : "", sweep_tags[i], p->val[i]);
+    }
+}
+
+const char *sweep_param_name(int param)
+{
+    return sweep_names[param];
+}
+
+int steady_init(struct steady_state *ss, int window, double cv)
+{
+    memset(ss, 0, sizeof(struct steady_state));
+    if (window < 2) {
+        window = 2;
+    }
+    ss->samples = (double *)calloc(window, sizeof(double));
+    if (ss->samples == NULL) {
+        return -1;
+    }
+    ss->window = window;
+    ss->cv = cv;
+    return 0;
+}
+
+void steady_free(struct steady_state *ss)
+{
+    free(ss->samples);
+    ss->samples = NULL;
+}
+
+void steady_reset(struct steady_state *ss)
+{
+    ss->n = ss->pos = 0;
+}
+
+int steady_add(struct steady_state *ss, double ops)
+{
+    double mean = 0, var = 0;
+    int i;
+
+    ss->samples[ss->pos] = ops;
+    ss->pos = (ss->pos + 1) % ss->window;
+    if (ss->n < ss->window) {
+        ss->n++;
+    }
+    if (ss->n < ss->window) {
+        return 0;
+    }
+
+    for (i = 0; i < ss->window; ++i) {
+        mean += ss->samples[i];
+    }
+    mean /= ss->window;
+    if (mean <= 0) {
+        return 0;
+    }
+    for (i = 0; i < ss->window; ++i) {
+        var += (ss->samples[i] - mean) * (ss->samples[i] - mean);
+    }
+    var /= ss->window - 1;
+    return (sqrt(var) * 100 / mean <= ss->cv);
+}
@@ -0,0 +1,72 @@
+#ifndef _KVBENCH_SWEEP_H
+#define _KVBENCH_SWEEP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// swept parameters, from the innermost (fastest changing) to the outermost
+enum sweep_param {
+    SWEEP_QUEUE_DEPTH = 0,
+    SWEEP_THREADS,        // benchmark threads per device
+    SWEEP_SCANNERS,       // scanner threads per DB, may be 0
+    SWEEP_VALUE_SIZE,
+    SWEEP_KEY_LENGTH,
+    SWEEP_NPARAMS,
+};
+
+// values of one parameter, n == 0 if the parameter is not swept
+struct sweep_dim {
+    int n;
+    int *vals;
+};
+
+struct sweep_info {
+    struct sweep_dim dim[SWEEP_NPARAMS];
+    size_t npoints;       // every combination of the values, 0 if no sweep
+};
+
+// parameters of one point, -1 for the ones that are not swept
+struct sweep_point {
+    int val[SWEEP_NPARAMS];
+};
+
+// 'str' is a list ("1,2,4") and/or ranges ("lo:hi[:step]", the step
+// multiplies when written as "x2", e.g. "1:64:x2" is 1,2,4,...,64)
+int sweep_set(struct sweep_info *si, int param, const char *str);
+void sweep_free(struct sweep_info *si);
+
+// largest value of a parameter, -1 if it is not swept
+int sweep_max(struct sweep_info *si, int param);
+void sweep_get_point(struct sweep_info *si, size_t idx, struct sweep_point *p);
+// points that differ only in the innermost swept parameter share a curve
+size_t sweep_curve(struct sweep_info *si, size_t idx);
+// e.g. "qd16.t4" for a sweep of queue depth and threads
+void sweep_point_name(struct sweep_info *si, struct sweep_point *p,
+                      char *buf, size_t len);
+const char *sweep_param_name(int param);
+
+// steady state: the throughput of the last 'window' intervals varies by at
+// most 'cv' percent (coefficient of variation)
+struct steady_state {
+    int window;
+    double cv;
+    double *samples;
+    int n;
+    int pos;
+};
+
+int steady_init(struct steady_state *ss, int window, double cv);
+void steady_free(struct steady_state *ss);
+void steady_reset(struct steady_state *ss);
+// adds the throughput of an interval; returns 1 once the state is steady
+int steady_add(struct steady_state *ss, double ops);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -5,14 +5,42 @@
 #include "aerospike/as_record.h"
 #endif
 
+#include <time.h>
 #include "../bench/arch.h"
+#include "hdr_histogram.h"
+
+// latency classes, recorded per thread for every operation
+enum latency_op {
+  LAT_READ,
+  LAT_WRITE,    // update, or store of unknown key existence
+  LAT_INSERT,
+  LAT_DELETE,
+  LAT_ITERATE,
+  LAT_SCAN,
+  LAT_RMW,      // read-modify-write, from the read to the end of the write
+  LAT_NOPS
+};
+
+// options value that asks a wrapper to time an async operation of class op;
+// 0 disables monitoring
+#define LAT_MONITOR(op) ((op) + 1)
 
 struct latency_stat {
-  uint64_t cursor;
-  uint64_t nsamples;
-  uint32_t *samples;
-  spin_t lock;
+  struct hdr_hist hist[LAT_NOPS];   // latencies in ns
 };
+
+static inline uint64_t latency_now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline void latency_record(struct latency_stat *l_stat, int op,
+                                  uint64_t start_ns)
+{
+  hdr_record(&l_stat->hist[op], latency_now_ns() - start_ns);
+}
 /*
 enum Operations  {
   OP_INSERT,
@@ -2,96 +2,111 @@
 #include <stdlib.h>
 #include <math.h>
 
-#include "adv_random.h"
 #include "zipfian_random.h"
 
 #include "memleak.h"
 
-double _get_den_sum(struct zipf_rnd *zipf)
+// log(1 + x) / x, also close to x == 0
+static double _helper1(double x)
 {
-    uint64_t i;
-    double s, sum;
-
-    s = zipf->s;
-    sum = 0;
-
-    for (i=0;i<zipf->n;++i){
-        sum += 1/pow((i+1), s);
+    if (fabs(x) > 1e-8) {
+        return log1p(x) / x;
     }
-    return sum;
+    return 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
 }
 
-double _get_zeta(struct zipf_rnd *zipf, uint64_t k, double s, uint64_t n)
+// (exp(x) - 1) / x, also close to x == 0
+static double _helper2(double x)
 {
-    return (1/pow(k,s)) / zipf->sum;
+    if (fabs(x) > 1e-8) {
+        return expm1(x) / x;
+    }
+    return 1 + x * 0.5 * (1 + x * (1.0 / 3) * (1 + 0.25 * x));
 }
 
-void zipf_rnd_init(struct zipf_rnd *zipf, uint64_t n, double s, uint32_t resolution)
+// h(x) = x^-s and its integral H(x) = (x^(1-s) - 1) / (1 - s), log(x) for s == 1
+static double _h(const struct zipf_rnd *zipf, double x)
 {
-    uint64_t i, j, temp, a, b;
-    uint32_t *table;
-    double cum, zeta;
-    BDR_RNG_VARS;
-
-    zipf->n = n;
-    zipf->s = s;
-    zipf->resolution = resolution;
-    zipf->turn = 0;
-    zipf->table = (uint32_t*)malloc(sizeof(uint32_t) * zipf->n);
-    zipf->map = (uint32_t*)malloc(sizeof(uint32_t) * resolution);
-    zipf->sum = _get_den_sum(zipf);
-
-    memset(zipf->map, 0, sizeof(uint32_t) * resolution);
-    table = zipf->table;
-    for (i=0; i<zipf->n; ++i){
-        table[i] = i;
-    }
+    return exp(-zipf->s * log(x));
+}
 
-    // shuffle zipfian table
-    for (i=0; i<zipf->n; ++i){
-        BDR_RNG_NEXTPAIR;
-        a = rngz % zipf->n;
-        b = rngz2 % zipf->n;
+static double _h_integral(const struct zipf_rnd *zipf, double x)
+{
+    double log_x = log(x);
+    return _helper2((1 - zipf->s) * log_x) * log_x;
+}
 
-        temp = table[a];
-        table[a] = table[b];
-        table[b] = temp;
+static double _h_integral_inv(const struct zipf_rnd *zipf, double x)
+{
+    double t = x * (1 - zipf->s);
+    if (t < -1) {
+        // limited by rounding errors
+        t = -1;
     }
+    return exp(_helper1(t) * x);
+}
 
-    // create map table
-    cum = 0;
-    for (i=0;i<zipf->n;++i){
-        zeta = _get_zeta(zipf, i+1, zipf->s, zipf->n);
-
-        a = (uint64_t)(cum * zipf->resolution);
-        b = (uint64_t)((cum+zeta) * zipf->resolution);
-        if (b >= zipf->resolution) b = zipf->resolution-1;
-        cum += zeta;
-
-        for (j = a; j <= b; ++j){
-            zipf->map[j] = i;
-        }
-    }
+// bijection of [0, mask], cycle-walked into [0, n)
+static uint64_t _scramble(const struct zipf_rnd *zipf, uint64_t x)
+{
+    do {
+        x = (x ^ zipf->seed) & zipf->mask;
+        x = (x * 0x9E3779B97F4A7C15ULL) & zipf->mask;
+        x ^= x >> zipf->shift;
+        x = (x * 0xBF58476D1CE4E5B9ULL) & zipf->mask;
+        x ^= x >> zipf->shift;
+    } while (x >= zipf->n);
+    return x;
 }
 
-uint32_t zipf_rnd_get(struct zipf_rnd *zipf)
+void zipf_rnd_init(struct zipf_rnd *zipf, uint64_t n, double s, uint64_t seed)
 {
-    uint32_t idx, r;
-    r = rand()  % zipf->resolution;
-    idx = (zipf->map[r] + zipf->turn) % zipf->n;
+    int bits = 0;
+
+    memset(zipf, 0, sizeof(struct zipf_rnd));
+    zipf->n = (n) ? n : 1;
+    zipf->s = (s > 0) ? s : 1e-6;
+    zipf->h_x1 = _h_integral(zipf, 1.5) - 1;
+    zipf->h_n = _h_integral(zipf, zipf->n + 0.5);
+    zipf->c = 2 - _h_integral_inv(zipf, _h_integral(zipf, 2.5) - _h(zipf, 2));
 
-    return zipf->table[idx];
+    while (bits < 64 && ((zipf->n - 1) >> bits)) {
+        bits++;
+    }
+    zipf->seed = seed;
+    zipf->mask = (bits == 64) ? ~0ULL : (1ULL << bits) - 1;
+    zipf->shift = (bits + 1) / 2;
+    if (zipf->shift == 0) {
+        zipf->shift = 1;
+    }
 }
 
-void zipf_rnd_shift(struct zipf_rnd *zipf, uint32_t shift)
+uint64_t zipf_rnd_get(const struct zipf_rnd *zipf, uint64_t *state)
 {
-    zipf->turn += shift;
-    zipf->turn = zipf->turn % zipf->n;
+    double u, x;
+    uint64_t k;
+
+    while (1) {
+        // uniform in (h_n, h_x1]
+        u = (double)(zipf_rnd_next(state) >> 11) / (double)(1ULL << 53);
+        u = zipf->h_n + u * (zipf->h_x1 - zipf->h_n);
+        x = _h_integral_inv(zipf, u);
+        k = (uint64_t)(x + 0.5);
+        if (k < 1) {
+            k = 1;
+        } else if (k > zipf->n) {
+            k = zipf->n;
+        }
+        if (k - x <= zipf->c ||
+            u >= _h_integral(zipf, k + 0.5) - _h(zipf, k)) {
+            break;
+        }
+    }
+    return (zipf->seed) ? _scramble(zipf, k - 1) : k - 1;
 }
 
 void zipf_rnd_free(struct zipf_rnd *zipf)
 {
-    free(zipf->table);
-    free(zipf->map);
+    // nothing is allocated; kept for the callers
+    (void)zipf;
 }
-
@@ -7,22 +7,40 @@
 extern "C" {
 #endif
 
+// zipfian ranks over [0, n) with exponent s > 0, drawn by rejection-inversion
+// (Hormann and Derflinger, 1996): O(1) time and memory to set up and per
+// draw, exact for any n. The struct is read-only after zipf_rnd_init(), so
+// threads share it and keep only their own random state.
 struct zipf_rnd{
     uint64_t n;
-    uint32_t resolution;
-    uint32_t *table;
-    // map from [0, resolution) -> table
-    uint32_t *map;
-    uint64_t turn;
     double s;
-    double sum;
+    double h_x1;          // H(1.5) - 1
+    double h_n;           // H(n + 0.5)
+    double c;             // acceptance bound of the squeeze
+    // scrambling: a permutation of [0, n), so that the hot items are spread
+    // over the key space instead of being the lowest ones
+    uint64_t seed;        // 0 if not scrambled
+    uint64_t mask;        // 2^bits - 1, bits covering n - 1
+    int shift;
 };
 
-void zipf_rnd_init(struct zipf_rnd *zipf, uint64_t n, double s, uint32_t resolution);
-uint32_t zipf_rnd_get(struct zipf_rnd *zipf);
-void zipf_rnd_shift(struct zipf_rnd *zipf, uint32_t shift);
+// seed != 0 scrambles the ranks, seed == 0 keeps rank 0 the hottest item
+void zipf_rnd_init(struct zipf_rnd *zipf, uint64_t n, double s, uint64_t seed);
+// 'state' is the caller's xorshift state, nonzero
+uint64_t zipf_rnd_get(const struct zipf_rnd *zipf, uint64_t *state);
 void zipf_rnd_free(struct zipf_rnd *zipf);
 
+// next value of an xorshift64* generator
+static inline uint64_t zipf_rnd_next(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
 #ifdef __cplusplus
 }
 #endif
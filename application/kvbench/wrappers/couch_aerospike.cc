@@ -20,7 +20,6 @@
 #include "aerospike/as_event.h"
 
 #define LATENCY_CHECK
-#define MAX_SAMPLES 1000000
 int64_t VALUE_MAXLEN = 65536; // 64KB
 static int pre_kv_gen = 0;
 
@@ -43,9 +42,6 @@ struct _db {
   IoContext *iodone;
   spin_t lock;
   long outstandingios;
-  latency_stat *l_read;
-  latency_stat *l_write;
-  latency_stat *l_delete;
 };
 
 as_monitor monitor;
@@ -107,11 +103,35 @@ bool is_empty(IoContext *ctx) {
   return (ctx == NULL);
 }
 
-void pass_lstat_to_db(Db *db, latency_stat *l_read, latency_stat *l_write, latency_stat *l_delete)
+// latency stats of the calling bench thread, see pass_lstat_to_db()
+static __thread latency_stat *thread_lstat = NULL;
+// intended start of the next op of an open-loop run, see pass_op_start_to_db()
+static __thread uint64_t thread_start_ns = 0;
+
+static inline uint64_t _op_start_ns()
+{
+  uint64_t start_ns = thread_start_ns;
+
+  thread_start_ns = 0;
+  return (start_ns) ? start_ns : latency_now_ns();
+}
+
+void pass_lstat_to_db(Db *db, latency_stat *l_stat)
+{
+  // async ops record into the stats of the thread that issued them
+  thread_lstat = l_stat;
+}
+
+void reserve_ops_in_db(Db *db, int tid, int nops)
+{
+  // the contexts are preallocated when the db is opened
+}
+
+void pass_op_start_to_db(Db *db, uint64_t start_ns)
 {
-  db->l_read = l_read;
-  db->l_write = l_write;
-  db->l_delete = l_delete;
+  // latency of the next async op is measured from its intended start, so
+  // that the time it waited for a free queue slot is not hidden
+  thread_start_ns = start_ns;
 }
 
 void add_event(Db *db, IoContext *ctx) {
@@ -153,26 +173,8 @@ static void write_complete(as_error *err, void *udata, as_event_loop *loop)
   add_event((Db*)ioctx->private1,ioctx);
 
 #if defined LATENCY_CHECK
-  if(ioctx->monitor == 1){
-    struct timespec t11;
-    unsigned long long start, end;
-    uint64_t cur_sample;
-    latency_stat *l_stat = ioctx->l_stat;
-
-    clock_gettime(CLOCK_REALTIME, &t11);
-    end = t11.tv_sec * 1000000000L + t11.tv_nsec;
-    end /= 1000L;
-    start = ioctx->start;
-    if (l_stat->cursor >= MAX_SAMPLES) {
-      l_stat->cursor = l_stat->cursor % MAX_SAMPLES;
-      l_stat->nsamples = MAX_SAMPLES;
-    } else {
-      l_stat->nsamples = l_stat->cursor + 1;
-    }
-    cur_sample = l_stat->cursor;
-    l_stat->cursor++;
-    l_stat->samples[cur_sample] = end - start;
-
+  if(ioctx->monitor && ioctx->l_stat){
+    latency_record(ioctx->l_stat, ioctx->monitor - 1, ioctx->start);
   }
 #endif
 
@@ -190,26 +192,8 @@ static void read_complete(as_error *err, as_record *record, void *udata, as_even
   add_event((Db*)ioctx->private1, ioctx);
   //((Aerospikedb*)ioctx->private1)->add_event(ioctx);
 #if defined LATENCY_CHECK
-  if(ioctx->monitor == 1){
-    struct timespec t11;
-    unsigned long long start, end;
-    uint64_t cur_sample;
-    latency_stat *l_stat = ioctx->l_stat;
-
-    clock_gettime(CLOCK_REALTIME, &t11);
-    end = t11.tv_sec * 1000000000L + t11.tv_nsec;
-    end /= 1000L;
-    start = ioctx->start;
-    if (l_stat->cursor >= MAX_SAMPLES) {
-      l_stat->cursor = l_stat->cursor % MAX_SAMPLES;
-      l_stat->nsamples = MAX_SAMPLES;
-    } else {
-      l_stat->nsamples = l_stat->cursor + 1;
-    }
-    cur_sample = l_stat->cursor;
-    l_stat->cursor++;
-    l_stat->samples[cur_sample] = end - start;
-
+  if(ioctx->monitor && ioctx->l_stat){
+    latency_record(ioctx->l_stat, ioctx->monitor - 1, ioctx->start);
   }
 #endif
   //as_key_destroy(&ioctx->akey);
@@ -227,26 +211,8 @@ static void delete_complete(as_error *err, void *udata, as_event_loop *loop)
   add_event((Db*)ioctx->private1, ioctx);
 
 #if defined LATENCY_CHECK
-  if(ioctx->monitor == 1){
-    struct timespec t11;
-    unsigned long long start, end;
-    uint64_t cur_sample;
-    latency_stat *l_stat = ioctx->l_stat;
-
-    clock_gettime(CLOCK_REALTIME, &t11);
-    end = t11.tv_sec * 1000000000L + t11.tv_nsec;
-    end /= 1000L;
-    start = ioctx->start;
-    if (l_stat->cursor >= MAX_SAMPLES) {
-      l_stat->cursor = l_stat->cursor % MAX_SAMPLES;
-      l_stat->nsamples = MAX_SAMPLES;
-    } else {
-      l_stat->nsamples = l_stat->cursor + 1;
-    }
-    cur_sample = l_stat->cursor;
-    l_stat->cursor++;
-    l_stat->samples[cur_sample] = end - start;
-
+  if(ioctx->monitor && ioctx->l_stat){
+    latency_record(ioctx->l_stat, ioctx->monitor - 1, ioctx->start);
   }
 #endif
 }
@@ -453,17 +419,12 @@ couchstore_error_t couchstore_save_documents(Db *db, Doc* const docs[], DocInfo
       ctx->valuelength = docs[i]->data.size;
       //ctx->op = OP_INSERT;
       ctx->private1 = db;
-      ctx->l_stat = db->l_write;
+      ctx->l_stat = thread_lstat;
 
 #if defined LATENCY_CHECK
-      if(options == 1) {
-      	struct timespec t11;
-      	unsigned long long nanosec;
-      	clock_gettime(CLOCK_REALTIME, &t11);
-      	nanosec = t11.tv_sec * 1000000000L + t11.tv_nsec;
-      	nanosec /= 1000L;
-      	ctx->start = nanosec;
-      	ctx->monitor = options;
+      ctx->monitor = options;
+      if(options) {
+        ctx->start = _op_start_ns();
       }
 #endif
 
@@ -534,17 +495,12 @@ couchstore_error_t couchstore_open_document(Db *db,
     ctx->valuelength = 0;
     //ctx->op = OP_GET;
     ctx->private1 = db;
-    ctx->l_stat = db->l_read;
+    ctx->l_stat = thread_lstat;
 
 #if defined LATENCY_CHECK
-    if(options == 1) {
-      struct timespec t11;
-      unsigned long long nanosec;
-      clock_gettime(CLOCK_REALTIME, &t11);
-      nanosec = t11.tv_sec * 1000000000L + t11.tv_nsec;
-      nanosec /= 1000L;
-      ctx->start = nanosec;
-      ctx->monitor = options;
+    ctx->monitor = options;
+    if(options) {
+      ctx->start = _op_start_ns();
     }
 #endif
 
@@ -587,17 +543,12 @@ couchstore_error_t couchstore_delete_document_kv(Db *db,sized_buf *key,
     ctx->valuelength = 0;
     //ctx->op = OP_DEL;
     ctx->private1 = db;
-    ctx->l_stat = db->l_delete;
+    ctx->l_stat = thread_lstat;
 
 #if defined LATENCY_CHECK
-    if(options == 1) {
-      struct timespec t11;
-      unsigned long long nanosec;
-      clock_gettime(CLOCK_REALTIME, &t11);
-      nanosec = t11.tv_sec * 1000000000L + t11.tv_nsec;
-      nanosec /= 1000L;
-      ctx->start = nanosec;
-      ctx->monitor = options;
+    ctx->monitor = options;
+    if(options) {
+      ctx->start = _op_start_ns();
     }
 #endif
 
@@ -515,6 +515,89 @@ couchstore_error_t couchstore_walk_id_tree(Db *db,
     return COUCHSTORE_SUCCESS;
 }
 
+// first four bytes of a key under bitmask, as in the key groups of KV devices
+static bool _scan_match(const char *key, size_t len, const uint8_t *bitmask,
+                        const uint8_t *pattern)
+{
+    size_t i;
+    uint8_t c;
+
+    for (i = 0; i < 4; ++i) {
+        c = (i < len) ? (uint8_t)key[i] : 0;
+        if ((c ^ pattern[i]) & bitmask[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// smallest key of a key group: the keys of a prefix group are next to
+// each other, from there on
+static size_t _scan_start(const uint8_t *bitmask, const uint8_t *pattern,
+                          char *start)
+{
+    size_t i, len = 0;
+
+    for (i = 0; i < 4; ++i) {
+        start[i] = pattern[i] & bitmask[i];
+        if (bitmask[i]) {
+            len = i + 1;
+        }
+    }
+    return len;
+}
+
+LIBCOUCHSTORE_API
+couchstore_error_t couchstore_scan_docs(Db *db,
+                                        const uint8_t *bitmask,
+                                        const uint8_t *pattern,
+                                        int with_value,
+                                        couchstore_walk_tree_callback_fn callback,
+                                        void *ctx)
+{
+    fdb_iterator *fit = NULL;
+    fdb_status fs;
+    fdb_doc *doc;
+    DocInfo doc_info = DOC_INFO_INITIALIZER;
+    char start[4];
+    int c_ret = 0;
+
+    if (bitmask) {
+        fs = fdb_iterator_init(db->fdb, &fit, start,
+                               _scan_start(bitmask, pattern, start),
+                               NULL, 0, FDB_ITR_NONE);
+    } else {
+        fs = fdb_iterator_init(db->fdb, &fit, NULL, 0, NULL, 0, FDB_ITR_NONE);
+    }
+    if (fs != FDB_RESULT_SUCCESS) {
+        return COUCHSTORE_ERROR_DOC_NOT_FOUND;
+    }
+
+    do {
+        doc = NULL;
+        // the meta of a document has the length of its body
+        fs = (with_value) ? fdb_iterator_get(fit, &doc) :
+                            fdb_iterator_get_metaonly(fit, &doc);
+        if (fs != FDB_RESULT_SUCCESS) {
+            break;
+        }
+        doc_info.id.buf = (char *)doc->key;
+        doc_info.id.size = doc->keylen;
+        doc_info.size = (with_value) ? doc->bodylen : 0;
+        if (bitmask &&
+            !_scan_match(doc_info.id.buf, doc_info.id.size, bitmask, pattern)) {
+            c_ret = -1;
+        } else {
+            c_ret = callback(db, 0, &doc_info, 0, NULL, ctx);
+        }
+        fdb_doc_free(doc);
+    } while (c_ret >= 0 && fdb_iterator_next(fit) != FDB_RESULT_ITERATOR_FAIL);
+
+    fdb_iterator_close(fit);
+
+    return COUCHSTORE_SUCCESS;
+}
+
 LIBCOUCHSTORE_API
 void couchstore_free_document(Doc *doc)
 {
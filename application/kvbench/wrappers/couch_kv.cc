@@ -7,7 +7,7 @@
 #include <pthread.h>
 #include <unistd.h>
 #include <mutex>
-#include <queue>
+#include <sched.h>
 
 #include "kvs_api.h"
 #include "libcouchstore/couch_db.h"
@@ -20,8 +20,6 @@
 
 #define workload_check (0)
 #define LATENCY_CHECK  // only for async IO completion latency
-//#define MAX_SAMPLES 1000000
-static uint32_t max_sample = 1000000;
 static int use_udd = 0;
 static int kdd_is_polling = 1;
 #define GB_SIZE (1024*1024*1024)
@@ -32,23 +30,44 @@ int couch_kv_max_key_len = KVS_MAX_KEY_LENGTH;
 const char* g_container_name = "container1";
 const int g_max_iterator_count = 16;
 
+// max # of bench/population threads (tid) per db
+#define KV_MAX_THREADS (1024)
+// completion ring entries per thread, more than the ops a thread can have
+// in flight; must be a power of 2
+#define KV_RING_SIZE (1024)
+// ops added to a thread's pool at a time when it runs dry, see
+// reserve_ops_in_db() for sizing it up front
+#define KV_SLAB_OPS (64)
+
+struct kv_bench_data;
+
+// ops are carved out of slabs, which are only freed when the db is closed
+struct kv_slab {
+  struct kv_slab *next;
+  int nops;
+};
+
+// per-thread completion ring and op pool. Completions of a thread's ops are
+// pushed by the driver's completion thread(s) and reaped by that thread
+// alone, so no thread ever scans or waits for another thread's completions.
+// The op pool is only touched by the owning thread: an op is taken when it
+// is submitted and returned when its completion is released.
+struct kv_thread {
+  struct kv_bench_data *ring[KV_RING_SIZE];  // NULL: not completed yet
+  uint64_t tail;                // next slot to fill, claimed by producers
+  uint64_t head;                // next slot to reap, owner only
+  struct kv_bench_data *free_ops;
+  struct kv_slab *slabs;
+};
+
 struct _db {
   int id;
   kvs_device_handle dev;
   kvs_key_space_handle cont_hd;
-  int context_idx;
-  IoContext contexts[256];
-
-  std::queue<IoContext*> *iocontexts;
-  std::queue<IoContext*> *iodone;
-  // only used for async 
-  latency_stat *l_read;
-  latency_stat *l_write;
-  latency_stat *l_delete;
+
+  struct kv_thread *threads[KV_MAX_THREADS];  // by tid, created on first use
   pthread_mutex_t mutex;
 
-  std::queue<kvs_key*> *kvs_key_pool;
-  std::queue<kvs_value*> *kvs_value_pool;
   std::mutex lock_k;
   
   /* For iterator  */
@@ -66,78 +85,159 @@ static int32_t aio_count = 0;
 char udd_core_masks[256];
 char udd_cq_thread_masks[256];
 uint32_t udd_mem_size_mb = 1024;
+static int kv_packing = 0;
+static kvs_option_packing kv_packing_option = {0, 0, 0, 0};
+static int kv_qos = 0;
+static kvs_qos_option kv_qos_option;
+static kvs_option_key_space_qos kv_ks_qos_option = {KVS_QOS_INHERIT, 0, 0, 0};
 
 #define iter_read_size (32 * 1024)
 
-typedef struct {
+typedef struct kv_bench_data {
+  IoContext ctx;          // handed out by getevents(), must come first
+  kvs_key kvskey;
+  kvs_value kvsvalue;
   int tid;
   _db *db;
+  latency_stat *l_stat;   // issuing thread's stats, NULL if not monitored
+  int lat_op;
+  uint64_t start_ns;
+  uint32_t rmw_length;    // value length of the write of a read-modify-write
+  struct kv_bench_data *next;  // op pool
 } kv_bench_data;
 
+// latency stats of the calling bench thread, see pass_lstat_to_db()
+static __thread latency_stat *thread_lstat = NULL;
+// intended start of the next op of an open-loop run, see pass_op_start_to_db()
+static __thread uint64_t thread_start_ns = 0;
+
+static inline uint64_t _op_start_ns()
+{
+  uint64_t start_ns = thread_start_ns;
+
+  thread_start_ns = 0;
+  return (start_ns) ? start_ns : latency_now_ns();
+}
+
 static const char *kv_conf_path = "../env_init.conf";
 static kvs_option_iterator g_iter_mode;
 static std::map<kvs_key_space_handle, kv_bench_data*> kviter_map;
 static std::mutex kviter_lock;
 
+// one entry of an iterator list: key size (uint32_t) and key, followed by
+// value size (uint32_t) and value for key+value iterators; returns the
+// next entry
+static uint8_t *_iter_list_entry(uint8_t *it_buffer, int with_value,
+                                 DocInfo *info)
+{
+  uint32_t size;
+
+  memcpy(&size, it_buffer, sizeof(uint32_t));
+  it_buffer += sizeof(uint32_t);
+  info->id.buf = (char*)it_buffer;
+  info->id.size = size;
+  it_buffer += size;
+
+  info->size = 0;
+  if (with_value) {
+    memcpy(&size, it_buffer, sizeof(uint32_t));
+    it_buffer += sizeof(uint32_t) + size;
+    info->size = size;
+  }
+  return it_buffer;
+}
+
 void print_iterator_keyvals(kvs_iterator_list *iter_list){
   uint8_t *it_buffer = (uint8_t *) iter_list->it_list;
-  uint32_t num_entries = iter_list->num_entries;
-
-  if(g_iter_mode.iter_type) {
-    uint32_t klen  = 16; // Only support fixed key length for iterator
-    uint32_t vlen = sizeof(uint32_t);
-    uint32_t vlen_value = 0;
-
-    for(int i = 0;i < iter_list->num_entries; i++) {
-      fprintf(stdout, "Iterator get %dth key: %s\n", i, it_buffer);
-      it_buffer += 16;
-      
-      uint8_t *addr = (uint8_t *)&vlen_value;
-      for (unsigned int i = 0; i < vlen; i++) {
-	      *(addr + i) = *(it_buffer + i);
-      }
-    
-      it_buffer += vlen;
-      it_buffer += vlen_value;
-    }
-  } else {
-    // For fixed key length
-    /*
-    for(int i = 0; i < iter_list->num_entries; i++)
-      fprintf(stdout, "Iterator get key %s\n",  it_buffer + i * 16);
-    */
-
-    // for ETA50K24 firmware with various key length
-    uint32_t key_size = 0;
-    char key[256];
-
-    for(int i = 0;i < iter_list->num_entries; i++) {
-      // get key size
-      key_size = *((unsigned int*)it_buffer);
-      it_buffer += sizeof(unsigned int);
-      // print key
-      memcpy(key, it_buffer, key_size);
-      key[key_size] = 0;
-      //fprintf(stdout, "%dth key --> %s\n", i, key);
-      it_buffer += key_size;
+  int with_value = (g_iter_mode.iter_type == KVS_ITERATOR_KEY_VALUE);
+  DocInfo info;
+
+  for(uint32_t i = 0; i < iter_list->num_entries; i++) {
+    it_buffer = _iter_list_entry(it_buffer, with_value, &info);
+    if (with_value) {
+      fprintf(stdout, "Iterator get %dth key: %.*s\n", i,
+              (int)info.id.size, info.id.buf);
     }
-    
   }
 }
 
-void release_kvskeyvalue(Db *db, kvs_key *key, kvs_value *value){
-  //memset(key, 0, sizeof(kvs_key));
-  std::unique_lock<std::mutex> lock(db->lock_k);
-  if(key)
-    db->kvs_key_pool->push(key);
-  if(value)
-    db->kvs_value_pool->push(value);
+static struct kv_thread *_get_thread(Db *db, int tid)
+{
+  struct kv_thread *t;
+
+  if (tid < 0 || tid >= KV_MAX_THREADS) {
+    fprintf(stderr, "KVBENCH: thread id %d out of range\n", tid);
+    exit(1);
+  }
+  t = db->threads[tid];
+  if (t == NULL) {
+    // only the thread itself creates its entry, completion threads reach it
+    // through the ops it submits
+    t = (struct kv_thread *)calloc(1, sizeof(struct kv_thread));
+    __atomic_store_n(&db->threads[tid], t, __ATOMIC_RELEASE);
+  }
+  return t;
 }
 
-void add_event(Db *db, IoContext *ctx) {
-  std::unique_lock<std::mutex> lock(db->lock_k);
-  db->iodone->push(ctx);
+static void _add_slab(struct kv_thread *t, int nops)
+{
+  struct kv_slab *slab;
+  kv_bench_data *ops;
 
+  slab = (struct kv_slab *)malloc(sizeof(struct kv_slab) +
+                                  sizeof(kv_bench_data) * nops);
+  if (slab == NULL) {
+    fprintf(stderr, "KVBENCH: can not allocate %d ops\n", nops);
+    exit(1);
+  }
+  slab->nops = nops;
+  slab->next = t->slabs;
+  t->slabs = slab;
+
+  ops = (kv_bench_data *)(slab + 1);
+  for (int i = nops - 1; i >= 0; i--) {
+    ops[i].next = t->free_ops;
+    t->free_ops = &ops[i];
+  }
+}
+
+// takes an op from the pool of the calling thread; once the pool holds
+// enough ops for the thread's queue depth, submitting allocates nothing
+static kv_bench_data *_alloc_op(Db *db, int tid)
+{
+  struct kv_thread *t = _get_thread(db, tid);
+  kv_bench_data *data;
+
+  if (t->free_ops == NULL) {
+    _add_slab(t, KV_SLAB_OPS);
+  }
+  data = t->free_ops;
+  t->free_ops = data->next;
+  memset(data, 0, sizeof(kv_bench_data));
+  data->db = db;
+  data->tid = tid;
+  data->ctx.tid = tid;
+  return data;
+}
+
+static void _free_op(Db *db, kv_bench_data *data)
+{
+  struct kv_thread *t = db->threads[data->tid];
+
+  data->next = t->free_ops;
+  t->free_ops = data;
+}
+
+void add_event(Db *db, kv_bench_data *data) {
+  struct kv_thread *t = __atomic_load_n(&db->threads[data->tid],
+                                        __ATOMIC_ACQUIRE);
+  uint64_t slot = __atomic_fetch_add(&t->tail, 1, __ATOMIC_RELAXED);
+
+  // wait for the owner to make room
+  while (slot - __atomic_load_n(&t->head, __ATOMIC_ACQUIRE) >= KV_RING_SIZE) {
+    sched_yield();
+  }
+  __atomic_store_n(&t->ring[slot & (KV_RING_SIZE - 1)], data, __ATOMIC_RELEASE);
 }
 
 void print_coremask(uint64_t x)
@@ -214,143 +314,70 @@ void on_io_complete(kvs_postprocess_context* ioctx) {
   }
 
   Db* owner = kvdata->db;
-  int tid = kvdata->tid;
-  free(kvdata);
-
-  const auto context_idx = owner->context_idx;
-  latency_stat *l_stat;
+  IoContext *ctx = &kvdata->ctx;
+#if defined LATENCY_CHECK
+  if (kvdata->l_stat) {
+    latency_record(kvdata->l_stat, kvdata->lat_op, kvdata->start_ns);
+  }
+#endif
 
-  if(use_udd) {
+  switch(ioctx->context) {
+  case KVS_CMD_STORE:
+  case KVS_CMD_RETRIEVE:
+    ctx->value = ioctx->value->value;
+    ctx->key = ioctx->key->key;
+    break;
+  case KVS_CMD_DELETE:
+    ctx->value = NULL;
+    ctx->key = ioctx->key->key;
+    break;
+  case KVS_CMD_ITER_NEXT: {
+    if(use_udd) print_iterator_keyvals(&owner->iter_list);
+    ctx->key = ctx->value = NULL;
     std::unique_lock<std::mutex> lock(owner->lock_k);
-    IoContext *ctx = owner->iocontexts->front();
-    ctx->tid = tid;
-    owner->iocontexts->pop();
-    lock.unlock();
-    if(ctx == NULL) {
-      fprintf(stderr, "Not enough context, outstanding %d\n", 
-              (int)owner->iodone->size());
-      exit(1);
-    }
-
-    switch(ioctx->context) {
-    case KVS_CMD_STORE:
-      ctx->value = ioctx->value->value;
-      ctx->key = ioctx->key->key;
-      l_stat = owner->l_write;
-      release_kvskeyvalue(owner, ioctx->key, ioctx->value);
-      break;
-    case KVS_CMD_RETRIEVE:
-      ctx->value = ioctx->value->value;
-      ctx->key = ioctx->key->key;
-      l_stat = owner->l_read;
-      release_kvskeyvalue(owner, ioctx->key, ioctx->value); 
-      break;
-    case KVS_CMD_DELETE:
-      ctx->key = ioctx->key->key;
-      ctx->value = NULL;
-      l_stat = owner->l_delete;
-      release_kvskeyvalue(owner, ioctx->key, 0); 
-      break;
-    case KVS_CMD_ITER_NEXT:
-      //ctx->op = OP_ITER_NEXT;
-      print_iterator_keyvals(&owner->iter_list);
-      ctx->key = ctx->value = NULL;
-      owner->has_iter_finish = 1;
-      break;
-    }
-  
-    //ctx->key = ioctx->key->key;
-    add_event(owner, ctx);
-  } else {  // kdd
-    if(kdd_is_polling) {
-      owner->context_idx++;
-    } else {  // interrupt mode
-      //IoContext *ctx = pop_ctx(owner, 0);
-      std::unique_lock<std::mutex> lock(owner->lock_k);
-      IoContext *ctx = owner->iocontexts->front();
-      ctx->tid = tid;
-      owner->iocontexts->pop();
-      lock.unlock();
-      if(ctx == NULL) {
-      	fprintf(stderr, "Not enough context, outstanding %ld\n", owner->iodone->size());
-      	exit(1);
-      }
+    owner->has_iter_finish = 1;
+    break;
+  }
+  default:
+    break;
+  }
 
-      switch(ioctx->context) {
-      case KVS_CMD_STORE:
-      	ctx->value = ioctx->value->value;
-      	ctx->key = ioctx->key->key;
-      	l_stat = owner->l_write;
-      	release_kvskeyvalue(owner, ioctx->key, ioctx->value);
-      	break;
-      case KVS_CMD_RETRIEVE:
-      	ctx->value = ioctx->value->value;
-      	ctx->key = ioctx->key->key;
-      	l_stat = owner->l_read;
-      	release_kvskeyvalue(owner, ioctx->key, ioctx->value);
-      	break;
-      case KVS_CMD_DELETE:
-      	ctx->value = NULL;
-      	ctx->key = ioctx->key->key;
-      	l_stat = owner->l_delete;
-      	release_kvskeyvalue(owner, ioctx->key, 0);
-      	break;
-      case KVS_CMD_ITER_NEXT:
-      	//print_iterator_keyvals(&owner->iter_list);
-      	//ctx->op= OP_ITER_NEXT;
-      	ctx->key = NULL;
-      	ctx->value = NULL;
-      	std::unique_lock<std::mutex> lock(owner->lock_k);
-      	owner->has_iter_finish = 1;
-      	lock.unlock();
-      	break;
-      }
+  add_event(owner, kvdata);
+}
 
-      add_event(owner, ctx);
-    } // end of interrupt mode
+// the read of a read-modify-write: the write of the same key is issued from
+// its completion, and the op completes, and is timed, with the write
+static void on_rmw_read_complete(kvs_postprocess_context* ioctx) {
+  kv_bench_data* kvdata = (kv_bench_data*)ioctx->private1;
+  kvs_option_store option = {KVS_STORE_POST, NULL};
+  int ret;
 
+  kvdata->kvsvalue.length = kvdata->rmw_length;
+  kvdata->kvsvalue.actual_value_size = kvdata->kvsvalue.offset = 0;
+  ret = kvs_store_kvp_async(kvdata->db->cont_hd, &kvdata->kvskey, &kvdata->kvsvalue,
+                            &option, kvdata, NULL, on_io_complete);
+  if (ret) {
+    fprintf(stderr, "KVBENCH: store tuple async failed %s 0x%x\n", (char*)kvdata->kvskey.key, ret);
+    exit(1);
   }
-  
-#if defined LATENCY_CHECK
-  if (ioctx->private2) {
-    struct timespec t11;
-    unsigned long long start, end;
-    uint64_t cur_sample;
-
-    clock_gettime(CLOCK_REALTIME, &t11);
-    end = t11.tv_sec * 1000000000L + t11.tv_nsec;
-    end /= 1000L;
-    start = *((unsigned long long*)ioctx->private2);
-    free(ioctx->private2);
-    if (l_stat->cursor >= max_sample) {
-      l_stat->cursor = l_stat->cursor % max_sample;
-      l_stat->nsamples = max_sample;
-    } else {
-      l_stat->nsamples = l_stat->cursor + 1;
-    }
-    cur_sample = l_stat->cursor;
-    l_stat->cursor++;
-    l_stat->samples[cur_sample] = end - start;
-  }
-#endif
 }
 
 int getevents(Db *db, int min, int max, IoContext_t **context, int tid)
 {
     int i = 0;
-    std::unique_lock<std::mutex> lock(db->lock_k);
-    int queue_size = db->iodone->size();
-    while(queue_size > 0 && i < max) {
-      context[i] = db->iodone->front();
-      db->iodone->pop();
-      if(context[i]->tid!=tid){
-        db->iodone->push(context[i]);
-      }else{
-        i++;
+    struct kv_thread *t = _get_thread(db, tid);
+    kv_bench_data **slot, *data;
+
+    while (i < max) {
+      slot = &t->ring[t->head & (KV_RING_SIZE - 1)];
+      data = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+      if (data == NULL) {
+        break;
       }
-      queue_size--;
+      *slot = NULL;
+      __atomic_store_n(&t->head, t->head + 1, __ATOMIC_RELEASE);
+      context[i++] = &data->ctx;
     }
-    lock.unlock();
     return i;
 }
 
@@ -430,42 +457,10 @@ couchstore_error_t couchstore_open_db_kvs(const char *dev_path,
   }
   
   ppdb->id = id;
-  ppdb->context_idx = 0;
   //ppdb->iter_handle = NULL;
   ppdb->has_iter_finish = 1;
-  memset(ppdb->contexts, 0, sizeof(ppdb->contexts));
   pthread_mutex_init(&(ppdb->mutex), NULL);
 
-  if(use_udd == 1 || kdd_is_polling == 0) {
-    IoContext *context = NULL;
-    ppdb->iocontexts = new std::queue<IoContext*>;
-    ppdb->iodone = new std::queue<IoContext*>;
-    
-    ppdb->kvs_key_pool = new std::queue<kvs_key*>;
-    ppdb->kvs_value_pool = new std::queue<kvs_value*>;
-    
-    kvs_key *key = NULL;
-    kvs_value *value = NULL;
-    for (int i =0; i < 36000; i++) {
-      context = (IoContext *)malloc(sizeof(IoContext));
-      memset(context, 0, sizeof(IoContext));
-      if(context == NULL){
-        fprintf(stderr, "Can not allocate db context\n");
-        kvs_close_device(ppdb->dev);
-        exit(0);
-      }
-
-      ppdb->iocontexts->push(context);
-      
-      key = (kvs_key*)malloc(sizeof(kvs_key));
-      ppdb->kvs_key_pool->push(key);
-
-      value = (kvs_value*)malloc(sizeof(kvs_value));
-      ppdb->kvs_value_pool->push(value);
-      
-    }
-  }
-    
   /* Keyspace related op */
   uint32_t valid_cnt = 0;
   const uint32_t retrieve_cnt = 2;
@@ -489,6 +484,18 @@ couchstore_error_t couchstore_open_db_kvs(const char *dev_path,
   kvs_option_key_space option = {KVS_KEY_ORDER_NONE};
   kvs_create_key_space(ppdb->dev, &ks_name, 0, option);
   kvs_open_key_space(ppdb->dev, (char *)g_container_name, &ppdb->cont_hd);
+  if (kv_packing) {
+    kvs_result ret = kvs_enable_packing(ppdb->cont_hd, &kv_packing_option);
+    if (ret != KVS_SUCCESS)
+      fprintf(stderr, "WARN: failed to enable packing: 0x%x\n", ret);
+  }
+  if (kv_qos) {
+    kvs_result ret = kvs_set_qos(ppdb->dev, &kv_qos_option);
+    if (ret == KVS_SUCCESS && (kv_ks_qos_option.iops_limit || kv_ks_qos_option.bandwidth_limit))
+      ret = kvs_set_key_space_qos(ppdb->cont_hd, &kv_ks_qos_option);
+    if (ret != KVS_SUCCESS)
+      fprintf(stderr, "WARN: failed to set qos: 0x%x\n", ret);
+  }
 
   fprintf(stdout, "device open %s\n", dev_path);
 
@@ -498,34 +505,31 @@ couchstore_error_t couchstore_open_db_kvs(const char *dev_path,
 LIBCOUCHSTORE_API
 couchstore_error_t couchstore_close_db(Db *db)
 {
-  if(use_udd || kdd_is_polling == 0) {
-    IoContext *tmp;
-
-    std::unique_lock<std::mutex> lock(db->lock_k);
+  for (int i = 0; i < KV_MAX_THREADS; i++) {
+    struct kv_slab *slab;
 
-    while(!db->iocontexts->empty()) {
-      tmp = db->iocontexts->front();
-      db->iocontexts->pop();
-      free(tmp);
+    if (db->threads[i] == NULL) {
+      continue;
     }
-    delete db->iocontexts;
-    delete db->iodone;
-
-    kvs_key *key;
-    kvs_value *value;
-    while(!db->kvs_key_pool->empty()) {
-      key = db->kvs_key_pool->front();
-      db->kvs_key_pool->pop();
-      free(key);
+    while ((slab = db->threads[i]->slabs) != NULL) {
+      db->threads[i]->slabs = slab->next;
+      free(slab);
     }
-    delete db->kvs_key_pool;
-    
-    while(!db->kvs_value_pool->empty()) {
-      value = db->kvs_value_pool->front();
-      db->kvs_value_pool->pop();
-      free(value);
+    free(db->threads[i]);
+  }
+
+  if (kv_qos) {
+    static const char *qos_names[KVS_QOS_CLASSES] = {"high", "normal", "low"};
+    kvs_stats *stats = (kvs_stats *)malloc(sizeof(kvs_stats));
+    if (stats && kvs_get_stats(db->dev, stats) == KVS_SUCCESS) {
+      for (int c = 0; c < KVS_QOS_CLASSES; c++) {
+        if (stats->qos[c].count == 0) continue;
+        fprintf(stdout, "qos %s: %lu commands, queueing delay avg %.1f us\n", qos_names[c],
+                (unsigned long)stats->qos[c].count,
+                stats->qos[c].latency_sum_ns / 1000.0 / stats->qos[c].count);
+      }
     }
-    delete db->kvs_value_pool;
+    free(stats);
   }
 
   kvs_close_key_space(db->cont_hd);
@@ -627,15 +631,20 @@ couchstore_error_t couchstore_iterator_next(Db *db) {
   db->has_iter_finish = 0;
   lock.unlock();
 
-  kv_bench_data* data = (kv_bench_data*)malloc(sizeof(kv_bench_data));
-  data->db = db;
-  data->tid = 0;
+  kv_bench_data* data = _alloc_op(db, 0);
+#if defined LATENCY_CHECK
+  if(thread_lstat){
+    data->l_stat = thread_lstat;
+    data->lat_op = LAT_ITERATE;
+    data->start_ns = latency_now_ns();
+  }
+#endif
   
   memset(iter_list->it_list, 0, iter_read_size);
   int ret = kvs_iterate_next_async(db->cont_hd, db->iter_handle, iter_list,
                                     data, NULL, on_io_complete);
   if (ret) {
-    if(data) free(data);
+    _free_op(db, data);
     fprintf(stderr, "KVBENCH: read iterator failed for %d\n", ret);
     exit(0);
   }
@@ -667,16 +676,10 @@ couchstore_error_t kvs_get_async(Db *db, sized_buf *key, sized_buf *value,
 
 {
   int ret;
+  kv_bench_data* data = _alloc_op(db, key->tid);
+  kvs_key *kvskey = &data->kvskey;
+  kvs_value *kvsvalue = &data->kvsvalue;
 
-  std::unique_lock<std::mutex> lock(db->lock_k);
-  kvs_key *kvskey = db->kvs_key_pool->front();
-  db->kvs_key_pool->pop();
-  kvs_value *kvsvalue = db->kvs_value_pool->front();
-  db->kvs_value_pool->pop();
-  lock.unlock();
-  
-  if(kvskey == NULL || kvsvalue == NULL) {fprintf(stdout, "No elem in the kvs key/value_pool\n"); exit(0);}
-  
   kvskey->key = key->buf;
   kvskey->length = (uint16_t)key->size;
 
@@ -685,30 +688,19 @@ couchstore_error_t kvs_get_async(Db *db, sized_buf *key, sized_buf *value,
   kvsvalue->actual_value_size = kvsvalue->offset = 0;
   
   kvs_option_retrieve option = {false};
-  kv_bench_data* data = (kv_bench_data*)malloc(sizeof(kv_bench_data));
-  memset(data, 0, sizeof(kv_bench_data));
-  data->db = db;
-  data->tid = key->tid;
 
-  uint64_t *ptime = NULL;
 #if defined LATENCY_CHECK
-  if(options == 1){
-    struct timespec t11;
-    unsigned long long nanosec;
-    clock_gettime(CLOCK_REALTIME, &t11);
-    unsigned long long *p1 = (unsigned long long *)malloc(sizeof(unsigned long long));
-    nanosec = t11.tv_sec * 1000000000L + t11.tv_nsec;
-    nanosec /= 1000L;
-    *p1 = nanosec;
-    ptime = (uint64_t*)p1;
+  if(options && thread_lstat){
+    data->l_stat = thread_lstat;
+    data->lat_op = options - 1;
+    data->start_ns = _op_start_ns();
   }
 #endif
 
-  ret = kvs_retrieve_kvp_async(db->cont_hd, kvskey, &option, data, ptime, 
+  ret = kvs_retrieve_kvp_async(db->cont_hd, kvskey, &option, data, NULL, 
                                 kvsvalue, on_io_complete);
   if (ret) {
-    if(data) free(data);
-    if(ptime) free(ptime);
+    _free_op(db, data);
     fprintf(stderr, "KVBENCH: retrieve tuple async failed for %s, err 0x%x\n", (char*)key->buf, ret);
     exit(1);
   }
@@ -716,6 +708,43 @@ couchstore_error_t kvs_get_async(Db *db, sized_buf *key, sized_buf *value,
   return COUCHSTORE_SUCCESS; 
 }
 
+couchstore_error_t kvs_rmw_async(Db *db, sized_buf *key, sized_buf *value,
+				 couchstore_open_options options)
+{
+  int ret;
+  kv_bench_data* data = _alloc_op(db, key->tid);
+  kvs_key *kvskey = &data->kvskey;
+  kvs_value *kvsvalue = &data->kvsvalue;
+
+  kvskey->key = key->buf;
+  kvskey->length = (uint16_t)key->size;
+
+  kvsvalue->value = value->buf;
+  kvsvalue->length = (uint32_t)value->size;
+  kvsvalue->actual_value_size = kvsvalue->offset = 0;
+  data->rmw_length = kvsvalue->length;
+
+  kvs_option_retrieve option = {false};
+
+#if defined LATENCY_CHECK
+  if(options && thread_lstat){
+    data->l_stat = thread_lstat;
+    data->lat_op = options - 1;
+    data->start_ns = _op_start_ns();
+  }
+#endif
+
+  ret = kvs_retrieve_kvp_async(db->cont_hd, kvskey, &option, data, NULL,
+                                kvsvalue, on_rmw_read_complete);
+  if (ret) {
+    _free_op(db, data);
+    fprintf(stderr, "KVBENCH: retrieve tuple async failed for %s, err 0x%x\n", (char*)key->buf, ret);
+    exit(1);
+  }
+
+  return COUCHSTORE_SUCCESS;
+}
+
 couchstore_error_t kvs_store_sync(Db *db, Doc* const docs[],
 				   unsigned numdocs, couchstore_save_options options)
 {
@@ -742,14 +771,9 @@ couchstore_error_t kvs_store_async(Db *db, Doc* const docs[],
 
   assert(numdocs == 1);
   kvs_option_store option = {KVS_STORE_POST, NULL};
-
-  std::unique_lock<std::mutex> lock(db->lock_k);
-  kvs_key *kvskey = db->kvs_key_pool->front();
-  db->kvs_key_pool->pop();
-  kvs_value *kvsvalue = db->kvs_value_pool->front();
-  db->kvs_value_pool->pop();
-  lock.unlock();
-  if(kvskey == NULL || kvsvalue == NULL) {fprintf(stdout, "No elem in the kvs key/value_pool\n"); exit(0);}
+  kv_bench_data* data = _alloc_op(db, docs[0]->tid);
+  kvs_key *kvskey = &data->kvskey;
+  kvs_value *kvsvalue = &data->kvsvalue;
 
   kvskey->key = docs[0]->id.buf;
   kvskey->length = (uint16_t)docs[0]->id.size;
@@ -757,29 +781,18 @@ couchstore_error_t kvs_store_async(Db *db, Doc* const docs[],
   kvsvalue->value = docs[0]->data.buf;
   kvsvalue->length = (uint32_t)docs[0]->data.size;
   kvsvalue->actual_value_size = kvsvalue->offset = 0;
-  kv_bench_data* data = (kv_bench_data*)malloc(sizeof(kv_bench_data));
-  memset(data, 0, sizeof(kv_bench_data));
-  data->db = db;
-  data->tid = docs[0]->tid;
 
-  uint64_t *ptime = NULL;
 #if defined LATENCY_CHECK
-  if(options == 1){
-    struct timespec t11;
-    unsigned long long nanosec;
-    clock_gettime(CLOCK_REALTIME, &t11);
-    unsigned long long *p1 = (unsigned long long *)malloc(sizeof(unsigned long long));
-    nanosec = t11.tv_sec * 1000000000L + t11.tv_nsec;
-    nanosec /= 1000L;
-    *p1 = nanosec;
-    ptime = (uint64_t*)p1;
+  if(options && thread_lstat){
+    data->l_stat = thread_lstat;
+    data->lat_op = options - 1;
+    data->start_ns = _op_start_ns();
   }
 #endif
   ret = kvs_store_kvp_async(db->cont_hd, kvskey, kvsvalue, &option, 
-                            data, ptime, on_io_complete);
+                            data, NULL, on_io_complete);
   if (ret) {
-    if(data) free(data);
-    if(ptime) free(ptime);
+    _free_op(db, data);
     fprintf(stderr, "KVBENCH: store tuple async failed %s 0x%x\n", (char*)docs[0]->id.buf, ret);
     exit(1);
   }
@@ -807,37 +820,23 @@ couchstore_error_t kvs_delete_async(Db *db, sized_buf *key,
 
   int ret;
   kvs_option_delete option = {false};
+  kv_bench_data* data = _alloc_op(db, key->tid);
+  kvs_key *kvskey = &data->kvskey;
 
-  std::unique_lock<std::mutex> lock(db->lock_k);  
-  kvs_key *kvskey = db->kvs_key_pool->front();
-  db->kvs_key_pool->pop();
-  lock.unlock();
-  if(kvskey == NULL) {fprintf(stdout, "No elem in the kvs key/value_pool\n"); exit(0);}
   kvskey->key = key->buf;
   kvskey->length = key->size;
-  kv_bench_data* data = (kv_bench_data*)malloc(sizeof(kv_bench_data));
-  memset(data, 0, sizeof(kv_bench_data));
-  data->db = db;
-  data->tid = key->tid;
 
-  uint64_t *ptime = NULL;
 #if defined LATENCY_CHECK
-  if(options == 1){
-    struct timespec t11;
-    unsigned long long nanosec;
-    clock_gettime(CLOCK_REALTIME, &t11);
-    unsigned long long *p1 = (unsigned long long *)malloc(sizeof(unsigned long long));
-    nanosec = t11.tv_sec * 1000000000L + t11.tv_nsec;
-    nanosec /= 1000L;
-    *p1 = nanosec;
-    ptime = (uint64_t*)p1;
+  if(options && thread_lstat){
+    data->l_stat = thread_lstat;
+    data->lat_op = options - 1;
+    data->start_ns = _op_start_ns();
   }
 #endif
   ret = kvs_delete_kvp_async(db->cont_hd, kvskey, &option,
-                              data, ptime, on_io_complete);
+                              data, NULL, on_io_complete);
   if (ret) {
-    if(data) free(data);
-    if(ptime) free(ptime);
+    _free_op(db, data);
     fprintf(stderr, "KVBENCH: delete tuple async failed for %s, err 0x%x\n", (char*)key->buf, ret);
     exit(1);
   }
@@ -845,25 +844,39 @@ couchstore_error_t kvs_delete_async(Db *db, sized_buf *key,
   return COUCHSTORE_SUCCESS;
 }
 
-void pass_lstat_to_db(Db *db, latency_stat *l_read, latency_stat *l_write, latency_stat *l_delete)
+void pass_lstat_to_db(Db *db, latency_stat *l_stat)
+{
+  // async ops record into the stats of the thread that issued them
+  thread_lstat = l_stat;
+}
+
+void reserve_ops_in_db(Db *db, int tid, int nops)
+{
+  // called by the thread itself before it starts issuing ops
+  struct kv_thread *t = _get_thread(db, tid);
+
+  if (t->slabs == NULL && nops > 0) {
+    _add_slab(t, nops);
+  }
+}
+
+void pass_op_start_to_db(Db *db, uint64_t start_ns)
 {
-  db->l_read = l_read;
-  db->l_write = l_write;
-  db->l_delete = l_delete;
+  // latency of the next async op is measured from its intended start, so
+  // that the time it waited for a free queue slot is not hidden
+  thread_start_ns = start_ns;
 }
 
 int release_context(Db *db, IoContext **contexts, int nr){
 
-  if(use_udd || kdd_is_polling == 0) {
-    for (int i =0 ;i < nr ; i++) {
-      if (contexts[i]) {
-      	std::unique_lock<std::mutex> lock(db->lock_k);
-      	db->iocontexts->push(contexts[i]);
-      	//push_ctx(db, contexts[i], 0);
-      }
+  // the contexts are embedded in the ops, which go back to the pool of the
+  // thread that reaped them
+  for (int i =0 ;i < nr ; i++) {
+    if (contexts[i]) {
+      _free_op(db, (kv_bench_data *)contexts[i]);
     }
   }
-  
+
   return 0;
 }
 
@@ -899,9 +912,29 @@ couchstore_error_t couchstore_kvs_reset_aiocompletion(){
   return COUCHSTORE_SUCCESS;
 }
 
-couchstore_error_t couchstore_kvs_set_max_sample(uint32_t sample_num)
+couchstore_error_t couchstore_kvs_set_packing(int enable, uint32_t max_value_len, uint8_t compaction_threshold)
+{
+  kv_packing = enable;
+  kv_packing_option.max_value_len = max_value_len;
+  kv_packing_option.compaction_threshold = compaction_threshold;
+  return COUCHSTORE_SUCCESS;
+}
+
+couchstore_error_t couchstore_kvs_set_qos(int enable, uint32_t max_inflight, uint32_t iops_limit, uint64_t bandwidth_limit)
 {
-  max_sample = sample_num;
+  kv_qos = enable;
+  memset(&kv_qos_option, 0, sizeof(kv_qos_option));
+  kv_qos_option.max_inflight = max_inflight;
+  kv_ks_qos_option.iops_limit = iops_limit;
+  kv_ks_qos_option.bandwidth_limit = bandwidth_limit;
+  return COUCHSTORE_SUCCESS;
+}
+
+// class of the commands of the calling bench thread
+couchstore_error_t couchstore_kvs_set_thread_qos(int qos_class)
+{
+  if (!kv_qos) return COUCHSTORE_SUCCESS;
+  kvs_set_thread_qos_class((kvs_qos_class)qos_class);
   return COUCHSTORE_SUCCESS;
 }
 
@@ -914,7 +947,17 @@ couchstore_error_t couchstore_close_device(int32_t dev_id)
 LIBCOUCHSTORE_API
 couchstore_error_t couchstore_db_info(Db *db, DbInfo* info)
 {
-    // TBD: need to get container information here, device usage
+    // the device is the whole db: capacity and used space only
+    uint64_t capacity = 0;
+    uint32_t utilization = 0;
+
+    if (kvs_get_device_capacity(db->dev, &capacity) != KVS_SUCCESS ||
+        kvs_get_device_utilization(db->dev, &utilization) != KVS_SUCCESS) {
+      return COUCHSTORE_ERROR_READ;
+    }
+    info->file_size = capacity;
+    // utilization is in 0.01%
+    info->space_used = (uint64_t)((double)capacity * utilization / 10000);
     return COUCHSTORE_SUCCESS;
 }
  
@@ -976,6 +1019,22 @@ couchstore_error_t couchstore_open_document(Db *db,
     return COUCHSTORE_SUCCESS;
 }
 
+// read-modify-write of key: value receives the value read and is written back
+couchstore_error_t couchstore_rmw_document_kv(Db *db,
+					      sized_buf *key,
+					      sized_buf *value,
+					      couchstore_open_options options)
+{
+  if(kv_write_mode == 1) {
+    Doc doc = {key->tid, *key, *value};
+    Doc *docs[1] = {&doc};
+
+    kvs_get_sync(db, key, value, options);
+    return kvs_store_sync(db, docs, 1, options);
+  }
+  return kvs_rmw_async(db, key, value, options);
+}
+
 couchstore_error_t couchstore_delete_document_kv(Db *db,
 						 sized_buf *key,
 						 couchstore_open_options options)
@@ -995,6 +1054,70 @@ couchstore_error_t couchstore_delete_document(Db *db,
   return COUCHSTORE_SUCCESS; 
 }
 
+LIBCOUCHSTORE_API
+couchstore_error_t couchstore_scan_docs(Db *db,
+                                        const uint8_t *bitmask,
+                                        const uint8_t *pattern,
+                                        int with_value,
+                                        couchstore_walk_tree_callback_fn callback,
+                                        void *ctx)
+{
+  kvs_key_group_filter iter_ctx;
+  kvs_option_iterator option;
+  kvs_iterator_handle iter_hd;
+  kvs_iterator_list iter_list;
+  DocInfo doc_info;
+  uint8_t *it_buffer;
+  uint32_t i;
+  int ret, c_ret = 0;
+
+  // a zero bitmask is a key group of every key
+  memset(&iter_ctx, 0, sizeof(kvs_key_group_filter));
+  if (bitmask) {
+    memcpy(iter_ctx.bitmask, bitmask, sizeof(iter_ctx.bitmask));
+    memcpy(iter_ctx.bit_pattern, pattern, sizeof(iter_ctx.bit_pattern));
+  }
+  memset(&option, 0, sizeof(kvs_option_iterator));
+  option.iter_type = (with_value) ? KVS_ITERATOR_KEY_VALUE : KVS_ITERATOR_KEY;
+
+  // a device keeps one iterator per key group and a few groups at a time:
+  // scans of the same group take turns, the others run concurrently
+  while ((ret = kvs_create_iterator(db->cont_hd, &option, &iter_ctx,
+                                    &iter_hd)) == KVS_ERR_ITERATOR_OPEN ||
+         ret == KVS_ERR_ITERATOR_MAX) {
+    usleep(100);
+  }
+  if (ret != KVS_SUCCESS) {
+    return COUCHSTORE_ERROR_READ;
+  }
+
+  memset(&doc_info, 0, sizeof(DocInfo));
+  iter_list.it_list = (uint8_t*)kvs_malloc(iter_read_size, 4096);
+  iter_list.end = 0;
+  while (c_ret >= 0 && !iter_list.end) {
+    iter_list.size = iter_read_size;
+    iter_list.num_entries = 0;
+    ret = kvs_iterate_next(db->cont_hd, iter_hd, &iter_list);
+    if (ret == KVS_SUCCESS && iter_list.num_entries == 0 && !iter_list.end) {
+      // the next pair does not fit into the buffer of the iterator
+      ret = KVS_ERR_BUFFER_SMALL;
+    }
+    if (ret != KVS_SUCCESS) {
+      break;
+    }
+    it_buffer = iter_list.it_list;
+    for (i = 0; i < iter_list.num_entries && c_ret >= 0; ++i) {
+      it_buffer = _iter_list_entry(it_buffer, with_value, &doc_info);
+      c_ret = callback(db, 0, &doc_info, 0, NULL, ctx);
+    }
+  }
+
+  kvs_free(iter_list.it_list);
+  kvs_delete_iterator(db->cont_hd, iter_hd);
+
+  return (ret == KVS_SUCCESS) ? COUCHSTORE_SUCCESS : COUCHSTORE_ERROR_READ;
+}
+
 LIBCOUCHSTORE_API
 couchstore_error_t couchstore_walk_id_tree(Db *db,
                                            const sized_buf* startDocID,
@@ -1002,8 +1125,17 @@ couchstore_error_t couchstore_walk_id_tree(Db *db,
                                            couchstore_walk_tree_callback_fn callback,
                                            void *ctx)
 {
-  // TBD: iterator - phase 2
-  return COUCHSTORE_SUCCESS;
+  // KV devices do not keep keys in order: the walk visits the keys that
+  // share the first two bytes of startDocID (a key group), in device order
+  uint8_t bitmask[4] = {0xff, 0xff, 0, 0};
+  uint8_t pattern[4] = {0, 0, 0, 0};
+
+  if (startDocID == NULL || startDocID->size < 2) {
+    return couchstore_scan_docs(db, NULL, NULL, 0, callback, ctx);
+  }
+  pattern[0] = startDocID->buf[0];
+  pattern[1] = startDocID->buf[1];
+  return couchstore_scan_docs(db, bitmask, pattern, 0, callback, ctx);
 }
 
 couchstore_error_t couchstore_kvs_malloc(size_t size_bytes, void **buf){
@@ -497,6 +497,76 @@ couchstore_error_t couchstore_walk_id_tree(Db *db,
     return COUCHSTORE_SUCCESS;
 }
 
+// first four bytes of a key under bitmask, as in the key groups of KV devices
+static bool _scan_match(const char *key, size_t len, const uint8_t *bitmask,
+                        const uint8_t *pattern)
+{
+    size_t i;
+    uint8_t c;
+
+    for (i = 0; i < 4; ++i) {
+        c = (i < len) ? (uint8_t)key[i] : 0;
+        if ((c ^ pattern[i]) & bitmask[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// smallest key of a key group: the keys of a prefix group are next to
+// each other, from there on
+static size_t _scan_start(const uint8_t *bitmask, const uint8_t *pattern,
+                          char *start)
+{
+    size_t i, len = 0;
+
+    for (i = 0; i < 4; ++i) {
+        start[i] = pattern[i] & bitmask[i];
+        if (bitmask[i]) {
+            len = i + 1;
+        }
+    }
+    return len;
+}
+
+LIBCOUCHSTORE_API
+couchstore_error_t couchstore_scan_docs(Db *db,
+                                        const uint8_t *bitmask,
+                                        const uint8_t *pattern,
+                                        int with_value,
+                                        couchstore_walk_tree_callback_fn callback,
+                                        void *ctx)
+{
+    rocksdb::Iterator* rit = db->db->NewIterator(rocksdb::ReadOptions());
+    rocksdb::Slice keyptr;
+    DocInfo doc_info = DOC_INFO_INITIALIZER;
+    char start[4];
+
+    if (bitmask) {
+        rit->Seek(rocksdb::Slice(start, _scan_start(bitmask, pattern, start)));
+    } else {
+        rit->SeekToFirst();
+    }
+
+    for (; rit->Valid(); rit->Next()) {
+        keyptr = rit->key();
+        if (bitmask &&
+            !_scan_match(keyptr.data(), keyptr.size(), bitmask, pattern)) {
+            break;
+        }
+        doc_info.id.buf = (char *)keyptr.data();
+        doc_info.id.size = keyptr.size();
+        doc_info.size = (with_value) ? rit->value().size() : 0;
+        if (callback(db, 0, &doc_info, 0, NULL, ctx) < 0) {
+            break;
+        }
+    }
+
+    delete rit;
+
+    return COUCHSTORE_SUCCESS;
+}
+
 LIBCOUCHSTORE_API
 void couchstore_free_document(Doc *doc)
 {
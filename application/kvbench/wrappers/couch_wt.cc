@@ -400,6 +400,88 @@ couchstore_error_t couchstore_walk_id_tree(Db *db,
     return COUCHSTORE_SUCCESS;
 }
 
+// first four bytes of a key under bitmask, as in the key groups of KV devices
+static bool _scan_match(const char *key, size_t len, const uint8_t *bitmask,
+                        const uint8_t *pattern)
+{
+    size_t i;
+    uint8_t c;
+
+    for (i = 0; i < 4; ++i) {
+        c = (i < len) ? (uint8_t)key[i] : 0;
+        if ((c ^ pattern[i]) & bitmask[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// smallest key of a key group: the keys of a prefix group are next to
+// each other, from there on
+static size_t _scan_start(const uint8_t *bitmask, const uint8_t *pattern,
+                          char *start)
+{
+    size_t i, len = 0;
+
+    for (i = 0; i < 4; ++i) {
+        start[i] = pattern[i] & bitmask[i];
+        if (bitmask[i]) {
+            len = i + 1;
+        }
+    }
+    return len;
+}
+
+LIBCOUCHSTORE_API
+couchstore_error_t couchstore_scan_docs(Db *db,
+                                        const uint8_t *bitmask,
+                                        const uint8_t *pattern,
+                                        int with_value,
+                                        couchstore_walk_tree_callback_fn callback,
+                                        void *ctx)
+{
+    WT_CURSOR *cursor = db->cursor;
+    WT_ITEM item;
+    DocInfo doc_info = DOC_INFO_INITIALIZER;
+    char start[4];
+    int ret, exact;
+
+    if (bitmask) {
+        item.data = start;
+        item.size = _scan_start(bitmask, pattern, start);
+        cursor->set_key(cursor, &item);
+        ret = cursor->search_near(cursor, &exact);
+        if (ret == 0 && exact < 0) {
+            ret = cursor->next(cursor);
+        }
+    } else {
+        cursor->reset(cursor);
+        ret = cursor->next(cursor);
+    }
+
+    for (; ret == 0; ret = cursor->next(cursor)) {
+        cursor->get_key(cursor, &item);
+        doc_info.id.buf = (char *)item.data;
+        doc_info.id.size = item.size;
+        if (bitmask &&
+            !_scan_match(doc_info.id.buf, doc_info.id.size, bitmask, pattern)) {
+            break;
+        }
+        doc_info.size = 0;
+        if (with_value) {
+            cursor->get_value(cursor, &item);
+            doc_info.size = item.size;
+        }
+        if (callback(db, 0, &doc_info, 0, NULL, ctx) < 0) {
+            break;
+        }
+    }
+    cursor->reset(cursor);
+
+    return (ret == 0 || ret == WT_NOTFOUND) ?
+           COUCHSTORE_SUCCESS : COUCHSTORE_ERROR_READ;
+}
+
 LIBCOUCHSTORE_API
 void couchstore_free_document(Doc *doc)
 {